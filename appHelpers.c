@@ -5,15 +5,71 @@
  * table-based MLS app assignment (ECE 361 HW #4)
 */
 
+#define _POSIX_C_SOURCE 200809L     // for mmap() and friends with -std=c99
 
  #include <stdlib.h>
  #include <stdio.h>
  #include <string.h>
  #include <ctype.h>
+ #include <limits.h>
+
+#if defined(_WIN32)
+ #define CSV_USE_MMAP 0
+#else
+ #define CSV_USE_MMAP 1
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+#endif
+
+ #include <pthread.h>
 
  #include "hash_table.h"
+ #include "sharded_table.h"
  #include "appHelpers.h"
 
+// a parsed record waiting to be inserted into its shard
+typedef struct _csvStaged_s {
+	uint64_t	hash;
+	char		key[MAX_KEY_LEN + 1];
+	TeamInfo_t	info;
+} csvStaged_t;
+
+// records staged by one thread for one shard
+typedef struct _csvStage_s {
+	csvStaged_t*	items;
+	long			count;
+	long			capacity;
+} csvStage_t;
+
+// what each thread of loadTeamInfoCsvParallel() works on
+typedef struct _csvWorker_s {
+	sht_table*		sht;
+	const char*		begin;		// the thread's chunk of the file
+	const char*		end;
+	int				id;
+	int				numThreads;
+	struct _csvWorker_s*	workers;	// every thread, phase 2 reads their stages
+	csvStage_t*		stages;		// one per shard
+	long			numStaged;
+	int				failed;		// phase 2 ran out of memory, some records weren't inserted
+	csvLoadResult_t	result;		// line numbers are relative to the chunk
+} csvWorker_t;
+
+// helpers for loadTeamInfoCsv() and loadTeamInfoCsvParallel()
+static int mapCsvFile(const char* path, const char** data, size_t* size, void** mapping);
+static void unmapCsvFile(const char* data, size_t size, void* mapping);
+static const char* csvLineEnd(const char* line, const char* end, const char** last);
+static void addCsvError(csvLoadResult_t* result, const long line, const int numFields);
+static void* parseCsvChunk(void* arg);
+static void* mergeCsvShards(void* arg);
+static const char* scanField(const char* p, const char* end, char* field, const int maxLen);
+static const char* scanInt(const char* p, const char* end, int* value);
+static int makeKey(const TeamInfo_t* info, char* key);
+static TeamInfoPtr_t findTeam(ht_hash_table* ht, const char* team, bool* newTeam);
+static int isComment(const char* p, const char* end);
+
  /**
  * parseTeamInfo() - parses a buffer to create a Team Info record
  *
@@ -88,16 +144,33 @@
  * @returns         a pointer to a character string containing the key for a hash table
  */
 char* createKey(TeamInfoPtr_t teamInfoPtr) {
-	char *key = malloc(MAX_CONF_NAME + MAX_CITY_NAME + 1); // string for key
+	char *key = malloc(MAX_KEY_LEN + 1); // string for key
+
+	if (key == NULL) {
+		return NULL;
+	}
+	return buildKey(teamInfoPtr, key);
+}
 
-	strcpy(key, "");
+/**
+ * buildKey() - Builds the key for a team info record in a caller's buffer
+ *
+ * Same key as createKey() but nothing is allocated, so the caller can use a
+ * buffer on the stack for a key that is only needed for one insert or search.
+ *
+ * @param teamInfoPtr   pointer to a team info record
+ * @param key           buffer for the key, at least MAX_KEY_LEN + 1 chars
+ *
+ * @returns         key
+ */
+char* buildKey(TeamInfoPtr_t teamInfoPtr, char* key) {
 	strcpy(key, teamInfoPtr->city);
 	strcat(key, teamInfoPtr->conf);
 	strUpper(key);
 
 	#if (_DEBUG_ > 0)
 		fprintf(stderr,
-			"INFO(createKey()): Generated key is %s\n\n",
+			"INFO(buildKey()): Generated key is %s\n\n",
 			key);
 	#endif
 
@@ -121,3 +194,796 @@ char* strUpper(char* str) {
     }
     return str;
 }
+
+/**
+ * parseConf() - converts a conference name to a conf_t
+ *
+ * @param	name		conference name (NWSL, EAST or WEST, in any case)
+ * @param	conf		filled in with the conference
+ *
+ * @return	0 on success, -1 if name isn't a conference
+ */
+int parseConf(const char* name, conf_t* conf) {
+	static const char* const names[] = {"NWSL", "EAST", "WEST"};
+
+	for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+		int j = 0;
+		while ((names[i][j] != '\0') && (toupper((unsigned char)name[j]) == names[i][j])) {
+			j++;
+		}
+		if ((names[i][j] == '\0') && (name[j] == '\0')) {
+			*conf = (conf_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * teamInfoKey() - gets the key of a team info record in a string key table
+ *
+ * A wal_key_fn, so a write-ahead log can find the key of a value that changed.
+ *
+ * @param	value		pointer to a team info record
+ * @param	key			buffer for the key, at least MAX_KEY_LEN + 1 chars
+ *
+ * @return	the length of the key
+ */
+int teamInfoKey(const void* value, void* key) {
+	const TeamInfo_t* info = value;
+	char* k = key;
+	int len = 0;
+
+	// the same key as buildKey() in one pass, it is built for every logged change
+	for (const char* p = info->city; *p != '\0'; p++) {
+		k[len++] = (char)toupper((unsigned char)*p);
+	}
+	for (const char* p = info->conf; *p != '\0'; p++) {
+		k[len++] = (char)toupper((unsigned char)*p);
+	}
+	k[len] = '\0';
+	return len;
+}
+
+/**
+ * teamInfoPackedKey() - gets the key of a team info record in a packed key table
+ *
+ * @param	value		pointer to a team info record
+ * @param	key			filled in with the ht_packed_key
+ *
+ * @return	sizeof(ht_packed_key), -1 if the record's conference or city can't be packed
+ */
+int teamInfoPackedKey(const void* value, void* key) {
+	const TeamInfo_t* info = value;
+	conf_t conf;
+
+	if ((parseConf(info->conf, &conf) != 0) || (ht_pack_key(key, conf, info->city) != 0)) {
+		return -1;
+	}
+	return (int)sizeof(ht_packed_key);
+}
+
+/**
+ * parseTeamInfoFields() - parses one CSV line into a caller's Team Info record
+ *
+ * This is the reentrant version of parseTeamInfo(): it parses straight into
+ * the caller's record, never prints and doesn't need a '\0' at the end of the
+ * line.  It accepts the same format as parseTeamInfo() (spaces are allowed in
+ * front of the team name and the numbers) and stops at the end of the line.
+ *
+ * @param	buf			first character of the line
+ * @param	end			one past the last character of the line (not including the '\n')
+ * @param	info		record to fill in
+ *
+ * @return	the number of fields parsed, NUMTEAMINFOFIELDS if the whole record
+ * was parsed
+ */
+int parseTeamInfoFields(const char* buf, const char* end, TeamInfoPtr_t info) {
+	int* const stats[] = {&info->pts, &info->win, &info->loss, &info->tie, &info->gd};
+	const char* p = buf;
+	int numFields = 0;
+
+	if ((p = scanField(p, end, info->conf, MAX_CONF_NAME)) == NULL) {
+		return numFields;
+	}
+	numFields++;
+	if ((p = scanField(p, end, info->city, MAX_CITY_NAME)) == NULL) {
+		return numFields;
+	}
+	numFields++;
+	while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+		p++;
+	}
+	if ((p = scanField(p, end, info->name, MAX_TEAM_NAME)) == NULL) {
+		return numFields;
+	}
+	numFields++;
+	for (int i = 0; i < 5; i++) {
+		if ((p = scanInt(p, end, stats[i])) == NULL) {
+			return numFields;
+		}
+		numFields++;
+	}
+	return numFields;
+}
+
+/**
+ * loadTeamInfoCsv() - bulk loads a CSV file of Team Info records into a hash table
+ *
+ * The file is mapped into memory (read in one piece on Windows) and scanned
+ * line by line with parseTeamInfoFields().  Each record is parsed directly into
+ * memory from ht_alloc_value() and inserted with its key, so there is no copy
+ * of the record and no per-line buffer.  The number of lines is counted first
+ * so the hash table is resized once with ht_reserve() before the inserts.
+ * If the table uses packed keys (HT_KEY_PACKED) the keys are packed with
+ * ht_pack_key() instead of built as strings.
+ *
+ * Lines with // in them are comments.  Lines that can't be parsed are counted
+ * and the first CSV_MAX_ERRORS are saved in result; nothing is printed so the
+ * caller decides how to report them.
+ *
+ * @param	ht			hash table to load the records into
+ * @param	path		path of the CSV file
+ * @param	result		filled in with the line, record, comment and error counts
+ *
+ * @return	the number of records loaded or -1 if the file could not be read
+ */
+long loadTeamInfoCsv(ht_hash_table* ht, const char* path, csvLoadResult_t* result) {
+	const char* data;
+	size_t size;
+	void* mapping;
+	char key[MAX_KEY_LEN + 1];
+	TeamInfoPtr_t info = NULL;
+
+	memset(result, 0, sizeof(csvLoadResult_t));
+	if (mapCsvFile(path, &data, &size, &mapping) != 0) {
+		return -1;
+	}
+
+	// count the lines so the table only has to grow once
+	long numLines = 0;
+	for (const char* p = data; (p = memchr(p, '\n', (size_t)(data + size - p))) != NULL; p++) {
+		numLines++;
+	}
+	ht_reserve(ht, (numLines < INT_MAX) ? (int)numLines : INT_MAX);
+
+	const char* end = data + size;
+	const char* line = data;
+	while (line < end) {
+		const char* last;
+		const char* eol = csvLineEnd(line, end, &last);
+		result->numLines++;
+
+		// comments in the file contain // and blank lines are skipped
+		if ((last == line) || isComment(line, last)) {
+			result->numComments++;
+		}
+		else {
+			if (info == NULL) {
+				info = ht_alloc_value(ht, sizeof(TeamInfo_t));
+				if (info == NULL) {
+					break;
+				}
+			}
+			const int numFields = parseTeamInfoFields(line, last, info);
+			conf_t conf;
+			ht_packed_key packed;
+			if (ht->key_mode == HT_KEY_PACKED) {
+				if ((numFields == NUMTEAMINFOFIELDS) && (parseConf(info->conf, &conf) == 0) &&
+				    (ht_pack_key(&packed, conf, info->city) == 0)) {
+					ht_insert_packed(ht, &packed, info);
+					info = NULL;
+					result->numRecords++;
+				}
+				else {
+					addCsvError(result, result->numLines, numFields);
+				}
+			}
+			else if ((numFields == NUMTEAMINFOFIELDS) && (makeKey(info, key) == 0)) {
+				ht_insert(ht, key, info);
+				info = NULL;
+				result->numRecords++;
+			}
+			else {
+				addCsvError(result, result->numLines, numFields);
+			}
+		}
+		line = eol + 1;
+	}
+	ht_free_value(ht, info);
+
+	unmapCsvFile(data, size, mapping);
+	return result->numRecords;
+}
+
+/**
+ * applyMatchResult() - updates the standings with the result of one match
+ *
+ * The line looks like HOME,AWAY,score where HOME and AWAY are team keys (the
+ * city followed by the conference, in any case, ex: PortlandNWSL) and the score
+ * is the home team's goals, a '-' and the away team's goals (ex: 2-1).  The
+ * Team Info records of both teams are updated in place: pts, win, loss, tie and
+ * gd.  A team that isn't in the hash table is added with an empty record.
+ *
+ * @param	ht			hash table with the Team Info records (any key mode)
+ * @param	line		first character of the line
+ * @param	end			end of the line (not including the '\n')
+ * @param	newTeam		set to true if a team was added (may be NULL)
+ *
+ * @return	the number of fields parsed, 3 if the result was applied
+ */
+int applyMatchResult(ht_hash_table* ht, const char* line, const char* end, bool* newTeam) {
+	char home[MAX_KEY_LEN + 1];
+	char away[MAX_KEY_LEN + 1];
+	int homeGoals, awayGoals;
+	const char* p = line;
+	bool homeNew = false, awayNew = false;
+
+	if (newTeam != NULL) {
+		*newTeam = false;
+	}
+	if ((p = scanField(p, end, home, MAX_KEY_LEN)) == NULL) {
+		return 0;
+	}
+	if ((p = scanField(p, end, away, MAX_KEY_LEN)) == NULL) {
+		return 1;
+	}
+	if (((p = scanInt(p, end, &homeGoals)) == NULL) || (homeGoals < 0) ||
+	    (p >= end) || (*p != '-') ||
+	    ((p = scanInt(p + 1, end, &awayGoals)) == NULL) || (awayGoals < 0)) {
+		return 2;
+	}
+	while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+		p++;
+	}
+	if (p != end) {
+		return 2;
+	}
+
+	// both teams are looked up before either record is changed
+	TeamInfoPtr_t homeTeam = findTeam(ht, home, &homeNew);
+	TeamInfoPtr_t awayTeam = (homeTeam != NULL) ? findTeam(ht, away, &awayNew) : NULL;
+	if (newTeam != NULL) {
+		*newTeam = homeNew || awayNew;
+	}
+	if ((awayTeam == NULL) || (awayTeam == homeTeam)) {
+		if (homeNew) {   // a new team is in the table even if the result isn't valid
+			ht_end_update(ht, homeTeam);
+		}
+		return 2;
+	}
+
+	// the records change in place, so the table's observers (ex: a standings
+	// index) are told before and after.  A new team is already being updated
+	if (!homeNew) {
+		ht_begin_update(ht, homeTeam);
+	}
+	if (!awayNew) {
+		ht_begin_update(ht, awayTeam);
+	}
+
+	const int diff = homeGoals - awayGoals;
+	homeTeam->gd += diff;
+	awayTeam->gd -= diff;
+	if (diff > 0) {
+		homeTeam->win++;
+		homeTeam->pts += PTS_PER_WIN;
+		awayTeam->loss++;
+	}
+	else if (diff < 0) {
+		awayTeam->win++;
+		awayTeam->pts += PTS_PER_WIN;
+		homeTeam->loss++;
+	}
+	else {
+		homeTeam->tie++;
+		awayTeam->tie++;
+		homeTeam->pts += PTS_PER_TIE;
+		awayTeam->pts += PTS_PER_TIE;
+	}
+	ht_end_update(ht, homeTeam);
+	ht_end_update(ht, awayTeam);
+	return 3;
+}
+
+/**
+ * applyMatchResults() - streams match results into the standings
+ *
+ * Reads HOME,AWAY,score lines (see applyMatchResult()) from a file or stdin
+ * until the end of the file and applies each one as it is read, so a live feed
+ * can be piped in.  Each result costs two hash table lookups and updates the
+ * records in place; nothing is allocated unless a new team shows up.  Lines
+ * with // in them are comments.  Lines that can't be parsed (or are longer
+ * than MATCH_MAX_LINE) are counted and skipped.
+ *
+ * @param	ht			hash table with the Team Info records (not a snapshot)
+ * @param	fp			file to read, ex: stdin
+ * @param	result		filled in with the line, result, comment and error counts
+ *
+ * @return	the number of results applied
+ */
+long applyMatchResults(ht_hash_table* ht, FILE* fp, matchFeedResult_t* result) {
+	char buf[MATCH_MAX_LINE + 2];
+
+	memset(result, 0, sizeof(matchFeedResult_t));
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		size_t len = strlen(buf);
+		int numFields = -1;
+		result->numLines++;
+
+		if ((len > 0) && (buf[len - 1] != '\n') && !feof(fp)) {
+			// too long, skip the rest of the line
+			int c;
+			while (((c = fgetc(fp)) != EOF) && (c != '\n')) {
+			}
+			numFields = 0;
+		}
+		else {
+			while ((len > 0) && ((buf[len - 1] == '\n') || (buf[len - 1] == '\r'))) {
+				len--;
+			}
+			if ((len == 0) || isComment(buf, buf + len)) {
+				result->numComments++;
+				continue;
+			}
+			bool newTeam;
+			numFields = applyMatchResult(ht, buf, buf + len, &newTeam);
+			result->numNewTeams += newTeam;
+		}
+
+		if (numFields == 3) {
+			result->numResults++;
+		}
+		else {
+			if (result->numErrors < CSV_MAX_ERRORS) {
+				result->errors[result->numErrors].line = result->numLines;
+				result->errors[result->numErrors].numFields = numFields;
+			}
+			result->numErrors++;
+		}
+	}
+	return result->numResults;
+}
+
+/**
+ * loadTeamInfoCsvParallel() - bulk loads a CSV file into a sharded table with several threads
+ *
+ * The file is mapped as in loadTeamInfoCsv() and split into numThreads chunks
+ * that start and end on line boundaries.  The load then runs in two phases:
+ *
+ *  1. each thread parses its chunk and appends every record, with its key and
+ *     the key's hash, to its own staging buffer for the record's shard
+ *  2. each thread takes every numThreads'th shard and inserts the records that
+ *     all of the threads staged for it, in file order
+ *
+ * A shard is only ever touched by one thread, so neither phase needs a lock.
+ * The shards should have their own arenas (sht_use_arenas()) since the arena
+ * of a table isn't thread-safe.  A key that appears twice ends up with the value
+ * of its last line, the same as loadTeamInfoCsv().
+ *
+ * @param	sht			sharded table to load the records into
+ * @param	path		path of the CSV file
+ * @param	numThreads	number of threads to use (at least 1, at most CSV_MAX_THREADS)
+ * @param	result		filled in with the line, record, comment and error counts
+ *
+ * @return	the number of records loaded or -1 if the file could not be read, a
+ * thread could not be started or a shard ran out of memory for the records
+ */
+long loadTeamInfoCsvParallel(sht_table* sht, const char* path, int numThreads,
+                             csvLoadResult_t* result) {
+	const char* data;
+	size_t size;
+	void* mapping;
+	csvWorker_t workers[CSV_MAX_THREADS];
+	pthread_t threads[CSV_MAX_THREADS];
+	long status = 0;
+
+	memset(result, 0, sizeof(csvLoadResult_t));
+	numThreads = (numThreads < 1) ? 1 : (numThreads > CSV_MAX_THREADS) ? CSV_MAX_THREADS : numThreads;
+	if (mapCsvFile(path, &data, &size, &mapping) != 0) {
+		return -1;
+	}
+
+	// split the file into chunks that end just after a '\n'
+	const char* chunk = data;
+	for (int i = 0; i < numThreads; i++) {
+		const char* chunkEnd = data + size;
+		if (i < numThreads - 1) {
+			chunkEnd = data + size / (size_t)numThreads * (size_t)(i + 1);
+			chunkEnd = (chunkEnd < chunk) ? chunk : chunkEnd;
+			const char* eol = memchr(chunkEnd, '\n', (size_t)(data + size - chunkEnd));
+			chunkEnd = (eol != NULL) ? eol + 1 : data + size;
+		}
+		memset(&workers[i], 0, sizeof(csvWorker_t));
+		workers[i].sht = sht;
+		workers[i].begin = chunk;
+		workers[i].end = chunkEnd;
+		workers[i].id = i;
+		workers[i].numThreads = numThreads;
+		workers[i].workers = workers;
+		workers[i].stages = calloc((size_t)sht->num_shards, sizeof(csvStage_t));
+		if (workers[i].stages == NULL) {
+			status = -1;
+		}
+		chunk = chunkEnd;
+	}
+
+	// phase 1: parse, phase 2: insert into the shards
+	void* (*const phases[])(void*) = {parseCsvChunk, mergeCsvShards};
+	for (int phase = 0; (phase < 2) && (status == 0); phase++) {
+		int started = 0;
+		while ((started < numThreads) &&
+		       (pthread_create(&threads[started], NULL, phases[phase], &workers[started]) == 0)) {
+			started++;
+		}
+		for (int i = 0; i < started; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		if (started < numThreads) {
+			status = -1;
+		}
+	}
+
+	// the error line numbers are relative to each chunk
+	long firstLine = 0;
+	for (int i = 0; i < numThreads; i++) {
+		const csvLoadResult_t* part = &workers[i].result;
+		for (long e = 0; (e < part->numErrors) && (e < CSV_MAX_ERRORS); e++) {
+			addCsvError(result, firstLine + part->errors[e].line, part->errors[e].numFields);
+		}
+		result->numErrors += part->numErrors - ((part->numErrors < CSV_MAX_ERRORS) ? part->numErrors : CSV_MAX_ERRORS);
+		result->numLines += part->numLines;
+		result->numComments += part->numComments;
+		result->numRecords += workers[i].numStaged;
+		firstLine += part->numLines;
+		if (workers[i].failed) {
+			status = -1;
+		}
+
+		for (int s = 0; (workers[i].stages != NULL) && (s < sht->num_shards); s++) {
+			free(workers[i].stages[s].items);
+		}
+		free(workers[i].stages);
+	}
+
+	unmapCsvFile(data, size, mapping);
+	return (status == 0) ? result->numRecords : -1;
+}
+
+/**
+ * parseCsvChunk() - phase 1 of loadTeamInfoCsvParallel(), parses a chunk into staging buffers
+ *
+ * @param	arg			the thread's csvWorker_t
+ *
+ * @return	NULL
+ */
+static void* parseCsvChunk(void* arg) {
+	csvWorker_t* worker = arg;
+	csvLoadResult_t* result = &worker->result;
+	const char* line = worker->begin;
+	csvStaged_t record;
+
+	while (line < worker->end) {
+		const char* last;
+		const char* eol = csvLineEnd(line, worker->end, &last);
+		result->numLines++;
+
+		if ((last == line) || isComment(line, last)) {
+			result->numComments++;
+		}
+		else {
+			const int numFields = parseTeamInfoFields(line, last, &record.info);
+			if ((numFields == NUMTEAMINFOFIELDS) && (makeKey(&record.info, record.key) == 0)) {
+				record.hash = ht_hash_string(record.key);
+				csvStage_t* stage = &worker->stages[sht_shard_of(worker->sht, record.hash)];
+				if (stage->count == stage->capacity) {
+					const long capacity = (stage->capacity == 0) ? 64 : stage->capacity * 2;
+					csvStaged_t* items = realloc(stage->items, (size_t)capacity * sizeof(csvStaged_t));
+					if (items == NULL) {
+						addCsvError(result, result->numLines, numFields);
+						line = eol + 1;
+						continue;
+					}
+					stage->items = items;
+					stage->capacity = capacity;
+				}
+				stage->items[stage->count++] = record;
+				worker->numStaged++;
+			}
+			else {
+				addCsvError(result, result->numLines, numFields);
+			}
+		}
+		line = eol + 1;
+	}
+	return NULL;
+}
+
+/**
+ * mergeCsvShards() - phase 2 of loadTeamInfoCsvParallel(), fills this thread's shards
+ *
+ * @param	arg			the thread's csvWorker_t
+ *
+ * @return	NULL
+ */
+static void* mergeCsvShards(void* arg) {
+	csvWorker_t* worker = arg;
+	sht_table* sht = worker->sht;
+
+	for (int s = worker->id; s < sht->num_shards; s += worker->numThreads) {
+		ht_hash_table* shard = sht->shards[s];
+		long total = 0;
+		for (int w = 0; w < worker->numThreads; w++) {
+			total += worker->workers[w].stages[s].count;
+		}
+		ht_reserve(shard, (total < INT_MAX) ? (int)total : INT_MAX);
+
+		for (int w = 0; w < worker->numThreads; w++) {
+			const csvStage_t* stage = &worker->workers[w].stages[s];
+			for (long i = 0; i < stage->count; i++) {
+				TeamInfoPtr_t info = ht_alloc_value(shard, sizeof(TeamInfo_t));
+				if (info == NULL) {
+					worker->failed = 1;
+					return NULL;
+				}
+				*info = stage->items[i].info;
+				ht_insert_hashed(shard, stage->items[i].key, stage->items[i].hash, info);
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * mapCsvFile() - maps a file into memory (reads it in one piece on Windows)
+ *
+ * @param	path		path of the file
+ * @param	data		set to the first character of the file
+ * @param	size		set to the size of the file
+ * @param	mapping		set to what unmapCsvFile() needs to release it
+ *
+ * @return	0 on success, -1 if the file could not be read
+ */
+static int mapCsvFile(const char* path, const char** data, size_t* size, void** mapping) {
+#if CSV_USE_MMAP
+	struct stat st;
+	void* map = NULL;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	if ((fstat(fd, &st) != 0) || (st.st_size < 0)) {
+		close(fd);
+		return -1;
+	}
+	*size = (size_t)st.st_size;
+	if (*size > 0) {
+		map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return -1;
+		}
+		posix_madvise(map, *size, POSIX_MADV_SEQUENTIAL);
+	}
+	close(fd);
+	*data = map;
+	*mapping = map;
+#else
+	char* copy;
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	*size = (size_t)ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	copy = malloc(*size + 1);
+	if ((copy == NULL) || (fread(copy, 1, *size, fp) != *size)) {
+		free(copy);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	*data = copy;
+	*mapping = copy;
+#endif
+	return 0;
+}
+
+/**
+ * unmapCsvFile() - releases a file mapped by mapCsvFile()
+ */
+static void unmapCsvFile(const char* data, size_t size, void* mapping) {
+	(void)data;
+#if CSV_USE_MMAP
+	if (mapping != NULL) {
+		munmap(mapping, size);
+	}
+#else
+	(void)size;
+	free(mapping);
+#endif
+}
+
+/**
+ * csvLineEnd() - finds the end of a line
+ *
+ * @param	line		first character of the line
+ * @param	end			end of the file (or chunk)
+ * @param	last		set to the end of the line's text, not counting a '\r'
+ *
+ * @return	pointer to the line's '\n' (or end if it is the last line)
+ */
+static const char* csvLineEnd(const char* line, const char* end, const char** last) {
+	const char* eol = memchr(line, '\n', (size_t)(end - line));
+	if (eol == NULL) {
+		eol = end;
+	}
+	*last = ((eol > line) && (eol[-1] == '\r')) ? eol - 1 : eol;
+	return eol;
+}
+
+/**
+ * addCsvError() - counts a line that could not be parsed and saves the first few
+ *
+ * @param	result		load result to add the error to
+ * @param	line		line number of the error
+ * @param	numFields	number of fields parsed before the error
+ */
+static void addCsvError(csvLoadResult_t* result, const long line, const int numFields) {
+	if (result->numErrors < CSV_MAX_ERRORS) {
+		result->errors[result->numErrors].line = line;
+		result->errors[result->numErrors].numFields = numFields;
+	}
+	result->numErrors++;
+}
+
+/**
+ * scanField() - copies a text field up to the next comma
+ *
+ * @param	p			first character of the field
+ * @param	end			end of the line
+ * @param	field		where to copy the field, room for maxLen chars and a '\0'
+ * @param	maxLen		longest field that fits
+ *
+ * @return	pointer to the character after the comma, or NULL if the field is
+ * empty, too long or there is no comma after it
+ */
+static const char* scanField(const char* p, const char* end, char* field, const int maxLen) {
+	const char* comma = memchr(p, ',', (size_t)(end - p));
+	if ((comma == NULL) || (comma == p) || (comma - p > maxLen)) {
+		return NULL;
+	}
+	memcpy(field, p, (size_t)(comma - p));
+	field[comma - p] = '\0';
+	return comma + 1;
+}
+
+/**
+ * scanInt() - converts a (possibly negative) integer field
+ *
+ * Leading spaces are skipped.  The field ends at a comma (which is skipped)
+ * or anything else that isn't a digit.
+ *
+ * @param	p			first character of the field
+ * @param	end			end of the line
+ * @param	value		set to the value of the field
+ *
+ * @return	pointer to the start of the next field, or NULL if there are no digits
+ * or the number doesn't fit in an int
+ */
+static const char* scanInt(const char* p, const char* end, int* value) {
+	long v = 0;
+	int negative;
+	const char* digits;
+
+	while ((p < end) && (*p == ' ')) {
+		p++;
+	}
+	negative = (p < end) && (*p == '-');
+	p += negative;
+	digits = p;
+	while ((p < end) && ((unsigned)(*p - '0') < 10) && (p - digits < 10)) {
+		v = v * 10 + (*p - '0');
+		p++;
+	}
+	if ((p == digits) || (v > INT_MAX)) {
+		return NULL;
+	}
+	*value = (int)(negative ? -v : v);
+	return ((p < end) && (*p == ',')) ? p + 1 : p;
+}
+
+/**
+ * makeKey() - builds the (uppercase) key for a record without strcat()
+ *
+ * @param	info		Team Info record
+ * @param	key			buffer for the key, at least MAX_KEY_LEN + 1 chars
+ *
+ * @return	0 on success, -1 if the key doesn't fit
+ */
+static int makeKey(const TeamInfo_t* info, char* key) {
+	const size_t cityLen = strlen(info->city);
+	const size_t confLen = strlen(info->conf);
+
+	if (cityLen + confLen > MAX_KEY_LEN) {
+		return -1;
+	}
+	for (size_t i = 0; i < cityLen; i++) {
+		key[i] = (char)toupper((unsigned char)info->city[i]);
+	}
+	for (size_t i = 0; i < confLen; i++) {
+		key[cityLen + i] = (char)toupper((unsigned char)info->conf[i]);
+	}
+	key[cityLen + confLen] = '\0';
+	return 0;
+}
+
+/**
+ * findTeam() - finds the Team Info record for a team key, adding the team if it's new
+ *
+ * The last 4 characters of the key are the conference, the rest is the city.
+ * The key is packed or uppercased to match the table's key mode.
+ *
+ * @param	ht			hash table with the Team Info records
+ * @param	team		team key, ex: PortlandNWSL
+ * @param	newTeam		set to true if the team was added, left alone otherwise
+ *
+ * @return	the team's record (updated in place by the caller) or NULL if the key
+ * isn't valid or the team couldn't be added
+ */
+static TeamInfoPtr_t findTeam(ht_hash_table* ht, const char* team, bool* newTeam) {
+	static const char* const confNames[] = {"NWSL", "EAST", "WEST"};
+	const size_t len = strlen(team);
+	const size_t confLen = 4;
+	char city[MAX_CITY_NAME + 1];
+	TeamInfoPtr_t info;
+	conf_t conf;
+	int inserted;
+
+	if ((len <= confLen) || (len - confLen > MAX_CITY_NAME) || (parseConf(team + len - confLen, &conf) != 0)) {
+		return NULL;
+	}
+	memcpy(city, team, len - confLen);
+	city[len - confLen] = '\0';
+
+	if (ht->key_mode == HT_KEY_PACKED) {
+		ht_packed_key key;
+		if (ht_pack_key(&key, conf, city) != 0) {
+			return NULL;
+		}
+		info = ht_get_or_insert_packed(ht, &key, sizeof(TeamInfo_t), &inserted);
+	}
+	else {
+		char key[MAX_KEY_LEN + 1];
+		for (size_t i = 0; i < len; i++) {
+			key[i] = (char)toupper((unsigned char)team[i]);
+		}
+		key[len] = '\0';
+		info = ht_get_or_insert(ht, key, sizeof(TeamInfo_t), &inserted);
+	}
+
+	if ((info != NULL) && inserted) {
+		strcpy(info->conf, confNames[conf]);
+		strcpy(info->city, city);
+		*newTeam = true;
+	}
+	return info;
+}
+
+/**
+ * isComment() - checks whether a line has a // comment in it
+ *
+ * @param	p			first character of the line
+ * @param	end			end of the line
+ *
+ * @return	1 if the line contains //, 0 if it doesn't
+ */
+static int isComment(const char* p, const char* end) {
+	while ((p = memchr(p, '/', (size_t)(end - p))) != NULL) {
+		if ((++p < end) && (*p == '/')) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -9,15 +9,58 @@
 #define _APPHELPERS_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "hash_table.h"
+#include "sharded_table.h"
 
 // define constants
 #define NUMTEAMINFOFIELDS 8	
+#define MAX_KEY_LEN       (MAX_CITY_NAME + MAX_CONF_NAME)   // not counting the \0
+#define CSV_MAX_ERRORS    32    // per-line errors saved by loadTeamInfoCsv()
+#define CSV_MAX_THREADS   64    // most threads loadTeamInfoCsvParallel() will use
+#define MATCH_MAX_LINE    128   // longest line applyMatchResults() accepts
+#define PTS_PER_WIN       3
+#define PTS_PER_TIE       1
+
+// a line of a CSV file that could not be parsed
+typedef struct _csvError_s {
+	long	line;         // line number in the file (the first line is 1)
+	int		numFields;    // number of fields parsed before the error
+} csvError_t;
+
+// what loadTeamInfoCsv() found in a CSV file
+typedef struct _csvLoadResult_s {
+	long	numLines;     // lines in the file
+	long	numRecords;   // team info records inserted into the hash table
+	long	numComments;  // comment (//) and blank lines
+	long	numErrors;    // lines that could not be parsed
+	csvError_t	errors[CSV_MAX_ERRORS];   // the first CSV_MAX_ERRORS errors
+} csvLoadResult_t;
+
+// what applyMatchResults() did with a feed of match results
+typedef struct _matchFeedResult_s {
+	long	numLines;     // lines read
+	long	numResults;   // match results applied to the standings
+	long	numComments;  // comment (//) and blank lines
+	long	numNewTeams;  // teams that weren't in the hash table and were added
+	long	numErrors;    // lines that could not be parsed
+	csvError_t	errors[CSV_MAX_ERRORS];   // the first CSV_MAX_ERRORS errors
+} matchFeedResult_t;
 
 // function prototypes
 TeamInfoPtr_t parseTeamInfo(char *buf);
 void printTeamInfo(TeamInfoPtr_t teamInfo);
 char* createKey(TeamInfoPtr_t teamInfoPtr);
+char* buildKey(TeamInfoPtr_t teamInfoPtr, char* key);
 char* strUpper(char* str);
+int parseConf(const char* name, conf_t* conf);
+int teamInfoKey(const void* value, void* key);
+int teamInfoPackedKey(const void* value, void* key);
+int parseTeamInfoFields(const char* buf, const char* end, TeamInfoPtr_t info);
+long loadTeamInfoCsv(ht_hash_table* ht, const char* path, csvLoadResult_t* result);
+long loadTeamInfoCsvParallel(sht_table* sht, const char* path, int numThreads,
+                             csvLoadResult_t* result);
+int applyMatchResult(ht_hash_table* ht, const char* line, const char* end, bool* newTeam);
+long applyMatchResults(ht_hash_table* ht, FILE* fp, matchFeedResult_t* result);
 
 #endif
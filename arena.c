@@ -0,0 +1,171 @@
+/**
+ * arena.c - Arena (slab) allocator for the Hash table ADT
+ *
+ * @brief   This is the source code file for an arena allocator.  Memory is
+ * taken from malloc() in large chunks and blocks are bump-allocated from the
+ * current chunk.  Every block has a small header that records its size class
+ * so it can go back on the free list for that class when it is freed; the
+ * next allocation of that class pops it off again.  Blocks larger than
+ * ARENA_MAX_BLOCK are not recycled, their memory comes back when the whole
+ * arena is deleted.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "hash_table.h"
+#include "arena.h"
+
+// constants, typedefs and global variables
+#define ARENA_LARGE_BLOCK   UINT32_MAX    // size class of a block that isn't recycled
+
+// header in front of every block, padded so the block stays aligned
+typedef union {
+  uint32_t size_class;
+  char pad[ARENA_ALIGN];
+} arena_header_t;
+
+// prototypes for the Helper functions
+
+// get a new chunk with room for at least size bytes
+static int arena_grow(arena_t* arena, size_t size);
+
+
+/**
+ * arena_new() - creates a new arena
+ *
+ * No memory is taken for blocks until the first allocation.
+ *
+ * @param chunk_size is the number of bytes to take from malloc() at a time,
+ * 0 uses ARENA_CHUNK_SIZE
+ *
+ * @return a pointer to the new arena or NULL if it could not be allocated
+ */
+arena_t* arena_new(size_t chunk_size) {
+  arena_t* arena = calloc(1, sizeof(arena_t));
+  if (arena == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr,
+        "ERROR(arena_new()): Could not allocate space for the arena\n");
+    #endif
+    return NULL;
+  }
+  arena->chunk_size = (chunk_size == 0) ? ARENA_CHUNK_SIZE : chunk_size;
+  return arena;
+}
+
+
+/**
+ * arena_del() - deletes an arena
+ *
+ * Frees every chunk of the arena, and with them every block that was allocated
+ * from it, in one pass over the chunk list.
+ *
+ * @param arena is a pointer to the arena to delete
+ */
+void arena_del(arena_t* arena) {
+  if (arena == NULL) {
+    return;
+  }
+  arena_chunk_t* chunk = arena->chunks;
+  while (chunk != NULL) {
+    arena_chunk_t* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
+
+
+/**
+ * arena_alloc() - allocates a block of memory from the arena
+ *
+ * Blocks up to ARENA_MAX_BLOCK bytes are taken off the free list for their size
+ * class if a block of that class has been freed, otherwise they are cut off the
+ * current chunk.
+ *
+ * @param arena is a pointer to the arena
+ * @param size is the number of bytes needed
+ *
+ * @return a pointer to a block aligned to ARENA_ALIGN or NULL if out of memory
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+  const size_t rounded = (size == 0) ? ARENA_ALIGN : (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  const uint32_t size_class = (rounded <= ARENA_MAX_BLOCK) ? (uint32_t)(rounded / ARENA_ALIGN - 1) : ARENA_LARGE_BLOCK;
+  arena_header_t* header;
+
+  if ((size_class != ARENA_LARGE_BLOCK) && (arena->free_list[size_class] != NULL)) {
+    void* block = arena->free_list[size_class];
+    arena->free_list[size_class] = *(void**)block;
+    arena->bytes_in_use += rounded;
+    return block;
+  }
+
+  if ((size_t)(arena->end - arena->next) < sizeof(arena_header_t) + rounded) {
+    if (arena_grow(arena, sizeof(arena_header_t) + rounded) != 0) {
+      return NULL;
+    }
+  }
+  header = (arena_header_t*)arena->next;
+  header->size_class = size_class;
+  arena->next += sizeof(arena_header_t) + rounded;
+  arena->bytes_in_use += rounded;
+  return header + 1;
+}
+
+
+/**
+ * arena_free() - returns a block to the arena
+ *
+ * The block is pushed on the free list for its size class.  The first bytes of
+ * a free block hold the link to the next free block of the class.
+ *
+ * @param arena is a pointer to the arena the block was allocated from
+ * @param block is the block to free (NULL is ignored)
+ */
+void arena_free(arena_t* arena, void* block) {
+  if (block == NULL) {
+    return;
+  }
+  const uint32_t size_class = ((arena_header_t*)block - 1)->size_class;
+  if (size_class == ARENA_LARGE_BLOCK) {
+    return;
+  }
+  *(void**)block = arena->free_list[size_class];
+  arena->free_list[size_class] = block;
+  arena->bytes_in_use -= ((size_t)size_class + 1) * ARENA_ALIGN;
+}
+
+
+// Helper functions
+
+/**
+ * arena_grow() - adds a new chunk to the arena
+ *
+ * Whatever is left of the current chunk is abandoned; it is freed with the rest
+ * of the arena.
+ *
+ * @param arena is a pointer to the arena
+ * @param size is the number of bytes the new chunk must have room for
+ *
+ * @return 0 on success, -1 if the chunk could not be allocated
+ */
+static int arena_grow(arena_t* arena, size_t size) {
+  const size_t chunk_bytes = (size > arena->chunk_size) ? size : arena->chunk_size;
+  const size_t header_bytes = (sizeof(arena_chunk_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  arena_chunk_t* chunk = malloc(header_bytes + chunk_bytes);
+  if (chunk == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr,
+        "ERROR(arena_grow()): Could not allocate a chunk of %lu bytes\n",
+        (unsigned long)chunk_bytes);
+    #endif
+    return -1;
+  }
+  chunk->size = chunk_bytes;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  arena->next = (char*)chunk + header_bytes;
+  arena->end = arena->next + chunk_bytes;
+  return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * arena.h - Arena (slab) allocator for the Hash table ADT
+ *
+ * @brief   This is the header file for an arena allocator that hands out
+ * keys and values for a hash table from large chunks of memory.  Freed
+ * blocks are kept on a free list per size class and reused, and the whole
+ * arena is released at once when the hash table is deleted.
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// constants
+#define ARENA_CHUNK_SIZE    (64 * 1024)   // default size of a chunk in bytes
+#define ARENA_ALIGN         8             // blocks are aligned (and sized) to this
+#define ARENA_MAX_BLOCK     256           // largest block that is recycled on a free list
+#define ARENA_NUM_CLASSES   (ARENA_MAX_BLOCK / ARENA_ALIGN)
+
+// struct containing one chunk of the arena
+typedef struct _arena_chunk_s {
+  struct _arena_chunk_s* next;
+  size_t size;                        // usable bytes after the chunk header
+} arena_chunk_t;
+
+// struct containing the arena
+typedef struct {
+  size_t chunk_size;                  // bytes to ask malloc() for at a time
+  arena_chunk_t* chunks;              // chunk being bump-allocated from is first
+  char* next;                         // next free byte in the first chunk
+  char* end;                          // end of the first chunk
+  void* free_list[ARENA_NUM_CLASSES]; // freed blocks, one list per size class
+  size_t bytes_in_use;                // bytes handed out and not freed (w/o headers)
+} arena_t;
+
+
+// API function prototypes
+
+// creates a new arena that allocates chunk_size bytes at a time (0 for the default)
+arena_t* arena_new(size_t chunk_size);
+
+// releases every chunk of the arena at once
+void arena_del(arena_t* arena);
+
+// allocates a block of memory from the arena
+void* arena_alloc(arena_t* arena, size_t size);
+
+// returns a block to the arena so it can be reused
+void arena_free(arena_t* arena, void* block);
+
+#endif
@@ -0,0 +1,2719 @@
+/**
+ * bench_hashtable.c - Microbenchmarks for the Hash table ADT
+ *
+ * @brief  This program times the hash function and lookups of the Hash table
+ * ADT.  It compares the current code against the original hash table, which
+ * called pow() for every character, reduced the hash with % on every
+ * iteration, ran both hash passes again on every probe attempt and marked
+ * deleted buckets with tombstones.  The original code is reproduced in this
+ * file (legacy_*) so the two can be compared in the same build.
+ *
+ * The keys look like the keys that createKey() makes (uppercase city
+ * followed by the conference, ex: PORTLANDWEST).
+ *
+ * usage: bench_hashtable [lookup|churn|load|batch|threads|stress|build|snapshot|packed|nocase|frozen|feed|
+ *                         standings|prefix|columns|typed|compact|wal|filter|seasons|big]
+ *                        [num_keys] [num_ops] [max_threads]
+ *
+ *  lookup  - hit and miss searches
+ *  churn   - keys are constantly deleted and other keys inserted; the search
+ *            times are reported after every round of churn
+ *  load    - bulk loads num_keys team info records and deletes the table,
+ *            with malloc() and with an arena for the keys and values
+ *  batch   - num_ops random searches (3/4 hits) one at a time with ht_search()
+ *            and in batches of BATCH_QUERIES with ht_search_batch().  Use
+ *            1M+ keys so the table doesn't fit in the L2 cache.
+ *  threads - throughput of the concurrent table with 1..max_threads threads
+ *            (90% searches, 5% inserts, 5% deletes), next to a hash table
+ *            behind one global mutex.  Each thread does num_ops operations.
+ *  stress  - max_threads/2 writers insert, replace and delete their own keys
+ *            while the other threads search and check every value they get
+ *            back.  The final contents are checked against what the writers
+ *            did.  Exits with 1 if anything was wrong.
+ *  build   - writes a CSV file with num_keys team info records and times
+ *            loadTeamInfoCsv() into one table against
+ *            loadTeamInfoCsvParallel() into a sharded table with
+ *            1..max_threads threads.
+ *  snapshot - loads the same kind of CSV file, saves it with ht_save_snapshot()
+ *            and times ht_open_snapshot() and searches of the mapped file.
+ *  packed  - inserts, searches and deletes with string keys built the way
+ *            test_hashtable used to (city + conference, uppercased) and
+ *            with packed keys (HT_KEY_PACKED).  Both tables must agree.
+ *            Then ht_search_packed_batch() vs single packed searches.
+ *  nocase  - hashes and searches of uppercase keys in a normal table and in a
+ *            case-insensitive table (HT_KEY_NOCASE), then mixed case keys
+ *            uppercased by the caller vs passed straight to the
+ *            case-insensitive table.  Both tables must agree.
+ *  frozen  - hit and miss searches before and after ht_freeze(), and the time
+ *            it takes to build the perfect hash.  Both must find the same values.
+ *  feed    - loads num_keys team info records, writes num_ops random match
+ *            results and times applyMatchResults() on them.  The standings
+ *            are checked afterwards (every win is someone's loss, the goal
+ *            differences still add up to the same total, no records added).
+ *  standings - loads num_keys team info records with a standings index
+ *            attached, then applies num_ops match results while deleting,
+ *            re-inserting and replacing teams.  Times top 10 queries with
+ *            st_top_k() against searching and sorting the whole conference,
+ *            then checks the index against a full sort of the table.
+ *  prefix  - loads num_keys team info records with a prefix index attached
+ *            and times px_search() against scanning every record with
+ *            strncmp(), then deletes, re-inserts and replaces teams and checks
+ *            num_ops / 1000 random prefixes against the scan.
+ *  columns - the same num_keys teams in a hash table of TeamInfo_t records and
+ *            in a columnar store (team_columns.h).  Times per-conference
+ *            totals and a gd > 10 filter walking the records against the
+ *            columns, then deletes and replaces teams and checks that both
+ *            still agree.  Use 1M+ keys.
+ *  typed   - the same num_keys teams in a packed key hash table of malloc'd
+ *            TeamInfo_t records and in a tt_table (team_table.h) that stores
+ *            the records in its slots.  Times the inserts, num_ops random
+ *            searches and the deletes, and checks that both find the same
+ *            records.
+ *  compact - the same num_keys teams with string keys and malloc'd records,
+ *            with string keys and records from an arena, and as packed
+ *            records (team_record.h) in a trt_table.  Reports the bytes per
+ *            team of each and times num_ops searches, then checks that all
+ *            three hold the same teams.  Keys too long to be inline are
+ *            inserted and deleted along the way.
+ *  wal     - loads num_keys team info records and applies num_ops match
+ *            results, deletes and re-inserts, with and without a write-ahead
+ *            log (wal.h).  Reports the cost of the log per operation as a
+ *            share of the 10 us an operation has at 100K ops/sec.  Then the
+ *            log is replayed into a fresh table, compacted and replayed into
+ *            an empty table, and replayed again with a torn record at the
+ *            end.  Every replay must give the same table.
+ *  filter  - hit and miss searches of num_keys keys with and without a Bloom
+ *            filter (ht_use_filter()): in a table, with ht_search_batch(),
+ *            frozen and opened from a snapshot.  Reports the expected and the
+ *            measured false positive rate.  Then keys are deleted,
+ *            re-inserted and added past the filter's capacity, and a table
+ *            with a filter is checked against one without.
+ *  seasons - writes SEASONS CSV files of num_keys teams and times loading
+ *            them into a catalog (catalog.h) with 1 and max_threads threads.
+ *            Then num_ops / 1000 versions are published, each moving points
+ *            between two of SEASON_TEAMS teams and deleting or putting back
+ *            another team, while max_threads - 1 readers check that every
+ *            version they hold has the same total.  Reports the cost of a
+ *            publish against copying the whole table, and checks the first
+ *            and the last version against the files.
+ *  big     - inserts at least BIG_MIN_KEYS packed keys (with NULL values), past
+ *            the ~21.4M items where count * 100 no longer fits in an int, and
+ *            checks that the table keeps growing and never shrinks below
+ *            HT_GROW_LOAD while most of the keys are deleted again.  Needs
+ *            about 3.5 GB.
+ *
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "hash_table.h"
+#include "concurrent_table.h"
+#include "sharded_table.h"
+#include "appHelpers.h"
+#include "standings.h"
+#include "prefix_index.h"
+#include "team_columns.h"
+#include "team_table.h"
+#include "team_record.h"
+#include "wal.h"
+#include "catalog.h"
+#include "prime.h"
+
+// constants
+#define DEFAULT_NUM_KEYS      100000
+#define DEFAULT_NUM_OPS       1000000
+#define CHURN_ROUNDS          10
+#define BATCH_QUERIES         1024    // keys per ht_search_batch() call
+#define MAX_THREADS           64
+#define BIG_MIN_KEYS          24000000  // past the 21.4M where count * 100 overflows an int
+#define BUILD_SHARDS          64      // shards in the build mode's sharded table
+#define BUILD_CSV             "bench_build.csv"
+#define BUILD_SNAPSHOT        "bench_build.snap"
+#define FEED_CSV              "bench_feed.csv"
+#define WAL_LOG               "bench_wal.log"
+#define FILTER_SNAPSHOT       "bench_filter.snap"
+#define SEASON_CSV            "bench_season%d.csv"
+#define SEASONS               4
+#define SEASON_TEAMS          64      // teams the seasons mode's writer moves points between
+#define WAL_BUDGET_NS         10000.0   // per operation at 100K ops/sec
+#define STANDINGS_TOP         10      // teams per top-k query in the standings mode
+#define LEGACY_PRIME_1        151
+#define LEGACY_PRIME_2        193
+
+static const char* confs[] = {"NWSL", "EAST", "WEST"};
+static char legacy_deleted[] = "";    // tombstone for the original table
+
+// prevents the compiler from optimizing away the work being timed
+static volatile unsigned long sink;
+
+// what each thread of the threads and stress modes works on
+typedef struct {
+  int id;
+  int num_threads;
+  int num_keys;
+  int num_ops;
+  char** keys;
+  cht_table* cht;                 // concurrent table, or
+  ht_hash_table* ht;              // hash table behind ht_lock
+  pthread_mutex_t* ht_lock;
+  unsigned long errors;
+  int* present;                   // stress: the writer's view of its keys
+  int* version;
+} thread_arg_t;
+
+// value stored by the stress mode, readers check that id matches the key
+typedef struct {
+  int id;
+  int version;
+} stress_value_t;
+
+static volatile int stress_done;
+
+
+/**
+ * now_ns() - reads the monotonic clock
+ *
+ * @return the current time in nanoseconds
+ */
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+/**
+ * make_keys() - generates keys that look like the ones createKey() makes
+ *
+ * @param num_keys is the number of keys to generate
+ * @param prefix distinguishes sets of keys (ex: keys that are never inserted)
+ *
+ * @return an array of num_keys strings.  Free with free_keys()
+ */
+static char** make_keys(const int num_keys, const char* prefix) {
+  char** keys = malloc((size_t)num_keys * sizeof(char*));
+  for (int i = 0; i < num_keys; i++) {
+    keys[i] = malloc(MAX_KEY_LEN + 1);
+    snprintf(keys[i], MAX_KEY_LEN + 1, "%s%07d%s", prefix, i, confs[i % 3]);
+  }
+  return keys;
+}
+
+static void free_keys(char** keys, const int num_keys) {
+  for (int i = 0; i < num_keys; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+}
+
+
+// original hash function and double hashing
+static int legacy_generic_hash(const char* s, const int a, const int m) {
+  long hash = 0;
+
+  const int len_s = strlen(s);
+  for (int i = 0; i < len_s; i++) {
+      hash += (long)pow(a, len_s - (i+1)) * s[i];
+      hash = hash % m;
+  }
+  return (int)hash;
+}
+
+static int legacy_get_hash(const char* s, const int num_buckets, const int attempt) {
+    const int hash_a = legacy_generic_hash(s, LEGACY_PRIME_1, num_buckets);
+    const int hash_b = legacy_generic_hash(s, LEGACY_PRIME_2, num_buckets);
+    return (int)((hash_a + ((long)attempt * (1 + hash_b % (num_buckets - 1)))) % num_buckets);
+}
+
+// original probe loops over an array of pointers to the keys.  A deleted
+// bucket holds a tombstone that searches skip and inserts reuse.  The probe
+// loops are capped at size attempts; the original spun forever on a table
+// with no NULL buckets left.
+static void legacy_insert(char** slots, const int size, char* key) {
+  for (int i = 0; i < size; i++) {
+    int index = legacy_get_hash(key, size, i);
+    if ((slots[index] == NULL) || (slots[index] == legacy_deleted)) {
+      slots[index] = key;
+      return;
+    }
+  }
+}
+
+static int legacy_find(char** slots, const int size, const char* key) {
+  for (int i = 0; i < size; i++) {
+    int index = legacy_get_hash(key, size, i);
+    if (slots[index] == NULL) {
+      break;
+    }
+    if ((slots[index] != legacy_deleted) && (strcmp(slots[index], key) == 0)) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+static char* legacy_search(char** slots, const int size, const char* key) {
+  int index = legacy_find(slots, size, key);
+  return (index < 0) ? NULL : slots[index];
+}
+
+static void legacy_delete(char** slots, const int size, const char* key) {
+  int index = legacy_find(slots, size, key);
+  if (index >= 0) {
+    slots[index] = legacy_deleted;
+  }
+}
+
+
+/**
+ * time_searches() - times searches in the original and the current table
+ *
+ * @param legacy_ns is set to the ns/search for the original table
+ * @param new_ns is set to the ns/search for the current table
+ */
+static void time_searches(char** legacy_slots, const int legacy_size, ht_hash_table* ht,
+                          char** keys, const int num_keys, const int num_ops,
+                          double* legacy_ns, double* new_ns) {
+  double t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    sink += (unsigned long)(legacy_search(legacy_slots, legacy_size, keys[((size_t)i * 7919) % (size_t)num_keys]) != NULL);
+  }
+  *legacy_ns = (now_ns() - t0) / num_ops;
+
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    sink += (unsigned long)(ht_search(ht, keys[((size_t)i * 7919) % (size_t)num_keys]) != NULL);
+  }
+  *new_ns = (now_ns() - t0) / num_ops;
+}
+
+
+/**
+ * bench_lookup() - hit and miss searches in tables that hold num_keys keys
+ */
+static void bench_lookup(const int num_keys, const int num_ops) {
+  double legacy_ns, new_ns;
+  char** keys = make_keys(num_keys, "CITY");
+  char** misses = make_keys(num_keys, "TOWN");
+  printf("Lookup: %d keys, %d searches\n\n", num_keys, num_ops);
+
+  // build the original table and the current table with the same keys
+  const int legacy_size = next_prime(num_keys * 2);
+  char** legacy_slots = calloc((size_t)legacy_size, sizeof(char*));
+  ht_hash_table* ht = ht_new_sized(num_keys * 2);
+  for (int i = 0; i < num_keys; i++) {
+    legacy_insert(legacy_slots, legacy_size, keys[i]);
+    ht_insert(ht, keys[i], NULL);
+  }
+
+  time_searches(legacy_slots, legacy_size, ht, keys, num_keys, num_ops, &legacy_ns, &new_ns);
+  printf("%-28s %10.1f ns/op (original)  %10.1f ns/op (new)  %6.1fx\n",
+         "hit search", legacy_ns, new_ns, legacy_ns / new_ns);
+
+  // unsuccessful searches walk the whole probe chain
+  time_searches(legacy_slots, legacy_size, ht, misses, num_keys, num_ops, &legacy_ns, &new_ns);
+  printf("%-28s %10.1f ns/op (original)  %10.1f ns/op (new)  %6.1fx\n",
+         "miss search", legacy_ns, new_ns, legacy_ns / new_ns);
+
+  free(legacy_slots);
+  ht_del_hash_table(ht);
+  free_keys(keys, num_keys);
+  free_keys(misses, num_keys);
+}
+
+
+/**
+ * bench_churn() - searches while keys are constantly deleted and re-added
+ *
+ * Both tables hold num_keys of a pool of 2 * num_keys keys.  Each round of churn
+ * deletes num_keys / 2 random keys and inserts the same number of keys that
+ * weren't in the table.  The original table leaves a tombstone for every delete so
+ * its searches get slower round after round; the Robin Hood table should stay flat.
+ */
+static void bench_churn(const int num_keys, const int num_ops) {
+  const int pool_size = num_keys * 2;
+  double legacy_hit, new_hit, legacy_miss, new_miss;
+  char** pool = make_keys(pool_size, "CITY");
+  char** misses = make_keys(num_keys, "TOWN");
+  int* present = malloc((size_t)pool_size * sizeof(int));   // pool indexes, first num_keys are in the tables
+  printf("Churn: %d keys, %d rounds of %d deletes + inserts, %d searches per round\n\n",
+         num_keys, CHURN_ROUNDS, num_keys / 2, num_ops);
+
+  const int legacy_size = next_prime(num_keys * 2);
+  char** legacy_slots = calloc((size_t)legacy_size, sizeof(char*));
+  ht_hash_table* ht = ht_new_sized(num_keys * 2);
+  for (int i = 0; i < pool_size; i++) {
+    present[i] = i;
+  }
+  for (int i = 0; i < num_keys; i++) {
+    legacy_insert(legacy_slots, legacy_size, pool[i]);
+    ht_insert(ht, pool[i], NULL);
+  }
+
+  printf("%5s  %14s %14s  %14s %14s\n", "round", "orig hit ns", "orig miss ns", "new hit ns", "new miss ns");
+  srand(361);
+  for (int round = 0; round <= CHURN_ROUNDS; round++) {
+    if (round > 0) {
+      for (int i = 0; i < num_keys / 2; i++) {
+        // swap a random key that is in the tables with one that is not
+        const int in = rand() % num_keys;
+        const int out = num_keys + (rand() % num_keys);
+        legacy_delete(legacy_slots, legacy_size, pool[present[in]]);
+        ht_delete(ht, pool[present[in]]);
+        legacy_insert(legacy_slots, legacy_size, pool[present[out]]);
+        ht_insert(ht, pool[present[out]], NULL);
+        const int tmp = present[in];
+        present[in] = present[out];
+        present[out] = tmp;
+      }
+    }
+
+    char** hits = malloc((size_t)num_keys * sizeof(char*));
+    for (int i = 0; i < num_keys; i++) {
+      hits[i] = pool[present[i]];
+    }
+    time_searches(legacy_slots, legacy_size, ht, hits, num_keys, num_ops, &legacy_hit, &new_hit);
+    time_searches(legacy_slots, legacy_size, ht, misses, num_keys, num_ops, &legacy_miss, &new_miss);
+    printf("%5d  %14.1f %14.1f  %14.1f %14.1f\n", round, legacy_hit, legacy_miss, new_hit, new_miss);
+    free(hits);
+  }
+
+  free(legacy_slots);
+  ht_del_hash_table(ht);
+  free(present);
+  free_keys(pool, pool_size);
+  free_keys(misses, num_keys);
+}
+
+
+/**
+ * bench_load() - bulk load and delete a table, with and without an arena
+ *
+ * Every record is a TeamInfo_t like the ones test_hashtable.c loads.  The table is
+ * sized for the keys up front so the times are mostly allocation and copying.
+ */
+static void bench_load(const int num_keys) {
+  char** keys = make_keys(num_keys, "CITY");
+  TeamInfo_t info;
+  double load_ns[2], del_ns[2];
+  printf("Load: %d team info records\n\n", num_keys);
+
+  // the first pass pays for faulting the pages in, the second one is reported
+  memset(&info, 0, sizeof(info));
+  for (int pass = 0; pass < 2; pass++) {
+    for (int use_arena = 0; use_arena <= 1; use_arena++) {
+      double t0 = now_ns();
+      ht_hash_table* ht = ht_new_sized(num_keys * 2);
+      if (use_arena) {
+        ht_use_arena(ht, arena_new(0));
+      }
+      for (int i = 0; i < num_keys; i++) {
+        TeamInfoPtr_t value = ht_alloc_value(ht, sizeof(TeamInfo_t));
+        memcpy(value, &info, sizeof(TeamInfo_t));
+        value->pts = i;
+        ht_insert(ht, keys[i], value);
+      }
+      load_ns[use_arena] = (now_ns() - t0) / num_keys;
+
+      t0 = now_ns();
+      ht_del_hash_table(ht);
+      del_ns[use_arena] = (now_ns() - t0) / num_keys;
+    }
+  }
+
+  printf("%-28s %10.1f ns/op (malloc)    %10.1f ns/op (arena)  %6.1fx\n",
+         "insert", load_ns[0], load_ns[1], load_ns[0] / load_ns[1]);
+  printf("%-28s %10.1f ns/op (malloc)    %10.1f ns/op (arena)  %6.1fx\n",
+         "delete table", del_ns[0], del_ns[1], del_ns[0] / del_ns[1]);
+  free_keys(keys, num_keys);
+}
+
+
+/**
+ * bench_batch() - single searches vs batched searches
+ *
+ * The queries are drawn at random from the keys (3 out of 4) and from keys that
+ * aren't in the table, so every search is likely to be a cache miss.  Both ways
+ * must return the same values.
+ */
+static void bench_batch(const int num_keys, const int num_ops) {
+  char** keys = make_keys(num_keys, "CITY");
+  char** misses = make_keys(num_keys, "TOWN");
+  const char** queries = malloc((size_t)num_ops * sizeof(char*));
+  void** single = malloc((size_t)num_ops * sizeof(void*));
+  void** batched = malloc((size_t)num_ops * sizeof(void*));
+  double t0, single_ns, batch_ns;
+  printf("Batch: %d keys, %d searches, %d keys per batch\n\n", num_keys, num_ops, BATCH_QUERIES);
+
+  ht_hash_table* ht = ht_new_sized(num_keys * 2);
+  ht_use_arena(ht, arena_new(0));
+  for (int i = 0; i < num_keys; i++) {
+    int* value = ht_alloc_value(ht, sizeof(int));
+    *value = i;
+    ht_insert(ht, keys[i], value);
+  }
+  srand(361);
+  for (int i = 0; i < num_ops; i++) {
+    const int k = (int)(((unsigned)rand() * (RAND_MAX + 1u) + (unsigned)rand()) % (unsigned)num_keys);
+    queries[i] = ((rand() % 4) != 0) ? keys[k] : misses[k];
+  }
+
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    single[i] = ht_search(ht, queries[i]);
+  }
+  single_ns = (now_ns() - t0) / num_ops;
+
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i += BATCH_QUERIES) {
+    const int n = ((num_ops - i) < BATCH_QUERIES) ? (num_ops - i) : BATCH_QUERIES;
+    ht_search_batch(ht, queries + i, n, batched + i);
+  }
+  batch_ns = (now_ns() - t0) / num_ops;
+
+  printf("%-28s %10.1f ns/op (single)    %10.1f ns/op (batch)  %6.1fx\n",
+         "search", single_ns, batch_ns, single_ns / batch_ns);
+  if (memcmp(single, batched, (size_t)num_ops * sizeof(void*)) != 0) {
+    printf("ERROR: ht_search_batch() and ht_search() returned different values\n");
+  }
+
+  ht_del_hash_table(ht);
+  free(queries);
+  free(single);
+  free(batched);
+  free_keys(keys, num_keys);
+  free_keys(misses, num_keys);
+}
+
+
+/**
+ * next_rand() - xorshift random numbers, rand() isn't thread-safe
+ *
+ * @param state is the thread's random number state (not 0)
+ *
+ * @return the next random number
+ */
+static unsigned next_rand(unsigned* state) {
+  unsigned x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+
+static void* mixed_ops_thread(void* p) {
+  thread_arg_t* arg = p;
+  unsigned state = 2166136261u + (unsigned)arg->id * 16777619u;
+  unsigned long found = 0;
+  cht_thread* thread = (arg->cht != NULL) ? cht_register(arg->cht) : NULL;
+
+  for (int i = 0; i < arg->num_ops; i++) {
+    const unsigned r = next_rand(&state);
+    const char* key = arg->keys[(r >> 8) % (unsigned)arg->num_keys];
+    const unsigned op = r % 20;
+    int value;
+
+    if (thread != NULL) {
+      if (op == 0) {
+        int* v = malloc(sizeof(int));
+        *v = i;
+        cht_insert(arg->cht, thread, key, v);
+      }
+      else if (op == 1) {
+        cht_delete(arg->cht, thread, key);
+      }
+      else {
+        found += cht_search_copy(arg->cht, thread, key, &value, sizeof(value));
+      }
+    }
+    else {
+      pthread_mutex_lock(arg->ht_lock);
+      if (op == 0) {
+        int* v = ht_alloc_value(arg->ht, sizeof(int));
+        *v = i;
+        if (ht_search(arg->ht, key) == NULL) {
+          ht_insert(arg->ht, key, v);
+        }
+        else {
+          ht_free_value(arg->ht, v);
+        }
+      }
+      else if (op == 1) {
+        ht_delete(arg->ht, key);
+      }
+      else {
+        found += (ht_search(arg->ht, key) != NULL);
+      }
+      pthread_mutex_unlock(arg->ht_lock);
+    }
+  }
+  if (thread != NULL) {
+    cht_unregister(thread);
+  }
+  sink += found;
+  return NULL;
+}
+
+
+/**
+ * run_threads() - runs fn on num_threads threads and times them
+ *
+ * @return the elapsed time in nanoseconds
+ */
+static double run_threads(void* (*fn)(void*), thread_arg_t* args, const int num_threads) {
+  pthread_t threads[MAX_THREADS];
+  const double t0 = now_ns();
+  for (int t = 0; t < num_threads; t++) {
+    pthread_create(&threads[t], NULL, fn, &args[t]);
+  }
+  for (int t = 0; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  return now_ns() - t0;
+}
+
+
+/**
+ * bench_threads() - concurrent table throughput with 1..max_threads threads
+ */
+static void bench_threads(const int num_keys, const int num_ops, const int max_threads) {
+  char** keys = make_keys(num_keys, "CITY");
+  thread_arg_t args[MAX_THREADS];
+  pthread_mutex_t ht_lock = PTHREAD_MUTEX_INITIALIZER;
+  printf("Threads: %d keys, %d operations per thread, 90%% searches\n\n", num_keys, num_ops);
+  printf("%8s %18s %18s\n", "threads", "concurrent Mops/s", "global lock Mops/s");
+
+  for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+    double mops[2];
+    for (int pass = 0; pass < 2; pass++) {
+      cht_table* cht = NULL;
+      ht_hash_table* ht = NULL;
+      if (pass == 0) {
+        cht = cht_new(num_keys);
+        cht_thread* thread = cht_register(cht);
+        for (int i = 0; i < num_keys; i++) {
+          int* v = malloc(sizeof(int));
+          *v = i;
+          cht_insert(cht, thread, keys[i], v);
+        }
+        cht_unregister(thread);
+      }
+      else {
+        ht = ht_new_sized(num_keys * 2);
+        ht_use_arena(ht, arena_new(0));
+        for (int i = 0; i < num_keys; i++) {
+          int* v = ht_alloc_value(ht, sizeof(int));
+          *v = i;
+          ht_insert(ht, keys[i], v);
+        }
+      }
+      for (int t = 0; t < num_threads; t++) {
+        args[t] = (thread_arg_t){.id = t, .num_threads = num_threads, .num_keys = num_keys,
+                                 .num_ops = num_ops, .keys = keys, .cht = cht, .ht = ht,
+                                 .ht_lock = &ht_lock};
+      }
+      const double ns = run_threads(mixed_ops_thread, args, num_threads);
+      mops[pass] = (double)num_ops * num_threads / ns * 1e3;
+      if (cht != NULL) {
+        cht_del_table(cht);
+      }
+      else {
+        ht_del_hash_table(ht);
+      }
+    }
+    printf("%8d %18.2f %18.2f\n", num_threads, mops[0], mops[1]);
+  }
+  free_keys(keys, num_keys);
+}
+
+
+static void* stress_writer(void* p) {
+  thread_arg_t* arg = p;
+  unsigned state = 2654435761u + (unsigned)arg->id;
+  cht_thread* thread = cht_register(arg->cht);
+  const int num_writers = arg->num_threads;
+  const int num_mine = (arg->num_keys - arg->id + num_writers - 1) / num_writers;
+
+  for (int i = 0; i < arg->num_ops; i++) {
+    const int k = arg->id + (int)(next_rand(&state) % (unsigned)num_mine) * num_writers;
+    if ((next_rand(&state) % 3) == 0) {
+      cht_delete(arg->cht, thread, arg->keys[k]);
+      arg->present[k] = 0;
+    }
+    else {
+      stress_value_t* v = malloc(sizeof(stress_value_t));
+      v->id = k;
+      v->version = ++arg->version[k];
+      cht_insert(arg->cht, thread, arg->keys[k], v);
+      arg->present[k] = 1;
+    }
+  }
+  cht_unregister(thread);
+  return NULL;
+}
+
+
+static void* stress_reader(void* p) {
+  thread_arg_t* arg = p;
+  unsigned state = 97u + (unsigned)arg->id;
+  cht_thread* thread = cht_register(arg->cht);
+
+  while (!__atomic_load_n(&stress_done, __ATOMIC_ACQUIRE)) {
+    cht_read_begin(thread);
+    for (int i = 0; i < 64; i++) {
+      const int k = (int)(next_rand(&state) % (unsigned)arg->num_keys);
+      const stress_value_t* v = cht_search(arg->cht, thread, arg->keys[k]);
+      if ((v != NULL) && ((v->id != k) || (v->version <= 0))) {
+        arg->errors++;
+      }
+    }
+    cht_read_end(thread);
+  }
+  cht_unregister(thread);
+  return NULL;
+}
+
+
+/**
+ * bench_stress() - checks the concurrent table under concurrent writers and readers
+ *
+ * @return the number of errors found
+ */
+static unsigned long bench_stress(const int num_keys, const int num_ops, const int max_threads) {
+  char** keys = make_keys(num_keys, "CITY");
+  int* present = calloc((size_t)num_keys, sizeof(int));
+  int* version = calloc((size_t)num_keys, sizeof(int));
+  const int num_writers = (max_threads > 1) ? max_threads / 2 : 1;
+  const int num_readers = (max_threads > 1) ? max_threads - num_writers : 1;
+  thread_arg_t args[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  unsigned long errors = 0;
+  printf("Stress: %d keys, %d writers x %d operations, %d readers\n\n",
+         num_keys, num_writers, num_ops, num_readers);
+
+  // start small so the table grows while the readers are running
+  cht_table* cht = cht_new(0);
+  stress_done = 0;
+  for (int t = 0; t < num_writers + num_readers; t++) {
+    const int writer = (t < num_writers);
+    args[t] = (thread_arg_t){.id = writer ? t : t - num_writers,
+                             .num_threads = writer ? num_writers : num_readers,
+                             .num_keys = num_keys, .num_ops = num_ops, .keys = keys,
+                             .cht = cht, .present = present, .version = version};
+    pthread_create(&threads[t], NULL, writer ? stress_writer : stress_reader, &args[t]);
+  }
+  for (int t = 0; t < num_writers; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  __atomic_store_n(&stress_done, 1, __ATOMIC_RELEASE);
+  for (int t = num_writers; t < num_writers + num_readers; t++) {
+    pthread_join(threads[t], NULL);
+    errors += args[t].errors;
+  }
+  printf("%-28s %lu bad values\n", "readers", errors);
+
+  // every key must be there iff its writer left it there, with the last version
+  cht_thread* thread = cht_register(cht);
+  long expected = 0;
+  unsigned long final_errors = 0;
+  for (int k = 0; k < num_keys; k++) {
+    stress_value_t v;
+    const int found = cht_search_copy(cht, thread, keys[k], &v, sizeof(v));
+    expected += present[k];
+    if ((found != present[k]) || (found && ((v.id != k) || (v.version != version[k])))) {
+      final_errors++;
+    }
+  }
+  if (cht_count(cht) != expected) {
+    final_errors++;
+  }
+  cht_unregister(thread);
+  printf("%-28s %lu wrong keys, %ld items\n", "final contents", final_errors, cht_count(cht));
+  errors += final_errors;
+  printf("%s\n", (errors == 0) ? "PASS" : "FAIL");
+
+  cht_del_table(cht);
+  free(present);
+  free(version);
+  free_keys(keys, num_keys);
+  return errors;
+}
+
+
+/**
+ * write_csv() - writes BUILD_CSV with num_keys team info records
+ *
+ * @return 0 on success, -1 if the file could not be created
+ */
+static int write_csv(const int num_keys) {
+  FILE* fp = fopen(BUILD_CSV, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "ERROR(write_csv()): Could not create %s\n", BUILD_CSV);
+    return -1;
+  }
+  fprintf(fp, "// conf,city,name,pts,win,loss,tie,gd\n");
+  for (int i = 0; i < num_keys; i++) {
+    fprintf(fp, "%s,City%07d,Team %d,%d,%d,%d,%d,%d\n",
+            confs[i % 3], i / 3, i, i % 70, i % 23, i % 17, i % 11, (i % 41) - 20);
+  }
+  fclose(fp);
+  return 0;
+}
+
+
+/**
+ * bench_build() - single-threaded vs parallel bulk build from a CSV file
+ */
+static void bench_build(const int num_keys, const int max_threads) {
+  csvLoadResult_t result;
+  double t0, ns;
+  printf("Build: %d records, %d shards\n\n", num_keys, BUILD_SHARDS);
+
+  if (write_csv(num_keys) != 0) {
+    return;
+  }
+
+  // run each load twice and report the second so the file is in the page cache
+  ht_hash_table* ht = NULL;
+  for (int pass = 0; pass < 2; pass++) {
+    if (ht != NULL) {
+      ht_del_hash_table(ht);
+    }
+    ht = ht_new();
+    ht_use_arena(ht, arena_new(0));
+    t0 = now_ns();
+    loadTeamInfoCsv(ht, BUILD_CSV, &result);
+    ns = now_ns() - t0;
+  }
+  const double single_ns = ns;
+  printf("%-28s %10.1f ms  %ld records\n", "loadTeamInfoCsv()", single_ns / 1e6, result.numRecords);
+  ht_del_hash_table(ht);
+
+  for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+    sht_table* sht = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+      if (sht != NULL) {
+        sht_del_table(sht);
+      }
+      sht = sht_new(BUILD_SHARDS, 0);
+      sht_use_arenas(sht);
+      t0 = now_ns();
+      loadTeamInfoCsvParallel(sht, BUILD_CSV, num_threads, &result);
+      ns = now_ns() - t0;
+    }
+    printf("parallel, %2d thread(s)       %10.1f ms  %ld records  %5.2fx\n",
+           num_threads, ns / 1e6, sht_count(sht), single_ns / ns);
+    sht_del_table(sht);
+  }
+  remove(BUILD_CSV);
+}
+
+
+/**
+ * bench_snapshot() - startup from the CSV file vs from a snapshot
+ *
+ * Times loading the CSV file and opening the snapshot of the same table, then
+ * searches every key in both tables and checks that the records are the same.
+ */
+static void bench_snapshot(const int num_keys, const int num_ops) {
+  csvLoadResult_t result;
+  char key[MAX_KEY_LEN + 1];
+  double t0;
+  printf("Snapshot: %d records\n\n", num_keys);
+
+  if (write_csv(num_keys) != 0) {
+    return;
+  }
+  ht_hash_table* ht = ht_new();
+  ht_use_arena(ht, arena_new(0));
+  t0 = now_ns();
+  loadTeamInfoCsv(ht, BUILD_CSV, &result);
+  printf("%-28s %10.3f ms\n", "loadTeamInfoCsv()", (now_ns() - t0) / 1e6);
+
+  t0 = now_ns();
+  const int saved = ht_save_snapshot(ht, BUILD_SNAPSHOT, sizeof(TeamInfo_t));
+  printf("%-28s %10.3f ms\n", "ht_save_snapshot()", (now_ns() - t0) / 1e6);
+
+  t0 = now_ns();
+  ht_hash_table* snap = (saved == 0) ? ht_open_snapshot(BUILD_SNAPSHOT, sizeof(TeamInfo_t)) : NULL;
+  printf("%-28s %10.3f ms\n", "ht_open_snapshot()", (now_ns() - t0) / 1e6);
+  if (snap == NULL) {
+    printf("ERROR: could not save or open the snapshot\n");
+    ht_del_hash_table(ht);
+    remove(BUILD_CSV);
+    return;
+  }
+
+  // the first searches page the parts of the file they need in
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    const int k = (int)(((size_t)i * 7919) % (size_t)num_keys);
+    snprintf(key, sizeof(key), "CITY%07d%s", k / 3, confs[k % 3]);
+    sink += (ht_search(snap, key) != NULL);
+  }
+  printf("%-28s %10.1f ns/op\n", "snapshot search", (now_ns() - t0) / num_ops);
+
+  int mismatches = (snap->count != ht->count);
+  for (int k = 0; k < num_keys; k++) {
+    snprintf(key, sizeof(key), "CITY%07d%s", k / 3, confs[k % 3]);
+    const TeamInfo_t* a = ht_search(ht, key);
+    const TeamInfo_t* b = ht_search(snap, key);
+    if ((a == NULL) || (b == NULL) || (strcmp(a->name, b->name) != 0) || (a->pts != b->pts) ||
+        (a->win != b->win) || (a->loss != b->loss) || (a->tie != b->tie) || (a->gd != b->gd)) {
+      mismatches++;
+    }
+  }
+  snprintf(key, sizeof(key), "TOWN%07d%s", 0, confs[0]);
+  mismatches += (ht_search(snap, key) != NULL);
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  ht_del_hash_table(snap);
+  ht_del_hash_table(ht);
+  remove(BUILD_SNAPSHOT);
+  remove(BUILD_CSV);
+}
+
+
+/**
+ * bench_packed() - string keys vs packed keys
+ *
+ * Every operation builds its key from a city and a conference, the way a
+ * caller would: snprintf() and uppercasing for the string table, ht_pack_key()
+ * for the packed one.  Searches are 3/4 hits.  Half the keys are deleted and
+ * both tables are checked against each other.  Last, the packed searches are
+ * repeated with ht_search_packed_batch() and checked against ht_search_packed().
+ *
+ * @return the number of mismatches between the two tables
+ */
+static int bench_packed(const int num_keys, const int num_ops) {
+  ht_hash_table* tables[2] = {ht_new(), ht_new()};
+  double insert_ns[2], search_ns[2], delete_ns[2];
+  char city[MAX_CITY_NAME + 1];
+  char key[MAX_KEY_LEN + 1];
+  ht_packed_key packed;
+  printf("Packed keys: %d keys, %d searches\n\n", num_keys, num_ops);
+
+  ht_set_key_mode(tables[1], HT_KEY_PACKED);
+  for (int mode = 0; mode <= 1; mode++) {
+    ht_hash_table* ht = tables[mode];
+    ht_use_arena(ht, arena_new(0));
+
+    double t0 = now_ns();
+    for (int k = 0; k < num_keys; k++) {
+      TeamInfoPtr_t value = ht_alloc_value(ht, sizeof(TeamInfo_t));
+      memset(value, 0, sizeof(TeamInfo_t));
+      value->pts = k;
+      snprintf(city, sizeof(city), "city%07d", k / 3);
+      if (mode == HT_KEY_PACKED) {
+        ht_pack_key(&packed, (conf_t)(k % 3), city);
+        ht_insert_packed(ht, &packed, value);
+      }
+      else {
+        snprintf(key, sizeof(key), "%s%s", city, confs[k % 3]);
+        strUpper(key);
+        ht_insert(ht, key, value);
+      }
+    }
+    insert_ns[mode] = (now_ns() - t0) / num_keys;
+
+    t0 = now_ns();
+    for (int i = 0; i < num_ops; i++) {
+      const int k = (int)(((size_t)i * 7919) % ((size_t)num_keys * 4 / 3 + 1));
+      snprintf(city, sizeof(city), "city%07d", k / 3);
+      if (mode == HT_KEY_PACKED) {
+        ht_pack_key(&packed, (conf_t)(k % 3), city);
+        sink += (ht_search_packed(ht, &packed) != NULL);
+      }
+      else {
+        snprintf(key, sizeof(key), "%s%s", city, confs[k % 3]);
+        strUpper(key);
+        sink += (ht_search(ht, key) != NULL);
+      }
+    }
+    search_ns[mode] = (now_ns() - t0) / num_ops;
+
+    t0 = now_ns();
+    for (int k = 0; k < num_keys; k += 2) {
+      snprintf(city, sizeof(city), "city%07d", k / 3);
+      if (mode == HT_KEY_PACKED) {
+        ht_pack_key(&packed, (conf_t)(k % 3), city);
+        ht_delete_packed(ht, &packed);
+      }
+      else {
+        snprintf(key, sizeof(key), "%s%s", city, confs[k % 3]);
+        strUpper(key);
+        ht_delete(ht, key);
+      }
+    }
+    delete_ns[mode] = (now_ns() - t0) / ((num_keys + 1) / 2);
+  }
+
+  printf("%-28s %10.1f ns/op (string)    %10.1f ns/op (packed) %6.1fx\n",
+         "insert", insert_ns[0], insert_ns[1], insert_ns[0] / insert_ns[1]);
+  printf("%-28s %10.1f ns/op (string)    %10.1f ns/op (packed) %6.1fx\n",
+         "search", search_ns[0], search_ns[1], search_ns[0] / search_ns[1]);
+  printf("%-28s %10.1f ns/op (string)    %10.1f ns/op (packed) %6.1fx\n",
+         "delete", delete_ns[0], delete_ns[1], delete_ns[0] / delete_ns[1]);
+
+  int mismatches = (tables[0]->count != tables[1]->count) || (tables[1]->count != num_keys / 2);
+  for (int k = 0; k < num_keys + 3; k++) {
+    snprintf(city, sizeof(city), "CITY%07d", k / 3);
+    snprintf(key, sizeof(key), "%s%s", city, confs[k % 3]);
+    ht_pack_key(&packed, (conf_t)(k % 3), city);
+    const TeamInfo_t* a = ht_search(tables[0], key);
+    const TeamInfo_t* b = ht_search_packed(tables[1], &packed);
+    const int expected = (k < num_keys) && (k % 2 == 1);
+    if (((a != NULL) != expected) || ((b != NULL) != expected) ||
+        (expected && ((a->pts != k) || (b->pts != k)))) {
+      mismatches++;
+    }
+  }
+
+  // the same searches a block at a time with ht_search_packed_batch()
+  enum { BLOCK = 1024 };
+  ht_packed_key* block = malloc(BLOCK * sizeof(ht_packed_key));
+  void** values = malloc(BLOCK * sizeof(void*));
+  double single_ns = 0, batch_ns = 0;
+  for (int i = 0; i < num_ops; i += BLOCK) {
+    const int n = (num_ops - i < BLOCK) ? num_ops - i : BLOCK;
+    for (int j = 0; j < n; j++) {
+      const int k = (int)(((size_t)(i + j) * 7919) % ((size_t)num_keys * 4 / 3 + 1));
+      snprintf(city, sizeof(city), "CITY%07d", k / 3);
+      ht_pack_key(&block[j], (conf_t)(k % 3), city);
+    }
+    double t0 = now_ns();
+    for (int j = 0; j < n; j++) {
+      sink += (ht_search_packed(tables[1], &block[j]) != NULL);
+    }
+    double t1 = now_ns();
+    sink += ht_search_packed_batch(tables[1], block, n, values);
+    batch_ns += now_ns() - t1;
+    single_ns += t1 - t0;
+    for (int j = 0; j < n; j++) {
+      mismatches += (values[j] != ht_search_packed(tables[1], &block[j]));
+    }
+  }
+  free(block);
+  free(values);
+  printf("%-28s %10.1f ns/op (single)    %10.1f ns/op (batch)  %6.1fx\n",
+         "packed search", single_ns / num_ops, batch_ns / num_ops, single_ns / batch_ns);
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  ht_del_hash_table(tables[0]);
+  ht_del_hash_table(tables[1]);
+  return mismatches;
+}
+
+
+/**
+ * bench_nocase() - case-sensitive vs case-insensitive tables
+ *
+ * Both tables get the same uppercase keys.  The queries are 3/4 hits, first
+ * uppercase (same work for both tables apart from the case folding) and then
+ * with the city in mixed case, the way a user types it.  The normal table
+ * needs the query copied and uppercased first; the case-insensitive table is
+ * searched with the query as it is.
+ *
+ * @return the number of searches where the two tables disagree
+ */
+static int bench_nocase(const int num_keys, const int num_ops) {
+  const int num_queries = num_keys * 4 / 3 + 1;
+  char** upper = make_keys(num_queries, "CITY");
+  char** mixed = make_keys(num_queries, "City");
+  ht_hash_table* tables[2] = {ht_new(), ht_new()};
+  char key[MAX_KEY_LEN + 1];
+  double t0;
+  printf("Case-insensitive keys: %d keys, %d searches\n\n", num_keys, num_ops);
+
+  ht_set_key_mode(tables[1], HT_KEY_NOCASE);
+  for (int t = 0; t < 2; t++) {
+    ht_use_arena(tables[t], arena_new(0));
+    for (int k = 0; k < num_keys; k++) {
+      TeamInfoPtr_t value = ht_alloc_value(tables[t], sizeof(TeamInfo_t));
+      value->pts = k;
+      ht_insert(tables[t], upper[k], value);
+    }
+  }
+
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    sink += ht_hash_string(upper[((size_t)i * 7919) % (size_t)num_queries]);
+  }
+  const double hash_ns = (now_ns() - t0) / num_ops;
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    sink += ht_hash_nocase(upper[((size_t)i * 7919) % (size_t)num_queries]);
+  }
+  const double hash_nocase_ns = (now_ns() - t0) / num_ops;
+
+  double search_ns[2];
+  for (int t = 0; t < 2; t++) {
+    t0 = now_ns();
+    for (int i = 0; i < num_ops; i++) {
+      sink += (ht_search(tables[t], upper[((size_t)i * 7919) % (size_t)num_queries]) != NULL);
+    }
+    search_ns[t] = (now_ns() - t0) / num_ops;
+  }
+
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    strcpy(key, mixed[((size_t)i * 7919) % (size_t)num_queries]);
+    strUpper(key);
+    sink += (ht_search(tables[0], key) != NULL);
+  }
+  const double upper_ns = (now_ns() - t0) / num_ops;
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    sink += (ht_search(tables[1], mixed[((size_t)i * 7919) % (size_t)num_queries]) != NULL);
+  }
+  const double raw_ns = (now_ns() - t0) / num_ops;
+
+  printf("%-28s %10.1f ns/op (string)    %10.1f ns/op (nocase) %6.2fx\n",
+         "hash", hash_ns, hash_nocase_ns, hash_ns / hash_nocase_ns);
+  printf("%-28s %10.1f ns/op (string)    %10.1f ns/op (nocase) %6.2fx\n",
+         "search uppercase", search_ns[0], search_ns[1], search_ns[0] / search_ns[1]);
+  printf("%-28s %10.1f ns/op (strUpper)  %10.1f ns/op (nocase) %6.2fx\n",
+         "search mixed case", upper_ns, raw_ns, upper_ns / raw_ns);
+
+  // every spelling of a key must find the same record, and only that one
+  int mismatches = 0;
+  for (int k = 0; k < num_queries; k++) {
+    const TeamInfo_t* a = ht_search(tables[0], upper[k]);
+    const TeamInfo_t* b = ht_search(tables[1], mixed[k]);
+    const TeamInfo_t* c = ht_search(tables[1], upper[k]);
+    mismatches += (a != NULL) != (k < num_keys);
+    mismatches += (b != NULL) != (k < num_keys);
+    mismatches += (b != c) || ((b != NULL) && (b->pts != k));
+    mismatches += (ht_search(tables[0], mixed[k]) != NULL);
+  }
+  for (int k = 0; k < num_keys; k += 2) {
+    ht_delete(tables[1], mixed[k]);
+  }
+  mismatches += (tables[1]->count != num_keys / 2);
+  for (int k = 0; k < num_keys; k++) {
+    mismatches += (ht_search(tables[1], upper[k]) != NULL) != (k % 2 == 1);
+  }
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  ht_del_hash_table(tables[0]);
+  ht_del_hash_table(tables[1]);
+  free_keys(upper, num_queries);
+  free_keys(mixed, num_queries);
+  return mismatches;
+}
+
+
+/**
+ * bench_frozen() - Robin Hood probing vs the perfect hash of a frozen table
+ *
+ * @return the number of searches that found different values
+ */
+static int bench_frozen(const int num_keys, const int num_ops) {
+  char** keys = make_keys(num_keys, "CITY");
+  char** misses = make_keys(num_keys, "TOWN");
+  void** found = malloc((size_t)num_keys * sizeof(void*));
+  ht_hash_table* ht = ht_new();
+  double hit_ns[2], miss_ns[2];
+  printf("Frozen: %d keys, %d searches\n\n", num_keys, num_ops);
+
+  ht_use_arena(ht, arena_new(0));
+  for (int i = 0; i < num_keys; i++) {
+    int* value = ht_alloc_value(ht, sizeof(int));
+    *value = i;
+    ht_insert(ht, keys[i], value);
+  }
+  for (int i = 0; i < num_keys; i++) {
+    found[i] = ht_search(ht, keys[i]);
+  }
+
+  double freeze_ns = 0;
+  for (int frozen = 0; frozen <= 1; frozen++) {
+    if (frozen) {
+      const double t0 = now_ns();
+      if (ht_freeze(ht) != 0) {
+        printf("ERROR: ht_freeze() failed\n");
+        return 1;
+      }
+      freeze_ns = now_ns() - t0;
+    }
+    double t0 = now_ns();
+    for (int i = 0; i < num_ops; i++) {
+      sink += (ht_search(ht, keys[((size_t)i * 7919) % (size_t)num_keys]) != NULL);
+    }
+    hit_ns[frozen] = (now_ns() - t0) / num_ops;
+    t0 = now_ns();
+    for (int i = 0; i < num_ops; i++) {
+      sink += (ht_search(ht, misses[((size_t)i * 7919) % (size_t)num_keys]) != NULL);
+    }
+    miss_ns[frozen] = (now_ns() - t0) / num_ops;
+  }
+
+  printf("%-28s %10.3f ms\n", "ht_freeze()", freeze_ns / 1e6);
+  printf("%-28s %10.1f ns/op (probing)   %10.1f ns/op (frozen) %6.2fx\n",
+         "hit search", hit_ns[0], hit_ns[1], hit_ns[0] / hit_ns[1]);
+  printf("%-28s %10.1f ns/op (probing)   %10.1f ns/op (frozen) %6.2fx\n",
+         "miss search", miss_ns[0], miss_ns[1], miss_ns[0] / miss_ns[1]);
+
+  int mismatches = (ht->count != num_keys);
+  for (int i = 0; i < num_keys; i++) {
+    mismatches += (ht_search(ht, keys[i]) != found[i]) || (found[i] == NULL);
+    mismatches += (ht_search(ht, misses[i]) != NULL);
+  }
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  ht_del_hash_table(ht);
+  free(found);
+  free_keys(keys, num_keys);
+  free_keys(misses, num_keys);
+  return mismatches;
+}
+
+
+/**
+ * sum_standings() - adds up the win, loss, tie, pts and gd of every record
+ */
+static void sum_standings(ht_hash_table* ht, const int num_keys, long sums[5]) {
+  char key[MAX_KEY_LEN + 1];
+
+  memset(sums, 0, 5 * sizeof(long));
+  for (int k = 0; k < num_keys; k++) {
+    snprintf(key, sizeof(key), "CITY%07d%s", k / 3, confs[k % 3]);
+    const TeamInfo_t* info = ht_search(ht, key);
+    if (info != NULL) {
+      sums[0] += info->win;
+      sums[1] += info->loss;
+      sums[2] += info->tie;
+      sums[3] += info->pts;
+      sums[4] += info->gd;
+    }
+  }
+}
+
+
+/**
+ * bench_feed() - streams match results into the standings
+ *
+ * @return the number of problems found in the standings afterwards
+ */
+static int bench_feed(const int num_keys, const int num_ops) {
+  csvLoadResult_t load;
+  matchFeedResult_t feed;
+  long before[5], after[5];
+  long decided = 0, drawn = 0;
+  unsigned state = 12345;
+  printf("Match feed: %d teams, %d results\n\n", num_keys, num_ops);
+
+  if ((num_keys < 2) || (write_csv(num_keys) != 0)) {
+    return 1;
+  }
+  FILE* fp = fopen(FEED_CSV, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "ERROR(bench_feed()): Could not create %s\n", FEED_CSV);
+    remove(BUILD_CSV);
+    return 1;
+  }
+  fprintf(fp, "// home,away,score\n");
+  for (int i = 0; i < num_ops; i++) {
+    const int home = (int)(next_rand(&state) % (unsigned)num_keys);
+    const int away = (home + 1 + (int)(next_rand(&state) % (unsigned)(num_keys - 1))) % num_keys;
+    const int home_goals = (int)(next_rand(&state) % 4);
+    const int away_goals = (int)(next_rand(&state) % 4);
+    fprintf(fp, "City%07d%s,City%07d%s,%d-%d\n", home / 3, confs[home % 3], away / 3,
+            confs[away % 3], home_goals, away_goals);
+    decided += (home_goals != away_goals);
+    drawn += (home_goals == away_goals);
+  }
+  fclose(fp);
+
+  ht_hash_table* ht = ht_new();
+  ht_use_arena(ht, arena_new(0));
+  loadTeamInfoCsv(ht, BUILD_CSV, &load);
+  sum_standings(ht, num_keys, before);
+
+  fp = fopen(FEED_CSV, "r");
+  const double t0 = now_ns();
+  applyMatchResults(ht, fp, &feed);
+  const double ns = now_ns() - t0;
+  fclose(fp);
+  sum_standings(ht, num_keys, after);
+
+  printf("%-28s %10.1f ns/result  %10.0f results/s\n", "applyMatchResults()",
+         ns / num_ops, num_ops / ns * 1e9);
+  int problems = (feed.numResults != num_ops) || (feed.numErrors != 0) || (feed.numNewTeams != 0) ||
+                 (ht->count != num_keys);
+  problems += (after[0] - before[0] != decided) || (after[1] - before[1] != decided);
+  problems += (after[2] - before[2] != 2 * drawn) || (after[4] != before[4]);
+  problems += (after[3] - before[3] != PTS_PER_WIN * decided + 2 * PTS_PER_TIE * drawn);
+  printf("%-28s %d problems\n", "check", problems);
+
+  ht_del_hash_table(ht);
+  remove(FEED_CSV);
+  remove(BUILD_CSV);
+  return problems;
+}
+
+
+/**
+ * compare_standings() - qsort() order of the standings index (see st_compare())
+ */
+static int compare_standings(const void* pa, const void* pb) {
+  const TeamInfo_t* a = *(const TeamInfo_t* const*)pa;
+  const TeamInfo_t* b = *(const TeamInfo_t* const*)pb;
+  if (a->pts != b->pts) {
+    return (a->pts > b->pts) ? -1 : 1;
+  }
+  if (a->gd != b->gd) {
+    return (a->gd > b->gd) ? -1 : 1;
+  }
+  const int cmp = strcmp(a->city, b->city);
+  return (cmp != 0) ? cmp : (a < b) ? -1 : (a > b);
+}
+
+
+/**
+ * sort_conference() - searches for every team of a conference and sorts them,
+ * the way a standings table had to be built without the index
+ *
+ * @return the number of teams in teams
+ */
+static int sort_conference(ht_hash_table* ht, const int num_keys, const int conf,
+                           TeamInfoPtr_t* teams) {
+  char key[MAX_KEY_LEN + 1];
+  int n = 0;
+
+  for (int k = conf; k < num_keys; k += 3) {
+    snprintf(key, sizeof(key), "CITY%07d%s", k / 3, confs[k % 3]);
+    TeamInfoPtr_t info = ht_search(ht, key);
+    if (info != NULL) {
+      teams[n++] = info;
+    }
+  }
+  qsort(teams, (size_t)n, sizeof(TeamInfoPtr_t), compare_standings);
+  return n;
+}
+
+
+/**
+ * bench_standings() - keeps a standings index while the table changes
+ *
+ * @return the number of problems found in the index
+ */
+static int bench_standings(const int num_keys, const int num_ops) {
+  csvLoadResult_t load;
+  char line[MATCH_MAX_LINE];
+  char key[MAX_KEY_LEN + 1];
+  unsigned state = 54321;
+  printf("Standings: %d teams, %d results\n\n", num_keys, num_ops);
+
+  if ((num_keys < 2) || (write_csv(num_keys) != 0)) {
+    return 1;
+  }
+  ht_hash_table* ht = ht_new();
+  st_index* st = st_new();
+  ht_use_arena(ht, arena_new(0));
+  loadTeamInfoCsv(ht, BUILD_CSV, &load);
+  remove(BUILD_CSV);
+  double t0 = now_ns();
+  int problems = (st_attach(st, ht) != 0);
+  const double attach_ns = now_ns() - t0;
+
+  // match results, with a team deleted and added back or replaced now and then
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    const int home = (int)(next_rand(&state) % (unsigned)num_keys);
+    const int away = (home + 1 + (int)(next_rand(&state) % (unsigned)(num_keys - 1))) % num_keys;
+    const int len = snprintf(line, sizeof(line), "City%07d%s,City%07d%s,%u-%u", home / 3,
+                             confs[home % 3], away / 3, confs[away % 3],
+                             next_rand(&state) % 4, next_rand(&state) % 4);
+    problems += (applyMatchResult(ht, line, line + len, NULL) != 3);
+
+    if (i % 16 == 0) {
+      snprintf(key, sizeof(key), "CITY%07d%s", home / 3, confs[home % 3]);
+      if (i % 32 == 0) {
+        ht_delete(ht, key);
+      }
+      TeamInfoPtr_t info = ht_alloc_value(ht, sizeof(TeamInfo_t));
+      memset(info, 0, sizeof(TeamInfo_t));
+      strcpy(info->conf, confs[home % 3]);
+      snprintf(info->city, sizeof(info->city), "City%07d", home / 3);
+      info->pts = (int)(next_rand(&state) % 100);
+      info->gd = (int)(next_rand(&state) % 41) - 20;
+      ht_insert(ht, key, info);
+    }
+  }
+  const double update_ns = now_ns() - t0;
+
+  // top 10 of a conference from the index vs searching and sorting all of it
+  TeamInfoPtr_t* teams = malloc((size_t)num_keys * sizeof(TeamInfoPtr_t));
+  TeamInfoPtr_t* indexed = malloc((size_t)num_keys * sizeof(TeamInfoPtr_t));
+  TeamInfoPtr_t top[STANDINGS_TOP];
+  const int queries = 1000;
+  t0 = now_ns();
+  for (int i = 0; i < queries; i++) {
+    sink += st_top_k(st, (conf_t)(i % 3), STANDINGS_TOP, top);
+  }
+  const double top_ns = (now_ns() - t0) / queries;
+  const int sorts = (num_keys > 10000) ? 3 : 30;
+  t0 = now_ns();
+  for (int i = 0; i < sorts; i++) {
+    sink += sort_conference(ht, num_keys, i % 3, teams);
+  }
+  const double sort_ns = (now_ns() - t0) / sorts;
+
+  printf("%-28s %10.1f ns/team\n", "st_attach()", attach_ns / num_keys);
+  printf("%-28s %10.1f ns/result (with the index)\n", "applyMatchResult()", update_ns / num_ops);
+  printf("%-28s %10.1f ns/query (search + sort) %10.1f ns/query (index) %6.1fx\n",
+         "top 10", sort_ns, top_ns, sort_ns / top_ns);
+
+  // the index has to match a full sort of the table, and so do range queries
+  int total = 0;
+  for (int conf = 0; conf < 3; conf++) {
+    const int n = sort_conference(ht, num_keys, conf, teams);
+    const int m = st_top_k(st, (conf_t)conf, num_keys, indexed);
+    problems += (n != m) || (memcmp(teams, indexed, (size_t)n * sizeof(TeamInfoPtr_t)) != 0);
+    total += m;
+
+    for (int lo = -10; lo < 120; lo += 13) {
+      const int hi = lo + 7;
+      int first = 0, expected = 0;
+      while ((first < n) && (teams[first]->pts > hi)) {
+        first++;
+      }
+      while ((first + expected < n) && (teams[first + expected]->pts >= lo)) {
+        expected++;
+      }
+      const int got = st_range(st, (conf_t)conf, lo, hi, indexed, num_keys);
+      problems += (got != expected) ||
+                  (memcmp(&teams[first], indexed, (size_t)expected * sizeof(TeamInfoPtr_t)) != 0);
+    }
+  }
+  problems += (total != ht->count) || (st->errors != 0);
+  printf("%-28s %d problems\n", "check", problems);
+
+  free(teams);
+  free(indexed);
+  ht_del_hash_table(ht);
+  st_del_index(st);
+  return problems;
+}
+
+
+/**
+ * scan_prefix() - finds the records whose city or name starts with a prefix by
+ * searching for every key, the way autocomplete worked without the index
+ *
+ * @return the number of matches, the first max_out are put in out
+ */
+static int scan_prefix(ht_hash_table* ht, const int num_keys, const char* prefix,
+                       TeamInfoPtr_t* out, const int max_out) {
+  char key[MAX_KEY_LEN + 1];
+  const size_t len = strlen(prefix);
+  int n = 0;
+
+  for (int k = 0; k < num_keys; k++) {
+    snprintf(key, sizeof(key), "CITY%07d%s", k / 3, confs[k % 3]);
+    TeamInfoPtr_t info = ht_search(ht, key);
+    if ((info != NULL) && ((strncmp(info->city, prefix, len) == 0) || (strncmp(info->name, prefix, len) == 0))) {
+      if (n < max_out) {
+        out[n] = info;
+      }
+      n++;
+    }
+  }
+  return n;
+}
+
+
+/**
+ * compare_pointers() - qsort() order of two TeamInfoPtr_t
+ */
+static int compare_pointers(const void* pa, const void* pb) {
+  const TeamInfo_t* a = *(const TeamInfo_t* const*)pa;
+  const TeamInfo_t* b = *(const TeamInfo_t* const*)pb;
+  return (a < b) ? -1 : (a > b);
+}
+
+
+/**
+ * bench_prefix() - prefix index vs scanning the table
+ *
+ * The cities are City0000000.. and the names Team 0.., so "City00012" matches
+ * 30 records and "Team 12" matches 111 (for 100000 keys).
+ *
+ * @return the number of problems found in the index
+ */
+static int bench_prefix(const int num_keys, const int num_ops) {
+  csvLoadResult_t load;
+  char prefix[MAX_CITY_NAME + 1];
+  char key[MAX_KEY_LEN + 1];
+  unsigned state = 24680;
+  printf("Prefix: %d teams\n\n", num_keys);
+
+  if (write_csv(num_keys) != 0) {
+    return 1;
+  }
+  ht_hash_table* ht = ht_new();
+  px_index* px = px_new();
+  ht_use_arena(ht, arena_new(0));
+  loadTeamInfoCsv(ht, BUILD_CSV, &load);
+  remove(BUILD_CSV);
+  double t0 = now_ns();
+  int problems = (px_attach(px, ht) != 0);
+  const double attach_ns = now_ns() - t0;
+
+  TeamInfoPtr_t* expected = malloc((size_t)num_keys * sizeof(TeamInfoPtr_t));
+  TeamInfoPtr_t* got = malloc((size_t)num_keys * sizeof(TeamInfoPtr_t));
+  const int queries = 1000;
+  t0 = now_ns();
+  for (int i = 0; i < queries; i++) {
+    snprintf(prefix, sizeof(prefix), "City%05d", (int)(next_rand(&state) % (unsigned)(num_keys / 300 + 1)));
+    sink += px_search(px, prefix, PX_ANY, got, num_keys);
+  }
+  const double index_ns = (now_ns() - t0) / queries;
+  const int scans = (num_keys > 10000) ? 3 : 30;
+  t0 = now_ns();
+  for (int i = 0; i < scans; i++) {
+    snprintf(prefix, sizeof(prefix), "City%05d", (int)(next_rand(&state) % (unsigned)(num_keys / 300 + 1)));
+    sink += scan_prefix(ht, num_keys, prefix, got, num_keys);
+  }
+  const double scan_ns = (now_ns() - t0) / scans;
+
+  printf("%-28s %10.1f ns/team\n", "px_attach()", attach_ns / num_keys);
+  printf("%-28s %10.1f ns/query (scan)     %10.1f ns/query (index) %6.1fx\n",
+         "prefix search", scan_ns, index_ns, scan_ns / index_ns);
+
+  // change the table and check random prefixes against the scan
+  for (int i = 0; i < num_keys / 4; i++) {
+    const int k = (int)(next_rand(&state) % (unsigned)num_keys);
+    snprintf(key, sizeof(key), "CITY%07d%s", k / 3, confs[k % 3]);
+    if (i % 3 == 0) {
+      ht_delete(ht, key);
+      continue;
+    }
+    TeamInfoPtr_t info = ht_alloc_value(ht, sizeof(TeamInfo_t));
+    memset(info, 0, sizeof(TeamInfo_t));
+    strcpy(info->conf, confs[k % 3]);
+    snprintf(info->city, sizeof(info->city), "City%07d", k / 3);
+    snprintf(info->name, sizeof(info->name), "Team %u", next_rand(&state) % (unsigned)num_keys);
+    ht_insert(ht, key, info);
+  }
+  const int checks = (num_ops / 1000 > 0) ? num_ops / 1000 : 1;
+  for (int i = 0; i < checks; i++) {
+    const unsigned r = next_rand(&state);
+    if (r % 2) {
+      snprintf(prefix, sizeof(prefix), "City%0*u", (int)(r % 7), (r / 8) % 1000000);
+    }
+    else {
+      snprintf(prefix, sizeof(prefix), "Team %u", (r / 8) % (unsigned)(num_keys / 10 + 1));
+    }
+    const int n = scan_prefix(ht, num_keys, prefix, expected, num_keys);
+    const int m = px_search(px, prefix, PX_ANY, got, num_keys);
+    qsort(expected, (size_t)n, sizeof(TeamInfoPtr_t), compare_pointers);
+    qsort(got, (size_t)m, sizeof(TeamInfoPtr_t), compare_pointers);
+    problems += (n != m) || (memcmp(expected, got, (size_t)n * sizeof(TeamInfoPtr_t)) != 0);
+  }
+  problems += (px->cities.count != ht->count) || (px->names.count != ht->count) || (px->errors != 0);
+  printf("%-28s %d problems\n", "check", problems);
+
+  free(expected);
+  free(got);
+  ht_del_hash_table(ht);
+  px_del_index(px);
+  return problems;
+}
+
+
+/**
+ * walk_totals() - tc_totals() and tc_filter_greater(TC_GD) over TeamInfo_t records
+ *
+ * @return the number of records with gd > gd_threshold
+ */
+static int walk_totals(TeamInfoPtr_t* teams, const int n, const int conf, const int gd_threshold,
+                       tc_totals_t* totals) {
+  int filtered = 0;
+
+  memset(totals, 0, sizeof(tc_totals_t));
+  for (int i = 0; i < n; i++) {
+    const TeamInfo_t* t = teams[i];
+    conf_t c;
+    if ((parseConf(t->conf, &c) == 0) && ((conf == TC_ALL_CONFS) || ((int)c == conf))) {
+      totals->count++;
+      totals->sums[TC_PTS] += t->pts;
+      totals->sums[TC_WIN] += t->win;
+      totals->sums[TC_LOSS] += t->loss;
+      totals->sums[TC_TIE] += t->tie;
+      totals->sums[TC_GD] += t->gd;
+      filtered += (t->gd > gd_threshold);
+    }
+  }
+  return filtered;
+}
+
+
+/**
+ * bench_columns() - TeamInfo_t records vs the columnar store
+ *
+ * @return the number of mismatches between the two
+ */
+static int bench_columns(const int num_keys) {
+  char city[MAX_CITY_NAME + 1];
+  ht_packed_key key;
+  TeamInfo_t info;
+  tc_totals_t a, b;
+  unsigned state = 13579;
+  printf("Columns: %d teams\n\n", num_keys);
+
+  ht_hash_table* records = ht_new_sized(num_keys * 2);
+  ht_hash_table* ids = ht_new_sized(num_keys * 2);
+  ht_set_key_mode(records, HT_KEY_PACKED);
+  ht_set_key_mode(ids, HT_KEY_PACKED);
+  ht_use_arena(records, arena_new(0));
+  ht_use_arena(ids, arena_new(0));
+  tc_store* tc = tc_new(ids);
+  TeamInfoPtr_t* teams = malloc((size_t)num_keys * sizeof(TeamInfoPtr_t));
+  uint32_t* rows = malloc((size_t)num_keys * sizeof(uint32_t));
+
+  for (int k = 0; k < num_keys; k++) {
+    TeamInfoPtr_t t = ht_alloc_value(records, sizeof(TeamInfo_t));
+    memset(t, 0, sizeof(TeamInfo_t));
+    strcpy(t->conf, confs[k % 3]);
+    snprintf(t->city, sizeof(t->city), "City%07d", k / 3);
+    snprintf(t->name, sizeof(t->name), "Team %d", k);
+    t->win = (int)(next_rand(&state) % 30);
+    t->loss = (int)(next_rand(&state) % 30);
+    t->tie = (int)(next_rand(&state) % 15);
+    t->pts = PTS_PER_WIN * t->win + PTS_PER_TIE * t->tie;
+    t->gd = (int)(next_rand(&state) % 61) - 30;
+    ht_pack_key(&key, (conf_t)(k % 3), t->city);
+    ht_insert_packed(records, &key, t);
+    tc_insert(tc, t);
+    teams[k] = t;
+  }
+
+  // every conference's totals and the teams with gd > 10, a few times over
+  const int reps = 10;
+  double t0 = now_ns();
+  for (int r = 0; r < reps; r++) {
+    for (int conf = 0; conf < 3; conf++) {
+      sink += (unsigned long)walk_totals(teams, num_keys, conf, 10, &a);
+    }
+  }
+  const double walk_ns = (now_ns() - t0) / reps;
+  t0 = now_ns();
+  for (int r = 0; r < reps; r++) {
+    for (int conf = 0; conf < 3; conf++) {
+      sink += (unsigned long)tc_totals(tc, conf, &b);
+      sink += (unsigned long)tc_filter_greater(tc, conf, TC_GD, 10, rows);
+    }
+  }
+  const double cols_ns = (now_ns() - t0) / reps;
+  printf("%-28s %10.2f ns/row (records)   %10.2f ns/row (columns) %6.1fx\n",
+         "totals + filter", walk_ns / num_keys, cols_ns / num_keys, walk_ns / cols_ns);
+  printf("%-28s %10.2f GB/s (columns)\n", "scan",
+         3.0 * num_keys * (TC_NUM_COLUMNS * sizeof(int) + 1) * 2 / cols_ns);
+
+  // delete a quarter of the teams and replace a quarter, then compare
+  for (int i = 0; i < num_keys / 2; i++) {
+    const int k = (int)(next_rand(&state) % (unsigned)num_keys);
+    snprintf(city, sizeof(city), "City%07d", k / 3);
+    ht_pack_key(&key, (conf_t)(k % 3), city);
+    TeamInfoPtr_t t = ht_search_packed(records, &key);
+    if (i % 2 == 0) {
+      ht_delete_packed(records, &key);
+      tc_delete(tc, &key);
+    }
+    else if (t != NULL) {
+      t->gd = (int)(next_rand(&state) % 61) - 30;
+      t->pts += PTS_PER_WIN;
+      tc_insert(tc, t);
+    }
+  }
+  int n = 0;
+  int mismatches = 0;
+  for (int k = 0; k < num_keys; k++) {
+    snprintf(city, sizeof(city), "City%07d", k / 3);
+    ht_pack_key(&key, (conf_t)(k % 3), city);
+    TeamInfoPtr_t t = ht_search_packed(records, &key);
+    const int row = tc_find(tc, &key);
+    if ((t == NULL) != (row < 0)) {
+      mismatches++;
+      continue;
+    }
+    if (t != NULL) {
+      teams[n++] = t;
+      tc_get(tc, row, &info);
+      mismatches += (strcmp(info.conf, t->conf) != 0) || (strcmp(info.city, t->city) != 0) ||
+                    (strcmp(info.name, t->name) != 0) || (info.pts != t->pts) || (info.gd != t->gd) ||
+                    (info.win != t->win) || (info.loss != t->loss) || (info.tie != t->tie);
+    }
+  }
+  for (int conf = TC_ALL_CONFS; conf < 3; conf++) {
+    for (int threshold = -31; threshold <= 30; threshold += 7) {
+      const int expected = walk_totals(teams, n, conf, threshold, &a);
+      tc_totals(tc, conf, &b);
+      const int got = tc_filter_greater(tc, conf, TC_GD, threshold, rows);
+      mismatches += (memcmp(&a, &b, sizeof(a)) != 0) || (got != expected) ||
+                    (tc_filter_greater(tc, conf, TC_GD, threshold, NULL) != expected);
+      for (int i = 0; i < got; i++) {
+        mismatches += (tc->cols[TC_GD][rows[i]] <= threshold) || ((i > 0) && (rows[i] <= rows[i - 1]));
+      }
+    }
+  }
+  mismatches += (tc->count != n) || (ids->count != n) || (tc->errors != 0);
+  printf("%-28s %.2f (all), %.2f (NWSL)\n", "average pts", tc_average(tc, TC_ALL_CONFS, TC_PTS),
+         tc_average(tc, NWSL, TC_PTS));
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  free(teams);
+  free(rows);
+  tc_del_store(tc);
+  ht_del_hash_table(ids);
+  ht_del_hash_table(records);
+  return mismatches;
+}
+
+
+/**
+ * bench_typed() - malloc'd TeamInfo_t values vs records stored in a tt_table
+ *
+ * @return the number of mismatches between the two
+ */
+static int bench_typed(const int num_keys, const int num_ops) {
+  ht_packed_key* keys = malloc((size_t)num_keys * sizeof(ht_packed_key));
+  char city[MAX_CITY_NAME + 1];
+  TeamInfo_t info;
+  unsigned state = 24680;
+  double ns[2][3];      // [generic, typed][insert, search, delete]
+  printf("Typed: %d teams, %d searches\n\n", num_keys, num_ops);
+
+  for (int k = 0; k < num_keys; k++) {
+    snprintf(city, sizeof(city), "City%07d", k / 3);
+    ht_pack_key(&keys[k], (conf_t)(k % 3), city);
+  }
+
+  ht_hash_table* ht = ht_new_sized(num_keys * 2);
+  tt_table* tt = tt_new(num_keys * 2);
+  ht_set_key_mode(ht, HT_KEY_PACKED);
+  for (int typed = 0; typed <= 1; typed++) {
+    state = 24680;
+    double t0 = now_ns();
+    for (int k = 0; k < num_keys; k++) {
+      memset(&info, 0, sizeof(info));
+      info.pts = k;
+      info.gd = (int)(next_rand(&state) % 61) - 30;
+      if (typed) {
+        tt_insert(tt, &keys[k], &info);
+      }
+      else {
+        TeamInfoPtr_t t = ht_alloc_value(ht, sizeof(TeamInfo_t));
+        *t = info;
+        ht_insert_packed(ht, &keys[k], t);
+      }
+    }
+    ns[typed][0] = (now_ns() - t0) / num_keys;
+
+    t0 = now_ns();
+    for (int i = 0; i < num_ops; i++) {
+      const ht_packed_key* key = &keys[((size_t)i * 7919) % (size_t)num_keys];
+      const TeamInfo_t* t = typed ? tt_search(tt, key) : ht_search_packed(ht, key);
+      sink += (unsigned long)t->pts;
+    }
+    ns[typed][1] = (now_ns() - t0) / num_ops;
+  }
+
+  // every team, then a third of them deleted, must be the same in both
+  int mismatches = (tt->count != ht->count);
+  for (int k = 0; k < num_keys; k++) {
+    const TeamInfo_t* a = ht_search_packed(ht, &keys[k]);
+    const TeamInfo_t* b = tt_search(tt, &keys[k]);
+    mismatches += (a == NULL) || (b == NULL) || (memcmp(a, b, sizeof(TeamInfo_t)) != 0);
+  }
+  for (int typed = 0; typed <= 1; typed++) {
+    const double t0 = now_ns();
+    for (int k = 0; k < num_keys; k += 3) {
+      if (typed) {
+        tt_delete(tt, &keys[k]);
+      }
+      else {
+        ht_delete_packed(ht, &keys[k]);
+      }
+    }
+    ns[typed][2] = (now_ns() - t0) / ((num_keys + 2) / 3);
+  }
+  for (int k = 0; k < num_keys; k++) {
+    const TeamInfo_t* a = ht_search_packed(ht, &keys[k]);
+    const TeamInfo_t* b = tt_search(tt, &keys[k]);
+    mismatches += ((a == NULL) != (k % 3 == 0)) || ((a == NULL) != (b == NULL)) ||
+                  ((a != NULL) && (memcmp(a, b, sizeof(TeamInfo_t)) != 0));
+  }
+  int n = 0;
+  int index = 0;
+  for (tt_slot* slot = tt_next(tt, &index); slot != NULL; slot = tt_next(tt, &index)) {
+    n++;
+    mismatches += (ht_search_packed(ht, &slot->key) == NULL);
+  }
+  mismatches += (n != tt->count) || (tt->count != ht->count);
+
+  const char* ops[] = {"insert", "search", "delete"};
+  for (int op = 0; op < 3; op++) {
+    printf("%-28s %10.1f ns/op (void*)     %10.1f ns/op (typed) %6.2fx\n",
+           ops[op], ns[0][op], ns[1][op], ns[0][op] / ns[1][op]);
+  }
+  // slots and control bytes per team, plus the malloc'd record (not counting
+  // malloc's own overhead) for the generic table
+  printf("%-28s %10.1f bytes/team (void*) %9.1f bytes/team (typed)\n", "memory",
+         (double)ht->size * (sizeof(ht_item) + 1) / ht->count + sizeof(TeamInfo_t),
+         (double)tt->size * (sizeof(tt_slot) + 1) / tt->count);
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  ht_del_hash_table(ht);
+  tt_del_table(tt);
+  free(keys);
+  return mismatches;
+}
+
+
+/**
+ * bench_compact() - memory per team of TeamInfo_t records and of packed records
+ *
+ * @return the number of mismatches between the three tables
+ */
+static int bench_compact(const int num_keys, const int num_ops) {
+  char** keys = malloc((size_t)num_keys * sizeof(char*));
+  ht_packed_key* packed = malloc((size_t)num_keys * sizeof(ht_packed_key));
+  char long_key[MAX_KEY_LEN + 1];
+  TeamInfo_t info, unpacked;
+  tr_record record;
+  ht_stats stats[2];
+  unsigned state = 97531;
+  int mismatches = 0;
+  printf("Compact: %d teams, %d searches\n\n", num_keys, num_ops);
+
+  // the tables grow as the teams are added, so they end up as full as they'd normally be
+  ht_hash_table* ht[2] = {ht_new(), ht_new()};
+  ht_use_arena(ht[1], arena_new(0));
+  trt_table* trt = trt_new(0);
+  tr_pool* pool = tr_pool_new();
+
+  for (int k = 0; k < num_keys; k++) {
+    memset(&info, 0, sizeof(info));
+    strcpy(info.conf, confs[k % 3]);
+    snprintf(info.city, sizeof(info.city), "City%07d", k / 3);
+    snprintf(info.name, sizeof(info.name), "Team %d", k);
+    info.win = (int)(next_rand(&state) % 30);
+    info.loss = (int)(next_rand(&state) % 30);
+    info.tie = (int)(next_rand(&state) % 15);
+    info.pts = PTS_PER_WIN * info.win + PTS_PER_TIE * info.tie;
+    info.gd = (int)(next_rand(&state) % 61) - 30;
+    keys[k] = createKey(&info);
+    ht_pack_key(&packed[k], (conf_t)(k % 3), info.city);
+    for (int a = 0; a < 2; a++) {
+      TeamInfoPtr_t t = ht_alloc_value(ht[a], sizeof(TeamInfo_t));
+      *t = info;
+      ht_insert(ht[a], keys[k], t);
+    }
+    mismatches += (tr_pack(pool, &info, &record) != 0) || (trt_insert(trt, &packed[k], &record) != 1);
+
+    // now and then a key too long to be inline, deleted again a little later
+    if (k % 64 == 0) {
+      snprintf(long_key, sizeof(long_key), "LONG CITY %07d%s", k, confs[k % 3]);
+      for (int a = 0; a < 2; a++) {
+        ht_insert(ht[a], long_key, ht_alloc_value(ht[a], sizeof(TeamInfo_t)));
+        if (k >= 64) {
+          snprintf(long_key, sizeof(long_key), "LONG CITY %07d%s", k - 64, confs[(k - 64) % 3]);
+          mismatches += (ht_search(ht[a], long_key) == NULL);
+          ht_delete(ht[a], long_key);
+          snprintf(long_key, sizeof(long_key), "LONG CITY %07d%s", k, confs[k % 3]);
+        }
+      }
+    }
+  }
+
+  double ns[2];
+  double t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    const TeamInfo_t* t = ht_search(ht[1], keys[((size_t)i * 7919) % (size_t)num_keys]);
+    sink += (unsigned long)t->pts;
+  }
+  ns[0] = (now_ns() - t0) / num_ops;
+  t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    const tr_record* r = trt_search(trt, &packed[((size_t)i * 7919) % (size_t)num_keys]);
+    sink += (unsigned long)r->pts;
+  }
+  ns[1] = (now_ns() - t0) / num_ops;
+
+  for (int k = 0; k < num_keys; k++) {
+    const TeamInfo_t* a = ht_search(ht[0], keys[k]);
+    const TeamInfo_t* b = ht_search(ht[1], keys[k]);
+    const tr_record* r = trt_search(trt, &packed[k]);
+    if ((a == NULL) || (b == NULL) || (r == NULL)) {
+      mismatches++;
+      continue;
+    }
+    tr_unpack(pool, r, &unpacked);
+    mismatches += (memcmp(a, b, sizeof(TeamInfo_t)) != 0) || (memcmp(a, &unpacked, sizeof(TeamInfo_t)) != 0);
+  }
+
+  for (int a = 0; a < 2; a++) {
+    ht_get_stats(ht[a], &stats[a]);
+    mismatches += (stats[a].inline_keys != num_keys) || (stats[a].count != num_keys + 1);
+  }
+  // the first table's records were malloc'd by ht_alloc_value(), which the stats can't see
+  const double records = (double)stats[0].count * (sizeof(TeamInfo_t) + HT_MALLOC_OVERHEAD);
+  const double packed_bytes = (double)sizeof(trt_table) + (double)trt->size * (sizeof(trt_slot) + 1) +
+                              HT_GROUP_WIDTH - 1 + tr_pool_bytes(pool);
+  printf("%-28s %10.1f bytes/team (%d inline keys, %zu key bytes)\n", "string keys + malloc",
+         stats[0].bytes_per_entry + records / stats[0].count, stats[0].inline_keys, stats[0].key_bytes);
+  printf("%-28s %10.1f bytes/team (%zu arena bytes)\n", "string keys + arena",
+         stats[1].bytes_per_entry, stats[1].arena_bytes);
+  printf("%-28s %10.1f bytes/team (%zu pool bytes, %d strings)\n", "packed records",
+         packed_bytes / trt->count, tr_pool_bytes(pool), pool->count);
+  printf("%-28s %10.1f ns/op (TeamInfo_t)  %10.1f ns/op (packed) %6.2fx\n", "search",
+         ns[0], ns[1], ns[0] / ns[1]);
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  for (int k = 0; k < num_keys; k++) {
+    free(keys[k]);
+  }
+  free(keys);
+  free(packed);
+  ht_del_hash_table(ht[0]);
+  ht_del_hash_table(ht[1]);
+  trt_del_table(trt);
+  tr_pool_del(pool);
+  return mismatches;
+}
+
+
+/**
+ * wal_ops() - the mixed operations of the wal mode: match results, with a team
+ * deleted and added back or replaced now and then
+ *
+ * @return the number of operations that failed
+ */
+static int wal_ops(ht_hash_table* ht, const int num_keys, const int num_ops) {
+  char line[MATCH_MAX_LINE];
+  char key[MAX_KEY_LEN + 1];
+  unsigned state = 97531;
+  int problems = 0;
+
+  for (int i = 0; i < num_ops; i++) {
+    const int home = (int)(next_rand(&state) % (unsigned)num_keys);
+    const int away = (home + 1 + (int)(next_rand(&state) % (unsigned)(num_keys - 1))) % num_keys;
+    if (i % 16 != 0) {
+      const int len = snprintf(line, sizeof(line), "City%07d%s,City%07d%s,%u-%u", home / 3,
+                               confs[home % 3], away / 3, confs[away % 3],
+                               next_rand(&state) % 4, next_rand(&state) % 4);
+      problems += (applyMatchResult(ht, line, line + len, NULL) != 3);
+      continue;
+    }
+    snprintf(key, sizeof(key), "CITY%07d%s", home / 3, confs[home % 3]);
+    ht_delete(ht, key);
+    if (i % 32 == 0) {
+      TeamInfoPtr_t info = ht_alloc_value(ht, sizeof(TeamInfo_t));
+      memset(info, 0, sizeof(TeamInfo_t));
+      strcpy(info->conf, confs[home % 3]);
+      snprintf(info->city, sizeof(info->city), "City%07d", home / 3);
+      info->pts = (int)(next_rand(&state) % 100);
+      info->gd = (int)(next_rand(&state) % 41) - 20;
+      ht_insert(ht, key, info);
+    }
+  }
+  return problems;
+}
+
+
+/**
+ * same_teams() - checks that two tables hold the same team info records.  The
+ * fields are compared, not the bytes after the end of the strings
+ *
+ * @return the number of records that differ or are missing
+ */
+static int same_teams(ht_hash_table* a, ht_hash_table* b) {
+  int mismatches = (a->count != b->count);
+  int index = 0;
+  for (ht_item* item = ht_next(a, &index); item != NULL; item = ht_next(a, &index)) {
+    const TeamInfo_t* t = ht_search(b, ht_item_key(item));
+    const TeamInfo_t* u = item->value;
+    mismatches += (t == NULL) || (strcmp(t->conf, u->conf) != 0) || (strcmp(t->city, u->city) != 0) ||
+                  (strcmp(t->name, u->name) != 0) || (t->pts != u->pts) || (t->win != u->win) ||
+                  (t->loss != u->loss) || (t->tie != u->tie) || (t->gd != u->gd);
+  }
+  return mismatches;
+}
+
+
+/**
+ * wal_reopen() - replays the log into a table, loaded from BUILD_CSV if
+ * from_csv, and closes the log again
+ *
+ * @return the table, or NULL if the log couldn't be opened
+ */
+static ht_hash_table* wal_reopen(const int from_csv, long* replayed) {
+  csvLoadResult_t load;
+  ht_hash_table* ht = ht_new();
+  if (from_csv) {
+    loadTeamInfoCsv(ht, BUILD_CSV, &load);
+  }
+  wal_t* wal = wal_open(WAL_LOG, ht, sizeof(TeamInfo_t), teamInfoKey);
+  if (wal == NULL) {
+    ht_del_hash_table(ht);
+    return NULL;
+  }
+  *replayed = wal->replayed;
+  wal_close(wal);
+  return ht;
+}
+
+
+/**
+ * file_size() - size of a file
+ *
+ * @return the size in bytes, -1 if it doesn't exist
+ */
+static long file_size(const char* path) {
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  const long size = ftell(fp);
+  fclose(fp);
+  return size;
+}
+
+
+/**
+ * cpu_ns() - reads the CPU time of the process, every thread included
+ *
+ * @return the CPU time in nanoseconds
+ */
+static double cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+/**
+ * bench_wal() - cost of the write-ahead log and checks of its replays.  The
+ * cost is the CPU time of the process, so the flusher thread's write() and
+ * fdatasync() count but the time it waits for the disk doesn't (the writer
+ * isn't waiting for it)
+ *
+ * @return the number of problems found
+ */
+static int bench_wal(const int num_keys, const int num_ops) {
+  csvLoadResult_t load;
+  long replayed = 0;
+  printf("WAL: %d teams, %d operations\n\n", num_keys, num_ops);
+
+  remove(WAL_LOG);
+  if ((num_keys < 2) || (write_csv(num_keys) != 0)) {
+    return 1;
+  }
+  ht_hash_table* plain = ht_new();
+  ht_hash_table* ht = ht_new();
+  loadTeamInfoCsv(plain, BUILD_CSV, &load);
+  loadTeamInfoCsv(ht, BUILD_CSV, &load);
+
+  double t0 = now_ns();
+  double c0 = cpu_ns();
+  int problems = wal_ops(plain, num_keys, num_ops);
+  const double plain_ns = (now_ns() - t0) / num_ops;
+  const double plain_cpu = (cpu_ns() - c0) / num_ops;
+
+  // the final commit counts, the operations aren't durable until it's done
+  wal_t* wal = wal_open(WAL_LOG, ht, sizeof(TeamInfo_t), teamInfoKey);
+  if (wal == NULL) {
+    fprintf(stderr, "ERROR(bench_wal()): Could not open %s\n", WAL_LOG);
+    remove(BUILD_CSV);
+    ht_del_hash_table(plain);
+    ht_del_hash_table(ht);
+    return 1;
+  }
+  t0 = now_ns();
+  c0 = cpu_ns();
+  problems += wal_ops(ht, num_keys, num_ops);
+  problems += (wal_commit(wal) != 0);
+  const double wal_ns = (now_ns() - t0) / num_ops;
+  const double wal_cpu = (cpu_ns() - c0) / num_ops;
+  const long records = wal->records;
+  const long commits = wal->commits;
+  const long compactions = wal->compactions;
+  problems += (wal_close(wal) != 0);
+  problems += same_teams(plain, ht);
+  const long log_bytes = file_size(WAL_LOG);
+
+  printf("%-28s %10.1f ns/op (no log)    %10.1f ns/op (log) %8.0f ops/sec\n", "operations",
+         plain_ns, wal_ns, 1e9 / wal_ns);
+  printf("%-28s %10.1f ns/op (no log)    %10.1f ns/op (log)\n", "CPU time", plain_cpu, wal_cpu);
+  printf("%-28s %10.1f ns/op %9.1f%% of the %.0f ns budget at 100K ops/sec\n", "log overhead",
+         wal_cpu - plain_cpu, 100.0 * (wal_cpu - plain_cpu) / WAL_BUDGET_NS, WAL_BUDGET_NS);
+  printf("%-28s %10ld records %8ld commits %8.1f records/commit %6ld compactions %10ld bytes\n", "log",
+         records, commits, (commits > 0) ? (double)records / commits : 0.0, compactions, log_bytes);
+
+  // replay on top of the CSV file
+  t0 = now_ns();
+  ht_hash_table* replay = wal_reopen(1, &replayed);
+  const double replay_ns = now_ns() - t0;
+  problems += (replay == NULL) || (replayed == 0) || (same_teams(ht, replay) != 0);
+  printf("%-28s %10.1f ms (CSV load + %ld records)\n", "replay", replay_ns / 1e6, replayed);
+
+  // compact, then the log alone has to rebuild the table
+  if ((replay != NULL) && ((wal = wal_open(WAL_LOG, replay, sizeof(TeamInfo_t), teamInfoKey)) != NULL)) {
+    t0 = now_ns();
+    problems += (wal_compact(wal) != 0);
+    const double compact_ns = now_ns() - t0;
+    problems += (wal_close(wal) != 0);
+    printf("%-28s %10.1f ms %18ld bytes\n", "wal_compact()", compact_ns / 1e6, file_size(WAL_LOG));
+  }
+  else {
+    problems++;
+  }
+  ht_hash_table* compacted = wal_reopen(0, &replayed);
+  problems += (compacted == NULL) || (same_teams(ht, compacted) != 0);
+
+  // a torn record at the end is dropped and the log is cut back to the last good one
+  const long good_bytes = file_size(WAL_LOG);
+  FILE* fp = fopen(WAL_LOG, "ab");
+  if (fp != NULL) {
+    fwrite("\x40\x00\x00\x00garbage", 1, 11, fp);
+    fclose(fp);
+  }
+  ht_hash_table* torn = wal_reopen(0, &replayed);
+  problems += (fp == NULL) || (torn == NULL) || (same_teams(ht, torn) != 0) ||
+              (file_size(WAL_LOG) != good_bytes);
+  printf("%-28s %d problems\n", "check", problems);
+
+  remove(WAL_LOG);
+  remove(BUILD_CSV);
+  ht_del_hash_table(plain);
+  ht_del_hash_table(ht);
+  if (replay != NULL) {
+    ht_del_hash_table(replay);
+  }
+  if (compacted != NULL) {
+    ht_del_hash_table(compacted);
+  }
+  if (torn != NULL) {
+    ht_del_hash_table(torn);
+  }
+  return problems;
+}
+
+
+/**
+ * filter_search_ns() - times num_ops searches of keys, in ns per search
+ */
+static double filter_search_ns(ht_hash_table* ht, char** keys, const int num_keys, const int num_ops) {
+  const double t0 = now_ns();
+  for (int i = 0; i < num_ops; i++) {
+    sink += (ht_search(ht, keys[((size_t)i * 7919) % (size_t)num_keys]) != NULL);
+  }
+  return (now_ns() - t0) / num_ops;
+}
+
+
+/**
+ * filter_batch_ns() - times ht_search_batch() over num_ops keys, in ns per key
+ */
+static double filter_batch_ns(ht_hash_table* ht, char** keys, const int num_keys, const int num_ops) {
+  const char* batch[BATCH_QUERIES];
+  void* values[BATCH_QUERIES];
+
+  const double t0 = now_ns();
+  for (int done = 0; done < num_ops; done += BATCH_QUERIES) {
+    for (int i = 0; i < BATCH_QUERIES; i++) {
+      batch[i] = keys[((size_t)(done + i) * 7919) % (size_t)num_keys];
+    }
+    sink += (unsigned long)ht_search_batch(ht, batch, BATCH_QUERIES, values);
+  }
+  return (now_ns() - t0) / ((num_ops + BATCH_QUERIES - 1) / BATCH_QUERIES * BATCH_QUERIES);
+}
+
+
+/**
+ * filter_check() - checks a table against the values it should have
+ *
+ * @return the number of keys with the wrong value plus the misses that were found
+ */
+static int filter_check(ht_hash_table* ht, char** keys, void** values, char** misses,
+                        const int num_keys) {
+  int mismatches = 0;
+  for (int i = 0; i < num_keys; i++) {
+    const int* a = ht_search(ht, keys[i]);
+    const int* b = values[i];
+    mismatches += ((a == NULL) != (b == NULL)) || ((a != NULL) && (*a != *b));
+    mismatches += (ht_search(ht, misses[i]) != NULL);
+  }
+  return mismatches;
+}
+
+
+/**
+ * bench_filter() - searches with and without a Bloom filter
+ *
+ * @return the number of mismatches found
+ */
+static int bench_filter(const int num_keys, const int num_ops) {
+  char** keys = make_keys(num_keys, "CITY");
+  char** misses = make_keys(num_keys, "TOWN");
+  char** extra = make_keys(num_keys, "VILLAGE");
+  void** values = malloc((size_t)num_keys * sizeof(void*));
+  ht_hash_table* tables[3];
+  const char* names[3] = {"table", "frozen", "snapshot"};
+  ht_stats stats;
+  int mismatches = 0;
+  printf("Bloom filter: %d keys, %d searches, %d bits per key\n\n", num_keys, num_ops, HT_FILTER_BITS);
+
+  for (int t = 0; t < 2; t++) {
+    tables[t] = ht_new();
+    ht_use_arena(tables[t], arena_new(0));
+    for (int i = 0; i < num_keys; i++) {
+      int* value = ht_alloc_value(tables[t], sizeof(int));
+      *value = i;
+      ht_insert(tables[t], keys[i], value);
+    }
+  }
+  const int saved = ht_save_snapshot(tables[0], FILTER_SNAPSHOT, sizeof(int));
+  tables[2] = (saved == 0) ? ht_open_snapshot(FILTER_SNAPSHOT, sizeof(int)) : NULL;
+  if ((ht_freeze(tables[1]) != 0) || (tables[2] == NULL)) {
+    printf("ERROR: could not freeze the table or open the snapshot\n");
+    return 1;
+  }
+
+  printf("%-28s %12s %12s %12s %12s\n", "", "hit", "hit+filter", "miss", "miss+filter");
+  for (int t = 0; t < 3; t++) {
+    double hit_ns[2], miss_ns[2];
+    for (int filtered = 0; filtered <= 1; filtered++) {
+      ht_use_filter(tables[t], filtered ? HT_FILTER_BITS : 0);
+      hit_ns[filtered] = filter_search_ns(tables[t], keys, num_keys, num_ops);
+      miss_ns[filtered] = filter_search_ns(tables[t], misses, num_keys, num_ops);
+    }
+    printf("%-28s %9.1f ns %9.1f ns %9.1f ns %9.1f ns\n", names[t],
+           hit_ns[0], hit_ns[1], miss_ns[0], miss_ns[1]);
+  }
+  double hit_ns[2], miss_ns[2];
+  for (int filtered = 0; filtered <= 1; filtered++) {
+    ht_use_filter(tables[0], filtered ? HT_FILTER_BITS : 0);
+    hit_ns[filtered] = filter_batch_ns(tables[0], keys, num_keys, num_ops);
+    miss_ns[filtered] = filter_batch_ns(tables[0], misses, num_keys, num_ops);
+  }
+  printf("%-28s %9.1f ns %9.1f ns %9.1f ns %9.1f ns\n", "ht_search_batch()",
+         hit_ns[0], hit_ns[1], miss_ns[0], miss_ns[1]);
+
+  // every table must still find every key, and the rate of misses that get
+  // through should be close to what the bits predict
+  for (int i = 0; i < num_keys; i++) {
+    values[i] = ht_search(tables[1], keys[i]);
+  }
+  for (int t = 0; t < 3; t++) {
+    ht_reset_stats(tables[t]);
+    mismatches += filter_check(tables[t], keys, values, misses, num_keys);
+    ht_get_stats(tables[t], &stats);
+    printf("%-28s %8.3f%% expected  %8.3f%% measured  %6.1f bytes/key of filter\n",
+           names[t], stats.filter_fpr * 100, stats.filter_measured_fpr * 100,
+           (double)stats.filter_bytes / num_keys);
+  }
+
+  // deletes leave their bits behind, the extra keys outgrow the filter and
+  // have it rebuilt.  The table without a filter says what should be there
+  ht_hash_table* plain = ht_new();
+  ht_hash_table* ht = tables[0];
+  for (int i = 0; i < num_keys; i++) {
+    int* value = malloc(sizeof(int));
+    *value = i;
+    ht_insert(plain, keys[i], value);
+  }
+  for (int i = 0; i < num_keys; i += 2) {
+    ht_delete(ht, keys[i]);
+    ht_delete(plain, keys[i]);
+  }
+  for (int i = 0; i < num_keys; i++) {
+    int* value = ht_alloc_value(ht, sizeof(int));
+    *value = -i;
+    ht_insert(ht, extra[i], value);
+    value = malloc(sizeof(int));
+    *value = -i;
+    ht_insert(plain, extra[i], value);
+    if (i % 4 == 0) {
+      value = ht_alloc_value(ht, sizeof(int));
+      *value = 2 * i;
+      ht_insert(ht, keys[i], value);
+      value = malloc(sizeof(int));
+      *value = 2 * i;
+      ht_insert(plain, keys[i], value);
+    }
+  }
+  int inserted = 1;
+  int* value = ht_get_or_insert(ht, keys[num_keys - 1], sizeof(int), &inserted);
+  mismatches += (value == NULL) || inserted || (*value != num_keys - 1);
+  mismatches += (ht->count != plain->count);
+  for (int i = 0; i < num_keys; i++) {
+    values[i] = ht_search(plain, keys[i]);
+  }
+  mismatches += filter_check(ht, keys, values, misses, num_keys);
+  for (int i = 0; i < num_keys; i++) {
+    values[i] = ht_search(plain, extra[i]);
+  }
+  mismatches += filter_check(ht, extra, values, misses, num_keys);
+  ht_get_stats(ht, &stats);
+  printf("%-28s %8.3f%% expected  %8.3f%% measured  (after churn)\n", "table",
+         stats.filter_fpr * 100, stats.filter_measured_fpr * 100);
+  printf("%-28s %d mismatches\n", "check", mismatches);
+
+  ht_del_hash_table(plain);
+  for (int t = 0; t < 3; t++) {
+    ht_del_hash_table(tables[t]);
+  }
+  remove(FILTER_SNAPSHOT);
+  free(values);
+  free_keys(keys, num_keys);
+  free_keys(misses, num_keys);
+  free_keys(extra, num_keys);
+  return mismatches;
+}
+
+
+// what each reader of the seasons mode checks and counts
+typedef struct {
+  cat_catalog* cat;
+  vt_table* table;
+  const ht_packed_key* keys;  // the SEASON_TEAMS teams the writer changes
+  long total_pts;             // what their points add up to in every version
+  long reads;
+  long versions;
+  long problems;
+} season_reader_t;
+
+static volatile int seasons_done;
+
+
+/**
+ * season_key() - the key of team k of the CSV files written by write_season()
+ */
+static void season_key(const int k, ht_packed_key* key) {
+  char city[MAX_CITY_NAME + 1];
+  conf_t conf;
+
+  snprintf(city, sizeof(city), "City%07d", k / 3);
+  parseConf(confs[k % 3], &conf);
+  ht_pack_key(key, conf, city);
+}
+
+
+/**
+ * write_season() - writes the CSV file of a season, the records differ by season
+ *
+ * @return 0 on success, -1 if the file could not be written
+ */
+static int write_season(const int season, const int num_keys) {
+  char path[64];
+
+  snprintf(path, sizeof(path), SEASON_CSV, season);
+  FILE* fp = fopen(path, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "ERROR(write_season()): Could not create %s\n", path);
+    return -1;
+  }
+  fprintf(fp, "// season %d: conf,city,name,pts,win,loss,tie,gd\n", season);
+  for (int i = 0; i < num_keys; i++) {
+    fprintf(fp, "%s,City%07d,Team %d,%d,%d,%d,%d,%d\n", confs[i % 3], i / 3, i,
+            (i + season) % 70, (i + season) % 23, i % 17, i % 11, (i % 41) - 20);
+  }
+  fclose(fp);
+  return 0;
+}
+
+
+/**
+ * season_pts() - adds up the points of the writer's teams in a version
+ *
+ * @return the total, or -1 if a team is missing
+ */
+static long season_pts(const vt_version* v, const ht_packed_key* keys) {
+  long total = 0;
+  for (int i = 0; i < SEASON_TEAMS; i++) {
+    const TeamInfo_t* team = vt_search(v, &keys[i]);
+    if (team == NULL) {
+      return -1;
+    }
+    total += team->pts;
+  }
+  return total;
+}
+
+
+/**
+ * season_reader() - holds one version after another and checks each of them
+ */
+static void* season_reader(void* arg) {
+  season_reader_t* r = arg;
+  vt_reader* reader = cat_register(r->cat);
+  uint64_t last = 0;
+
+  while (!__atomic_load_n(&seasons_done, __ATOMIC_ACQUIRE)) {
+    vt_version* v = vt_acquire(r->table, reader);
+    r->problems += (season_pts(v, r->keys) != r->total_pts) || (v->number < last);
+    last = v->number;
+    r->reads += SEASON_TEAMS;
+    r->versions++;
+    vt_release(reader, v);
+  }
+  vt_unregister(reader);
+  return NULL;
+}
+
+
+/**
+ * season_matches() - compares a version with the records of a hash table
+ *
+ * @param skip_moved is 1 to skip the points of the writer's teams
+ *
+ * @return the number of teams that differ or are missing
+ */
+static int season_matches(const vt_version* v, ht_hash_table* ht, const int skip_moved) {
+  ht_packed_key key;
+  ht_item* item;
+  int index = 0;
+  int problems = (v->count != ht->count);
+
+  while ((item = ht_next(ht, &index)) != NULL) {
+    const TeamInfo_t* a = item->value;
+    teamInfoPackedKey(a, &key);
+    const TeamInfo_t* b = vt_search(v, &key);
+    int k = -1;
+    sscanf(a->name, "Team %d", &k);
+    problems += (b == NULL) || (strcmp(a->name, b->name) != 0) || (a->win != b->win) ||
+                (a->loss != b->loss) || (a->tie != b->tie) || (a->gd != b->gd) ||
+                ((a->pts != b->pts) && !(skip_moved && (k >= 0) && (k < SEASON_TEAMS)));
+  }
+  return problems;
+}
+
+
+/**
+ * bench_seasons() - a catalog of seasons, and publishing versions under readers
+ *
+ * @return the number of problems found
+ */
+static int bench_seasons(const int num_keys, const int num_ops, const int max_threads) {
+  char path[64];
+  ht_packed_key keys[SEASON_TEAMS];
+  season_reader_t readers[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  cat_catalog* cat = NULL;
+  int problems = 0;
+  printf("Seasons: %d seasons of %d teams, %d threads\n\n", SEASONS, num_keys, max_threads);
+
+  if (num_keys < 2 * SEASON_TEAMS) {
+    printf("ERROR: need at least %d teams\n", 2 * SEASON_TEAMS);
+    return 1;
+  }
+  for (int s = 0; s < SEASONS; s++) {
+    if (write_season(2021 + s, num_keys) != 0) {
+      return 1;
+    }
+  }
+
+  // the first load is not timed, it gets the files into the page cache
+  for (int pass = 0; pass < 3; pass++) {
+    const int num_threads = (pass < 2) ? 1 : max_threads;
+    if (cat != NULL) {
+      cat_del(cat);
+    }
+    cat = cat_new();
+    for (int s = 0; s < SEASONS; s++) {
+      snprintf(path, sizeof(path), SEASON_CSV, 2021 + s);
+      cat_add(cat, 2021 + s, path);
+    }
+    const double t0 = now_ns();
+    const long loaded = cat_load(cat, num_threads);
+    if (pass > 0) {
+      printf("%-28s %10.3f ms (%d threads)\n", "cat_load()", (now_ns() - t0) / 1e6, num_threads);
+    }
+    problems += (loaded != (long)SEASONS * num_keys);
+  }
+
+  // the points of the writer's teams add up to the same total in every version
+  vt_table* vt = cat_get(cat, 2021);
+  vt_reader* main_reader = cat_register(cat);
+  vt_version* first = vt_acquire(vt, main_reader);
+  for (int k = 0; k < SEASON_TEAMS; k++) {
+    season_key(k, &keys[k]);
+  }
+  const long total_pts = season_pts(first, keys);
+  const int num_readers = (max_threads > 1) ? max_threads - 1 : 1;
+  seasons_done = 0;
+  for (int i = 0; i < num_readers; i++) {
+    memset(&readers[i], 0, sizeof(season_reader_t));
+    readers[i].cat = cat;
+    readers[i].table = vt;
+    readers[i].keys = keys;
+    readers[i].total_pts = total_pts;
+    pthread_create(&threads[i], NULL, season_reader, &readers[i]);
+  }
+
+  // every version moves a point between two teams and deletes, or puts back,
+  // one of the other teams
+  const int num_versions = ((num_ops / 1000) + 1) & ~1;
+  snprintf(path, sizeof(path), SEASON_CSV, 2021);
+  ht_hash_table* plain = ht_new();
+  ht_set_key_mode(plain, HT_KEY_PACKED);
+  csvLoadResult_t result;
+  loadTeamInfoCsv(plain, path, &result);
+  const long pages_before = vt->pages_copied;
+  const long records_before = vt->records_copied;
+  double t0 = now_ns();
+  for (int i = 0; i < num_versions; i++) {
+    const int a = (int)(((size_t)i * 7919) % SEASON_TEAMS);
+    const int b = (a + 1 + i % (SEASON_TEAMS - 1)) % SEASON_TEAMS;
+    const int other = SEASON_TEAMS + (i / 2) % (num_keys - SEASON_TEAMS);
+    ht_packed_key key;
+    season_key(other, &key);
+    vt_begin(vt);
+    TeamInfo_t* from = vt_modify(vt, &keys[a]);
+    TeamInfo_t* to = vt_modify(vt, &keys[b]);
+    if ((from == NULL) || (to == NULL)) {
+      problems++;
+      vt_abort(vt);
+      continue;
+    }
+    from->pts--;
+    to->pts++;
+    if (i % 2 == 0) {
+      problems += (vt_delete(vt, &key) != 1);
+    }
+    else {
+      problems += (vt_put(vt, ht_search_packed(plain, &key)) != 1);
+    }
+    vt_publish(vt);
+  }
+  const double publish_ns = (now_ns() - t0) / num_versions;
+  __atomic_store_n(&seasons_done, 1, __ATOMIC_RELEASE);
+  long reads = 0, versions = 0;
+  for (int i = 0; i < num_readers; i++) {
+    pthread_join(threads[i], NULL);
+    reads += readers[i].reads;
+    versions += readers[i].versions;
+    problems += (readers[i].problems != 0);
+  }
+
+  // what a version would cost without sharing: every record copied
+  t0 = now_ns();
+  ht_hash_table* copy = ht_new_sized(2 * num_keys);
+  ht_set_key_mode(copy, HT_KEY_PACKED);
+  ht_use_arena(copy, arena_new(0));
+  vt_version* last = vt_acquire(vt, main_reader);
+  const TeamInfo_t* team;
+  int index = 0;
+  while ((team = vt_next(last, &index)) != NULL) {
+    ht_packed_key key;
+    TeamInfo_t* info = ht_alloc_value(copy, sizeof(TeamInfo_t));
+    *info = *team;
+    teamInfoPackedKey(team, &key);
+    ht_insert_packed(copy, &key, info);
+  }
+  const double copy_ns = now_ns() - t0;
+
+  printf("%-28s %10.1f us/version  %6.2f pages and %4.2f records copied (of %d pages)\n",
+         "vt_begin() .. vt_publish()", publish_ns / 1e3,
+         (double)(vt->pages_copied - pages_before) / num_versions,
+         (double)(vt->records_copied - records_before) / num_versions, VT_NUM_PAGES);
+  printf("%-28s %10.1f us/version\n", "copying every record", copy_ns / 1e3);
+  printf("%-28s %10ld versions, %ld searches by %d readers\n", "readers saw", versions, reads,
+         num_readers);
+
+  // the first version is still what the file said, the last one has the
+  // same teams with the points moved around
+  problems += (season_matches(first, plain, 0) != 0);
+  problems += (season_matches(last, plain, 1) != 0) || (season_pts(last, keys) != total_pts) ||
+              (last->number != first->number + (uint64_t)num_versions);
+  problems += (copy->count != last->count);
+  printf("%-28s %d problems\n", "check", problems);
+
+  vt_release(main_reader, first);
+  vt_release(main_reader, last);
+  vt_unregister(main_reader);
+  ht_del_hash_table(copy);
+  ht_del_hash_table(plain);
+  cat_del(cat);
+  for (int s = 0; s < SEASONS; s++) {
+    snprintf(path, sizeof(path), SEASON_CSV, 2021 + s);
+    remove(path);
+  }
+  return problems;
+}
+
+
+/**
+ * big_key() - the key of item k of bench_big()
+ */
+static void big_key(const int k, ht_packed_key* key) {
+  char city[MAX_CITY_NAME + 1];
+  conf_t conf;
+
+  snprintf(city, sizeof(city), "Big%08d", k / 3);
+  parseConf(confs[k % 3], &conf);
+  ht_pack_key(key, conf, city);
+}
+
+
+/**
+ * big_check() - checks that the table isn't loaded past HT_GROW_LOAD
+ *
+ * @return 1 if it is, 0 if not
+ */
+static int big_check(const ht_hash_table* ht, const char* when) {
+  // reads the fields, ht_get_stats() would walk every slot
+  if ((long)ht->count * 100 > (long)HT_GROW_LOAD * ht->size) {
+    printf("ERROR: %d items in %d slots %s\n", ht->count, ht->size, when);
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * bench_big() - grows and shrinks a table past the int overflow of count * 100
+ *
+ * @return the number of problems found
+ */
+static int bench_big(const int num_keys) {
+  const int n = (num_keys > BIG_MIN_KEYS) ? num_keys : BIG_MIN_KEYS;
+  ht_hash_table* ht = ht_new();
+  ht_packed_key key;
+  ht_stats stats;
+  int problems = 0;
+  ht_set_key_mode(ht, HT_KEY_PACKED);
+  printf("Big table: %d packed keys\n\n", n);
+
+  double t0 = now_ns();
+  for (int i = 0; i < n; i++) {
+    big_key(i, &key);
+    ht_insert_packed(ht, &key, NULL);
+    problems += big_check(ht, "while inserting");
+  }
+  double t1 = now_ns();
+  ht_get_stats(ht, &stats);
+  printf("%-28s %10.1f ns/op  %d items in %d slots, max PSL %d\n", "ht_insert_packed()",
+         (t1 - t0) / n, stats.count, stats.size, stats.max_psl);
+  problems += (stats.count != n);
+
+  // the values are all NULL, so the count says whether each delete found its key
+  t0 = now_ns();
+  for (int i = 0; i < n; i++) {
+    const int before = ht->count;
+    big_key(i, &key);
+    ht_delete_packed(ht, &key);
+    problems += (ht->count != before - 1);
+    problems += big_check(ht, "while deleting");
+  }
+  t1 = now_ns();
+  ht_get_stats(ht, &stats);
+  printf("%-28s %10.1f ns/op  %d items in %d slots\n", "ht_delete_packed()",
+         (t1 - t0) / n, stats.count, stats.size);
+  problems += (stats.count != 0);
+
+  ht_del_hash_table(ht);
+  printf("check                        %d problems\n", problems);
+  return problems;
+}
+
+
+int main(int argc, char* argv[]) {
+  const char* mode = (argc > 1) ? argv[1] : "lookup";
+  const int num_keys = (argc > 2) ? atoi(argv[2]) : DEFAULT_NUM_KEYS;
+  const int num_ops = (argc > 3) ? atoi(argv[3]) : DEFAULT_NUM_OPS;
+  int max_threads = (argc > 4) ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (argc <= 4) {
+    max_threads = (max_threads < 2) ? 2 : (max_threads > MAX_THREADS) ? MAX_THREADS : max_threads;
+  }
+
+  if ((num_keys <= 0) || (num_ops <= 0) || (max_threads <= 0) || (max_threads > MAX_THREADS)) {
+    fprintf(stderr, "usage: %s [lookup|churn|load|batch|threads|stress|build|snapshot|packed|nocase|frozen|feed|standings|prefix|columns|typed|compact|wal|filter|seasons|big]"
+                    " [num_keys] [num_ops] [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  if (strcmp(mode, "lookup") == 0) {
+    bench_lookup(num_keys, num_ops);
+  }
+  else if (strcmp(mode, "churn") == 0) {
+    bench_churn(num_keys, num_ops);
+  }
+  else if (strcmp(mode, "load") == 0) {
+    bench_load(num_keys);
+  }
+  else if (strcmp(mode, "batch") == 0) {
+    bench_batch(num_keys, num_ops);
+  }
+  else if (strcmp(mode, "threads") == 0) {
+    bench_threads(num_keys, num_ops, max_threads);
+  }
+  else if (strcmp(mode, "stress") == 0) {
+    return (bench_stress(num_keys, num_ops, max_threads) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "build") == 0) {
+    bench_build(num_keys, max_threads);
+  }
+  else if (strcmp(mode, "snapshot") == 0) {
+    bench_snapshot(num_keys, num_ops);
+  }
+  else if (strcmp(mode, "packed") == 0) {
+    return (bench_packed(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "nocase") == 0) {
+    return (bench_nocase(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "frozen") == 0) {
+    return (bench_frozen(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "feed") == 0) {
+    return (bench_feed(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "standings") == 0) {
+    return (bench_standings(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "prefix") == 0) {
+    return (bench_prefix(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "columns") == 0) {
+    return (bench_columns(num_keys) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "typed") == 0) {
+    return (bench_typed(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "compact") == 0) {
+    return (bench_compact(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "wal") == 0) {
+    return (bench_wal(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "filter") == 0) {
+    return (bench_filter(num_keys, num_ops) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "seasons") == 0) {
+    return (bench_seasons(num_keys, num_ops, max_threads) == 0) ? 0 : 1;
+  }
+  else if (strcmp(mode, "big") == 0) {
+    return (bench_big(num_keys) == 0) ? 0 : 1;
+  }
+  else {
+    fprintf(stderr, "usage: %s [lookup|churn|load|batch|threads|stress|build|snapshot|packed|nocase|frozen|feed|standings|prefix|columns|typed|compact|wal|filter|seasons|big]"
+                    " [num_keys] [num_ops] [max_threads]\n", argv[0]);
+    return 1;
+  }
+  return 0;
+}
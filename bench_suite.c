@@ -0,0 +1,434 @@
+/**
+ * bench_suite.c - Benchmark suite for the Hash table ADT
+ *
+ * @brief  This program measures the hash table on synthetic keys shaped like
+ * the keys createKey() makes (an uppercase city followed by the conference, ex:
+ * PORTLANDWEST) so changes to hash_table.c can be tracked from release to
+ * release.  For every table size and load factor it runs these workloads:
+ *
+ *  insert  - inserts every key into an empty table sized for the load factor
+ *  hit     - searches for keys that are in the table
+ *  miss    - searches for keys that are not in the table
+ *  churn   - deletes a key that is in the table and inserts one that isn't
+ *            (one op is the pair), so the load factor stays the same
+ *  delete  - deletes every key
+ *
+ * and reports the average ns/op, the median (p50) and 99th percentile (p99)
+ * latency of a single op, the peak resident set size and, from ht_get_stats(),
+ * the average and longest probe sequence length, the number of resizes and the
+ * bytes of memory per entry (table, keys and the arena's values).  Every size/load
+ * configuration runs in its own child process so its peak RSS isn't hidden by
+ * an earlier, bigger configuration.  The results are printed and written to a
+ * CSV file.
+ *
+ * The table has a power of two number of slots, so a size and load factor
+ * are turned into the power of two closest to size / load slots and that many
+ * slots times the load factor keys; the keys column is the actual number of
+ * keys.  The table grows on its own above HT_GROW_LOAD, so higher load factors
+ * end up at about half of that (see the actual load column).  The percentiles
+ * are the latency of one op on its own, while ns/op is the throughput of a
+ * loop of ops whose cache misses can overlap, so p50 can be above ns/op.
+ *
+ * usage: bench_suite [-s sizes] [-l loads] [-n num_ops] [-o file.csv]
+ *
+ *  -s  comma separated table sizes in keys (default 1000,10000,100000,1000000)
+ *  -l  comma separated load factors in percent (default 50,70)
+ *  -n  searches and churn ops per workload (default 1000000)
+ *  -o  CSV file to write (default bench_results.csv)
+ *
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "hash_table.h"
+
+// constants
+#define DEFAULT_SIZES       "1000,10000,100000,1000000"
+#define DEFAULT_LOADS       "50,70"
+#define DEFAULT_NUM_OPS     1000000
+#define DEFAULT_CSV         "bench_results.csv"
+#define MAX_CONFIGS         32        // sizes or loads on the command line
+#define MAX_SUITE_KEYS      10000000
+#define MISS_KEYS_FIRST     (4 * MAX_SUITE_KEYS)   // index of the first key that is never inserted
+#define KEY_STRIDE          32        // bytes per key in the key buffer
+#define CITY_LETTERS        7         // letters that make a key unique
+
+static const char* confs[] = {"NWSL", "EAST", "WEST"};
+
+// prevents the compiler from optimizing away the work being timed
+static volatile unsigned long sink;
+
+// what a workload measured
+typedef struct {
+  double ns_per_op;
+  double p50;
+  double p99;
+} result_t;
+
+
+/**
+ * now_ns() - reads the monotonic clock
+ *
+ * @return the current time in nanoseconds
+ */
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+/**
+ * make_keys() - generates num_keys distinct keys like the ones createKey() makes
+ *
+ * Key i is a city of 7 to 14 uppercase letters followed by a conference.  The
+ * first 7 letters are index i scrambled (multiplying by an odd constant is a
+ * one-to-one map) and written in base 26, so no two keys are the same and
+ * neighbouring keys don't share prefixes.
+ *
+ * @param first is the index of the first key, keys from different ranges never match
+ * @param num_keys is the number of keys
+ *
+ * @return num_keys keys, KEY_STRIDE bytes apart.  Free with free()
+ */
+static char* make_keys(const long first, const long num_keys) {
+  char* keys = malloc((size_t)num_keys * KEY_STRIDE);
+  for (long i = 0; i < num_keys; i++) {
+    char* key = keys + (size_t)i * KEY_STRIDE;
+    uint32_t x = (uint32_t)(first + i) * 2654435761u;
+    int len = 0;
+    for (int d = 0; d < CITY_LETTERS; d++) {
+      key[len++] = (char)('A' + x % 26);
+      x /= 26;
+    }
+    for (int d = 0; d < (int)((first + i) % 8); d++) {
+      key[len++] = (char)('A' + (first + i + d) % 26);
+    }
+    strcpy(key + len, confs[(first + i) % 3]);
+  }
+  return keys;
+}
+
+
+/**
+ * clock_overhead() - measures the cost of reading the clock twice
+ *
+ * @return the smallest time between two now_ns() calls
+ */
+static double clock_overhead(void) {
+  double best = 1e9;
+  for (int i = 0; i < 1000; i++) {
+    const double t0 = now_ns();
+    const double t1 = now_ns();
+    best = (t1 - t0 < best) ? t1 - t0 : best;
+  }
+  return best;
+}
+
+
+static int compare_doubles(const void* a, const void* b) {
+  const double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+
+/**
+ * summarize() - works out ns/op and the latency percentiles of a workload
+ *
+ * @param samples is the latency of every op (sorted by this function)
+ * @param num_ops is the number of ops
+ * @param total_ns is the time all of the ops took
+ * @param overhead is the clock overhead to take off every sample
+ *
+ * @return the results
+ */
+static result_t summarize(double* samples, const long num_ops, const double total_ns,
+                          const double overhead) {
+  result_t r;
+  qsort(samples, (size_t)num_ops, sizeof(double), compare_doubles);
+  r.ns_per_op = total_ns / num_ops;
+  r.p50 = samples[num_ops / 2] - overhead;
+  r.p99 = samples[num_ops * 99 / 100] - overhead;
+  r.p50 = (r.p50 < 0) ? 0 : r.p50;
+  r.p99 = (r.p99 < 0) ? 0 : r.p99;
+  return r;
+}
+
+
+/**
+ * peak_rss_kb() - reads the peak resident set size of this process
+ *
+ * @return the peak RSS in KB
+ */
+static long peak_rss_kb(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;      // bytes on macOS
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+
+/**
+ * report() - prints a workload's results and appends them to the CSV file
+ */
+static void report(FILE* csv, const char* workload, const long num_keys, const int load,
+                   const ht_hash_table* ht, const long num_ops, const result_t* r) {
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+  const double actual = 100.0 * stats.load_factor;
+  const long rss = peak_rss_kb();
+  printf("%-8s %9ld %5d%% %7.1f%% %9ld %10.1f %10.1f %10.1f %10ld %7.2f %7d %7ld %9.1f\n",
+         workload, num_keys, load, actual, num_ops, r->ns_per_op, r->p50, r->p99, rss,
+         stats.avg_psl, stats.max_psl, stats.resizes, stats.bytes_per_entry);
+  fprintf(csv, "%s,%ld,%d,%.1f,%ld,%.1f,%.1f,%.1f,%ld,%.2f,%d,%ld,%.1f\n",
+          workload, num_keys, load, actual, num_ops, r->ns_per_op, r->p50, r->p99, rss,
+          stats.avg_psl, stats.max_psl, stats.resizes, stats.bytes_per_entry);
+  fflush(stdout);
+  fflush(csv);
+}
+
+
+/**
+ * run_config() - runs every workload for one table size and load factor
+ *
+ * Every workload is run twice: once timing the whole loop for ns/op and once
+ * timing every op on its own for the percentiles (the clock overhead is taken
+ * off those samples).
+ */
+static void run_config(FILE* csv, const long size, const int load, const long num_ops) {
+  long num_slots = HT_MIN_BASE_SIZE;
+  while ((double)num_slots * 1.5 < (double)size * 100.0 / load) {
+    num_slots *= 2;
+  }
+  const long num_keys = (num_slots * load / 100 > 0) ? num_slots * load / 100 : 1;
+  char* keys = make_keys(0, num_keys);
+  char* misses = make_keys(MISS_KEYS_FIRST, num_keys);
+  const long max_samples = (num_keys > num_ops) ? num_keys : num_ops;
+  double* samples = malloc((size_t)max_samples * sizeof(double));
+  long* order = malloc((size_t)num_ops * sizeof(long));
+  const double overhead = clock_overhead();
+  double t0, total = 0;
+  result_t r;
+
+  srand((unsigned)num_keys);
+  for (long i = 0; i < num_ops; i++) {
+    order[i] = (long)(((unsigned long)rand() * ((unsigned long)RAND_MAX + 1) + (unsigned long)rand()) %
+                      (unsigned long)num_keys);
+  }
+
+  // insert, once for the total time and once for the samples
+  ht_hash_table* ht = NULL;
+  for (int pass = 0; pass < 2; pass++) {
+    if (ht != NULL) {
+      ht_del_hash_table(ht);
+    }
+    ht = ht_new_sized((int)num_slots);
+    ht_use_arena(ht, arena_new(0));
+    t0 = now_ns();
+    for (long i = 0; i < num_keys; i++) {
+      const double s = (pass == 1) ? now_ns() : 0;
+      long* value = ht_alloc_value(ht, sizeof(long));
+      *value = i;
+      ht_insert(ht, keys + (size_t)i * KEY_STRIDE, value);
+      if (pass == 1) {
+        samples[i] = now_ns() - s;
+      }
+    }
+    if (pass == 0) {
+      total = now_ns() - t0;
+    }
+  }
+  r = summarize(samples, num_keys, total, overhead);
+  report(csv, "insert", num_keys, load, ht, num_keys, &r);
+
+  // hit and miss searches
+  for (int miss = 0; miss < 2; miss++) {
+    const char* set = miss ? misses : keys;
+    unsigned long found = 0;
+    t0 = now_ns();
+    for (long i = 0; i < num_ops; i++) {
+      found += (ht_search(ht, set + (size_t)order[i] * KEY_STRIDE) != NULL);
+    }
+    total = now_ns() - t0;
+    for (long i = 0; i < num_ops; i++) {
+      const double s = now_ns();
+      found += (ht_search(ht, set + (size_t)order[i] * KEY_STRIDE) != NULL);
+      samples[i] = now_ns() - s;
+    }
+    sink += found;
+    r = summarize(samples, num_ops, total, overhead);
+    report(csv, miss ? "miss" : "hit", num_keys, load, ht, num_ops, &r);
+  }
+
+  // churn: exactly one of keys[k] and misses[k] is in the table, swap it for
+  // the other one
+  t0 = now_ns();
+  for (int pass = 0; pass < 2; pass++) {
+    for (long i = 0; i < num_ops; i++) {
+      const double s = (pass == 1) ? now_ns() : 0;
+      char* in = keys + (size_t)order[i] * KEY_STRIDE;
+      char* out = misses + (size_t)order[i] * KEY_STRIDE;
+      if (ht_search(ht, in) == NULL) {
+        char* tmp = in;
+        in = out;
+        out = tmp;
+      }
+      long* value = ht_alloc_value(ht, sizeof(long));
+      *value = order[i];
+      ht_delete(ht, in);
+      ht_insert(ht, out, value);
+      if (pass == 1) {
+        samples[i] = now_ns() - s;
+      }
+    }
+    if (pass == 0) {
+      total = now_ns() - t0;
+    }
+  }
+  r = summarize(samples, num_ops, total, overhead);
+  report(csv, "churn", num_keys, load, ht, num_ops, &r);
+
+  // delete whatever is in the table now: every key is either in keys or
+  // misses, found beforehand so only the deletes are timed.  The keys go back
+  // in between the two passes
+  const char** live = malloc((size_t)num_keys * sizeof(char*));
+  for (long i = 0; i < num_keys; i++) {
+    live[i] = keys + (size_t)i * KEY_STRIDE;
+    if (ht_search(ht, live[i]) == NULL) {
+      live[i] = misses + (size_t)i * KEY_STRIDE;
+    }
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass == 1) {
+      for (long i = 0; i < num_keys; i++) {
+        long* value = ht_alloc_value(ht, sizeof(long));
+        *value = i;
+        ht_insert(ht, live[i], value);
+      }
+    }
+    t0 = now_ns();
+    for (long i = 0; i < num_keys; i++) {
+      const double s = (pass == 1) ? now_ns() : 0;
+      ht_delete(ht, live[i]);
+      if (pass == 1) {
+        samples[i] = now_ns() - s;
+      }
+    }
+    if (pass == 0) {
+      total = now_ns() - t0;
+    }
+  }
+  free(live);
+  r = summarize(samples, num_keys, total, overhead);
+  report(csv, "delete", num_keys, load, ht, num_keys, &r);
+
+  ht_del_hash_table(ht);
+  free(order);
+  free(samples);
+  free(keys);
+  free(misses);
+}
+
+
+/**
+ * parse_list() - parses a comma separated list of numbers
+ *
+ * @return the number of values or -1 if the list isn't valid
+ */
+static int parse_list(const char* list, long* values, const long min, const long max) {
+  int n = 0;
+  char* end;
+  while (*list != '\0') {
+    if (n == MAX_CONFIGS) {
+      return -1;
+    }
+    values[n] = strtol(list, &end, 10);
+    if ((end == list) || (values[n] < min) || (values[n] > max) || ((*end != ',') && (*end != '\0'))) {
+      return -1;
+    }
+    n++;
+    list = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+
+int main(int argc, char* argv[]) {
+  const char* sizes_arg = DEFAULT_SIZES;
+  const char* loads_arg = DEFAULT_LOADS;
+  const char* csv_path = DEFAULT_CSV;
+  long num_ops = DEFAULT_NUM_OPS;
+  long sizes[MAX_CONFIGS], loads[MAX_CONFIGS];
+  int num_sizes, num_loads;
+
+  for (int i = 1; i < argc; i++) {
+    if ((i + 1 < argc) && (strcmp(argv[i], "-s") == 0)) {
+      sizes_arg = argv[++i];
+    }
+    else if ((i + 1 < argc) && (strcmp(argv[i], "-l") == 0)) {
+      loads_arg = argv[++i];
+    }
+    else if ((i + 1 < argc) && (strcmp(argv[i], "-n") == 0)) {
+      num_ops = atol(argv[++i]);
+    }
+    else if ((i + 1 < argc) && (strcmp(argv[i], "-o") == 0)) {
+      csv_path = argv[++i];
+    }
+    else {
+      num_ops = 0;
+      break;
+    }
+  }
+  num_sizes = parse_list(sizes_arg, sizes, 1, MAX_SUITE_KEYS);
+  num_loads = parse_list(loads_arg, loads, 1, 100);
+  if ((num_sizes <= 0) || (num_loads <= 0) || (num_ops <= 0)) {
+    fprintf(stderr, "usage: %s [-s sizes] [-l loads] [-n num_ops] [-o file.csv]\n", argv[0]);
+    return 1;
+  }
+
+  FILE* csv = fopen(csv_path, "w");
+  if (csv == NULL) {
+    fprintf(stderr, "ERROR: Could not create %s\n", csv_path);
+    return 1;
+  }
+  fprintf(csv, "workload,keys,load_pct,actual_load_pct,ops,ns_per_op,p50_ns,p99_ns,peak_rss_kb,"
+               "avg_psl,max_psl,resizes,bytes_per_entry\n");
+  fflush(csv);
+  printf("%-8s %9s %6s %8s %9s %10s %10s %10s %10s %7s %7s %7s %9s\n",
+         "workload", "keys", "load", "actual", "ops", "ns/op", "p50 ns", "p99 ns", "RSS KB",
+         "avg PSL", "max PSL", "resizes", "B/entry");
+  fflush(stdout);
+
+  // each configuration in its own process so the peak RSS is its own
+  int failed = 0;
+  for (int s = 0; s < num_sizes; s++) {
+    for (int l = 0; l < num_loads; l++) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        run_config(csv, sizes[s], (int)loads[l], num_ops);
+        fclose(csv);
+        _exit(0);
+      }
+      int status = 1;
+      if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) ||
+          (WEXITSTATUS(status) != 0)) {
+        fprintf(stderr, "ERROR: %ld keys at %ld%% load failed\n", sizes[s], loads[l]);
+        failed = 1;
+      }
+    }
+  }
+  fclose(csv);
+  printf("\nResults written to %s\n", csv_path);
+  return failed;
+}
@@ -0,0 +1,241 @@
+/**
+ * catalog.c - Catalog of team tables by season
+ *
+ * @brief   This is the source code file for the season catalog.  The catalog
+ * itself is a short array sorted by season; the seasons are added before the
+ * readers start and only their tables change afterwards, by publishing new
+ * versions.
+ *
+ * cat_load() starts numThreads threads that take the next season off a shared
+ * counter until every file is loaded, so a big file doesn't hold up the small
+ * ones behind it.  Each file is loaded by vt_load_csv() into its own table, so
+ * the threads never share anything but the counter.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "catalog.h"
+
+// prototypes for the Helper functions
+
+// loads seasons until there are none left, the body of a cat_load() thread
+static void* cat_load_seasons(void* arg);
+
+// Catalog ADT
+
+/**
+ * cat_new() - initializes a new, empty catalog
+ *
+ * @return a pointer to the new catalog or NULL if it could not be allocated
+ */
+cat_catalog* cat_new(void) {
+  cat_catalog* cat = calloc(1, sizeof(cat_catalog));
+  if (cat == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(cat_new()): Could not allocate space for the catalog\n");
+    #endif
+    return NULL;
+  }
+  cat->ebr = ebr_new();
+  if (cat->ebr == NULL) {
+    free(cat);
+    return NULL;
+  }
+  return cat;
+}
+
+
+/**
+ * cat_del() - deletes a catalog and the tables of its seasons
+ *
+ * @param cat is the catalog.  Every reader must have released its versions
+ * and unregistered
+ */
+void cat_del(cat_catalog* cat) {
+  for (int i = 0; i < cat->num_seasons; i++) {
+    vt_del_table(cat->seasons[i].table);
+    free(cat->seasons[i].path);
+  }
+  // frees the versions the tables retired
+  ebr_del(cat->ebr);
+  free(cat);
+}
+
+
+/**
+ * cat_add() - adds a season to the catalog
+ *
+ * The season's table is empty until cat_load() reads its file.  Seasons must
+ * be added before any thread reads the catalog.
+ *
+ * @param cat is the catalog
+ * @param season is the season (ex: 2021)
+ * @param path is the CSV file with the season's teams
+ *
+ * @return 0 on success, -1 if the catalog already has the season, is full or
+ * out of memory
+ */
+int cat_add(cat_catalog* cat, const int season, const char* path) {
+  if ((cat->num_seasons == CAT_MAX_SEASONS) || (cat_get(cat, season) != NULL)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(cat_add()): Season %d is already there or the catalog is full\n", season);
+    #endif
+    return -1;
+  }
+  const size_t len = strlen(path);
+  char* copy = malloc(len + 1);
+  vt_table* table = vt_new(cat->ebr);
+  if ((copy == NULL) || (table == NULL)) {
+    free(copy);
+    if (table != NULL) {
+      vt_del_table(table);
+    }
+    return -1;
+  }
+  memcpy(copy, path, len + 1);
+
+  // keep the seasons in order
+  int i = cat->num_seasons++;
+  while ((i > 0) && (cat->seasons[i - 1].season > season)) {
+    cat->seasons[i] = cat->seasons[i - 1];
+    i--;
+  }
+  memset(&cat->seasons[i], 0, sizeof(cat_season));
+  cat->seasons[i].season = season;
+  cat->seasons[i].path = copy;
+  cat->seasons[i].table = table;
+  return 0;
+}
+
+
+/**
+ * cat_load() - loads the CSV file of every season
+ *
+ * Each file is published as a new version of its season's table (see
+ * vt_load_csv()), so readers can already be using the catalog.  The line,
+ * record and error counts of each file are left in its cat_season.
+ *
+ * @param cat is the catalog
+ * @param numThreads is the most threads to load with (at least 1, at most
+ * CAT_MAX_THREADS), no more than one per season is started
+ *
+ * @return the number of records loaded or -1 if a file could not be read or
+ * a thread could not be started (the seasons that did load are published)
+ */
+long cat_load(cat_catalog* cat, int numThreads) {
+  pthread_t threads[CAT_MAX_THREADS];
+  int started = 0;
+  long total = 0;
+
+  numThreads = (numThreads < 1) ? 1 : (numThreads > CAT_MAX_THREADS) ? CAT_MAX_THREADS : numThreads;
+  numThreads = (numThreads > cat->num_seasons) ? cat->num_seasons : numThreads;
+  for (int i = 0; i < cat->num_seasons; i++) {
+    cat->seasons[i].loaded = -1;
+  }
+  cat->next_load = 0;
+  while ((started < numThreads) &&
+         (pthread_create(&threads[started], NULL, cat_load_seasons, cat) == 0)) {
+    started++;
+  }
+  if (started == 0) {
+    // no thread at all, load them on this one
+    cat_load_seasons(cat);
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  for (int i = 0; i < cat->num_seasons; i++) {
+    if (cat->seasons[i].loaded < 0) {
+      total = -1;
+    }
+    else if (total >= 0) {
+      total += cat->seasons[i].loaded;
+    }
+  }
+  return total;
+}
+
+
+/**
+ * cat_get() - finds the table of a season
+ *
+ * @param cat is the catalog
+ * @param season is the season (ex: 2021)
+ *
+ * @return the season's table or NULL if the catalog doesn't have the season
+ */
+vt_table* cat_get(cat_catalog* cat, const int season) {
+  for (int i = 0; i < cat->num_seasons; i++) {
+    if (cat->seasons[i].season == season) {
+      return cat->seasons[i].table;
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * cat_register() - registers the calling thread as a reader of the catalog
+ *
+ * @param cat is the catalog
+ *
+ * @return the handle to pass to vt_acquire() and vt_release() for any season,
+ * unregister it with vt_unregister().  NULL if out of memory
+ */
+vt_reader* cat_register(cat_catalog* cat) {
+  return ebr_register(cat->ebr);
+}
+
+
+/**
+ * cat_season_of() - finds the season in the name of a CSV file
+ *
+ * @param path is the file (ex: data/soccer2021.csv)
+ *
+ * @return the last group of exactly four digits in the file name (2021), or
+ * -1 if it doesn't have one
+ */
+int cat_season_of(const char* path) {
+  const char* name = path;
+  int season = -1;
+
+  for (const char* p = path; *p != '\0'; p++) {
+    if ((*p == '/') || (*p == '\\')) {
+      name = p + 1;
+    }
+  }
+  for (const char* p = name; *p != '\0'; ) {
+    if (!isdigit((unsigned char)*p)) {
+      p++;
+      continue;
+    }
+    const char* start = p;
+    while (isdigit((unsigned char)*p)) {
+      p++;
+    }
+    if (p - start == 4) {
+      season = atoi(start);
+    }
+  }
+  return season;
+}
+
+
+// Helper functions
+
+static void* cat_load_seasons(void* arg) {
+  cat_catalog* cat = arg;
+  int i;
+
+  while ((i = __atomic_fetch_add(&cat->next_load, 1, __ATOMIC_RELAXED)) < cat->num_seasons) {
+    cat_season* season = &cat->seasons[i];
+    season->loaded = vt_load_csv(season->table, season->path, &season->result);
+  }
+  return NULL;
+}
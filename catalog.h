@@ -0,0 +1,70 @@
+/**
+ * catalog.h - Catalog of team tables by season
+ *
+ * @brief   This is the header file for a catalog that keeps one versioned
+ * table (versioned_table.h) per season instead of a single table loaded from
+ * soccer2021.csv.  Seasons are added with the CSV file that holds them and
+ * cat_load() reads the files on several threads at once, one file per thread
+ * at a time.
+ *
+ * The seasons' tables share one EBR domain, so a reader thread registers once
+ * with cat_register() and uses the same handle for every season:
+ *
+ *   cat_add(cat, 2021, "soccer2021.csv");
+ *   cat_add(cat, 2022, "soccer2022.csv");
+ *   cat_load(cat, 4);
+ *   vt_reader* reader = cat_register(cat);
+ *   vt_version* v = vt_acquire(cat_get(cat, 2022), reader);
+*/
+
+#ifndef _CATALOG_H_
+#define _CATALOG_H_
+
+#include "appHelpers.h"
+#include "epoch.h"
+#include "versioned_table.h"
+
+// constants
+#define CAT_MAX_SEASONS     64
+#define CAT_MAX_THREADS     CSV_MAX_THREADS
+
+// a season and the file it is loaded from
+typedef struct {
+  int season;                 // ex: 2021
+  char* path;
+  vt_table* table;
+  long loaded;                // records the last cat_load() loaded, -1 if the file couldn't be read
+  csvLoadResult_t result;     // what the last cat_load() found in the file
+} cat_season;
+
+// struct containing the catalog
+typedef struct {
+  ebr_t* ebr;                 // shared by the tables of the seasons
+  int num_seasons;
+  cat_season seasons[CAT_MAX_SEASONS];    // sorted by season
+  int next_load;              // next season a cat_load() thread takes
+} cat_catalog;
+
+
+// API function prototypes
+
+// creates and deletes a catalog (no reader may still hold a version)
+cat_catalog* cat_new(void);
+void cat_del(cat_catalog* cat);
+
+// adds a season with an empty table, loaded from path by cat_load()
+int cat_add(cat_catalog* cat, const int season, const char* path);
+
+// loads the CSV files of every season with up to numThreads threads
+long cat_load(cat_catalog* cat, int numThreads);
+
+// returns the table of a season, NULL if the catalog doesn't have it
+vt_table* cat_get(cat_catalog* cat, const int season);
+
+// registers the calling thread as a reader of every season
+vt_reader* cat_register(cat_catalog* cat);
+
+// returns the season in a file name like soccer2021.csv, -1 if there is none
+int cat_season_of(const char* path);
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * concurrent_table.c - Thread-safe hash table source code file
+ *
+ * @brief   This is the source code file for the concurrent hash table.
+ *
+ * The items are kept in bucket chains.  A node is never changed once another
+ * thread can see it: an update links in a new node in place of the old one and
+ * a delete unlinks the node, so a reader walking a chain without a lock sees
+ * either the old or the new version of an item but never a half-written one.
+ * Links are published with release stores and followed with acquire loads.
+ *
+ * Writers lock the stripe picked by the low bits of the hash.  The number of
+ * buckets is always a multiple of CHT_NUM_STRIPES so every node in a bucket
+ * belongs to the same stripe.  Growing the table locks every stripe, copies the
+ * nodes into a new bucket array and swaps it in; the old array and its nodes
+ * are retired and freed once no reader can still be walking them.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "concurrent_table.h"
+
+// prototypes for the Helper functions
+
+// allocate a node (key stored inline)
+static cht_node* cht_new_node(const char* key, void* value, const uint64_t hash);
+
+// allocate and free a bucket array
+static cht_buckets* cht_new_buckets(const size_t num_buckets);
+static void cht_free_buckets(void* ptr);
+
+// grow the bucket array if the load factor is too high
+static void cht_grow(cht_table* cht, cht_thread* thread);
+
+// Concurrent Hash Table ADT
+
+/**
+ * cht_new() - initializes a new concurrent hash table
+ *
+ * @param base_size is the number of items the table should hold before it grows
+ *
+ * @return a pointer to the new table or NULL if it could not be allocated
+ */
+cht_table* cht_new(const int base_size) {
+  cht_table* cht = malloc(sizeof(cht_table));
+  if (cht == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(cht_new()): Could not allocate space for hash table\n");
+    #endif
+    return NULL;
+  }
+
+  size_t num_buckets = CHT_MIN_BUCKETS;
+  while ((base_size > 0) && (num_buckets * CHT_MAX_LOAD / 100 < (size_t)base_size)) {
+    num_buckets *= 2;
+  }
+  cht->buckets = cht_new_buckets(num_buckets);
+  cht->ebr = ebr_new();
+  if ((cht->buckets == NULL) || (cht->ebr == NULL)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(cht_new()): Could not allocate space for the buckets\n");
+    #endif
+    free(cht->buckets);
+    if (cht->ebr != NULL) {
+      ebr_del(cht->ebr);
+    }
+    free(cht);
+    return NULL;
+  }
+  cht->count = 0;
+  for (int i = 0; i < CHT_NUM_STRIPES; i++) {
+    pthread_mutex_init(&cht->stripes[i], NULL);
+  }
+  return cht;
+}
+
+
+/**
+ * cht_del_table() - deletes a concurrent hash table
+ *
+ * Frees every node and value as well as anything still waiting to be reclaimed.
+ * Every thread must have unregistered.
+ *
+ * @param cht is a pointer to the table
+ */
+void cht_del_table(cht_table* cht) {
+  cht_buckets* buckets = cht->buckets;
+
+  for (size_t i = 0; i <= buckets->mask; i++) {
+    cht_node* node = buckets->heads[i];
+    while (node != NULL) {
+      cht_node* next = node->next;
+      free(node->value);
+      free(node);
+      node = next;
+    }
+  }
+  free(buckets);
+  ebr_del(cht->ebr);
+  for (int i = 0; i < CHT_NUM_STRIPES; i++) {
+    pthread_mutex_destroy(&cht->stripes[i]);
+  }
+  free(cht);
+}
+
+
+/**
+ * cht_register() - registers the calling thread with the table
+ *
+ * @param cht is a pointer to the table
+ *
+ * @return the handle the thread passes to the other functions
+ */
+cht_thread* cht_register(cht_table* cht) {
+  return ebr_register(cht->ebr);
+}
+
+
+/**
+ * cht_unregister() - unregisters a thread
+ *
+ * @param thread is the handle from cht_register()
+ */
+void cht_unregister(cht_thread* thread) {
+  ebr_unregister(thread);
+}
+
+
+/**
+ * cht_read_begin() - starts a group of searches
+ *
+ * @param thread is the handle from cht_register()
+ */
+void cht_read_begin(cht_thread* thread) {
+  ebr_enter(thread);
+}
+
+
+/**
+ * cht_read_end() - ends a group of searches
+ *
+ * Values returned by cht_search() must not be used after this.
+ *
+ * @param thread is the handle from cht_register()
+ */
+void cht_read_end(cht_thread* thread) {
+  ebr_exit(thread);
+}
+
+
+/**
+ * cht_search() - searches for an element in the table
+ *
+ * Takes no locks.  Must be called between cht_read_begin() and cht_read_end().
+ *
+ * @param cht is a pointer to the table
+ * @param thread is the handle from cht_register()
+ * @param key is the key to search for
+ *
+ * @return a pointer to the value or NULL if the key is not in the table
+ */
+void* cht_search(cht_table* cht, cht_thread* thread, const char* key) {
+  (void)thread;
+  const uint64_t hash = ht_hash_string(key);
+  const cht_buckets* buckets = __atomic_load_n(&cht->buckets, __ATOMIC_ACQUIRE);
+  const cht_node* node = __atomic_load_n(&buckets->heads[hash & buckets->mask], __ATOMIC_ACQUIRE);
+
+  while (node != NULL) {
+    if ((node->hash == hash) && (strcmp(node->key, key) == 0)) {
+      return node->value;
+    }
+    node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+  }
+  return NULL;
+}
+
+
+/**
+ * cht_search_copy() - searches for an element and copies its value
+ *
+ * @param cht is a pointer to the table
+ * @param thread is the handle from cht_register()
+ * @param key is the key to search for
+ * @param out is where to copy the value
+ * @param size is the number of bytes to copy
+ *
+ * @return 1 if the key was found, 0 if not
+ */
+int cht_search_copy(cht_table* cht, cht_thread* thread, const char* key, void* out, size_t size) {
+  ebr_enter(thread);
+  const void* value = cht_search(cht, thread, key);
+  if (value != NULL) {
+    memcpy(out, value, size);
+  }
+  ebr_exit(thread);
+  return (value != NULL);
+}
+
+
+/**
+ * cht_insert() - inserts an element into the table
+ *
+ * If the key is already in the table its node is replaced and the old value is
+ * freed once no reader can be using it.
+ *
+ * @param cht is a pointer to the table
+ * @param thread is the handle from cht_register()
+ * @param key is the key for the element
+ * @param value is a pointer to the value (allocated with malloc())
+ */
+void cht_insert(cht_table* cht, cht_thread* thread, const char* key, void* value) {
+  const uint64_t hash = ht_hash_string(key);
+  cht_node* item = cht_new_node(key, value, hash);
+  if (item == NULL) {
+    return;
+  }
+
+  pthread_mutex_t* stripe = &cht->stripes[hash & (CHT_NUM_STRIPES - 1)];
+  pthread_mutex_lock(stripe);
+
+  // the bucket array can't be swapped while we hold a stripe
+  cht_buckets* buckets = cht->buckets;
+  cht_node** link = &buckets->heads[hash & buckets->mask];
+  cht_node* node;
+  while ((node = *link) != NULL) {
+    if ((node->hash == hash) && (strcmp(node->key, key) == 0)) {
+      item->next = node->next;
+      __atomic_store_n(link, item, __ATOMIC_RELEASE);
+      pthread_mutex_unlock(stripe);
+      ebr_retire(thread, node->value, free);
+      ebr_retire(thread, node, free);
+      return;
+    }
+    link = &node->next;
+  }
+
+  item->next = buckets->heads[hash & buckets->mask];
+  __atomic_store_n(&buckets->heads[hash & buckets->mask], item, __ATOMIC_RELEASE);
+  const long count = __atomic_add_fetch(&cht->count, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(stripe);
+
+  if ((size_t)count > (buckets->mask + 1) * CHT_MAX_LOAD / 100) {
+    cht_grow(cht, thread);
+  }
+}
+
+
+/**
+ * cht_delete() - deletes an element from the table
+ *
+ * The node and its value are freed once no reader can be using them.
+ *
+ * @param cht is a pointer to the table
+ * @param thread is the handle from cht_register()
+ * @param key is the key of the element to delete
+ */
+void cht_delete(cht_table* cht, cht_thread* thread, const char* key) {
+  const uint64_t hash = ht_hash_string(key);
+  pthread_mutex_t* stripe = &cht->stripes[hash & (CHT_NUM_STRIPES - 1)];
+  pthread_mutex_lock(stripe);
+
+  cht_buckets* buckets = cht->buckets;
+  cht_node** link = &buckets->heads[hash & buckets->mask];
+  cht_node* node;
+  while ((node = *link) != NULL) {
+    if ((node->hash == hash) && (strcmp(node->key, key) == 0)) {
+      __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+      __atomic_sub_fetch(&cht->count, 1, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(stripe);
+      ebr_retire(thread, node->value, free);
+      ebr_retire(thread, node, free);
+      return;
+    }
+    link = &node->next;
+  }
+  pthread_mutex_unlock(stripe);
+}
+
+
+/**
+ * cht_count() - returns the number of elements in the table
+ *
+ * @param cht is a pointer to the table
+ *
+ * @return the number of elements (a snapshot if other threads are writing)
+ */
+long cht_count(cht_table* cht) {
+  return __atomic_load_n(&cht->count, __ATOMIC_RELAXED);
+}
+
+
+// Helper functions
+
+static cht_node* cht_new_node(const char* key, void* value, const uint64_t hash) {
+  const size_t len = strlen(key);
+  cht_node* node = malloc(sizeof(cht_node) + len + 1);
+  if (node == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(cht_new_node()): Could not allocate space for the node\n");
+    #endif
+    return NULL;
+  }
+  node->next = NULL;
+  node->value = value;
+  node->hash = hash;
+  memcpy(node->key, key, len + 1);
+  return node;
+}
+
+
+static cht_buckets* cht_new_buckets(const size_t num_buckets) {
+  cht_buckets* buckets = calloc(1, sizeof(cht_buckets) + num_buckets * sizeof(cht_node*));
+  if (buckets != NULL) {
+    buckets->mask = num_buckets - 1;
+  }
+  return buckets;
+}
+
+
+/**
+ * cht_free_buckets() - frees a retired bucket array and its nodes
+ *
+ * The values are not freed, they were carried over to the new array.
+ *
+ * @param ptr is the bucket array
+ */
+static void cht_free_buckets(void* ptr) {
+  cht_buckets* buckets = ptr;
+  for (size_t i = 0; i <= buckets->mask; i++) {
+    cht_node* node = buckets->heads[i];
+    while (node != NULL) {
+      cht_node* next = node->next;
+      free(node);
+      node = next;
+    }
+  }
+  free(buckets);
+}
+
+
+/**
+ * cht_grow() - doubles the number of buckets
+ *
+ * Locks every stripe (always in the same order), copies every node into a new
+ * bucket array and publishes it.  The nodes are copied rather than relinked
+ * because readers may still be walking the old chains.
+ *
+ * @param cht is a pointer to the table
+ * @param thread is the handle from cht_register()
+ */
+static void cht_grow(cht_table* cht, cht_thread* thread) {
+  for (int i = 0; i < CHT_NUM_STRIPES; i++) {
+    pthread_mutex_lock(&cht->stripes[i]);
+  }
+
+  cht_buckets* old = cht->buckets;
+  cht_buckets* buckets = NULL;
+  if ((size_t)cht->count > (old->mask + 1) * CHT_MAX_LOAD / 100) {
+    buckets = cht_new_buckets((old->mask + 1) * 2);
+  }
+  if (buckets != NULL) {
+    for (size_t i = 0; i <= old->mask; i++) {
+      for (cht_node* node = old->heads[i]; node != NULL; node = node->next) {
+        cht_node* copy = cht_new_node(node->key, node->value, node->hash);
+        if (copy == NULL) {
+          // out of memory, keep the old array
+          cht_free_buckets(buckets);
+          buckets = NULL;
+          break;
+        }
+        copy->next = buckets->heads[node->hash & buckets->mask];
+        buckets->heads[node->hash & buckets->mask] = copy;
+      }
+      if (buckets == NULL) {
+        break;
+      }
+    }
+  }
+  if (buckets != NULL) {
+    __atomic_store_n(&cht->buckets, buckets, __ATOMIC_RELEASE);
+  }
+
+  for (int i = CHT_NUM_STRIPES - 1; i >= 0; i--) {
+    pthread_mutex_unlock(&cht->stripes[i]);
+  }
+  if (buckets != NULL) {
+    ebr_retire(thread, old, cht_free_buckets);
+  }
+}
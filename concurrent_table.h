@@ -0,0 +1,82 @@
+/**
+ * concurrent_table.h - Thread-safe hash table header file
+ *
+ * @brief   This is the header file for a hash table that can be shared by many
+ * threads.  Searches never take a lock; inserts and deletes lock one of
+ * CHT_NUM_STRIPES mutexes picked by the hash of the key, so writers only wait for
+ * each other when they touch the same stripe.  Memory that a reader might still
+ * be looking at is freed through epoch-based reclamation (see epoch.h).
+*/
+
+#ifndef _CONCURRENT_TABLE_H_
+#define _CONCURRENT_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "epoch.h"
+
+// constants
+#define CHT_NUM_STRIPES     64    // writer locks, must be a power of two
+#define CHT_MIN_BUCKETS     CHT_NUM_STRIPES
+#define CHT_MAX_LOAD        100   // grow above this load factor (in percent)
+
+// one key:value pair.  The key is stored in the same allocation
+typedef struct cht_node {
+  struct cht_node* next;
+  void* value;
+  uint64_t hash;
+  char key[];
+} cht_node;
+
+// an array of bucket chains.  It is replaced (not resized in place) when the
+// table grows so readers always see a consistent array
+typedef struct {
+  size_t mask;                // number of buckets - 1
+  cht_node* heads[];
+} cht_buckets;
+
+// struct containing the concurrent hash table
+typedef struct {
+  cht_buckets* buckets;       // current bucket array, swapped atomically on a resize
+  long count;                 // number of items
+  ebr_t* ebr;                 // reclaims replaced nodes, values and bucket arrays
+  pthread_mutex_t stripes[CHT_NUM_STRIPES];
+} cht_table;
+
+// per-thread handle, every thread using the table needs its own
+typedef ebr_thread_t cht_thread;
+
+
+// API function prototypes
+
+// creates a new concurrent hash table with room for about base_size items
+cht_table* cht_new(const int base_size);
+
+// deletes a concurrent hash table and its values.  No thread may still be using it
+void cht_del_table(cht_table* cht);
+
+// registers and unregisters the calling thread
+cht_thread* cht_register(cht_table* cht);
+void cht_unregister(cht_thread* thread);
+
+// brackets a group of searches.  Values returned by cht_search() stay valid until cht_read_end()
+void cht_read_begin(cht_thread* thread);
+void cht_read_end(cht_thread* thread);
+
+// searches for element in the table.  Must be called between cht_read_begin() and cht_read_end()
+void* cht_search(cht_table* cht, cht_thread* thread, const char* key);
+
+// searches for element and copies its value out, no read section needed
+int cht_search_copy(cht_table* cht, cht_thread* thread, const char* key, void* out, size_t size);
+
+// inserts (or replaces) an element.  The table owns value (malloc'ed) from here on
+void cht_insert(cht_table* cht, cht_thread* thread, const char* key, void* value);
+
+// deletes an element from the table
+void cht_delete(cht_table* cht, cht_thread* thread, const char* key);
+
+// returns the number of elements in the table
+long cht_count(cht_table* cht);
+
+#endif
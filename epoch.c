@@ -0,0 +1,261 @@
+/**
+ * epoch.c - Epoch-based memory reclamation
+ *
+ * @brief   This is the source code file for epoch-based reclamation.
+ *
+ * There is a global epoch number.  A thread entering a critical section
+ * announces the epoch it saw.  Memory retired while the global epoch is E goes
+ * on the retiring thread's limbo list for E.  The global epoch can only move
+ * from E to E + 1 once every thread in a critical section has announced E, so
+ * by the time it reaches E + 2 no reader can still hold a pointer to anything
+ * retired in epoch E and that limbo list can be freed.
+ *
+ * The shared words are read and written with the GCC __atomic builtins
+ * (sequentially consistent) so this builds with -std=c99.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "hash_table.h"
+#include "epoch.h"
+
+// prototypes for the Helper functions
+
+// free a list of garbage
+static void ebr_free_list(ebr_garbage_t* list);
+
+// free the limbo lists of a thread that are old enough
+static void ebr_collect(ebr_thread_t* thread, const uint64_t epoch);
+
+// move the global epoch forward if every active thread has caught up
+static void ebr_try_advance(ebr_t* ebr);
+
+
+/**
+ * ebr_new() - creates an EBR domain
+ *
+ * @return a pointer to the new domain or NULL if it could not be allocated
+ */
+ebr_t* ebr_new(void) {
+  ebr_t* ebr = calloc(1, sizeof(ebr_t));
+  if (ebr == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(ebr_new()): Could not allocate the EBR domain\n");
+    #endif
+    return NULL;
+  }
+  ebr->global = 1;
+  pthread_mutex_init(&ebr->lock, NULL);
+  return ebr;
+}
+
+
+/**
+ * ebr_del() - deletes an EBR domain
+ *
+ * Frees everything that is still waiting to be freed.  No thread may be in a
+ * critical section.
+ *
+ * @param ebr is the domain to delete
+ */
+void ebr_del(ebr_t* ebr) {
+  ebr_thread_t* thread = ebr->threads;
+  while (thread != NULL) {
+    ebr_thread_t* next = thread->next;
+    for (int i = 0; i < EBR_NUM_EPOCHS; i++) {
+      ebr_free_list(thread->limbo[i]);
+    }
+    free(thread);
+    thread = next;
+  }
+  ebr_free_list(ebr->orphans);
+  pthread_mutex_destroy(&ebr->lock);
+  free(ebr);
+}
+
+
+/**
+ * ebr_register() - registers the calling thread with an EBR domain
+ *
+ * A thread record left behind by a thread that unregistered is reused.
+ *
+ * @param ebr is the domain
+ *
+ * @return the thread's EBR state, passed to the other functions, or NULL if out
+ * of memory
+ */
+ebr_thread_t* ebr_register(ebr_t* ebr) {
+  ebr_thread_t* thread;
+
+  pthread_mutex_lock(&ebr->lock);
+  for (thread = ebr->threads; thread != NULL; thread = thread->next) {
+    if (!thread->in_use) {
+      break;
+    }
+  }
+  if (thread == NULL) {
+    thread = calloc(1, sizeof(ebr_thread_t));
+    if (thread != NULL) {
+      thread->ebr = ebr;
+      thread->next = ebr->threads;
+      __atomic_store_n(&ebr->threads, thread, __ATOMIC_RELEASE);
+    }
+  }
+  if (thread != NULL) {
+    thread->in_use = 1;
+    thread->nesting = 0;
+    thread->retired = 0;
+  }
+  pthread_mutex_unlock(&ebr->lock);
+  return thread;
+}
+
+
+/**
+ * ebr_unregister() - unregisters a thread
+ *
+ * Memory the thread retired that can't be freed yet is handed to the domain and
+ * freed by ebr_del().
+ *
+ * @param thread is the thread's EBR state from ebr_register()
+ */
+void ebr_unregister(ebr_thread_t* thread) {
+  ebr_t* ebr = thread->ebr;
+
+  __atomic_store_n(&thread->local, 0, __ATOMIC_SEQ_CST);
+  ebr_try_advance(ebr);
+  ebr_collect(thread, __atomic_load_n(&ebr->global, __ATOMIC_SEQ_CST));
+
+  pthread_mutex_lock(&ebr->lock);
+  for (int i = 0; i < EBR_NUM_EPOCHS; i++) {
+    while (thread->limbo[i] != NULL) {
+      ebr_garbage_t* garbage = thread->limbo[i];
+      thread->limbo[i] = garbage->next;
+      garbage->next = ebr->orphans;
+      ebr->orphans = garbage;
+    }
+  }
+  thread->in_use = 0;
+  pthread_mutex_unlock(&ebr->lock);
+}
+
+
+/**
+ * ebr_enter() - enters a read-side critical section
+ *
+ * Pointers read from the shared structure stay valid until the matching
+ * ebr_exit().  Critical sections can be nested.
+ *
+ * @param thread is the thread's EBR state from ebr_register()
+ */
+void ebr_enter(ebr_thread_t* thread) {
+  if (thread->nesting++ > 0) {
+    return;
+  }
+  const uint64_t epoch = __atomic_load_n(&thread->ebr->global, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&thread->local, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+  ebr_collect(thread, epoch);
+}
+
+
+/**
+ * ebr_exit() - leaves a read-side critical section
+ *
+ * @param thread is the thread's EBR state from ebr_register()
+ */
+void ebr_exit(ebr_thread_t* thread) {
+  if (--thread->nesting > 0) {
+    return;
+  }
+  __atomic_store_n(&thread->local, 0, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * ebr_retire() - frees memory once no reader can be using it
+ *
+ * The memory must already be unreachable for new readers (unlinked from the
+ * shared structure).  Every EBR_ADVANCE_EVERY retirements the thread tries to
+ * move the global epoch forward.
+ *
+ * @param thread is the thread's EBR state from ebr_register()
+ * @param ptr is the memory to free
+ * @param free_fn is the function that frees it (ex: free)
+ */
+void ebr_retire(ebr_thread_t* thread, void* ptr, void (*free_fn)(void*)) {
+  ebr_garbage_t* garbage = malloc(sizeof(ebr_garbage_t));
+  if (garbage == NULL) {
+    // can't defer it, so leak it rather than free it under a reader
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(ebr_retire()): Could not allocate garbage record\n");
+    #endif
+    return;
+  }
+
+  const uint64_t epoch = __atomic_load_n(&thread->ebr->global, __ATOMIC_SEQ_CST);
+  const int slot = (int)(epoch % EBR_NUM_EPOCHS);
+  ebr_collect(thread, epoch);
+  thread->limbo_epoch[slot] = epoch;
+  garbage->ptr = ptr;
+  garbage->free_fn = free_fn;
+  garbage->next = thread->limbo[slot];
+  thread->limbo[slot] = garbage;
+
+  if (++thread->retired >= EBR_ADVANCE_EVERY) {
+    thread->retired = 0;
+    ebr_try_advance(thread->ebr);
+  }
+}
+
+
+// Helper functions
+
+static void ebr_free_list(ebr_garbage_t* list) {
+  while (list != NULL) {
+    ebr_garbage_t* next = list->next;
+    list->free_fn(list->ptr);
+    free(list);
+    list = next;
+  }
+}
+
+
+/**
+ * ebr_collect() - frees the limbo lists that are at least two epochs old
+ *
+ * @param thread is the thread's EBR state
+ * @param epoch is the current global epoch
+ */
+static void ebr_collect(ebr_thread_t* thread, const uint64_t epoch) {
+  for (int i = 0; i < EBR_NUM_EPOCHS; i++) {
+    if ((thread->limbo[i] != NULL) && (thread->limbo_epoch[i] + 2 <= epoch)) {
+      ebr_free_list(thread->limbo[i]);
+      thread->limbo[i] = NULL;
+    }
+  }
+}
+
+
+/**
+ * ebr_try_advance() - moves the global epoch forward if it can
+ *
+ * The epoch can move from E to E + 1 when every thread that is in a critical
+ * section entered it during epoch E.
+ *
+ * @param ebr is the domain
+ */
+static void ebr_try_advance(ebr_t* ebr) {
+  uint64_t epoch = __atomic_load_n(&ebr->global, __ATOMIC_SEQ_CST);
+
+  for (ebr_thread_t* thread = __atomic_load_n(&ebr->threads, __ATOMIC_ACQUIRE);
+       thread != NULL; thread = thread->next) {
+    const uint64_t local = __atomic_load_n(&thread->local, __ATOMIC_SEQ_CST);
+    if (((local & 1) != 0) && ((local >> 1) != epoch)) {
+      return;
+    }
+  }
+  __atomic_compare_exchange_n(&ebr->global, &epoch, epoch + 1, 0,
+                              __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
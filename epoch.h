@@ -0,0 +1,67 @@
+/**
+ * epoch.h - Epoch-based memory reclamation
+ *
+ * @brief   This is the header file for epoch-based reclamation (EBR).  It lets
+ * readers walk a shared data structure without taking any locks while writers
+ * unlink and "retire" memory.  Retired memory is only freed once every reader
+ * that could still be looking at it has left its read-side critical section.
+*/
+
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+// constants
+#define EBR_NUM_EPOCHS      3     // current, previous and safe-to-free
+#define EBR_ADVANCE_EVERY   64    // retirements between attempts to advance the epoch
+
+// memory waiting to be freed
+typedef struct _ebr_garbage_s {
+  struct _ebr_garbage_s* next;
+  void* ptr;
+  void (*free_fn)(void*);
+} ebr_garbage_t;
+
+struct _ebr_s;
+
+// per-thread EBR state, from ebr_register()
+typedef struct _ebr_thread_s {
+  struct _ebr_thread_s* next;         // all threads that ever registered
+  struct _ebr_s* ebr;
+  uint64_t local;                     // (epoch << 1) | 1 while in a critical section, else 0
+  int in_use;                         // 0 once the thread has unregistered
+  int nesting;                        // ebr_enter() calls without an ebr_exit()
+  int retired;                        // retirements since the last advance attempt
+  uint64_t limbo_epoch[EBR_NUM_EPOCHS];
+  ebr_garbage_t* limbo[EBR_NUM_EPOCHS];
+} ebr_thread_t;
+
+// struct containing an EBR domain
+typedef struct _ebr_s {
+  uint64_t global;                    // global epoch
+  ebr_thread_t* threads;
+  pthread_mutex_t lock;               // protects registration and the orphans
+  ebr_garbage_t* orphans;             // garbage left by threads that unregistered
+} ebr_t;
+
+
+// API function prototypes
+
+// creates and deletes an EBR domain (no thread may be registered when it is deleted)
+ebr_t* ebr_new(void);
+void ebr_del(ebr_t* ebr);
+
+// registers and unregisters the calling thread
+ebr_thread_t* ebr_register(ebr_t* ebr);
+void ebr_unregister(ebr_thread_t* thread);
+
+// enters and leaves a read-side critical section
+void ebr_enter(ebr_thread_t* thread);
+void ebr_exit(ebr_thread_t* thread);
+
+// frees ptr with free_fn once no reader can be using it
+void ebr_retire(ebr_thread_t* thread, void* ptr, void (*free_fn)(void*));
+
+#endif
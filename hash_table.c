@@ -3,66 +3,326 @@
  *
  * @brief   This is the source code file for the functionality in the Hash
  * table ADT
+ *
+ * The items are stored in a flat array of slots (no per-item allocation) next
+ * to a parallel array of 1-byte control bytes.  A control byte is either
+ * HT_CTRL_EMPTY or, for a full slot, the top 7 bits of the hash of its key.
+ * Searching compares the control bytes of HT_GROUP_WIDTH slots at once (with
+ * SSE2 when the compiler supports it) so most mismatches are rejected without
+ * touching the slots at all.  The control byte array has HT_GROUP_WIDTH - 1
+ * extra bytes at the end that mirror the first bytes so a group that wraps
+ * around the end of the table can be loaded in one go.
+ *
+ * Collisions are handled by Robin Hood linear probing.  An item's probe
+ * sequence length (PSL) is how far it sits past its home slot (the slot picked
+ * by the low bits of its hash).  When an insert meets an item with a shorter
+ * PSL than its own it takes that slot and carries the displaced item further
+ * along, which keeps every PSL short and close to the average.  Deletes use
+ * backward shifting: the items after the deleted one are moved back one slot
+ * until an empty slot or an item in its home slot is reached, so there are no
+ * tombstones and a chain always ends at the first empty slot.
+ *
+ * A table can be saved to a binary snapshot file and opened again later by
+ * mapping the file into memory.  The snapshot has the same control bytes and
+ * slot positions as the table it came from, but a slot holds offsets into the
+ * file instead of pointers, so the mapping is searched as it is without any
+ * parsing or allocation.
 */
 
+#define _POSIX_C_SOURCE 200809L     // for mmap() and friends with -std=c99
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
+#include <limits.h>
 #include "hash_table.h"
 
+#if defined(_WIN32)
+#define HT_USE_MMAP 0
+#else
+#define HT_USE_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // constants, typedefs and global variables
-static ht_item HT_DELETED_ITEM = {NULL, NULL};
+#define HT_CTRL_EMPTY     ((uint8_t)0x80)
+#define HT_CTRL_TAG(hash) ((uint8_t)((hash) >> 57))   // full slot: top 7 bits of the hash
+#define HT_CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+
+// bit i is set when slot i of a group matches
+typedef uint32_t ht_bitmask;
+
+// the key of a case-insensitive (HT_KEY_NOCASE) table as it is passed down to the
+// probing code.  The length is measured once, while hashing
+typedef struct {
+  const char* str;
+  size_t len;
+} ht_nocase_key;
+
+// a packed key must be exactly two 64-bit words
+typedef char ht_packed_key_is_16_bytes[(sizeof(ht_packed_key) == 16) ? 1 : -1];
+
+// conference names for ht_dump(), indexed by conf_t
+static const char* const ht_conf_names[] = {"NWSL", "EAST", "WEST", "?", "?", "?", "?", "?",
+                                            "?", "?", "?", "?", "?", "?", "?", "?"};
+
+// hint to the CPU to start loading a cache line we'll need soon
+#if defined(__GNUC__)
+#define HT_PREFETCH(addr) __builtin_prefetch((addr))
+#else
+#define HT_PREFETCH(addr) ((void)(addr))
+#endif
+
+// blocked Bloom filter: every key sets one bit in each of the HT_FILTER_WORDS
+// words of a 64-byte block, so a lookup reads one cache line.  The bits come
+// from the low half of the hash (multiplied by the salts), the block from the high half
+#define HT_FILTER_WORDS   8
+#define HT_FILTER_ALIGN   64
+
+static const uint32_t ht_filter_salts[HT_FILTER_WORDS] = {
+  0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+  0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+// snapshot file layout.  Every section starts on a HT_SNAPSHOT_ALIGN boundary
+//
+//   header | ctrl (size + HT_GROUP_WIDTH - 1 bytes) | slots (size of them) |
+//   string pool (keys, '\0' terminated) | values (count records of value_size bytes)
+#define HT_SNAPSHOT_MAGIC       "HTSNAP\r\n"
+#define HT_SNAPSHOT_BYTE_ORDER  0x01020304u
+#define HT_SNAPSHOT_ALIGN       64
+#define HT_SNAPSHOT_NULL_VALUE  UINT32_MAX
+
+typedef struct {
+  char magic[8];
+  uint32_t version;         // HT_SNAPSHOT_VERSION
+  uint32_t byte_order;      // HT_SNAPSHOT_BYTE_ORDER as written by the saving machine
+  uint64_t hash_seed;       // HT_HASH_SEED of the code that wrote the file
+  uint32_t size;            // number of slots
+  uint32_t count;           // number of items (and value records)
+  uint32_t max_psl;
+  uint32_t value_size;
+  uint32_t num_values;      // value records (items with a NULL value don't have one)
+  uint32_t key_mode;        // HT_KEY_STRING (keys end with '\0'), HT_KEY_NOCASE (uppercase,
+                            // zero padded to 8 bytes) or HT_KEY_PACKED (16 bytes each)
+  uint64_t ctrl_offset;
+  uint64_t slots_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint64_t values_offset;
+  uint64_t file_size;
+} ht_snapshot_header;
+
+// a slot in the snapshot file
+typedef struct {
+  uint64_t hash;
+  uint32_t key;             // offset of the key in the string pool
+  uint32_t value;           // index of the value record or HT_SNAPSHOT_NULL_VALUE
+} ht_snapshot_slot;
 
 // prototypes for the Helper functions
 
-// create a new element for the hash table
-static ht_item* ht_new_item(const char* k, void*  v);
+// fill in a slot of the hash table
+static int ht_new_item(ht_hash_table* ht, ht_item* i, const void* k, void*  v, const uint64_t hash);
+
+// compare the key in a slot with a key (a string, an ht_nocase_key or an ht_packed_key)
+static int ht_key_equal(const ht_item* item, const void* key, const int key_mode);
+
+// hash a string, folding it to uppercase first if fold is set
+static inline uint64_t ht_hash_bytes(const char* s, size_t len, const int fold);
+
+// ASCII uppercase the 8 bytes of a word
+static inline uint64_t ht_fold_word(const uint64_t word);
+
+// compare a folded, padded key with a key of a case-insensitive table
+static int ht_nocase_equal(const char* folded, const ht_nocase_key* key);
+
+// size of the copy of a key in a case-insensitive table
+static size_t ht_nocase_size(const size_t len);
+
+// insert, search and delete a key of any mode
+static int ht_insert_key(ht_hash_table* ht, const void* key, const uint64_t hash, void* value);
+static void* ht_get_or_insert_key(ht_hash_table* ht, const void* key, const uint64_t hash,
+                                  const size_t value_size, int* inserted);
+static int ht_add_key(ht_hash_table* ht, const void* key, const uint64_t hash, void* value);
+static void* ht_search_key(ht_hash_table* ht, const void* key, const uint64_t hash);
+static void ht_delete_key(ht_hash_table* ht, const void* key, const uint64_t hash);
 
 // delete an element from the hash table
-static void ht_del_item(ht_item* i);
+static void ht_del_item(ht_hash_table* ht, ht_item* i);
+
+// the allocated copy of a slot's key, NULL if it is inline
+static char* ht_heap_key(const ht_hash_table* ht, ht_item* i);
+
+// control byte group matching
+static ht_bitmask ht_group_match(const uint8_t* group, const uint8_t tag);
+static ht_bitmask ht_group_match_empty(const uint8_t* group);
+
+// set a control byte (and its mirror)
+static void ht_set_ctrl(uint8_t* ctrl, const int size, const int index, const uint8_t c);
+
+// allocate the control bytes and slots for a table with size slots
+static int ht_alloc_slots(const int size, uint8_t** ctrl, ht_item** items);
+
+// find the slot holding key in an array of slots
+static int ht_find_index(const uint8_t* ctrl, const ht_item* items, const int size,
+                         const int max_psl, int pos, const void* key, const uint64_t hash,
+                         const int key_mode);
+
+// hash a block of keys and prefetch their home slots
+static void ht_prefetch_block(const ht_hash_table* ht, const void* keys, const int n,
+                              uint64_t* hashes);
+
+// tells the table's observers about a value
+static inline void ht_notify(ht_hash_table* ht, void* value, const int event);
+
+// key i of an array of string keys or of packed keys
+static inline const void* ht_batch_key(const ht_hash_table* ht, const void* keys, const int i);
+
+// the prefetching pipeline of ht_search_batch() and ht_search_packed_batch()
+static int ht_search_batch_keys(ht_hash_table* ht, const void* keys, const int n, void** out_values);
+
+// find the slot holding key in the new or the old array of slots
+static int ht_find_new(const ht_hash_table* ht, const void* key, const uint64_t hash);
+static int ht_find_old(const ht_hash_table* ht, const void* key, const uint64_t hash);
+
+// store an item with Robin Hood probing
+static int ht_place(uint8_t* ctrl, ht_item* items, const int size, int* max_psl, ht_item item);
 
-  // generic hash function
-static int ht_generic_hash(const char* s, const int a, const int m);
+// remove the item in a slot by shifting the rest of its chain back
+static void ht_backward_shift(uint8_t* ctrl, ht_item* items, const int size, int index);
 
-// actual hash function
-static int ht_get_hash(const char* s, const int num_buckets, const int attempt);
+// start resizing the hash table to a new base size
+static void ht_start_resize(ht_hash_table* ht, const int base_size);
+
+// migrate slots from the old array to the new one
+static void ht_rehash_step(ht_hash_table* ht, int num_slots);
+
+// search a table opened with ht_open_snapshot()
+static void* ht_snapshot_search(ht_hash_table* ht, const void* key, const uint64_t hash);
+
+// sizes a Bloom filter for the table and adds every key to it
+static int ht_filter_build(ht_hash_table* ht, const int bits_per_key);
+
+// adds a new key to the Bloom filter, rebuilding it once it is full
+static void ht_filter_add(ht_hash_table* ht, const uint64_t hash);
+
+// 0 if the Bloom filter says the key isn't in the table
+static inline int ht_filter_maybe(const ht_hash_table* ht, const uint64_t hash);
+
+// ht_filter_maybe() for a search, counts the misses the filter answers
+static inline int ht_filter_rejects(ht_hash_table* ht, const uint64_t hash);
+
+// searches a table frozen with ht_freeze()
+static void* ht_frozen_search(ht_hash_table* ht, const void* key, const uint64_t hash);
+
+// writes a key as a C initializer
+static void ht_write_c_key(FILE* fp, const ht_item* item, const int key_mode);
+
+// checks that a mapped snapshot file is one we can search
+static int ht_snapshot_valid(const ht_snapshot_header* header, const size_t file_size,
+                             const size_t value_size);
+
+// rounds a file offset up to the next section boundary
+static uint64_t ht_snapshot_align(const uint64_t offset);
+
+#if (HT_STATS > 0)
+// count a search in the probe length histograms
+static void ht_count_search(ht_hash_table* ht, const uint64_t hash, const int found_new,
+                            const int index);
+
+// number of slots from pos to the first empty slot (at most max_psl + HT_GROUP_WIDTH)
+static int ht_empty_distance(const uint8_t* ctrl, const int size, const int max_psl, int pos);
+#endif
+
+// add an item's probe sequence length to the stats
+static void ht_stats_add_psl(ht_stats* stats, const int psl, long* total_psl);
 
 // Hash Table ADT
 
 /**
  * ht_new() - initializes a new Hash table
  *
- * Allocates space for a new hash table.  The size of the array is fixed in
- * this implementation
+ * Allocates space for a new hash table with the default number of slots
+ * (HASH_TABLE_SIZE).  The table grows and shrinks as items are added and removed.
  *
  * @return a pointer to the new hash table
- *
- * @note We initialize the array of items with `calloc`, which fills the allocated memory
- * with `NULL` bytes. A `NULL` entry in the array indicates that the bucket is empty.
  */
 ht_hash_table* ht_new(void) {
-    ht_hash_table* ht = malloc(sizeof(ht_hash_table));
+  return ht_new_sized(HASH_TABLE_SIZE);
+}
+
+
+/**
+ * ht_new_sized() - initializes a new Hash table with a given number of slots
+ *
+ * Allocates space for a new hash table.  The number of slots is the next power of
+ * two that is >= base_size (and at least HT_GROUP_WIDTH) so a slot index can be
+ * taken from the hash with a mask.  Callers that know roughly how many items they
+ * will load should ask for about twice that many slots to avoid rehashing during
+ * the load.
+ *
+ * @param base_size is the requested number of slots (at least HT_MIN_BASE_SIZE)
+ *
+ * @return a pointer to the new hash table or NULL if it could not be allocated
+ *
+ * @note Every control byte starts out as HT_CTRL_EMPTY to mark the slot as empty.
+ * The slots themselves are not initialized until an item is stored in them.
+ */
+ht_hash_table* ht_new_sized(const int base_size) {
+  ht_hash_table* ht = malloc(sizeof(ht_hash_table));
 	if (ht == NULL) {
 		#if (_DEBUG_ > 0)
 			fprintf(stderr,
-				"ERROR(ht_new()): Could not allocate space for hash table\n");
+				"ERROR(ht_new_sized()): Could not allocate space for hash table\n");
 		#endif
 		return NULL;
 	}
 
 	// allocated space for hash table, now get space for all of the elements in the hash table
-  ht->size = HASH_TABLE_SIZE;
+  ht->base_size = (base_size < HT_MIN_BASE_SIZE) ? HT_MIN_BASE_SIZE : base_size;
+  ht->size = HT_GROUP_WIDTH;
+  while (ht->size < ht->base_size) {
+    ht->size *= 2;
+  }
   ht->count = 0;
-  ht->items = calloc((size_t)ht->size, sizeof(ht_item*));
-	if (ht->items == NULL) {
+  ht->max_psl = 0;
+	if (ht_alloc_slots(ht->size, &ht->ctrl, &ht->items) != 0) {
 		#if (_DEBUG_ > 0)
 			fprintf(stderr,
-				"ERROR(ht_new()): Could not allocate elements for the hash table\n");
+				"ERROR(ht_new_sized()): Could not allocate elements for the hash table\n");
 		#endif
+		free(ht);
 		return NULL;
 	}
+
+  ht->old_size = 0;
+  ht->old_count = 0;
+  ht->old_max_psl = 0;
+  ht->rehash_start = 0;
+  ht->rehash_pos = 0;
+  ht->old_ctrl = NULL;
+  ht->old_items = NULL;
+  ht->arena = NULL;
+  ht->key_mode = HT_KEY_STRING;
+  ht->snapshot = NULL;
+  ht->snapshot_size = 0;
+  ht->frozen_disp = NULL;
+  ht->frozen_buckets = 0;
+  ht->filter = NULL;
+  ht->filter_mem = NULL;
+  ht->filter_blocks = 0;
+  ht->filter_bits = 0;
+  ht->filter_keys = 0;
+  ht->filter_capacity = 0;
+  ht->num_observers = 0;
+  ht_reset_stats(ht);
   return ht;
 }
 
@@ -71,271 +331,2729 @@ ht_hash_table* ht_new(void) {
  * ht_del_hash_table() - deletes an entire hash table
  *
  * Deletes all of the elements in the hash table and frees up their memory
- * After the elements are deleted the table, itself is deleted
+ * After the elements are deleted the table, itself is deleted.  If the table
+ * uses an arena the keys and values are released all at once with the arena.
+ * A table opened from a snapshot just unmaps the file.
  *
  * @param	ht is a pointer to the Hash table that should be deleted
  *
  */
 void ht_del_hash_table(ht_hash_table* ht) {
-    for (int i = 0; i < ht->size; i++) {
-        ht_item* item = ht->items[i];
-        if ((item != NULL) && (item != &HT_DELETED_ITEM)) {
-            ht_del_item(item);
+    free(ht->frozen_disp);
+    free(ht->filter_mem);
+    if (ht->snapshot != NULL) {
+#if HT_USE_MMAP
+        munmap((void*)ht->snapshot, ht->snapshot_size);
+#else
+        free((void*)ht->snapshot);
+#endif
+        free(ht);
+        return;
+    }
+    if (ht->arena != NULL) {
+        arena_del(ht->arena);
+    }
+    else {
+        for (int i = 0; i < ht->size; i++) {
+            if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+                ht_del_item(ht, &ht->items[i]);
+            }
+        }
+        for (int i = 0; i < ht->old_size; i++) {
+            if (HT_CTRL_IS_FULL(ht->old_ctrl[i])) {
+                ht_del_item(ht, &ht->old_items[i]);
+            }
         }
     }
+    free(ht->old_ctrl);
+    free(ht->old_items);
+    free(ht->ctrl);
     free(ht->items);
     free(ht);
 }
 
 
 /**
- * ht_insert() - insert a new key-value pair into hash table
+ * ht_use_arena() - has a hash table allocate its keys and values from an arena
  *
- * To insert a new key-value pair, we iterate through indexes until we find an empty bucket.
- * We then insert the item into that bucket and increment the hash table's
- * `count` attribute, to indicate a new item has been added.
+ * Every insert into a hash table copies the key, and the table frees the key and
+ * the value when the item is deleted.  With an arena the key copies are cut from
+ * the arena's chunks instead of malloc()'d one at a time, deleted items go back on
+ * the arena's free lists, and ht_del_hash_table() releases everything in one go.
+ * The hash table takes over the arena and deletes it with the table.
  *
  * @param ht is a pointer to a Hash table created with the ht_new() function
- * @param key is a pointer to a string containing the key
- * @param value is a void pointer to what we want to insert into the hash table
+ * @param arena is the arena to use (from arena_new())
  *
+ * @return 0 on success, -1 if the table already has items or an arena
+ *
+ * @note Once a table has an arena, the values inserted into it must come from
+ * ht_alloc_value() (or be NULL) since the table gives them back to the arena.
  */
-void ht_insert(ht_hash_table* ht, const char* key, void* value) {
-  ht_item* item = ht_new_item(key, value);
-  int index = ht_get_hash(item->key, ht->size, 0);
-  ht_item* cur_item = ht->items[index];
-  int i = 1;
-
-  while (cur_item != NULL && cur_item != &HT_DELETED_ITEM) {
-	if (strcmp(cur_item->key, key) == 0) {  // support updating keys
-    ht->items[index] = item;
-    return;
+int ht_use_arena(ht_hash_table* ht, arena_t* arena) {
+  if ((ht->count != 0) || (ht->arena != NULL) || (ht->snapshot != NULL) || (ht->frozen_disp != NULL)) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr,
+				"ERROR(ht_use_arena()): The hash table must be empty and have no arena\n");
+		#endif
+    return -1;
   }
-  index = ht_get_hash(item->key, ht->size, i);
-  cur_item = ht->items[index];
-  i++;
+  ht->arena = arena;
+  return 0;
+}
+
+
+/**
+ * ht_alloc_value() - allocates memory for a value
+ *
+ * Values are freed by the hash table when their item is deleted, so they have to
+ * be allocated the same way the table will free them: from the table's arena if it
+ * has one, with malloc() if it doesn't.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param size is the number of bytes needed for the value
+ *
+ * @return a pointer to the memory for the value or NULL if out of memory
+ */
+void* ht_alloc_value(ht_hash_table* ht, size_t size) {
+  if (ht->arena != NULL) {
+    return arena_alloc(ht->arena, size);
   }
-ht->items[index] = item;
+  return malloc(size);
+}
 
-	#if (_DEBUG_ > 0)
-		fprintf(stderr,
-			"\tINFO(ht_insert()): Inserted hash table[%d], k:v = %s:%p\n",
-			index, item->key, item->value);
-	#endif
 
-  ht->count++;
+/**
+ * ht_free_value() - frees a value that was not inserted into the hash table
+ *
+ * @param ht is a pointer to the Hash table the value was allocated for
+ * @param value is a value from ht_alloc_value() (NULL is ignored)
+ */
+void ht_free_value(ht_hash_table* ht, void* value) {
+  if (ht->arena != NULL) {
+    arena_free(ht->arena, value);
+  }
+  else {
+    free(value);
+  }
 }
 
 
 /**
- * ht_search() - search the hash table for an element with the specified key
+ * ht_reserve() - makes room for more items
+ *
+ * Bulk loaders that know how many items are coming call this first so the table
+ * is resized once, up front, instead of doubling over and over during the load.
+ * Any rehash already in progress is finished first.  The items that are already
+ * in the table are migrated incrementally as usual.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param num_items is the number of items that are about to be inserted
+ */
+void ht_reserve(ht_hash_table* ht, const int num_items) {
+  const long needed = ((long)ht->count + num_items) * 100 / HT_GROW_LOAD + 1;
+  if ((num_items <= 0) || (needed <= ht->size) || (needed > (long)INT_MAX / 2) ||
+      (ht->snapshot != NULL) || (ht->frozen_disp != NULL)) {
+    return;
+  }
+  while (ht->old_items != NULL) {
+    ht_rehash_step(ht, ht->old_size);
+  }
+  ht_start_resize(ht, (int)needed);
+}
+
+
+/**
+ * ht_insert() - insert a new key-value pair into hash table
  *
- * Searching is similar to inserting, but at each iteration of the `while` loop,
- * we check whether the item's key matches the key we're searching for. If it does,
- * we return the item's value. If the while loop hits a `NULL` bucket, we return`NULL`
- * to indicate that no value was found.
+ * If the key is already in the table (in either the new or the old array while a
+ * rehash is in progress) its value is replaced and the old value is freed.  Otherwise we check whether the
+ * new item would push the load factor over HT_GROW_LOAD, or whether the longest
+ * probe sequence has grown past HT_MAX_PSL, and if so a rehash to twice the size
+ * is started.  The item is then stored with Robin Hood probing and the hash table's
+ * `count` attribute is incremented.
  *
  * @param ht is a pointer to a Hash table created with the ht_new() function
  * @param key is a pointer to a string containing the key
+ * @param value is a void pointer to what we want to insert into the hash table
  *
- * @return value as a generic pointer.  Should be cast to the type of the return data
  */
-void* ht_search(ht_hash_table* ht, const char* key) {
-	int index;
-	ht_item* item;
-	int i;
+void ht_insert(ht_hash_table* ht, const char* key, void* value) {
+  ht_insert_hashed(ht, key, (ht->key_mode == HT_KEY_NOCASE) ? ht_hash_nocase(key) : ht_hash_string(key),
+                   value);
+}
 
-	#if (_DEBUG_ > 0)
-		fprintf(stderr,
-			"\tINFO(ht_search()): Searching for key: %s\n",
-			key);
-	#endif
 
-  index = ht_get_hash(key, ht->size, 0);
-  item = ht->items[index];
-	i = 1;
-  while (item != NULL && item != &HT_DELETED_ITEM) {
-    if (strcmp(item->key, key) == 0) {
-		    #if (_DEBUG_ > 0)
-				fprintf(stderr,
-					"\tINFO(ht_search()): Found key %s in bucket: %d at address %p\n",
-					key, index, item->value);
-			  #endif
-			  return item->value;
-    }
-    index = ht_get_hash(key, ht->size, i);
-    item = ht->items[index];
-    i++;
+/**
+ * ht_insert_hashed() - insert a key-value pair whose key has already been hashed
+ *
+ * Same as ht_insert() but the hash of the key is passed in, so a caller that
+ * needed the hash anyway (ex: to pick a shard) doesn't hash the key twice.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param key is a pointer to a string containing the key
+ * @param hash is the hash of key from ht_hash_string() (ht_hash_nocase() if the
+ * table is case-insensitive)
+ * @param value is a void pointer to what we want to insert into the hash table
+ *
+ */
+void ht_insert_hashed(ht_hash_table* ht, const char* key, const uint64_t hash, void* value) {
+  if (ht->key_mode == HT_KEY_NOCASE) {
+    const ht_nocase_key nocase = {key, strlen(key)};
+    (void)ht_insert_key(ht, &nocase, hash, value);
+    return;
   }
-
-	#if (_DEBUG_ > 0)
-		fprintf(stderr,
-			"\tINFO(ht_search()): key: %s is not in the hash table\n",
-			key);
+  if (ht->key_mode != HT_KEY_STRING) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_insert()): The table doesn't use string keys\n");
 		#endif
-    return NULL;
+    return;
+  }
+  (void)ht_insert_key(ht, key, hash, value);
 }
 
 
-/* ht_delete() - delete an element from the hash table
+/**
+ * ht_upsert() - inserts a key-value pair or replaces the value of a key
  *
- * Deleting from an open addressed hash table is more complicated than inserting
- * or searching. The item we wish to delete may be part of a collision chain.
- * Removing it from the table will break that chain, and will make finding items in
- * the tail of the chain impossible.
+ * Same as ht_insert() but tells the caller which of the two happened.  A value
+ * that is replaced is freed (see ht_alloc_value()), unless it is the same value.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param key is a pointer to a string containing the key
+ * @param value is a value from ht_alloc_value()
+ *
+ * @return 1 if the key was inserted, 0 if its value was replaced, -1 on error
+ * (out of memory, a read-only snapshot or a table with packed keys)
+ */
+int ht_upsert(ht_hash_table* ht, const char* key, void* value) {
+  if (ht->key_mode == HT_KEY_NOCASE) {
+    const ht_nocase_key nocase = {key, strlen(key)};
+    return ht_insert_key(ht, &nocase, ht_hash_bytes(key, nocase.len, 1), value);
+  }
+  if (ht->key_mode != HT_KEY_STRING) {
+    return -1;
+  }
+  return ht_insert_key(ht, key, ht_hash_string(key), value);
+}
+
+
+/**
+ * ht_get_or_insert() - finds the value of a key, inserting the key if it isn't there
  *
- * To solve this, instead of deleting the item, we simply mark it as deleted.
- * We mark an item as deleted by replacing it with a pointer to a global sentinel
- * item which represents that a bucket contains a deleted item.
+ * Returns the key's value so the caller can update it in place: a lookup and an
+ * update cost one probe and nothing is allocated or copied.  If the key isn't in
+ * the table a zeroed value of value_size bytes is allocated with ht_alloc_value()
+ * and inserted with the key.  Values never move, so the pointer stays valid
+ * until the key is deleted or its value is replaced.  If the table has an
+ * observer (see ht_add_observer()) a change to a found value goes between
+ * ht_begin_update() and ht_end_update(), and a new value gets ht_end_update()
+ * once it is filled in.
  *
  * @param ht is a pointer to a Hash table created with the ht_new() function
  * @param key is a pointer to a string containing the key
+ * @param value_size is the size of a new value
+ * @param inserted is set to 1 if the key was inserted and 0 if it was found (may be NULL)
  *
+ * @return the key's value or NULL on error (out of memory, a read-only snapshot
+ * or a table with packed keys)
  */
-void ht_delete(ht_hash_table* ht, const char* key) {
-    int index = ht_get_hash(key, ht->size, 0);
-    ht_item* item = ht->items[index];
-    int i = 1;
-
-    while (item != NULL && item != &HT_DELETED_ITEM) {
-        if (strcmp(item->key, key) == 0) {
-            ht_del_item(item);
-            ht->items[index] = &HT_DELETED_ITEM;
-        }
-        index = ht_get_hash(key, ht->size, i);
-        item = ht->items[index];
-        i++;
-    }
-    ht->count--;
+void* ht_get_or_insert(ht_hash_table* ht, const char* key, const size_t value_size, int* inserted) {
+  if (ht->key_mode == HT_KEY_NOCASE) {
+    const ht_nocase_key nocase = {key, strlen(key)};
+    return ht_get_or_insert_key(ht, &nocase, ht_hash_bytes(key, nocase.len, 1), value_size, inserted);
+  }
+  if (ht->key_mode != HT_KEY_STRING) {
+    return NULL;
+  }
+  return ht_get_or_insert_key(ht, key, ht_hash_string(key), value_size, inserted);
 }
 
 
 /**
- * ht_dump() - dumps (lists) the entire hash table to the console
+ * ht_get_or_insert_packed() - ht_get_or_insert() for a table with packed keys
  *
- * Traverses the entire hash table displaying the key and value for
- * every occupied bucket in the hash table.  Empty ('.') and deleted ("delete")
- * buckets are noted
+ * @param ht is a pointer to a Hash table in HT_KEY_PACKED mode
+ * @param key is the key from ht_pack_key()
+ * @param value_size is the size of a new value
+ * @param inserted is set to 1 if the key was inserted and 0 if it was found (may be NULL)
  *
- * @param	ht is a pointer to the Hash table that should be deleted
+ * @return the key's value or NULL on error
+ */
+void* ht_get_or_insert_packed(ht_hash_table* ht, const ht_packed_key* key, const size_t value_size,
+                              int* inserted) {
+  if (ht->key_mode != HT_KEY_PACKED) {
+    return NULL;
+  }
+  return ht_get_or_insert_key(ht, key, ht_hash_packed(key), value_size, inserted);
+}
+
+
+/**
+ * ht_insert_packed() - insert a key-value pair into a table with packed keys
  *
+ * Same as ht_insert() for a table in HT_KEY_PACKED mode.  The key is stored in
+ * the slot, so nothing is allocated for it.
+ *
+ * @param ht is a pointer to a Hash table in HT_KEY_PACKED mode
+ * @param key is the key from ht_pack_key()
+ * @param value is a void pointer to what we want to insert into the hash table
  */
-void ht_dump(ht_hash_table* ht) {
-	printf("Hash table contains:\n");
-    for (int i = 0; i < ht->size; i++) {
-        ht_item* item = ht->items[i];
-        if (item == NULL) {
-            printf(".");
-        }
-		else if (item == &HT_DELETED_ITEM) {
-			printf("\n\tHash Table[%02d] has been deleted\n", i);
-		}
-		else {
-			printf("\n\tHash Table[%02d] has k:v = %s:%p", i, item->key, item->value);
-		}
-    }
-	printf("\n");
+void ht_insert_packed(ht_hash_table* ht, const ht_packed_key* key, void* value) {
+  if (ht->key_mode != HT_KEY_PACKED) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_insert_packed()): The table doesn't use packed keys\n");
+		#endif
+    return;
+  }
+  (void)ht_insert_key(ht, key, ht_hash_packed(key), value);
 }
 
 
+/**
+ * ht_search_packed() - search a table with packed keys
+ *
+ * @param ht is a pointer to a Hash table in HT_KEY_PACKED mode
+ * @param key is the key from ht_pack_key()
+ *
+ * @return the value or NULL if the key is not in the table
+ */
+void* ht_search_packed(ht_hash_table* ht, const ht_packed_key* key) {
+  if (ht->key_mode != HT_KEY_PACKED) {
+    return NULL;
+  }
+  const uint64_t hash = ht_hash_packed(key);
+  if (ht->snapshot != NULL) {
+    return ht_snapshot_search(ht, key, hash);
+  }
+  return ht_search_key(ht, key, hash);
+}
+
+
+/**
+ * ht_delete_packed() - delete an element from a table with packed keys
+ *
+ * @param ht is a pointer to a Hash table in HT_KEY_PACKED mode
+ * @param key is the key from ht_pack_key()
+ */
+void ht_delete_packed(ht_hash_table* ht, const ht_packed_key* key) {
+  if (ht->key_mode != HT_KEY_PACKED) {
+    return;
+  }
+  ht_delete_key(ht, key, ht_hash_packed(key));
+}
 
-// Helper functions
 
 /**
- * ht_new_item() - allocate a new element for the hash table
+ * ht_set_key_mode() - chooses the kind of keys an (empty) table uses
  *
- * Allocates a chunk of memory the size of an `ht_item` and saves a copy of the
- * key and value pair in the new chunk of memory.
+ * HT_KEY_STRING tables (the default) take '\0' terminated strings and keep a copy
+ * of every key.  HT_KEY_PACKED tables take ht_packed_key keys (a conference and
+ * a city packed into 16 bytes by ht_pack_key()): the key is stored in the slot,
+ * hashing it is a couple of multiplies and comparing it is two word compares, so
+ * inserts and searches never allocate or call strcmp().  Use ht_insert_packed(),
+ * ht_search_packed() and ht_delete_packed() with a packed table.
  *
- * @param k is a pointer to the string containing the key for the element
- * @param v is a pointer to a team Info record
+ * HT_KEY_NOCASE tables take strings like HT_KEY_STRING tables but ASCII case
+ * doesn't matter: "Portland" and "PORTLAND" are the same key.  The table keeps
+ * an uppercased copy of each key and folds the keys passed to ht_search() and
+ * ht_delete() 8 bytes at a time while hashing and comparing them, so callers
+ * pass raw input instead of building an uppercased copy.
  *
- * @return a pointer to the new element
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param key_mode is HT_KEY_STRING, HT_KEY_NOCASE or HT_KEY_PACKED
  *
- * @note The function is declared `static` because it will only be called by code internal to the hash table.
+ * @return 0 on success, -1 if the table isn't empty or the mode isn't valid
  */
-static ht_item* ht_new_item(const char* k, void*  v) {
-  ht_item* i = malloc(sizeof(ht_item));
-	if (i == NULL) {
+int ht_set_key_mode(ht_hash_table* ht, const int key_mode) {
+  if ((ht->count != 0) || (ht->snapshot != NULL) || (ht->frozen_disp != NULL) ||
+      ((key_mode != HT_KEY_STRING) && (key_mode != HT_KEY_NOCASE) && (key_mode != HT_KEY_PACKED))) {
 		#if (_DEBUG_ > 0)
-		fprintf(stderr,
-			"ERROR (ht_item()):  Could not allocate a new item\n");
+			fprintf(stderr,
+				"ERROR(ht_set_key_mode()): The hash table must be empty and the mode valid\n");
 		#endif
-		return NULL;
-	}
+    return -1;
+  }
+  ht->key_mode = key_mode;
+  return 0;
+}
 
-	// alas, if only there was a strdup() function in the string library..do this instead
-	char* d = malloc(strlen(k) + 1);
-	i->key = strcpy(d, k);
 
-  i->value = v;
-  return i;
-}
+/**
+ * ht_pack_key() - packs a conference and a city into a fixed size key
+ *
+ * The city is uppercased (ASCII) so, like createKey(), the case of the input
+ * doesn't matter.  Unused bytes are zero so two keys are equal exactly when
+ * their bytes are.
+ *
+ * @param key is the key to fill in
+ * @param conf is the conference
+ * @param city is the city, 1 to HT_PACKED_CITY_LEN characters
+ *
+ * @return 0 on success, -1 if the conference or the city isn't valid
+ */
+int ht_pack_key(ht_packed_key* key, const conf_t conf, const char* city) {
+  const size_t len = strlen(city);
 
+  memset(key, 0, sizeof(ht_packed_key));
+  if (((int)conf < NWSL) || ((int)conf > WEST) || (len == 0) || (len > HT_PACKED_CITY_LEN)) {
+    return -1;
+  }
+  key->conf_len = (uint8_t)(((unsigned)conf << 4) | (unsigned)len);
+  for (size_t i = 0; i < len; i++) {
+    const char c = city[i];
+    key->city[i] = ((c >= 'a') && (c <= 'z')) ? (char)(c - 'a' + 'A') : c;
+  }
+  return 0;
+}
 
 
 /**
- * ht_del_item() - deletes an element from the hash table
+ * ht_hash_packed() - hash function for packed keys
  *
- * Deletes the specified element from the hash table.  Frees up the memory
- * for the key and the value and the hash+item.
+ * The same multiply-xorshift steps and final avalanche as ht_hash_string(), run
+ * over the two 64-bit words of the key (see ht_hash_packed_inline()).
  *
- * @param	i is a pointer to the ht_item that should be deleted
+ * @param key is the key from ht_pack_key()
  *
- * @note The function is declared `static` because it will only be called by code internal to the hash table
+ * @return the 64-bit hash of the key
  */
-static void ht_del_item(ht_item* i) {
-  free(i->key);
-  free(i->value);
-  free(i);
+uint64_t ht_hash_packed(const ht_packed_key* key) {
+  return ht_hash_packed_inline(key);
 }
 
 
 /**
- * ht_generic_hash() -  generic Hash function
+ * ht_insert_key() - inserts a key of any mode, see ht_upsert()
  *
- * Applies a generic hash function for character strings.  Produces an index into
- * the Hash table.  The algorithm works by creating a large integer from scanning each
- * character in the string and then using the modulus (%) operator to reduce the number so that it fits into the table.
+ * @param ht is a pointer to the Hash table
+ * @param key is a string, an ht_nocase_key or an ht_packed_key, depending on the
+ * table's key mode
+ * @param hash is the hash of key
+ * @param value is the value
  *
- * @param s is the key for the hash table element
- * @param a is a prime number larger than the size of the alphabet (> 128).
- * @param m is the number of elements (the size) in the Hash table
+ * @return 1 if the key was inserted, 0 if its value was replaced, -1 on error
+ */
+static int ht_insert_key(ht_hash_table* ht, const void* key, const uint64_t hash, void* value) {
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL)) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_insert()): A snapshot or a frozen table is read-only\n");
+		#endif
+    return -1;
+  }
+
+  ht_rehash_step(ht, HT_REHASH_STEP);
+
+  // support updating keys, the old value belongs to the table so it is freed.
+  // A key the Bloom filter has never seen is new, there is nothing to look for
+  ht_item* found = NULL;
+  const int maybe = ht_filter_maybe(ht, hash);
+  int index = maybe ? ht_find_new(ht, key, hash) : -1;
+  if (index >= 0) {
+    found = &ht->items[index];
+  }
+  else if (maybe && ((index = ht_find_old(ht, key, hash)) >= 0)) {
+    found = &ht->old_items[index];
+  }
+  if (found != NULL) {
+    ht_notify(ht, found->value, HT_VALUE_REMOVED);
+    if (found->value != value) {
+      ht_free_value(ht, found->value);
+      found->value = value;
+    }
+    ht_notify(ht, value, HT_VALUE_ADDED);
+    return 0;
+  }
+  const int status = ht_add_key(ht, key, hash, value);
+  if (status == 1) {
+    ht_notify(ht, value, HT_VALUE_ADDED);
+  }
+  return status;
+}
+
+
+/**
+ * ht_get_or_insert_key() - finds or inserts a key of any mode, see ht_get_or_insert()
  *
- * @return the value calculated by the function.  This generic function is used
- * in this implementation for generating the primary hash and the secondary hash that is
- * used if the first hash results in collision.
+ * @param ht is a pointer to the Hash table
+ * @param key is a string, an ht_nocase_key or an ht_packed_key, depending on the
+ * table's key mode
+ * @param hash is the hash of key
+ * @param value_size is the size of a new value
+ * @param inserted is set to 1 if the key was inserted and 0 if it was found (may be NULL)
  *
+ * @return the key's value or NULL on error
  */
-static int ht_generic_hash(const char* s, const int a, const int m) {
-  long hash = 0;
+static void* ht_get_or_insert_key(ht_hash_table* ht, const void* key, const uint64_t hash,
+                                  const size_t value_size, int* inserted) {
+  if (inserted != NULL) {
+    *inserted = 0;
+  }
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL)) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_get_or_insert()): A snapshot or a frozen table is read-only\n");
+		#endif
+    return NULL;
+  }
+
+  ht_rehash_step(ht, HT_REHASH_STEP);
+
+  ht_item* found = NULL;
+  const int maybe = ht_filter_maybe(ht, hash);
+  int index = maybe ? ht_find_new(ht, key, hash) : -1;
+  if (index >= 0) {
+    found = &ht->items[index];
+  }
+  else if (maybe && ((index = ht_find_old(ht, key, hash)) >= 0)) {
+    found = &ht->old_items[index];
+  }
+  if ((found != NULL) && (found->value != NULL)) {
+    return found->value;
+  }
 
-  const int len_s = strlen(s);
-  for (int i = 0; i < len_s; i++) {
-      hash += (long)pow(a, len_s - (i+1)) * s[i];
-      hash = hash % m;
+  // a new key, or a key that was inserted without a value
+  void* value = ht_alloc_value(ht, value_size);
+  if (value == NULL) {
+    return NULL;
   }
-  return (int)hash;
+  memset(value, 0, value_size);
+  if (found != NULL) {
+    found->value = value;
+  }
+  else if (ht_add_key(ht, key, hash, value) != 1) {
+    ht_free_value(ht, value);
+    return NULL;
+  }
+  if (inserted != NULL) {
+    *inserted = 1;
+  }
+  return value;
 }
 
 
 /**
- * ht_get_hash() -  gets the index for a key by employing a double hashing algorithm
+ * ht_add_key() - adds a key that isn't in the table
  *
- * The hashing function that returns the index into the hash table.  Collision handling
- * is handled by double hashing.  That is, a secondary hashing function is used to select
- * the next bucket in the hash table for that index if applying the first hashing
- * function results in a collision.
+ * Grows the table first if it is too full or its probe chains are too long.
  *
- * @param s is the key for the Hash table element
- * @param num_buckets is the number of buckets in the Hash table
- * @param attempt is the number of attempts to find the correct bucket for the key
- *
- * @returns the value calculated by the function.
+ * @param ht is a pointer to the Hash table
+ * @param key is a string, an ht_nocase_key or an ht_packed_key, depending on the
+ * table's key mode
+ * @param hash is the hash of key
+ * @param value is the value
  *
+ * @return 1 if the key was added, -1 if there wasn't memory for it
  */
-static int ht_get_hash(const char* s, const int num_buckets, const int attempt) {
-    const int hash_a = ht_generic_hash(s, HT_PRIME_1, num_buckets);
-    const int hash_b = ht_generic_hash(s, HT_PRIME_2, num_buckets);
-    return (hash_a + (attempt * (hash_b + 1))) % num_buckets;
+static int ht_add_key(ht_hash_table* ht, const void* key, const uint64_t hash, void* value) {
+  ht_item item;
+  int index;
+
+  // grow before the probe chains get too long (in long, in_use * 100
+  // overflows an int past about 21M items)
+  const long in_use = (long)ht->count - ht->old_count + 1;
+  if ((in_use * 100 > (long)HT_GROW_LOAD * ht->size) ||
+      ((ht->max_psl > HT_MAX_PSL) && (in_use * 100 > (long)HT_SHRINK_LOAD * ht->size))) {
+    while (ht->old_items != NULL) {
+      ht_rehash_step(ht, ht->old_size);
+    }
+    ht_start_resize(ht, ht->base_size * 2);
+  }
+
+  if (ht_new_item(ht, &item, key, value, hash) != 0) {
+    return -1;
+  }
+  #if (HT_STATS > 0)
+    if (HT_CTRL_IS_FULL(ht->ctrl[hash & (uint64_t)(ht->size - 1)])) {
+      ht->collisions++;
+    }
+  #endif
+  index = ht_place(ht->ctrl, ht->items, ht->size, &ht->max_psl, item);
+  if (index < 0) {
+    // the caller still owns the value, only the copy of the key is ours
+    ht_free_value(ht, ht_heap_key(ht, &item));
+    return -1;
+  }
+
+	#if (_DEBUG_ > 0)
+		fprintf(stderr,
+			"\tINFO(ht_insert()): Inserted hash table[%d], v = %p\n",
+			index, ht->items[index].value);
+	#endif
+
+  ht->count++;
+  if (ht->filter != NULL) {
+    ht_filter_add(ht, hash);
+  }
+  return 1;
+}
+
+
+/**
+ * ht_add_observer() - has the table report the values it adds and removes
+ *
+ * An observer is how a secondary index over the values (ex: the standings in
+ * standings.c) stays consistent with the table.  It is called with
+ * HT_VALUE_ADDED after ht_insert() (and the other inserts) adds a value, with
+ * HT_VALUE_DELETED before ht_delete() frees a value, and with HT_VALUE_REMOVED
+ * and then HT_VALUE_ADDED when a value is replaced.  A value that the caller changes in place
+ * is reported by ht_begin_update() and ht_end_update().  The values already in
+ * the table are reported to the new observer as added right away.  Deleting
+ * the table doesn't call the observers.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param observer is the function to call
+ * @param ctx is passed to the observer (ex: the index)
+ *
+ * @return 0 on success, -1 for a snapshot (its values are in the mapped file)
+ * or if the table already has HT_MAX_OBSERVERS observers
+ *
+ * @note A value returned by ht_get_or_insert() with *inserted set isn't
+ * reported until the caller has filled it in and calls ht_end_update().
+ */
+int ht_add_observer(ht_hash_table* ht, ht_observer observer, void* ctx) {
+  if ((ht->snapshot != NULL) || (ht->num_observers == HT_MAX_OBSERVERS)) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_add_observer()): A snapshot or too many observers\n");
+		#endif
+    return -1;
+  }
+  ht->observers[ht->num_observers].fn = observer;
+  ht->observers[ht->num_observers].ctx = ctx;
+  ht->num_observers++;
+  for (int i = 0; i < ht->size; i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i]) && (ht->items[i].value != NULL)) {
+      observer(ctx, ht->items[i].value, HT_VALUE_ADDED);
+    }
+  }
+  for (int i = 0; i < ht->old_size; i++) {
+    if (HT_CTRL_IS_FULL(ht->old_ctrl[i]) && (ht->old_items[i].value != NULL)) {
+      observer(ctx, ht->old_items[i].value, HT_VALUE_ADDED);
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * ht_remove_observer() - stops reporting to an observer, see ht_add_observer()
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param observer is the function that was added
+ * @param ctx is the ctx it was added with
+ *
+ * @return 0 on success, -1 if the observer wasn't added to the table
+ */
+int ht_remove_observer(ht_hash_table* ht, ht_observer observer, void* ctx) {
+  for (int i = 0; i < ht->num_observers; i++) {
+    if ((ht->observers[i].fn == observer) && (ht->observers[i].ctx == ctx)) {
+      ht->num_observers--;
+      memmove(&ht->observers[i], &ht->observers[i + 1],
+              (size_t)(ht->num_observers - i) * sizeof(ht->observers[0]));
+      return 0;
+    }
+  }
+  return -1;
+}
+
+
+/**
+ * ht_begin_update() - starts an in-place change of a value
+ *
+ * Call before changing the fields of a value that is in the table (ex: one from
+ * ht_search() or ht_get_or_insert()), so the observer can find the value by its
+ * old fields and take it out of its index.  Does nothing without an observer.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param value is the value about to be changed
+ */
+void ht_begin_update(ht_hash_table* ht, void* value) {
+  ht_notify(ht, value, HT_VALUE_REMOVED);
+}
+
+
+/**
+ * ht_end_update() - ends an in-place change of a value, see ht_begin_update()
+ *
+ * Also call it once a new value from ht_get_or_insert() has been filled in.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param value is the value that was changed
+ */
+void ht_end_update(ht_hash_table* ht, void* value) {
+  ht_notify(ht, value, HT_VALUE_ADDED);
+}
+
+
+/**
+ * ht_use_filter() - adds a Bloom filter that answers most misses
+ *
+ * A search for a key that isn't in the table probes its home group and stops
+ * at the first empty slot, a cache miss on the control bytes and usually one
+ * on the slots.  The filter is a blocked Bloom filter: every key sets one bit
+ * in each of the 8 words of a 64-byte block picked by its hash, so a key that
+ * isn't in the table is turned away after one cache line, about 99% of the
+ * time with the default HT_FILTER_BITS bits per key.  Inserts, deletes and
+ * ht_get_or_insert() of a new key skip their search the same way.  It pays
+ * off when most lookups miss (ex: validating user input against a big
+ * table), it is a cost when most of them hit.
+ *
+ * The filter is sized for twice the items in the table (at least
+ * HT_FILTER_MIN_KEYS) and rebuilt from the stored hashes when more keys than
+ * that have been added.  Deleted keys stay in the filter until then.  A table
+ * opened from a snapshot or frozen with ht_freeze() can have a filter too,
+ * built once from the keys it has.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param bits_per_key is how big to make the filter (ex: HT_FILTER_BITS), more
+ * bits give fewer false positives.  0 drops the filter
+ *
+ * @return 0 on success, -1 if bits_per_key isn't 0..64 or there isn't memory
+ * for the filter (the table keeps the filter it had)
+ */
+int ht_use_filter(ht_hash_table* ht, const int bits_per_key) {
+  if ((bits_per_key < 0) || (bits_per_key > 64)) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_use_filter()): %d bits per key\n", bits_per_key);
+		#endif
+    return -1;
+  }
+  if (bits_per_key == 0) {
+    free(ht->filter_mem);
+    ht->filter = NULL;
+    ht->filter_mem = NULL;
+    ht->filter_blocks = 0;
+    ht->filter_bits = 0;
+    ht->filter_keys = 0;
+    ht->filter_capacity = 0;
+    return 0;
+  }
+  return ht_filter_build(ht, bits_per_key);
+}
+
+
+/**
+ * ht_next() - walks the items of a hash table
+ *
+ * Returns the items one at a time, in slot order, and then the items still
+ * waiting in the array being rehashed.  The table must not change while it is
+ * walked; that includes searches, which move items while a rehash is in
+ * progress.  A table opened from a snapshot has no ht_items to walk.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param index is where the walk is, set it to 0 before the first call
+ *
+ * @return the next item (its key is ht_item_key() or key.packed) or NULL after
+ * the last one
+ */
+ht_item* ht_next(ht_hash_table* ht, int* index) {
+  if (ht->snapshot != NULL) {
+    return NULL;
+  }
+  while (*index < ht->size + ht->old_size) {
+    const int i = (*index)++;
+    if (i < ht->size) {
+      if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+        return &ht->items[i];
+      }
+    }
+    else if (HT_CTRL_IS_FULL(ht->old_ctrl[i - ht->size])) {
+      return &ht->old_items[i - ht->size];
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * ht_search() - search the hash table for an element with the specified key
+ *
+ * Searching follows the same probe sequence as inserting, but for each group of
+ * slots we check the slots whose control byte matches the key's tag.  If a slot's
+ * key matches the key we're searching for, we return the item's value.  A group
+ * with an empty slot ends the search, and no item is ever more than `max_psl`
+ * slots past its home slot so the search never looks further than that.  While a
+ * rehash is in progress the old array is searched when the key is not in the new
+ * one.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param key is a pointer to a string containing the key
+ *
+ * @return value as a generic pointer.  Should be cast to the type of the return data
+ */
+void* ht_search(ht_hash_table* ht, const char* key) {
+	#if (_DEBUG_ > 0)
+		fprintf(stderr,
+			"\tINFO(ht_search()): Searching for key: %s\n",
+			key);
+	#endif
+
+  if (ht->key_mode == HT_KEY_NOCASE) {
+    const ht_nocase_key nocase = {key, strlen(key)};
+    const uint64_t hash = ht_hash_bytes(key, nocase.len, 1);
+    if (ht->snapshot != NULL) {
+      return ht_snapshot_search(ht, &nocase, hash);
+    }
+    return ht_search_key(ht, &nocase, hash);
+  }
+  if (ht->key_mode != HT_KEY_STRING) {
+    return NULL;
+  }
+  const uint64_t hash = ht_hash_string(key);
+  if (ht->snapshot != NULL) {
+    return ht_snapshot_search(ht, key, hash);
+  }
+  return ht_search_key(ht, key, hash);
+}
+
+
+/**
+ * ht_search_key() - searches for a key of either mode, see ht_search()
+ *
+ * @param ht is a pointer to the Hash table
+ * @param key is a string, an ht_nocase_key or an ht_packed_key, depending on the
+ * table's key mode
+ * @param hash is the hash of key
+ *
+ * @return the value or NULL if the key is not in the table
+ */
+static void* ht_search_key(ht_hash_table* ht, const void* key, const uint64_t hash) {
+	int index;
+
+  if (ht_filter_rejects(ht, hash)) {
+    #if (HT_STATS > 0)
+      ht->searches++;
+      ht->miss_probes[0]++;
+    #endif
+    return NULL;
+  }
+  if (ht->frozen_disp != NULL) {
+    return ht_frozen_search(ht, key, hash);
+  }
+  ht_rehash_step(ht, HT_REHASH_STEP);
+
+  index = ht_find_new(ht, key, hash);
+  #if (HT_STATS > 0)
+    ht_count_search(ht, hash, (index >= 0), index);
+  #endif
+  if (index >= 0) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr,
+				"\tINFO(ht_search()): Found key in slot: %d at address %p\n",
+				index, ht->items[index].value);
+		#endif
+    return ht->items[index].value;
+  }
+
+  index = ht_find_old(ht, key, hash);
+  if (index >= 0) {
+    return ht->old_items[index].value;
+  }
+
+	#if (_DEBUG_ > 0)
+		fprintf(stderr,
+			"\tINFO(ht_search()): key is not in the hash table\n");
+		#endif
+  #if (HT_STATS > 0)
+    ht->filter_false_positives += (ht->filter != NULL);
+  #endif
+    return NULL;
+}
+
+
+/**
+ * ht_search_batch() - search the hash table for many keys at once
+ *
+ * Each ht_search() call waits on a cache miss for the key's control bytes and
+ * another for its slot before it can move on to the next key.  This function
+ * works on blocks of HT_BATCH_SIZE keys: while one block is being resolved the
+ * next block has already been hashed and the control bytes and slots of its home
+ * slots prefetched, so the misses for many independent lookups are in flight at
+ * the same time.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param keys is an array of n keys
+ * @param n is the number of keys
+ * @param out_values is set to the n values, NULL for the keys that aren't in the
+ * table (the same results as n calls to ht_search())
+ *
+ * @return the number of keys that were found
+ */
+int ht_search_batch(ht_hash_table* ht, const char* const* keys, const int n, void** out_values) {
+  int found = 0;
+
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL) || (ht->key_mode != HT_KEY_STRING)) {
+    for (int i = 0; i < n; i++) {
+      out_values[i] = ht_search(ht, keys[i]);
+      found += (out_values[i] != NULL);
+    }
+    return found;
+  }
+  return ht_search_batch_keys(ht, keys, n, out_values);
+}
+
+
+/**
+ * ht_search_packed_batch() - ht_search_batch() for a table with packed keys
+ *
+ * @param ht is a pointer to a Hash table in HT_KEY_PACKED mode
+ * @param keys is an array of n keys from ht_pack_key()
+ * @param n is the number of keys
+ * @param out_values is set to the n values, NULL for the keys that aren't in the
+ * table (the same results as n calls to ht_search_packed())
+ *
+ * @return the number of keys that were found
+ */
+int ht_search_packed_batch(ht_hash_table* ht, const ht_packed_key* keys, const int n, void** out_values) {
+  int found = 0;
+
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL) || (ht->key_mode != HT_KEY_PACKED)) {
+    for (int i = 0; i < n; i++) {
+      out_values[i] = ht_search_packed(ht, &keys[i]);
+      found += (out_values[i] != NULL);
+    }
+    return found;
+  }
+  return ht_search_batch_keys(ht, keys, n, out_values);
+}
+
+
+/**
+ * ht_search_batch_keys() - searches for a block of keys at a time, see ht_search_batch()
+ *
+ * @param ht is a pointer to a Hash table with string or packed keys
+ * @param keys is an array of n char* or of n ht_packed_key, depending on the
+ * table's key mode
+ * @param n is the number of keys
+ * @param out_values is set to the n values
+ *
+ * @return the number of keys that were found
+ */
+static int ht_search_batch_keys(ht_hash_table* ht, const void* keys, const int n, void** out_values) {
+  uint64_t hashes[2][HT_BATCH_SIZE];
+  int found = 0;
+
+  // do the rehash work the n searches would have done before looking at any slots
+  ht_rehash_step(ht, (n < ht->old_size / HT_REHASH_STEP) ? n * HT_REHASH_STEP : ht->old_size);
+
+  int block_len = (n < HT_BATCH_SIZE) ? n : HT_BATCH_SIZE;
+  ht_prefetch_block(ht, keys, block_len, hashes[0]);
+  const size_t key_size = (ht->key_mode == HT_KEY_PACKED) ? sizeof(ht_packed_key) : sizeof(char*);
+
+  for (int start = 0, cur = 0; start < n; cur ^= 1) {
+    const int next_start = start + block_len;
+    const int next_len = ((n - next_start) < HT_BATCH_SIZE) ? (n - next_start) : HT_BATCH_SIZE;
+    if (next_len > 0) {
+      ht_prefetch_block(ht, (const char*)keys + (size_t)next_start * key_size, next_len, hashes[cur ^ 1]);
+    }
+
+    for (int i = 0; i < block_len; i++) {
+      const uint64_t hash = hashes[cur][i];
+      const void* key = ht_batch_key(ht, keys, start + i);
+      if (ht_filter_rejects(ht, hash)) {
+        #if (HT_STATS > 0)
+          ht->searches++;
+          ht->miss_probes[0]++;
+        #endif
+        out_values[start + i] = NULL;
+        continue;
+      }
+      int index = ht_find_new(ht, key, hash);
+      #if (HT_STATS > 0)
+        ht_count_search(ht, hash, (index >= 0), index);
+      #endif
+      if (index >= 0) {
+        out_values[start + i] = ht->items[index].value;
+        found++;
+        continue;
+      }
+      index = ht_find_old(ht, key, hash);
+      if (index >= 0) {
+        out_values[start + i] = ht->old_items[index].value;
+        found++;
+      }
+      else {
+        out_values[start + i] = NULL;
+        #if (HT_STATS > 0)
+          ht->filter_false_positives += (ht->filter != NULL);
+        #endif
+      }
+    }
+    start = next_start;
+    block_len = next_len;
+  }
+  return found;
+}
+
+
+/* ht_delete() - delete an element from the hash table
+ *
+ * Deleting from an open addressed hash table is more complicated than inserting
+ * or searching. The item we wish to delete may be part of a collision chain.
+ * Removing it from the table will break that chain, and will make finding items in
+ * the tail of the chain impossible.
+ *
+ * Instead of leaving a tombstone, the items that follow the deleted one in its
+ * chain are shifted back one slot each (see ht_backward_shift()) so the chain is
+ * closed up again.  The count is only changed if the key was actually in the
+ * table.  If the table gets too empty it is shrunk.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param key is a pointer to a string containing the key
+ *
+ */
+void ht_delete(ht_hash_table* ht, const char* key) {
+    if (ht->key_mode == HT_KEY_NOCASE) {
+        const ht_nocase_key nocase = {key, strlen(key)};
+        ht_delete_key(ht, &nocase, ht_hash_bytes(key, nocase.len, 1));
+        return;
+    }
+    if (ht->key_mode != HT_KEY_STRING) {
+        return;
+    }
+    ht_delete_key(ht, key, ht_hash_string(key));
+}
+
+
+/**
+ * ht_delete_key() - deletes a key of either mode, see ht_delete()
+ *
+ * @param ht is a pointer to the Hash table
+ * @param key is a string, an ht_nocase_key or an ht_packed_key, depending on the
+ * table's key mode
+ * @param hash is the hash of key
+ */
+static void ht_delete_key(ht_hash_table* ht, const void* key, const uint64_t hash) {
+    if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL)) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_delete()): A snapshot or a frozen table is read-only\n");
+		#endif
+        return;
+    }
+    ht_rehash_step(ht, HT_REHASH_STEP);
+    if (!ht_filter_maybe(ht, hash)) {
+        return;
+    }
+
+    int index = ht_find_new(ht, key, hash);
+    if (index >= 0) {
+        ht_notify(ht, ht->items[index].value, HT_VALUE_DELETED);
+        ht_del_item(ht, &ht->items[index]);
+        ht_backward_shift(ht->ctrl, ht->items, ht->size, index);
+        ht->count--;
+    }
+    else {
+        index = ht_find_old(ht, key, hash);
+        if (index < 0) {
+            return;
+        }
+        ht_notify(ht, ht->old_items[index].value, HT_VALUE_DELETED);
+        ht_del_item(ht, &ht->old_items[index]);
+        ht_backward_shift(ht->old_ctrl, ht->old_items, ht->old_size, index);
+        ht->old_count--;
+        ht->count--;
+    }
+
+    // shrink the table once it is mostly empty, but never to a size the items
+    // would fill past HT_GROW_LOAD (in long, count * 100 overflows an int)
+    if ((ht->old_items == NULL) && (ht->base_size > HT_MIN_BASE_SIZE) &&
+        ((long)ht->count * 100 < (long)HT_SHRINK_LOAD * ht->size) &&
+        ((long)ht->count * 100 <= (long)HT_GROW_LOAD * (ht->base_size / 2))) {
+        ht_start_resize(ht, ht->base_size / 2);
+    }
+}
+
+
+/**
+ * ht_dump() - dumps (lists) the entire hash table to the console
+ *
+ * Traverses the entire hash table displaying the key and value for
+ * every occupied slot in the hash table.  Empty ('.') slots are noted.  Items that have not been migrated yet by a rehash that is
+ * in progress are listed after the new slots.
+ *
+ * @param	ht is a pointer to the Hash table that should be deleted
+ *
+ */
+void ht_dump(ht_hash_table* ht) {
+	printf("Hash table contains:\n");
+    for (int i = 0; i < ht->size; i++) {
+        if (ht->ctrl[i] == HT_CTRL_EMPTY) {
+            printf(".");
+        }
+		else if (ht->snapshot != NULL) {
+			const ht_snapshot_header* header = ht->snapshot;
+			const ht_snapshot_slot* slot = (const ht_snapshot_slot*)
+				((const char*)ht->snapshot + header->slots_offset) + i;
+			const char* key = (const char*)ht->snapshot + header->strings_offset + slot->key;
+			if (ht->key_mode == HT_KEY_PACKED) {
+				const ht_packed_key* packed = (const ht_packed_key*)key;
+				printf("\n\tHash Table[%02d] has k:v = %.*s%s:#%u", i, packed->conf_len & 0x0F,
+					packed->city, ht_conf_names[packed->conf_len >> 4], slot->value);
+			}
+			else {
+				printf("\n\tHash Table[%02d] has k:v = %s:#%u", i, key, slot->value);
+			}
+		}
+		else if (ht->key_mode == HT_KEY_PACKED) {
+			const ht_packed_key* packed = &ht->items[i].key.packed;
+			printf("\n\tHash Table[%02d] has k:v = %.*s%s:%p", i, packed->conf_len & 0x0F,
+				packed->city, ht_conf_names[packed->conf_len >> 4], ht->items[i].value);
+		}
+		else {
+			printf("\n\tHash Table[%02d] has k:v = %s:%p", i, ht_item_key(&ht->items[i]), ht->items[i].value);
+		}
+    }
+	printf("\n");
+
+	if (ht->old_items != NULL) {
+		printf("Not yet rehashed:\n");
+		for (int i = 0; i < ht->old_size; i++) {
+			if (HT_CTRL_IS_FULL(ht->old_ctrl[i])) {
+				if (ht->key_mode == HT_KEY_PACKED) {
+					const ht_packed_key* packed = &ht->old_items[i].key.packed;
+					printf("\tOld Hash Table[%02d] has k:v = %.*s%s:%p\n", i, packed->conf_len & 0x0F,
+						packed->city, ht_conf_names[packed->conf_len >> 4], ht->old_items[i].value);
+				}
+				else {
+					printf("\tOld Hash Table[%02d] has k:v = %s:%p\n", i,
+						ht_item_key(&ht->old_items[i]), ht->old_items[i].value);
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * ht_get_stats() - reports how well the hash table is doing
+ *
+ * The load factor and the probe sequence lengths of the items are worked out
+ * from the slots, so this takes time proportional to the size of the table;
+ * call it now and then, not on every operation.  The search, collision and
+ * resize counters are only kept when the code is compiled with HT_STATS > 0.
+ * Searches of a snapshot are not counted (only what its Bloom filter did).
+ *
+ * A search that finds its key probes the item's PSL slots past its home slot.
+ * A search that fails stops at the first empty slot, so its probe length is the
+ * distance from the home slot to that slot.  A miss the Bloom filter answers
+ * is counted with 0 slots probed.
+ *
+ * filter_fpr is the false positive rate the bits set in the Bloom filter should
+ * give, filter_measured_fpr the rate of the searches since the last
+ * ht_reset_stats().  Deleted keys leave their bits set until the filter is
+ * rebuilt, so the rate drifts up on a table with a lot of deletes.
+ *
+ * bytes_per_entry is what the table costs per item: its slots and control
+ * bytes, the copies of the keys too long to be inline, the Bloom filter and,
+ * with an arena, everything allocated from the arena.  Values the caller malloc'd aren't
+ * counted, the table doesn't know how big they are.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param stats is filled in with the statistics
+ */
+void ht_get_stats(const ht_hash_table* ht, ht_stats* stats) {
+  long total_psl = 0;
+
+  memset(stats, 0, sizeof(ht_stats));
+  stats->size = ht->size;
+  stats->count = ht->count;
+  stats->load_factor = (double)(ht->count - ht->old_count) / ht->size;
+  stats->tombstones = 0;
+  stats->rehashing = (ht->old_items != NULL);
+  stats->frozen = (ht->frozen_disp != NULL);
+
+  for (int i = 0; i < ht->size; i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+      uint64_t hash;
+      if (ht->snapshot != NULL) {
+        const ht_snapshot_header* header = ht->snapshot;
+        hash = ((const ht_snapshot_slot*)((const char*)ht->snapshot + header->slots_offset))[i].hash;
+      }
+      else {
+        hash = ht->items[i].hash;
+      }
+      ht_stats_add_psl(stats, (ht->frozen_disp != NULL) ? 0 :
+                       (int)(((uint64_t)i - hash) & (uint64_t)(ht->size - 1)), &total_psl);
+    }
+  }
+  for (int i = 0; i < ht->old_size; i++) {
+    if (HT_CTRL_IS_FULL(ht->old_ctrl[i])) {
+      const uint64_t hash = ht->old_items[i].hash;
+      ht_stats_add_psl(stats, (int)(((uint64_t)i - hash) & (uint64_t)(ht->old_size - 1)), &total_psl);
+    }
+  }
+  stats->avg_psl = (ht->count > 0) ? (double)total_psl / ht->count : 0.0;
+
+  // memory: the slots and control bytes, then the keys that aren't inline
+  stats->table_bytes = sizeof(ht_hash_table);
+  if (ht->snapshot != NULL) {
+    stats->table_bytes += ht->snapshot_size;
+  }
+  else {
+    stats->table_bytes += ((size_t)ht->size + HT_GROUP_WIDTH - 1) + (size_t)ht->size * sizeof(ht_item);
+    if (ht->old_items != NULL) {
+      stats->table_bytes += ((size_t)ht->old_size + HT_GROUP_WIDTH - 1) +
+                            (size_t)ht->old_size * sizeof(ht_item);
+    }
+    stats->table_bytes += (size_t)ht->frozen_buckets * sizeof(uint32_t);
+    for (int array = 0; (ht->key_mode != HT_KEY_PACKED) && (array < 2); array++) {
+      const int size = (array == 0) ? ht->size : ht->old_size;
+      const uint8_t* ctrl = (array == 0) ? ht->ctrl : ht->old_ctrl;
+      const ht_item* items = (array == 0) ? ht->items : ht->old_items;
+      for (int i = 0; i < size; i++) {
+        if (!HT_CTRL_IS_FULL(ctrl[i])) {
+          continue;
+        }
+        if ((uint8_t)items[i].key.inl[HT_INLINE_KEY_LEN] != HT_KEY_HEAP) {
+          stats->inline_keys++;
+        }
+        else if (ht->arena == NULL) {
+          const size_t len = strlen(items[i].key.str);
+          stats->key_bytes += ((ht->key_mode == HT_KEY_NOCASE) ? ht_nocase_size(len) : len + 1) +
+                              HT_MALLOC_OVERHEAD;
+        }
+      }
+    }
+  }
+  stats->arena_bytes = (ht->arena != NULL) ? ht->arena->bytes_in_use : 0;
+
+  // a key that isn't in the table gets through a block with probability
+  // (bits set / 64) for each word, averaged over the blocks
+  if (ht->filter != NULL) {
+    double sum = 0.0;
+    stats->filter_bytes = (size_t)ht->filter_blocks * HT_FILTER_WORDS * sizeof(uint64_t);
+    for (uint32_t b = 0; b < ht->filter_blocks; b++) {
+      double pass = 1.0;
+      for (int w = 0; w < HT_FILTER_WORDS; w++) {
+        pass *= __builtin_popcountll(ht->filter[b * HT_FILTER_WORDS + w]) / 64.0;
+      }
+      sum += pass;
+    }
+    stats->filter_fpr = sum / ht->filter_blocks;
+  }
+  stats->bytes_per_entry = (ht->count > 0) ?
+      (double)(stats->table_bytes + stats->key_bytes + stats->arena_bytes + stats->filter_bytes) /
+      ht->count : 0.0;
+
+#if (HT_STATS > 0)
+  stats->stats_enabled = 1;
+  stats->searches = ht->searches;
+  for (int i = 0; i < HT_STATS_BUCKETS; i++) {
+    stats->hit_probes[i] = ht->hit_probes[i];
+    stats->miss_probes[i] = ht->miss_probes[i];
+    stats->hits += ht->hit_probes[i];
+    stats->misses += ht->miss_probes[i];
+  }
+  stats->collisions = ht->collisions;
+  stats->grows = ht->grows;
+  stats->shrinks = ht->shrinks;
+  stats->resizes = ht->grows + ht->shrinks;
+  stats->filter_negatives = ht->filter_negatives;
+  stats->filter_false_positives = ht->filter_false_positives;
+  if (ht->filter_negatives + ht->filter_false_positives > 0) {
+    stats->filter_measured_fpr = (double)ht->filter_false_positives /
+                                 (ht->filter_negatives + ht->filter_false_positives);
+  }
+#endif
+}
+
+
+/**
+ * ht_reset_stats() - zeroes the counters reported by ht_get_stats()
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ */
+void ht_reset_stats(ht_hash_table* ht) {
+#if (HT_STATS > 0)
+  ht->searches = 0;
+  memset(ht->hit_probes, 0, sizeof(ht->hit_probes));
+  memset(ht->miss_probes, 0, sizeof(ht->miss_probes));
+  ht->collisions = 0;
+  ht->grows = 0;
+  ht->shrinks = 0;
+  ht->filter_negatives = 0;
+  ht->filter_false_positives = 0;
+#else
+  (void)ht;
+#endif
+}
+
+
+/**
+ * ht_save_snapshot() - writes the hash table to a binary snapshot file
+ *
+ * The file has a header (format version, hash seed, byte order and the offsets
+ * of the sections), a copy of the control bytes, a slot array with the same
+ * layout as the table, a string pool with the keys and the values packed one
+ * after the other.  Every value is copied as value_size bytes, so the values
+ * must be plain records without pointers (ex: TeamInfo_t).  The file is written
+ * under a temporary name and renamed, so a reader never sees half of it.  Any
+ * rehash in progress is finished first.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ * @param path is the name of the snapshot file
+ * @param value_size is the size of every value in bytes
+ *
+ * @return 0 on success, -1 if the file could not be written (or the table is
+ * frozen, its layout isn't one a snapshot can describe)
+ */
+int ht_save_snapshot(ht_hash_table* ht, const char* path, const size_t value_size) {
+  ht_snapshot_header header;
+  static const char padding[HT_SNAPSHOT_ALIGN];
+  char tmp_path[FILENAME_MAX];
+
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL) || (value_size > UINT32_MAX) ||
+      (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))) {
+    return -1;
+  }
+  while (ht->old_items != NULL) {
+    ht_rehash_step(ht, ht->old_size);
+  }
+
+  // build the slots and lay out the file
+  ht_snapshot_slot* slots = calloc((size_t)ht->size, sizeof(ht_snapshot_slot));
+  if (slots == NULL) {
+    return -1;
+  }
+  uint64_t strings_size = 0;
+  uint32_t num_values = 0;
+  for (int i = 0; i < ht->size; i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+      slots[i].hash = ht->items[i].hash;
+      slots[i].key = (uint32_t)strings_size;
+      slots[i].value = (ht->items[i].value != NULL) ? num_values++ : HT_SNAPSHOT_NULL_VALUE;
+      strings_size += (ht->key_mode == HT_KEY_PACKED) ? sizeof(ht_packed_key) :
+                      (ht->key_mode == HT_KEY_NOCASE) ? ht_nocase_size(strlen(ht_item_key(&ht->items[i]))) :
+                      strlen(ht_item_key(&ht->items[i])) + 1;
+    }
+  }
+  if (strings_size > UINT32_MAX) {
+    free(slots);
+    return -1;
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, HT_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = HT_SNAPSHOT_VERSION;
+  header.byte_order = HT_SNAPSHOT_BYTE_ORDER;
+  header.hash_seed = HT_HASH_SEED;
+  header.size = (uint32_t)ht->size;
+  header.count = (uint32_t)ht->count;
+  header.max_psl = (uint32_t)ht->max_psl;
+  header.value_size = (uint32_t)value_size;
+  header.num_values = num_values;
+  header.key_mode = (uint32_t)ht->key_mode;
+  header.ctrl_offset = ht_snapshot_align(sizeof(header));
+  header.slots_offset = ht_snapshot_align(header.ctrl_offset + (uint64_t)ht->size + HT_GROUP_WIDTH - 1);
+  header.strings_offset = ht_snapshot_align(header.slots_offset + (uint64_t)ht->size * sizeof(ht_snapshot_slot));
+  header.strings_size = strings_size;
+  header.values_offset = ht_snapshot_align(header.strings_offset + strings_size);
+  header.file_size = header.values_offset + (uint64_t)num_values * value_size;
+
+  FILE* fp = fopen(tmp_path, "wb");
+  if (fp == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(ht_save_snapshot()): Could not create %s\n", tmp_path);
+    #endif
+    free(slots);
+    return -1;
+  }
+
+  int ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  ok = ok && (fwrite(padding, 1, header.ctrl_offset - sizeof(header), fp) == header.ctrl_offset - sizeof(header));
+  ok = ok && (fwrite(ht->ctrl, 1, (size_t)ht->size + HT_GROUP_WIDTH - 1, fp) == (size_t)ht->size + HT_GROUP_WIDTH - 1);
+  ok = ok && (fseek(fp, (long)header.slots_offset, SEEK_SET) == 0);
+  ok = ok && (fwrite(slots, sizeof(ht_snapshot_slot), (size_t)ht->size, fp) == (size_t)ht->size);
+  ok = ok && (fseek(fp, (long)header.strings_offset, SEEK_SET) == 0);
+  for (int i = 0; ok && (i < ht->size); i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+      if (ht->key_mode == HT_KEY_PACKED) {
+        ok = (fwrite(&ht->items[i].key.packed, sizeof(ht_packed_key), 1, fp) == 1);
+      }
+      else if (ht->key_mode == HT_KEY_NOCASE) {
+        // keep the zero padding so the keys are compared a word at a time
+        const char* key = ht_item_key(&ht->items[i]);
+        ok = (fwrite(key, ht_nocase_size(strlen(key)), 1, fp) == 1);
+      }
+      else {
+        ok = (fputs(ht_item_key(&ht->items[i]), fp) != EOF) && (fputc('\0', fp) != EOF);
+      }
+    }
+  }
+  ok = ok && (fseek(fp, (long)header.values_offset, SEEK_SET) == 0);
+  for (int i = 0; ok && (i < ht->size); i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i]) && (ht->items[i].value != NULL)) {
+      ok = (fwrite(ht->items[i].value, 1, value_size, fp) == value_size);
+    }
+  }
+  ok = (fclose(fp) == 0) && ok;
+  free(slots);
+
+  if (!ok || (rename(tmp_path, path) != 0)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(ht_save_snapshot()): Could not write %s\n", path);
+    #endif
+    remove(tmp_path);
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+ * ht_open_snapshot() - opens a snapshot file as a read-only hash table
+ *
+ * The file is mapped into memory read-only (read in one piece on Windows) and
+ * checked, and that is all: ht_search() works straight from the mapping.  The
+ * values it returns point into the mapping, are value_size bytes long and must
+ * not be written to.  ht_insert() and ht_delete() don't change a snapshot.
+ *
+ * @param path is the name of the snapshot file
+ * @param value_size is the size of every value in bytes, it must match the size
+ * the file was saved with
+ *
+ * @return a pointer to the hash table or NULL if the file could not be opened,
+ * is damaged or was written by an incompatible version
+ */
+ht_hash_table* ht_open_snapshot(const char* path, const size_t value_size) {
+  size_t size;
+  void* data;
+
+#if HT_USE_MMAP
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(ht_snapshot_header))) {
+    close(fd);
+    return NULL;
+  }
+  size = (size_t)st.st_size;
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+#else
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = (size_t)ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data = malloc(size);
+  if ((data == NULL) || (fread(data, 1, size, fp) != size)) {
+    free(data);
+    fclose(fp);
+    return NULL;
+  }
+  fclose(fp);
+#endif
+
+  const ht_snapshot_header* header = data;
+  ht_hash_table* ht = NULL;
+  if (ht_snapshot_valid(header, size, value_size)) {
+    ht = calloc(1, sizeof(ht_hash_table));
+  }
+  if (ht == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(ht_open_snapshot()): %s is not a usable snapshot\n", path);
+    #endif
+#if HT_USE_MMAP
+    munmap(data, size);
+#else
+    free(data);
+#endif
+    return NULL;
+  }
+
+  ht->base_size = (int)header->size;
+  ht->size = (int)header->size;
+  ht->count = (int)header->count;
+  ht->max_psl = (int)header->max_psl;
+  ht->key_mode = (int)header->key_mode;
+  ht->ctrl = (uint8_t*)data + header->ctrl_offset;
+  ht->items = NULL;
+  ht->snapshot = data;
+  ht->snapshot_size = size;
+  return ht;
+}
+
+
+
+// Helper functions
+
+/**
+ * ht_freeze() - makes a table read-only with single probe searches
+ *
+ * Builds a minimal perfect hash (CHD, "compress, hash and displace") over the
+ * keys in the table.  The keys are split into buckets of about HT_MPH_LAMBDA
+ * keys by the top half of their hash.  Starting with the biggest bucket, each
+ * bucket gets the first displacement that sends all of its keys to free slots
+ * (see ht_mph_slot()).  The items are then moved into a dense array of exactly
+ * count slots, each at the slot the perfect hash gives it.
+ *
+ * A search of the frozen table looks up its bucket's displacement and checks
+ * one slot: the item's saved hash is the fingerprint that rejects almost every
+ * miss, and the key is compared only when the fingerprints match.  Inserts and
+ * deletes are refused from then on.  ht_search(), ht_search_packed(),
+ * ht_search_batch(), ht_dump(), ht_get_stats() and ht_del_hash_table() work as
+ * usual.
+ *
+ * @param ht is a pointer to a Hash table created with the ht_new() function
+ *
+ * @return 0 on success, -1 if the table is a snapshot or already frozen, two
+ * keys have the same 64-bit hash, or there isn't enough memory.  The table is
+ * unchanged when freezing fails
+ */
+int ht_freeze(ht_hash_table* ht) {
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL)) {
+    return -1;
+  }
+  while (ht->old_items != NULL) {
+    ht_rehash_step(ht, ht->old_size);
+  }
+
+  const uint32_t n = (uint32_t)ht->count;
+  const uint32_t num_buckets = (n + HT_MPH_LAMBDA - 1) / HT_MPH_LAMBDA + 1;
+  uint64_t* hashes = malloc(((size_t)n + 1) * sizeof(uint64_t));
+  uint32_t* bucket_of = malloc(((size_t)n + 1) * sizeof(uint32_t));
+  uint32_t* start = calloc((size_t)num_buckets + 1, sizeof(uint32_t));
+  uint32_t* members = malloc(((size_t)n + 1) * sizeof(uint32_t));
+  uint32_t* order = malloc((size_t)num_buckets * sizeof(uint32_t));
+  uint32_t* disp = calloc((size_t)num_buckets, sizeof(uint32_t));
+  uint32_t* slot_of = malloc(((size_t)n + 1) * sizeof(uint32_t));
+  uint8_t* taken = calloc((size_t)n + 1, 1);
+  uint8_t* ctrl = malloc((size_t)n + 1);
+  ht_item* items = malloc(((size_t)n + 1) * sizeof(ht_item));
+  int ok = (hashes != NULL) && (bucket_of != NULL) && (start != NULL) && (members != NULL) &&
+           (order != NULL) && (disp != NULL) && (slot_of != NULL) && (taken != NULL) &&
+           (ctrl != NULL) && (items != NULL);
+
+  // the items in slot order, and the keys of each bucket (start[] is the prefix sum)
+  uint32_t count = 0;
+  uint32_t max_bucket = 0;
+  for (int i = 0; ok && (i < ht->size); i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+      hashes[count] = ht->items[i].hash;
+      bucket_of[count] = ht_mph_bucket(hashes[count], num_buckets);
+      start[bucket_of[count] + 1]++;
+      slot_of[count++] = (uint32_t)i;
+    }
+  }
+  for (uint32_t b = 0; ok && (b < num_buckets); b++) {
+    max_bucket = (start[b + 1] > max_bucket) ? start[b + 1] : max_bucket;
+    start[b + 1] += start[b];
+  }
+  if (ok) {
+    uint32_t* fill = order;     // borrowed as the fill pointers of the buckets
+    memcpy(fill, start, (size_t)num_buckets * sizeof(uint32_t));
+    for (uint32_t k = 0; k < n; k++) {
+      members[fill[bucket_of[k]]++] = k;
+    }
+    // buckets from the biggest to the smallest (a counting sort by size)
+    uint32_t* by_size = calloc((size_t)max_bucket + 2, sizeof(uint32_t));
+    ok = (by_size != NULL);
+    for (uint32_t b = 0; ok && (b < num_buckets); b++) {
+      by_size[max_bucket - (start[b + 1] - start[b]) + 1]++;
+    }
+    for (uint32_t size = 0; ok && (size <= max_bucket); size++) {
+      by_size[size + 1] += by_size[size];
+    }
+    for (uint32_t b = 0; ok && (b < num_buckets); b++) {
+      order[by_size[max_bucket - (start[b + 1] - start[b])]++] = b;
+    }
+    free(by_size);
+  }
+
+  // find a displacement for each bucket, the last few buckets of 1 key have to
+  // find one of the last free slots so allow about 64 tries per slot
+  const uint64_t max_tries = (uint64_t)n * 64 + 1024;
+  for (uint32_t o = 0; ok && (o < num_buckets); o++) {
+    const uint32_t b = order[o];
+    const uint32_t first = start[b];
+    const uint32_t len = start[b + 1] - start[b];
+    if (len == 0) {
+      break;
+    }
+    for (uint32_t i = first; ok && (i < first + len); i++) {
+      for (uint32_t j = first; j < i; j++) {
+        ok = ok && (hashes[members[i]] != hashes[members[j]]);
+      }
+    }
+    uint64_t d = 0;
+    for (; ok && (d < max_tries) && (d <= UINT32_MAX); d++) {
+      uint32_t placed = 0;
+      while (placed < len) {
+        const uint32_t slot = ht_mph_slot(hashes[members[first + placed]], (uint32_t)d, n);
+        if (taken[slot]) {
+          break;
+        }
+        taken[slot] = 1;
+        placed++;
+      }
+      if (placed == len) {
+        break;
+      }
+      // undo this displacement's slots
+      while (placed-- > 0) {
+        taken[ht_mph_slot(hashes[members[first + placed]], (uint32_t)d, n)] = 0;
+      }
+    }
+    ok = ok && (d < max_tries) && (d <= UINT32_MAX);
+    disp[b] = (uint32_t)d;
+  }
+
+  if (!ok) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_freeze()): Could not build the perfect hash\n");
+		#endif
+    free(disp);
+    free(ctrl);
+    free(items);
+  }
+  else {
+    // move the items to their slots, nothing is copied but the slot itself
+    for (uint32_t k = 0; k < n; k++) {
+      const uint32_t slot = ht_mph_slot(hashes[k], disp[bucket_of[k]], n);
+      items[slot] = ht->items[slot_of[k]];
+      ctrl[slot] = HT_CTRL_TAG(hashes[k]);
+    }
+    free(ht->ctrl);
+    free(ht->items);
+    ht->ctrl = ctrl;
+    ht->items = items;
+    ht->size = (int)n;
+    ht->max_psl = 0;
+    ht->frozen_disp = disp;
+    ht->frozen_buckets = num_buckets;
+  }
+  free(hashes);
+  free(bucket_of);
+  free(start);
+  free(members);
+  free(order);
+  free(slot_of);
+  free(taken);
+  return ok ? 0 : -1;
+}
+
+
+/**
+ * ht_write_mph_tables() - writes a frozen table's perfect hash as C source
+ *
+ * For a fixed set of keys (ex: the NUM_TEAMS teams) the perfect hash can be
+ * built once at build time and compiled in.  This writes, for the given prefix:
+ *
+ *  - <PREFIX>_NUM_KEYS and <PREFIX>_NUM_BUCKETS
+ *  - <prefix>_disp[], the displacement of each bucket
+ *  - <prefix>_fingerprints[], the 64-bit hash of the key in each slot
+ *  - <prefix>_keys[], the key in each slot (strings, or ht_packed_key for a
+ *    packed table)
+ *  - static inline int <prefix>_lookup(key), the slot of key or -1
+ *
+ * Slot i holds the same item as ht->items[i], so the caller can write its
+ * values in slot order next to these.  The caller writes the include guard and
+ * includes hash_table.h (for the hash functions and ht_mph_slot()) and, for a
+ * case-insensitive table, <ctype.h>.
+ *
+ * @param ht is a table frozen with ht_freeze()
+ * @param fp is the file to write to
+ * @param prefix is the prefix of the names, a C identifier in lower case
+ *
+ * @return 0 on success, -1 if the table isn't frozen or the file could not be written
+ */
+int ht_write_mph_tables(const ht_hash_table* ht, FILE* fp, const char* prefix) {
+  char upper[64];
+  size_t len = strlen(prefix);
+
+  if ((ht->frozen_disp == NULL) || (len == 0) || (len >= sizeof(upper))) {
+    return -1;
+  }
+  for (size_t i = 0; i <= len; i++) {
+    upper[i] = ((prefix[i] >= 'a') && (prefix[i] <= 'z')) ? (char)(prefix[i] - 'a' + 'A') : prefix[i];
+  }
+
+  const char* hash_fn = (ht->key_mode == HT_KEY_PACKED) ? "ht_hash_packed" :
+                        (ht->key_mode == HT_KEY_NOCASE) ? "ht_hash_nocase" : "ht_hash_string";
+  fprintf(fp, "// minimal perfect hash of %d keys, hashed with %s() (hash seed 0x%016llxULL)\n",
+          ht->count, hash_fn, (unsigned long long)HT_HASH_SEED);
+  fprintf(fp, "#define %s_NUM_KEYS %d\n", upper, ht->count);
+  fprintf(fp, "#define %s_NUM_BUCKETS %u\n\n", upper, ht->frozen_buckets);
+
+  fprintf(fp, "static const uint32_t %s_disp[%u] = {", prefix, ht->frozen_buckets);
+  for (uint32_t b = 0; b < ht->frozen_buckets; b++) {
+    fprintf(fp, "%s%u", ((b % 12) == 0) ? "\n  " : " ", ht->frozen_disp[b]);
+    fputc((b + 1 < ht->frozen_buckets) ? ',' : '\n', fp);
+  }
+  fprintf(fp, "};\n\nstatic const uint64_t %s_fingerprints[%d] = {", prefix, (ht->count > 0) ? ht->count : 1);
+  for (int i = 0; i < ht->count; i++) {
+    fprintf(fp, "%s0x%016llxULL", ((i % 4) == 0) ? "\n  " : " ", (unsigned long long)ht->items[i].hash);
+    fputc((i + 1 < ht->count) ? ',' : '\n', fp);
+  }
+  fprintf(fp, "};\n\nstatic const %s %s_keys[%d] = {",
+          (ht->key_mode == HT_KEY_PACKED) ? "ht_packed_key" : "char* const", prefix,
+          (ht->count > 0) ? ht->count : 1);
+  for (int i = 0; i < ht->count; i++) {
+    fputs("\n  ", fp);
+    ht_write_c_key(fp, &ht->items[i], ht->key_mode);
+    fputc((i + 1 < ht->count) ? ',' : '\n', fp);
+  }
+  fputs("};\n\n", fp);
+
+  // the lookup function checks the one slot the key can be in
+  if (ht->key_mode == HT_KEY_PACKED) {
+    fprintf(fp, "static inline int %s_lookup(const ht_packed_key* key) {\n", prefix);
+  }
+  else {
+    fprintf(fp, "static inline int %s_lookup(const char* key) {\n", prefix);
+  }
+  fprintf(fp, "  const uint64_t hash = %s(key);\n", hash_fn);
+  fprintf(fp, "  const uint32_t slot = ht_mph_slot(hash, %s_disp[ht_mph_bucket(hash, %s_NUM_BUCKETS)], %s_NUM_KEYS);\n",
+          prefix, upper, upper);
+  fprintf(fp, "  if ((%s_NUM_KEYS == 0) || (%s_fingerprints[slot] != hash)) {\n    return -1;\n  }\n",
+          upper, prefix);
+  if (ht->key_mode == HT_KEY_PACKED) {
+    fprintf(fp, "  return (memcmp(&%s_keys[slot], key, sizeof(ht_packed_key)) == 0) ? (int)slot : -1;\n", prefix);
+  }
+  else if (ht->key_mode == HT_KEY_NOCASE) {
+    fprintf(fp, "  const char* k = %s_keys[slot];\n", prefix);
+    fputs("  while ((*k != '\\0') && (*k == (char)toupper((unsigned char)*key))) {\n"
+          "    k++;\n    key++;\n  }\n"
+          "  return (*k == *key) ? (int)slot : -1;\n", fp);
+  }
+  else {
+    fprintf(fp, "  return (strcmp(%s_keys[slot], key) == 0) ? (int)slot : -1;\n", prefix);
+  }
+  fputs("}\n", fp);
+  return ferror(fp) ? -1 : 0;
+}
+
+
+/**
+ * ht_new_item() - fills in a slot of the hash table
+ *
+ * Saves a copy of the key and the key:value pair in the slot.  A string key
+ * of up to HT_INLINE_KEY_LEN characters is copied into the slot itself, a
+ * longer one into the table's arena if it has one (see ht_item_key()).  The control byte for the slot
+ * is set by the caller.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param i is a pointer to the slot
+ * @param k is the key for the element, a string, an ht_nocase_key or an ht_packed_key
+ * @param v is a pointer to a team Info record
+ * @param hash is the hash of k from ht_hash_string()
+ *
+ * @return 0 if the item was stored, -1 if there wasn't memory for the key
+ *
+ * @note The function is declared `static` because it will only be called by code internal to the hash table.
+ */
+static int ht_new_item(ht_hash_table* ht, ht_item* i, const void* k, void*  v, const uint64_t hash) {
+  i->value = v;
+  i->hash = hash;
+  if (ht->key_mode == HT_KEY_PACKED) {
+    i->key.packed = *(const ht_packed_key*)k;
+    return 0;
+  }
+
+  if (ht->key_mode == HT_KEY_NOCASE) {
+    // an uppercased copy padded with zeros to a whole number of words
+    const ht_nocase_key* nocase = k;
+    const size_t size = ht_nocase_size(nocase->len);
+    char* d = i->key.inl;
+    if (nocase->len > HT_INLINE_KEY_LEN) {
+      d = (ht->arena != NULL) ? arena_alloc(ht->arena, size) : malloc(size);
+      if (d == NULL) {
+        return -1;
+      }
+    }
+    else {
+      memset(d, 0, sizeof(i->key.inl));
+    }
+    memset(d + size - sizeof(uint64_t), 0, sizeof(uint64_t));
+    memcpy(d, nocase->str, nocase->len);
+    for (size_t n = 0; n < size; n += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, d + n, sizeof(word));
+      word = ht_fold_word(word);
+      memcpy(d + n, &word, sizeof(word));
+    }
+    if (d != i->key.inl) {
+      i->key.str = d;
+      i->key.inl[HT_INLINE_KEY_LEN] = (char)HT_KEY_HEAP;
+    }
+    return 0;
+  }
+
+  const size_t len = strlen(k) + 1;
+  if (len <= HT_INLINE_KEY_LEN + 1) {
+    memset(i->key.inl, 0, sizeof(i->key.inl));
+    memcpy(i->key.inl, k, len);
+    return 0;
+  }
+
+	// alas, if only there was a strdup() function in the string library..do this instead
+	char* d = (ht->arena != NULL) ? arena_alloc(ht->arena, len) : malloc(len);
+	if (d == NULL) {
+		#if (_DEBUG_ > 0)
+		fprintf(stderr,
+			"ERROR (ht_new_item()):  Could not allocate a new key\n");
+		#endif
+		return -1;
+	}
+	i->key.str = memcpy(d, k, len);
+	i->key.inl[HT_INLINE_KEY_LEN] = (char)HT_KEY_HEAP;
+  return 0;
+}
+
+
+/**
+ * ht_heap_key() - the copy of a slot's key that the table allocated
+ *
+ * @param ht is a pointer to the Hash table
+ * @param i is a pointer to the slot
+ *
+ * @return the copy to free or NULL if the key is in the slot itself
+ */
+static char* ht_heap_key(const ht_hash_table* ht, ht_item* i) {
+  if ((ht->key_mode == HT_KEY_PACKED) || ((uint8_t)i->key.inl[HT_INLINE_KEY_LEN] != HT_KEY_HEAP)) {
+    return NULL;
+  }
+  return i->key.str;
+}
+
+
+
+/**
+ * ht_del_item() - deletes an element from the hash table
+ *
+ * Deletes the specified element from the hash table.  Frees up the memory
+ * for the key (unless it is inline) and the value (back to the table's arena if
+ * it has one).  The slot itself belongs to the table.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param	i is a pointer to the ht_item that should be deleted
+ *
+ * @note The function is declared `static` because it will only be called by code internal to the hash table
+ */
+static void ht_del_item(ht_hash_table* ht, ht_item* i) {
+  char* key = ht_heap_key(ht, i);
+  if (ht->arena != NULL) {
+    arena_free(ht->arena, key);
+    arena_free(ht->arena, i->value);
+  }
+  else {
+    free(key);
+    free(i->value);
+  }
+}
+
+
+/**
+ * ht_key_equal() - compares the key in a slot with a key
+ *
+ * @param item is the slot
+ * @param key is a string, an ht_nocase_key or an ht_packed_key
+ * @param key_mode is the table's key mode
+ *
+ * @return 1 if the keys are the same, 0 if they aren't
+ */
+static int ht_key_equal(const ht_item* item, const void* key, const int key_mode) {
+  if (key_mode == HT_KEY_PACKED) {
+    return ht_packed_equal(&item->key.packed, key);
+  }
+  if (key_mode == HT_KEY_NOCASE) {
+    return ht_nocase_equal(ht_item_key(item), key);
+  }
+  return strcmp(ht_item_key(item), key) == 0;
+}
+
+
+/**
+ * ht_nocase_equal() - compares a key with a key of a case-insensitive table
+ *
+ * The table's copy of the key is uppercase and padded with zeros to a whole
+ * number of words (see ht_nocase_size()), so it is read a word at a time.  The
+ * other key is read a word at a time up to its length and folded with
+ * ht_fold_word().  The last word of the copy must match the folded tail of the
+ * key followed by zeros, which also checks that the copy isn't longer.
+ *
+ * @param folded is the table's copy of the key
+ * @param key is the key to compare it with
+ *
+ * @return 1 if the keys are the same apart from case, 0 if they aren't
+ */
+static int ht_nocase_equal(const char* folded, const ht_nocase_key* key) {
+  const char* s = key->str;
+  size_t len = key->len;
+  uint64_t a, b;
+
+  while (len >= sizeof(uint64_t)) {
+    memcpy(&a, folded, sizeof(a));
+    memcpy(&b, s, sizeof(b));
+    if (a != ht_fold_word(b)) {
+      return 0;
+    }
+    folded += sizeof(uint64_t);
+    s += sizeof(uint64_t);
+    len -= sizeof(uint64_t);
+  }
+  b = 0;
+  memcpy(&a, folded, sizeof(a));
+  memcpy(&b, s, len);
+  return a == ht_fold_word(b);
+}
+
+
+/**
+ * ht_nocase_size() - size of a key's copy in a case-insensitive table
+ *
+ * The copy has room for the '\0' and is rounded up to a whole number of
+ * words, so ht_nocase_equal() never reads past it.
+ *
+ * @param len is the length of the key
+ *
+ * @return the size of the copy in bytes
+ */
+static size_t ht_nocase_size(const size_t len) {
+  return (len + sizeof(uint64_t)) & ~(sizeof(uint64_t) - 1);
+}
+
+
+/**
+ * ht_fold_word() - ASCII uppercases 8 characters at once
+ *
+ * For each byte the low 7 bits are offset so that the top bit of the byte is
+ * set when it is >= 'a' and, separately, when it is > 'z'.  Bytes that are in
+ * range and were ASCII to begin with get 0x20 subtracted.  No carry crosses a
+ * byte, so the result is the same as toupper() in the C locale on each byte.
+ *
+ * @param word is 8 characters
+ *
+ * @return the characters with a-z changed to A-Z
+ */
+static inline uint64_t ht_fold_word(const uint64_t word) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t low7 = word & (0x7F * ones);
+  const uint64_t ge_a = low7 + (0x80 - 'a') * ones;
+  const uint64_t gt_z = low7 + (0x80 - 'z' - 1) * ones;
+  const uint64_t lower = ge_a & ~gt_z & ~word & (0x80 * ones);
+  return word ^ (lower >> 2);
+}
+
+
+/**
+ * ht_hash_string() -  Hash function for the keys
+ *
+ * Produces a 64-bit hash of a character string in a single pass.  The string is
+ * consumed 8 bytes at a time; each word is xor'ed into the hash, which is then
+ * multiplied by a large odd constant and folded with a shift (multiply-xorshift).
+ * A final avalanche step mixes the high and low halves so that both the slot
+ * index (low bits) and the control byte tag (top 7 bits) can be taken from the
+ * one hash value.
+ *
+ * @param s is the key for the hash table element
+ *
+ * @return the 64-bit hash of the key.  It is computed once per operation and saved
+ * in the ht_item.
+ */
+uint64_t ht_hash_string(const char* s) {
+  return ht_hash_bytes(s, strlen(s), 0);
+}
+
+
+/**
+ * ht_hash_nocase() - Hash function for the keys of a case-insensitive table
+ *
+ * Same as ht_hash_string() on the uppercased key, but each word is folded with
+ * ht_fold_word() as it is read, so no uppercased copy is made.
+ *
+ * @param s is the key for the hash table element
+ *
+ * @return the 64-bit hash of the key
+ */
+uint64_t ht_hash_nocase(const char* s) {
+  return ht_hash_bytes(s, strlen(s), 1);
+}
+
+
+/**
+ * ht_hash_bytes() - hashes len characters, see ht_hash_string()
+ *
+ * @param s is the key
+ * @param len is the length of the key
+ * @param fold folds each word to uppercase before it is mixed in.  It is a
+ * constant in every caller so the compiler drops the test
+ *
+ * @return the 64-bit hash of the key
+ */
+static inline uint64_t ht_hash_bytes(const char* s, size_t len, const int fold) {
+  uint64_t hash = HT_HASH_SEED ^ ((uint64_t)len * 0xFF51AFD7ED558CCDULL);
+  uint64_t word;
+
+  while (len >= sizeof(word)) {
+    memcpy(&word, s, sizeof(word));     // memcpy() handles keys that aren't aligned
+    hash = (hash ^ (fold ? ht_fold_word(word) : word)) * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+    s += sizeof(word);
+    len -= sizeof(word);
+  }
+  if (len > 0) {
+    word = 0;
+    memcpy(&word, s, len);
+    hash = (hash ^ (fold ? ht_fold_word(word) : word)) * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+  }
+
+  // final avalanche (from MurmurHash3's fmix64)
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+
+/**
+ * ht_group_match() - finds the slots in a group with a given control byte
+ *
+ * Compares HT_GROUP_WIDTH control bytes at once.  With SSE2 this is one 16-byte
+ * compare and a movemask, otherwise a plain loop.
+ *
+ * @param group is a pointer to the first control byte of the group
+ * @param tag is the control byte to look for
+ *
+ * @return a bitmask with bit i set if control byte i of the group equals tag
+ */
+static ht_bitmask ht_group_match(const uint8_t* group, const uint8_t tag) {
+#if defined(__SSE2__)
+  const __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (ht_bitmask)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+#else
+  ht_bitmask mask = 0;
+  for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+    mask |= (ht_bitmask)(group[i] == tag) << i;
+  }
+  return mask;
+#endif
+}
+
+static ht_bitmask ht_group_match_empty(const uint8_t* group) {
+  return ht_group_match(group, HT_CTRL_EMPTY);
+}
+
+
+/**
+ * ht_set_ctrl() - sets the control byte for a slot
+ *
+ * The first HT_GROUP_WIDTH - 1 control bytes are mirrored after the end of the
+ * array so they have to be updated in both places.
+ *
+ * @param ctrl is the control byte array
+ * @param size is the number of slots in the table
+ * @param index is the slot whose control byte is set
+ * @param c is the new control byte
+ */
+static void ht_set_ctrl(uint8_t* ctrl, const int size, const int index, const uint8_t c) {
+  ctrl[index] = c;
+  if (index < HT_GROUP_WIDTH - 1) {
+    ctrl[size + index] = c;
+  }
+}
+
+
+/**
+ * ht_alloc_slots() - allocates the control bytes and slots for a table
+ *
+ * @param size is the number of slots (a power of two >= HT_GROUP_WIDTH)
+ * @param ctrl is set to the control byte array, with every slot empty
+ * @param items is set to the array of slots
+ *
+ * @return 0 on success, -1 if the memory could not be allocated
+ */
+static int ht_alloc_slots(const int size, uint8_t** ctrl, ht_item** items) {
+  *ctrl = malloc((size_t)size + HT_GROUP_WIDTH - 1);
+  *items = malloc((size_t)size * sizeof(ht_item));
+  if ((*ctrl == NULL) || (*items == NULL)) {
+    free(*ctrl);
+    free(*items);
+    return -1;
+  }
+  memset(*ctrl, HT_CTRL_EMPTY, (size_t)size + HT_GROUP_WIDTH - 1);
+  return 0;
+}
+
+
+/**
+ * ht_find_index() - finds the slot that holds a key
+ *
+ * Follows the probe sequence for the key one group at a time.  Only the slots whose
+ * control byte matches the key's tag are looked at, and their saved hash is compared
+ * first so the keys are only compared when the hashes match.  The search ends at the
+ * first group that has an empty slot or once max_psl slots past pos have been
+ * checked.
+ *
+ * @param ctrl is the control byte array of the slots to search
+ * @param items is the array of slots to search
+ * @param size is the number of slots in items
+ * @param max_psl is the longest probe sequence length of any item in items
+ * @param pos is the slot to start at (normally the key's home slot)
+ * @param key is the key to look for
+ * @param hash is the hash of key from ht_hash_string()
+ * @param key_mode is the table's key mode (what kind of key `key` is)
+ *
+ * @return the index of the slot holding key or -1 if key is not in items
+ */
+static int ht_find_index(const uint8_t* ctrl, const ht_item* items, const int size,
+                         const int max_psl, int pos, const void* key, const uint64_t hash,
+                         const int key_mode) {
+  const int mask = size - 1;
+  const uint8_t tag = HT_CTRL_TAG(hash);
+
+  for (int probed = 0; probed <= max_psl; probed += HT_GROUP_WIDTH) {
+    const uint8_t* group = ctrl + pos;
+    ht_bitmask match = ht_group_match(group, tag);
+    while (match != 0) {
+      const int index = (pos + __builtin_ctz(match)) & mask;
+      if ((items[index].hash == hash) && ht_key_equal(&items[index], key, key_mode)) {
+        return index;
+      }
+      match &= match - 1;
+    }
+    if (ht_group_match_empty(group) != 0) {
+      break;
+    }
+    pos = (pos + HT_GROUP_WIDTH) & mask;
+  }
+  return -1;
+}
+
+
+/**
+ * ht_prefetch_block() - hashes a block of keys and prefetches their home slots
+ *
+ * @param ht is a pointer to the Hash table
+ * @param keys is the block of keys (char* or ht_packed_key, see ht_batch_key())
+ * @param n is the number of keys in the block (at most HT_BATCH_SIZE)
+ * @param hashes is set to the hashes of the keys
+ */
+static void ht_prefetch_block(const ht_hash_table* ht, const void* keys, const int n,
+                              uint64_t* hashes) {
+  const uint64_t mask = (uint64_t)(ht->size - 1);
+
+  for (int i = 0; i < n; i++) {
+    hashes[i] = (ht->key_mode == HT_KEY_PACKED) ? ht_hash_packed(ht_batch_key(ht, keys, i)) :
+                ht_hash_string(ht_batch_key(ht, keys, i));
+    if (ht->filter != NULL) {
+      HT_PREFETCH(ht->filter + (((hashes[i] >> 32) * ht->filter_blocks) >> 32) * HT_FILTER_WORDS);
+    }
+    HT_PREFETCH(ht->ctrl + (hashes[i] & mask));
+    HT_PREFETCH(ht->items + (hashes[i] & mask));
+  }
+}
+
+
+/**
+ * ht_notify() - tells the table's observers that a value was added or removed
+ *
+ * @param ht is a pointer to the Hash table
+ * @param value is the value (ignored if NULL)
+ * @param event is HT_VALUE_ADDED, HT_VALUE_REMOVED or HT_VALUE_DELETED
+ */
+static inline void ht_notify(ht_hash_table* ht, void* value, const int event) {
+  if (value == NULL) {
+    return;
+  }
+  for (int i = 0; i < ht->num_observers; i++) {
+    ht->observers[i].fn(ht->observers[i].ctx, value, event);
+  }
+}
+
+
+/**
+ * ht_batch_key() - gets a key from the keys passed to ht_search_batch_keys()
+ *
+ * @param ht is a pointer to the Hash table
+ * @param keys is an array of char* (string keys) or of ht_packed_key (packed keys)
+ * @param i is the index of the key
+ *
+ * @return the string or a pointer to the packed key
+ */
+static inline const void* ht_batch_key(const ht_hash_table* ht, const void* keys, const int i) {
+  if (ht->key_mode == HT_KEY_PACKED) {
+    return &((const ht_packed_key*)keys)[i];
+  }
+  return ((const char* const*)keys)[i];
+}
+
+
+/**
+ * ht_find_new() - finds the slot that holds a key in the (new) array of slots
+ *
+ * @param ht is a pointer to the Hash table
+ * @param key is the key to look for
+ * @param hash is the hash of key from ht_hash_string()
+ *
+ * @return the index of the slot in ht->items or -1 if key is not there
+ */
+static int ht_find_new(const ht_hash_table* ht, const void* key, const uint64_t hash) {
+  return ht_find_index(ht->ctrl, ht->items, ht->size, ht->max_psl,
+                       (int)(hash & (uint64_t)(ht->size - 1)), key, hash, ht->key_mode);
+}
+
+
+/**
+ * ht_find_old() - finds the slot that holds a key in the array being rehashed
+ *
+ * The rehash empties the old slots in order starting at `rehash_start`.  If the
+ * key's home slot has already been emptied, any of its chain that is left starts
+ * at the next slot to be migrated, so the search starts there instead.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param key is the key to look for
+ * @param hash is the hash of key from ht_hash_string()
+ *
+ * @return the index of the slot in ht->old_items or -1 if key is not there (or
+ * no rehash is in progress)
+ */
+static int ht_find_old(const ht_hash_table* ht, const void* key, const uint64_t hash) {
+  if (ht->old_items == NULL) {
+    return -1;
+  }
+
+  const int mask = ht->old_size - 1;
+  int pos = (int)(hash & (uint64_t)mask);
+  if (((pos - ht->rehash_start) & mask) < ht->rehash_pos) {
+    pos = (ht->rehash_start + ht->rehash_pos) & mask;
+  }
+  return ht_find_index(ht->old_ctrl, ht->old_items, ht->old_size, ht->old_max_psl,
+                       pos, key, hash, ht->key_mode);
+}
+
+
+/**
+ * ht_place() - stores an item using Robin Hood probing
+ *
+ * Walks forward from the item's home slot.  The item goes into the first empty
+ * slot, unless it first meets an item that is closer to its own home slot than the
+ * new item is to its home.  In that case the new item takes the slot and the
+ * displaced item carries on looking for a slot further along.  The caller must
+ * already know that the key is not in the table.
+ *
+ * @param ctrl is the control byte array
+ * @param items is the array of slots
+ * @param size is the number of slots
+ * @param max_psl is updated with the longest probe sequence length that results
+ * @param item is the item to store
+ *
+ * @return the index of the slot the item was stored in or -1 if the table is full
+ */
+static int ht_place(uint8_t* ctrl, ht_item* items, const int size, int* max_psl, ht_item item) {
+  const int mask = size - 1;
+  int index = (int)(item.hash & (uint64_t)mask);
+  int placed = -1;
+  int psl = 0;
+
+  for (int probed = 0; probed < size; probed++) {
+    if (!HT_CTRL_IS_FULL(ctrl[index])) {
+      items[index] = item;
+      ht_set_ctrl(ctrl, size, index, HT_CTRL_TAG(item.hash));
+      if (psl > *max_psl) {
+        *max_psl = psl;
+      }
+      return (placed < 0) ? index : placed;
+    }
+
+    const int resident_psl = (index - (int)(items[index].hash & (uint64_t)mask)) & mask;
+    if (resident_psl < psl) {
+      // take from the rich (close to home) and give to the poor
+      ht_item displaced = items[index];
+      items[index] = item;
+      ht_set_ctrl(ctrl, size, index, HT_CTRL_TAG(item.hash));
+      if (psl > *max_psl) {
+        *max_psl = psl;
+      }
+      if (placed < 0) {
+        placed = index;
+      }
+      item = displaced;
+      psl = resident_psl;
+    }
+    index = (index + 1) & mask;
+    psl++;
+  }
+
+	#if (_DEBUG_ > 0)
+		fprintf(stderr,
+			"ERROR(ht_place()): No free slot for hash %016llx\n", (unsigned long long)item.hash);
+	#endif
+  return -1;
+}
+
+
+/**
+ * ht_backward_shift() - removes an item by shifting the rest of its chain back
+ *
+ * Every item after the removed one is moved back one slot until we reach an empty
+ * slot or an item that is already in its home slot.  This never moves an item in
+ * front of its home slot and leaves no tombstones.  The caller frees the item's
+ * key and value first.
+ *
+ * @param ctrl is the control byte array
+ * @param items is the array of slots
+ * @param size is the number of slots
+ * @param index is the slot to remove
+ */
+static void ht_backward_shift(uint8_t* ctrl, ht_item* items, const int size, int index) {
+  const int mask = size - 1;
+  int next = (index + 1) & mask;
+
+  while (HT_CTRL_IS_FULL(ctrl[next]) &&
+         (((next - (int)(items[next].hash & (uint64_t)mask)) & mask) != 0)) {
+    items[index] = items[next];
+    ht_set_ctrl(ctrl, size, index, ctrl[next]);
+    index = next;
+    next = (next + 1) & mask;
+  }
+  ht_set_ctrl(ctrl, size, index, HT_CTRL_EMPTY);
+}
+
+
+/**
+ * ht_start_resize() - starts resizing the hash table
+ *
+ * Allocates the new array of slots and turns the current array into the old array
+ * that ht_rehash_step() drains a few slots at a time.  The draining starts at an
+ * empty slot so that no chain is cut in half by where the rehash starts (see
+ * ht_find_old()).  A rehash must not already be in progress.  If the new array
+ * can't be allocated the table keeps its current size.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param base_size is the new requested number of slots
+ */
+static void ht_start_resize(ht_hash_table* ht, const int base_size) {
+  const int new_base = (base_size < HT_MIN_BASE_SIZE) ? HT_MIN_BASE_SIZE : base_size;
+  int new_size = HT_GROUP_WIDTH;
+  uint8_t* new_ctrl;
+  ht_item* new_items;
+
+  while (new_size < new_base) {
+    new_size *= 2;
+  }
+  if (ht_alloc_slots(new_size, &new_ctrl, &new_items) != 0) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr,
+				"ERROR(ht_start_resize()): Could not allocate %d slots\n", new_size);
+		#endif
+    return;
+  }
+
+	#if (_DEBUG_ > 0)
+		fprintf(stderr,
+			"\tINFO(ht_start_resize()): Resizing from %d to %d slots (%d items)\n",
+			ht->size, new_size, ht->count);
+	#endif
+
+  #if (HT_STATS > 0)
+    if (new_size > ht->size) {
+      ht->grows++;
+    }
+    else {
+      ht->shrinks++;
+    }
+  #endif
+
+  ht->old_ctrl = ht->ctrl;
+  ht->old_items = ht->items;
+  ht->old_size = ht->size;
+  ht->old_count = ht->count;
+  ht->old_max_psl = ht->max_psl;
+  ht->rehash_start = 0;
+  while (HT_CTRL_IS_FULL(ht->old_ctrl[ht->rehash_start])) {
+    ht->rehash_start++;
+  }
+  ht->rehash_pos = 0;
+
+  ht->base_size = new_base;
+  ht->ctrl = new_ctrl;
+  ht->items = new_items;
+  ht->size = new_size;
+  ht->max_psl = 0;
+}
+
+
+/**
+ * ht_rehash_step() - migrates some slots from the old array
+ *
+ * Moves the live items in the next num_slots slots of the old array into the
+ * new array.  Only the slot is copied, the key and value stay where they are.
+ * A migrated slot is simply emptied: the search in the old array skips over the
+ * slots that have already been migrated (see ht_find_old()).  Once every item
+ * has been migrated the old array is freed.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param num_slots is the maximum number of old slots to migrate
+ */
+static void ht_rehash_step(ht_hash_table* ht, int num_slots) {
+  if (ht->old_items == NULL) {
+    return;
+  }
+
+  const int mask = ht->old_size - 1;
+  while ((num_slots-- > 0) && (ht->old_count > 0) && (ht->rehash_pos < ht->old_size)) {
+    const int pos = (ht->rehash_start + ht->rehash_pos) & mask;
+    if (HT_CTRL_IS_FULL(ht->old_ctrl[pos])) {
+      ht_place(ht->ctrl, ht->items, ht->size, &ht->max_psl, ht->old_items[pos]);
+      ht_set_ctrl(ht->old_ctrl, ht->old_size, pos, HT_CTRL_EMPTY);
+      ht->old_count--;
+    }
+    ht->rehash_pos++;
+  }
+
+  if ((ht->old_count == 0) || (ht->rehash_pos >= ht->old_size)) {
+    free(ht->old_ctrl);
+    free(ht->old_items);
+    ht->old_ctrl = NULL;
+    ht->old_items = NULL;
+    ht->old_size = 0;
+    ht->old_count = 0;
+    ht->old_max_psl = 0;
+    ht->rehash_start = 0;
+    ht->rehash_pos = 0;
+  }
+}
+
+
+/**
+ * ht_snapshot_search() - searches a table opened with ht_open_snapshot()
+ *
+ * The same probing as ht_find_index(), but the slots hold offsets into the
+ * mapping.  Offsets are range checked so a damaged file can't make us read
+ * outside of the mapping.
+ *
+ * @param ht is a pointer to the snapshot table
+ * @param key is the key to look for (a string or an ht_packed_key)
+ * @param hash is the hash of key
+ *
+ * @return a pointer to the value in the mapping or NULL if key is not in the table
+ */
+static void* ht_snapshot_search(ht_hash_table* ht, const void* key, const uint64_t hash) {
+  if (ht_filter_rejects(ht, hash)) {
+    return NULL;
+  }
+  const ht_snapshot_header* header = ht->snapshot;
+  const char* base = ht->snapshot;
+  const ht_snapshot_slot* slots = (const ht_snapshot_slot*)(base + header->slots_offset);
+  const char* strings = base + header->strings_offset;
+  const uint64_t key_size = (ht->key_mode == HT_KEY_PACKED) ? sizeof(ht_packed_key) :
+                            (ht->key_mode == HT_KEY_NOCASE) ?
+                            ht_nocase_size(((const ht_nocase_key*)key)->len) : 1;
+  const int mask = ht->size - 1;
+  const uint8_t tag = HT_CTRL_TAG(hash);
+  int pos = (int)(hash & (uint64_t)mask);
+
+  for (int probed = 0; probed <= ht->max_psl; probed += HT_GROUP_WIDTH) {
+    const uint8_t* group = ht->ctrl + pos;
+    ht_bitmask match = ht_group_match(group, tag);
+    while (match != 0) {
+      const ht_snapshot_slot* slot = &slots[(pos + __builtin_ctz(match)) & mask];
+      if ((slot->hash == hash) && ((uint64_t)slot->key + key_size <= header->strings_size) &&
+          ((ht->key_mode == HT_KEY_PACKED) ? (memcmp(strings + slot->key, key, sizeof(ht_packed_key)) == 0) :
+           (ht->key_mode == HT_KEY_NOCASE) ? ht_nocase_equal(strings + slot->key, key) :
+                                             (strcmp(strings + slot->key, key) == 0))) {
+        if (slot->value >= header->num_values) {
+          return NULL;
+        }
+        return (void*)(base + header->values_offset + (uint64_t)slot->value * header->value_size);
+      }
+      match &= match - 1;
+    }
+    if (ht_group_match_empty(group) != 0) {
+      break;
+    }
+    pos = (pos + HT_GROUP_WIDTH) & mask;
+  }
+  #if (HT_STATS > 0)
+    ht->filter_false_positives += (ht->filter != NULL);
+  #endif
+  return NULL;
+}
+
+
+/**
+ * ht_frozen_search() - searches a table frozen with ht_freeze()
+ *
+ * The perfect hash gives the only slot the key can be in.  The item's saved
+ * hash is compared first, so a miss almost never compares keys.
+ *
+ * @param ht is a pointer to the frozen table
+ * @param key is a string, an ht_nocase_key or an ht_packed_key, depending on the
+ * table's key mode
+ * @param hash is the hash of key
+ *
+ * @return the value or NULL if the key is not in the table
+ */
+static void* ht_frozen_search(ht_hash_table* ht, const void* key, const uint64_t hash) {
+  if (ht->size == 0) {
+    return NULL;
+  }
+  const uint32_t bucket = ht_mph_bucket(hash, ht->frozen_buckets);
+  const ht_item* item = &ht->items[ht_mph_slot(hash, ht->frozen_disp[bucket], (uint32_t)ht->size)];
+  const int found = (item->hash == hash) && ht_key_equal(item, key, ht->key_mode);
+  #if (HT_STATS > 0)
+    ht->searches++;
+    if (found) {
+      ht->hit_probes[0]++;
+    }
+    else {
+      ht->miss_probes[0]++;
+      ht->filter_false_positives += (ht->filter != NULL);
+    }
+  #endif
+  return found ? item->value : NULL;
+}
+
+
+/**
+ * ht_filter_build() - (re)builds the Bloom filter, see ht_use_filter()
+ *
+ * @param ht is a pointer to the Hash table
+ * @param bits_per_key is the number of bits per key
+ *
+ * @return 0 on success, -1 if there isn't memory for the filter
+ */
+static int ht_filter_build(ht_hash_table* ht, const int bits_per_key) {
+  const int keys = (ht->count * 2 > HT_FILTER_MIN_KEYS) ? ht->count * 2 : HT_FILTER_MIN_KEYS;
+  const uint64_t blocks = ((uint64_t)keys * bits_per_key + 511) / 512;
+  void* mem = malloc((size_t)blocks * HT_FILTER_ALIGN + HT_FILTER_ALIGN - 1);
+  if (mem == NULL) {
+		#if (_DEBUG_ > 0)
+			fprintf(stderr, "ERROR(ht_use_filter()): Could not allocate the filter\n");
+		#endif
+    return -1;
+  }
+  free(ht->filter_mem);
+  ht->filter_mem = mem;
+  ht->filter = (uint64_t*)(((uintptr_t)mem + HT_FILTER_ALIGN - 1) & ~(uintptr_t)(HT_FILTER_ALIGN - 1));
+  ht->filter_blocks = (uint32_t)blocks;
+  ht->filter_bits = bits_per_key;
+  ht->filter_keys = 0;
+  ht->filter_capacity = keys;
+  memset(ht->filter, 0, (size_t)blocks * HT_FILTER_ALIGN);
+
+  // every key has its hash saved in its slot, snapshot or not
+  if (ht->snapshot != NULL) {
+    const ht_snapshot_header* header = ht->snapshot;
+    const ht_snapshot_slot* slots = (const ht_snapshot_slot*)((const char*)ht->snapshot + header->slots_offset);
+    for (int i = 0; i < ht->size; i++) {
+      if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+        ht_filter_add(ht, slots[i].hash);
+      }
+    }
+    return 0;
+  }
+  for (int i = 0; i < ht->size; i++) {
+    if (HT_CTRL_IS_FULL(ht->ctrl[i])) {
+      ht_filter_add(ht, ht->items[i].hash);
+    }
+  }
+  for (int i = 0; i < ht->old_size; i++) {
+    if (HT_CTRL_IS_FULL(ht->old_ctrl[i])) {
+      ht_filter_add(ht, ht->old_items[i].hash);
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * ht_filter_add() - sets a key's bits in the Bloom filter
+ *
+ * A filter that has had more keys added than it was sized for is rebuilt
+ * for the current count, which also drops the bits of the deleted keys.  The
+ * key being added is already in the table, so the rebuild picks it up.
+ *
+ * @param ht is a pointer to a Hash table with a filter
+ * @param hash is the hash of the key
+ */
+static void ht_filter_add(ht_hash_table* ht, const uint64_t hash) {
+  if (++ht->filter_keys > ht->filter_capacity) {
+    if (ht_filter_build(ht, ht->filter_bits) == 0) {
+      return;
+    }
+    // no memory for a bigger one: keep filling this one and try again later
+    ht->filter_capacity = ht->filter_keys * 2;
+  }
+  uint64_t* block = ht->filter + (((hash >> 32) * ht->filter_blocks) >> 32) * HT_FILTER_WORDS;
+  for (int w = 0; w < HT_FILTER_WORDS; w++) {
+    block[w] |= (uint64_t)1 << (((uint32_t)hash * ht_filter_salts[w]) >> 26);
+  }
+}
+
+
+/**
+ * ht_filter_maybe() - checks a key against the Bloom filter
+ *
+ * @param ht is a pointer to the Hash table
+ * @param hash is the hash of the key
+ *
+ * @return 0 if the key is not in the table, 1 if it may be (or there is no filter)
+ */
+static inline int ht_filter_maybe(const ht_hash_table* ht, const uint64_t hash) {
+  if (ht->filter == NULL) {
+    return 1;
+  }
+  const uint64_t* block = ht->filter + (((hash >> 32) * ht->filter_blocks) >> 32) * HT_FILTER_WORDS;
+  uint64_t missing = 0;
+  for (int w = 0; w < HT_FILTER_WORDS; w++) {
+    missing |= ~block[w] & ((uint64_t)1 << (((uint32_t)hash * ht_filter_salts[w]) >> 26));
+  }
+  return missing == 0;
+}
+
+
+/**
+ * ht_filter_rejects() - checks a key being searched for against the Bloom filter
+ *
+ * @param ht is a pointer to the Hash table
+ * @param hash is the hash of the key
+ *
+ * @return 1 if the filter says the key is not in the table (the search is over)
+ */
+static inline int ht_filter_rejects(ht_hash_table* ht, const uint64_t hash) {
+  if (ht_filter_maybe(ht, hash)) {
+    return 0;
+  }
+  #if (HT_STATS > 0)
+    ht->filter_negatives++;
+  #endif
+  return 1;
+}
+
+
+/**
+ * ht_write_c_key() - writes a key as a C initializer, see ht_write_mph_tables()
+ *
+ * @param fp is the file to write to
+ * @param item is the slot holding the key
+ * @param key_mode is the table's key mode
+ */
+static void ht_write_c_key(FILE* fp, const ht_item* item, const int key_mode) {
+  const char* s = (key_mode == HT_KEY_PACKED) ? item->key.packed.city : ht_item_key(item);
+  const int len = (key_mode == HT_KEY_PACKED) ? (item->key.packed.conf_len & 0x0F) : (int)strlen(s);
+
+  if (key_mode == HT_KEY_PACKED) {
+    fprintf(fp, "{0x%02x, ", item->key.packed.conf_len);
+  }
+  fputc('"', fp);
+  for (int i = 0; i < len; i++) {
+    const unsigned char c = (unsigned char)s[i];
+    if ((c == '"') || (c == '\\') || (c == '?')) {
+      fprintf(fp, "\\%c", c);
+    }
+    else if ((c < ' ') || (c > '~')) {
+      fprintf(fp, "\\%03o", c);
+    }
+    else {
+      fputc(c, fp);
+    }
+  }
+  fputs((key_mode == HT_KEY_PACKED) ? "\"}" : "\"", fp);
+}
+
+
+/**
+ * ht_snapshot_valid() - checks the header of a mapped snapshot file
+ *
+ * @param header is the start of the mapping
+ * @param file_size is the size of the file
+ * @param value_size is the value size the caller expects
+ *
+ * @return 1 if the file can be searched, 0 if it can't
+ */
+static int ht_snapshot_valid(const ht_snapshot_header* header, const size_t file_size,
+                             const size_t value_size) {
+  const uint64_t size = header->size;
+
+  return (file_size >= sizeof(ht_snapshot_header)) &&
+         (memcmp(header->magic, HT_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0) &&
+         (header->version == HT_SNAPSHOT_VERSION) &&
+         (header->byte_order == HT_SNAPSHOT_BYTE_ORDER) &&
+         (header->hash_seed == HT_HASH_SEED) &&
+         (header->value_size == value_size) &&
+         (header->file_size == file_size) &&
+         (header->ctrl_offset <= file_size) && (header->slots_offset <= file_size) &&
+         (header->strings_offset <= file_size) && (header->strings_size <= file_size) &&
+         (header->values_offset <= file_size) &&
+         (size >= HT_GROUP_WIDTH) && (size <= INT_MAX / 2) && ((size & (size - 1)) == 0) &&
+         (header->count <= size) && (header->max_psl < size) &&
+         (header->ctrl_offset >= sizeof(ht_snapshot_header)) &&
+         (header->slots_offset >= header->ctrl_offset + size + HT_GROUP_WIDTH - 1) &&
+         (header->strings_offset >= header->slots_offset + size * sizeof(ht_snapshot_slot)) &&
+         (header->values_offset >= header->strings_offset + header->strings_size) &&
+         (header->num_values <= header->count) &&
+         (header->file_size == header->values_offset + (uint64_t)header->num_values * value_size) &&
+         ((header->slots_offset % sizeof(uint64_t)) == 0) &&
+         ((header->key_mode == HT_KEY_STRING) || (header->key_mode == HT_KEY_NOCASE) ||
+          (header->key_mode == HT_KEY_PACKED)) &&
+         // string keys are read with strcmp(), so the pool must end with a '\0'
+         ((header->strings_size == 0) ? (header->count == 0) :
+          ((header->key_mode == HT_KEY_PACKED) ||
+           (((const char*)header)[header->strings_offset + header->strings_size - 1] == '\0')));
+}
+
+
+static uint64_t ht_snapshot_align(const uint64_t offset) {
+  return (offset + HT_SNAPSHOT_ALIGN - 1) & ~(uint64_t)(HT_SNAPSHOT_ALIGN - 1);
+}
+
+
+#if (HT_STATS > 0)
+/**
+ * ht_count_search() - counts a search in the probe length histograms
+ *
+ * A search that found its key in the old array while a rehash is in progress is
+ * counted as a miss of the new array, which is the part of it that cost the most.
+ *
+ * @param ht is a pointer to the Hash table
+ * @param hash is the hash of the key
+ * @param found_new is 1 if the key was found in the new array
+ * @param index is the slot it was found in
+ */
+static void ht_count_search(ht_hash_table* ht, const uint64_t hash, const int found_new,
+                            const int index) {
+  const int mask = ht->size - 1;
+  int probes;
+
+  ht->searches++;
+  if (found_new) {
+    probes = (int)(((uint64_t)index - hash) & (uint64_t)mask);
+    ht->hit_probes[(probes < HT_STATS_BUCKETS - 1) ? probes : HT_STATS_BUCKETS - 1]++;
+  }
+  else {
+    probes = ht_empty_distance(ht->ctrl, ht->size, ht->max_psl, (int)(hash & (uint64_t)mask));
+    ht->miss_probes[(probes < HT_STATS_BUCKETS - 1) ? probes : HT_STATS_BUCKETS - 1]++;
+  }
+}
+
+
+static int ht_empty_distance(const uint8_t* ctrl, const int size, const int max_psl, int pos) {
+  int probed;
+  for (probed = 0; probed <= max_psl; probed += HT_GROUP_WIDTH) {
+    const ht_bitmask empty = ht_group_match_empty(ctrl + pos);
+    if (empty != 0) {
+      return probed + __builtin_ctz(empty);
+    }
+    pos = (pos + HT_GROUP_WIDTH) & (size - 1);
+  }
+  return probed;
+}
+#endif
+
+
+static void ht_stats_add_psl(ht_stats* stats, const int psl, long* total_psl) {
+  stats->psl_histogram[(psl < HT_STATS_BUCKETS - 1) ? psl : HT_STATS_BUCKETS - 1]++;
+  stats->max_psl = (psl > stats->max_psl) ? psl : stats->max_psl;
+  *total_psl += psl;
 }
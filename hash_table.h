@@ -9,6 +9,12 @@
 #ifndef _HASH_TABLE_H_
 #define _HASH_TABLE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
+
 // constants
 #define NUM_MLS_EAST_TEAMS  15
 #define NUM_MLS_WEST_TEAMS  15
@@ -16,8 +22,23 @@
 #define NUM_TEAMS           (NUM_MLS_EAST_TEAMS + NUM_MLS_WEST_TEAMS + NUM_NWSL_TEAMS)
 
 #define HASH_TABLE_SIZE		(NUM_TEAMS * 2)
-#define HT_PRIME_1			151
-#define HT_PRIME_2			193
+#define HT_HASH_SEED        0x9E3779B97F4A7C15ULL   // starting value for the key hash
+
+// storage constants.  Probing looks at the control bytes of a group of
+// HT_GROUP_WIDTH slots at a time (one SSE2 register)
+#define HT_GROUP_WIDTH      16
+
+// resizing constants.  Load factors are in percent
+#define HT_MIN_BASE_SIZE    HT_GROUP_WIDTH  // never shrink below this many slots
+#define HT_GROW_LOAD        70    // start a rehash above this load factor
+#define HT_SHRINK_LOAD      10    // shrink below this load factor
+#define HT_MAX_PSL          64    // grow if an item ends up this far from its home slot
+#define HT_MPH_LAMBDA       4     // average keys per bucket of a frozen table's perfect hash
+#define HT_REHASH_STEP      8     // old slots migrated per insert/search/delete
+#define HT_BATCH_SIZE       16    // keys hashed and prefetched ahead by ht_search_batch()
+#define HT_SNAPSHOT_VERSION 1     // format of the files written by ht_save_snapshot()
+#define HT_FILTER_BITS      10    // bits per key of a Bloom filter (see ht_use_filter())
+#define HT_FILTER_MIN_KEYS  1024  // a filter is sized for at least this many keys
 
 #define MAX_CONF_NAME       10
 #define MAX_CITY_NAME       15
@@ -30,6 +51,15 @@
 // Be sure you use {} in pieces of code that make use of the approach
 #define _DEBUG_ 0		// > 0 compiles in the debug code.
 
+// Statistics constants
+// HT_STATS > 0 compiles in the search, collision and resize counters that
+// ht_get_stats() reports.  They cost a few increments per operation.  With
+// HT_STATS 0 ht_get_stats() still reports what it can work out from the slots.
+#ifndef HT_STATS
+#define HT_STATS 1
+#endif
+#define HT_STATS_BUCKETS    17    // histogram buckets: 0..15 slots and 16 or more
+
 // define conference enum
 typedef enum _conf_e {NWSL, EAST, WEST} conf_t;
 
@@ -45,38 +75,316 @@ typedef struct _TeamInfo_s {
   int     gd;
 } TeamInfo_t, *TeamInfoPtr_t;
 
-// struct containing key:value (k:v) pairs
+// key modes (see ht_set_key_mode())
+#define HT_KEY_STRING       0     // '\0' terminated strings, the table keeps a copy
+#define HT_KEY_PACKED       1     // ht_packed_key, stored in the slot itself
+#define HT_KEY_NOCASE       2     // strings, ASCII case doesn't matter
+
+#define HT_PACKED_CITY_LEN  MAX_CITY_NAME
+
+// a conference and a city packed into two 64-bit words.  conf_len has the
+// conf_t in the top 4 bits and the length of the city in the low 4 bits.  The
+// city is uppercased and padded with zeros, so two keys are equal exactly when
+// their bytes are (make them with ht_pack_key())
+typedef struct {
+  uint8_t conf_len;
+  char    city[HT_PACKED_CITY_LEN];
+} ht_packed_key;
+
+// string keys up to HT_INLINE_KEY_LEN characters are kept in the slot itself
+// (ex: PORTLANDNWSL), longer ones are copied to the heap or the arena.  The last
+// byte of the key is '\0' for an inline key and HT_KEY_HEAP for a copy
+#define HT_INLINE_KEY_LEN   15
+#define HT_KEY_HEAP         0xFF
+
+// bytes malloc() adds to every block (glibc, 64-bit), for the memory estimates
+#define HT_MALLOC_OVERHEAD  16
+
+// struct containing key:value (k:v) pairs.  This is one slot of the table.
+// The full 64-bit hash of the key is saved so probes can skip most mismatches
+// without comparing keys and so a rehash never has to scan the key again
 typedef struct ht_item {
-  char* key;
+  union {
+    char* str;                // HT_KEY_STRING: copy of the key, HT_KEY_NOCASE: uppercased copy
+    char inl[HT_INLINE_KEY_LEN + 1];  // a short key (or its uppercased copy), zero padded
+    ht_packed_key packed;     // HT_KEY_PACKED: the key itself
+  } key;
   void* value;
+  uint64_t hash;
 } ht_item;
 
+// events passed to an ht_observer (see ht_add_observer())
+#define HT_VALUE_ADDED      0   // the value is in the table, or was changed in place
+#define HT_VALUE_REMOVED    1   // the value is about to be replaced or changed
+#define HT_VALUE_DELETED    2   // the key and its value are about to be deleted
+
+// called when a value is added to or removed from a table, so a secondary index
+// over the values (ex: standings.h, prefix_index.h) can follow the table.  An
+// index can treat HT_VALUE_DELETED like HT_VALUE_REMOVED; the write-ahead log
+// (wal.h) needs to tell a delete from the first half of an update
+typedef void (*ht_observer)(void* ctx, void* value, const int event);
+
+#define HT_MAX_OBSERVERS    4
+
 // struct containing the hash table
+//
+// The slots are stored by value in one contiguous array.  Each slot has a
+// 1-byte control byte in the parallel ctrl array that says whether the slot is
+// empty or full; a full slot's control byte holds 7 bits of its hash.  ctrl has
+// size + HT_GROUP_WIDTH - 1 bytes (see hash_table.c).  Collisions are resolved
+// with Robin Hood probing, max_psl is how far the furthest item is from its
+// home slot.
+//
+// While a resize is in progress the items live in two arrays: `items` is the
+// new (resized) array and `old_items` is the array being drained.  Every
+// insert, search and delete migrates up to HT_REHASH_STEP slots from
+// `old_items` to `items` so no single call pays for the whole rehash.
 typedef struct {
-  int size;
-  int count;
-  ht_item** items;
+  int base_size;      // requested size, the table is sized to the next power of two
+  int size;           // number of slots in items
+  int count;          // number of live items (in both arrays)
+  int max_psl;        // longest probe sequence length in items
+  uint8_t* ctrl;
+  ht_item* items;
+
+  // incremental rehash state, old_items is NULL when no rehash is in progress
+  int old_size;       // number of slots in old_items
+  int old_count;      // number of live items still waiting in old_items
+  int old_max_psl;    // longest probe sequence length in old_items
+  int rehash_start;   // slot in old_items where the migration started
+  int rehash_pos;     // number of slots in old_items migrated so far
+  uint8_t* old_ctrl;
+  ht_item* old_items;
+
+  // keys and values come from the arena when there is one (see ht_use_arena())
+  arena_t* arena;
+  int key_mode;       // HT_KEY_STRING, HT_KEY_NOCASE or HT_KEY_PACKED (see ht_set_key_mode())
+
+#if (HT_STATS > 0)
+  // counters reported by ht_get_stats()
+  long searches;
+  long hit_probes[HT_STATS_BUCKETS];    // successful searches by PSL of the item found
+  long miss_probes[HT_STATS_BUCKETS];   // failed searches by slots to the first empty slot
+  long collisions;    // inserts whose home slot was already taken
+  long grows;
+  long shrinks;
+  long filter_negatives;          // searches the Bloom filter answered on its own
+  long filter_false_positives;    // searches the filter let through that missed
+#endif
+
+  // a table opened with ht_open_snapshot() is a read-only view of the mapped
+  // file: ctrl points into the mapping and items is NULL
+  const void* snapshot;     // start of the mapping, NULL for an ordinary table
+  size_t snapshot_size;
+
+  // a table frozen with ht_freeze() is read-only: items has exactly count slots
+  // (size == count, every control byte full) laid out by a minimal perfect hash
+  uint32_t* frozen_disp;    // displacement of each bucket, NULL unless frozen
+  uint32_t frozen_buckets;
+
+  // optional blocked Bloom filter over the hashes of the keys, NULL without one
+  // (see ht_use_filter()).  filter is filter_mem aligned to a cache line
+  uint64_t* filter;
+  void* filter_mem;
+  uint32_t filter_blocks;   // 64-byte blocks
+  int filter_bits;          // bits per key
+  int filter_keys;          // keys added since it was built, deleted ones included
+  int filter_capacity;      // keys it was sized for, it is rebuilt after that many
+
+  // secondary indexes told about every value added or removed
+  int num_observers;
+  struct {
+    ht_observer fn;
+    void* ctx;
+  } observers[HT_MAX_OBSERVERS];
 } ht_hash_table;
 
+// what ht_get_stats() reports.  Probe lengths are in slots past the key's
+// home slot.  The counters are only kept when HT_STATS > 0 (stats_enabled),
+// otherwise they are 0
+typedef struct {
+  int size;             // number of slots (new array while a rehash is in progress)
+  int count;            // number of items
+  double load_factor;   // items in the new array / size, what the grow check uses.  While
+                        // rehashing, the items left in the old array aren't counted
+  int tombstones;       // always 0, deletes shift items back instead
+  int max_psl;          // longest probe sequence length of any item
+  double avg_psl;       // average probe sequence length of the items
+  long psl_histogram[HT_STATS_BUCKETS];   // items by probe sequence length
+  int rehashing;        // 1 while an incremental rehash is in progress
+  int frozen;           // 1 after ht_freeze(), every item is in its home slot
+
+  int stats_enabled;    // 1 if the counters below were compiled in
+  long searches;        // ht_search() and ht_search_batch() keys
+  long hits;
+  long misses;
+  long hit_probes[HT_STATS_BUCKETS];    // successful searches by probe length
+  long miss_probes[HT_STATS_BUCKETS];   // failed searches by probe length
+  long collisions;      // inserts whose home slot was already taken
+  long resizes;         // grows + shrinks
+  long grows;
+  long shrinks;
+
+  // memory.  Values are only counted when they come from the table's arena
+  size_t table_bytes;   // the table, its control bytes and slots (or the mapped snapshot)
+  size_t key_bytes;     // copies of the keys that aren't inline, with malloc's overhead
+  size_t arena_bytes;   // keys and values allocated from the arena
+  int inline_keys;      // string keys kept in their slot
+  size_t filter_bytes;  // the Bloom filter, 0 without one
+  double bytes_per_entry;   // (table_bytes + key_bytes + arena_bytes + filter_bytes) / count
+
+  // the Bloom filter.  The rate expected from the bits that are set is always
+  // there, the counters only with HT_STATS > 0
+  double filter_fpr;            // chance that a key that isn't in the table gets through
+  long filter_negatives;        // searches answered by the filter alone
+  long filter_false_positives;  // searches the filter let through that missed
+  double filter_measured_fpr;   // false positives / (false positives + negatives)
+} ht_stats;
+
 
 // API function prototypes
 
 // creates a new hash table
 ht_hash_table* ht_new(void);
 
+// creates a new hash table with room for about base_size slots
+ht_hash_table* ht_new_sized(const int base_size);
+
 // deletes a hash table
 void ht_del_hash_table(ht_hash_table* ht);
 
+// has an (empty) hash table allocate its keys and values from an arena
+int ht_use_arena(ht_hash_table* ht, arena_t* arena);
+
+// chooses string or packed keys for an (empty) hash table
+int ht_set_key_mode(ht_hash_table* ht, const int key_mode);
+
+// builds a packed key from a conference and a city
+int ht_pack_key(ht_packed_key* key, const conf_t conf, const char* city);
+
+// allocates memory for a value that will be inserted into the hash table
+void* ht_alloc_value(ht_hash_table* ht, size_t size);
+
+// frees a value from ht_alloc_value() that was never inserted
+void ht_free_value(ht_hash_table* ht, void* value);
+
+// makes room for num_items more items without growing the table again
+void ht_reserve(ht_hash_table* ht, const int num_items);
+
 // inserts element into hash table
 void ht_insert(ht_hash_table* ht, const char* key, void* value);
 
+// inserts element whose key was already hashed with ht_hash_string() (or
+// ht_hash_nocase() for an HT_KEY_NOCASE table)
+void ht_insert_hashed(ht_hash_table* ht, const char* key, const uint64_t hash, void* value);
+
+// inserts an element or replaces its value, returns 1 if it was inserted
+int ht_upsert(ht_hash_table* ht, const char* key, void* value);
+
+// finds an element's value so it can be updated in place, inserting a zeroed
+// value of value_size bytes if the key isn't in the table
+void* ht_get_or_insert(ht_hash_table* ht, const char* key, const size_t value_size, int* inserted);
+
+// has the table report the values it adds and removes to an observer
+int ht_add_observer(ht_hash_table* ht, ht_observer observer, void* ctx);
+int ht_remove_observer(ht_hash_table* ht, ht_observer observer, void* ctx);
+
+// bracket an in-place change of a value, so its observers see the change
+void ht_begin_update(ht_hash_table* ht, void* value);
+void ht_end_update(ht_hash_table* ht, void* value);
+
+// adds (or with 0 bits, drops) a Bloom filter that answers most misses
+int ht_use_filter(ht_hash_table* ht, const int bits_per_key);
+
+// walks the items of the hash table, start with *index = 0
+ht_item* ht_next(ht_hash_table* ht, int* index);
+
 // searches for element in the hash table
 void* ht_search(ht_hash_table* ht, const char* key);
 
+// searches for many elements at once, overlapping their cache misses
+int ht_search_batch(ht_hash_table* ht, const char* const* keys, const int n, void** out_values);
+
 // deletes an element from the hash table
 void ht_delete(ht_hash_table* ht, const char* key);
 
+// insert, search and delete with packed keys (HT_KEY_PACKED tables)
+void ht_insert_packed(ht_hash_table* ht, const ht_packed_key* key, void* value);
+void* ht_search_packed(ht_hash_table* ht, const ht_packed_key* key);
+int ht_search_packed_batch(ht_hash_table* ht, const ht_packed_key* keys, const int n, void** out_values);
+void* ht_get_or_insert_packed(ht_hash_table* ht, const ht_packed_key* key, const size_t value_size,
+                              int* inserted);
+void ht_delete_packed(ht_hash_table* ht, const ht_packed_key* key);
+
+// makes the table read-only with single probe searches (minimal perfect hash)
+int ht_freeze(ht_hash_table* ht);
+
+// writes a frozen table's perfect hash as C arrays and a lookup function
+int ht_write_mph_tables(const ht_hash_table* ht, FILE* fp, const char* prefix);
+
+// writes the table to a binary snapshot file, every value is value_size bytes
+int ht_save_snapshot(ht_hash_table* ht, const char* path, const size_t value_size);
+
+// opens a snapshot file as a read-only hash table
+ht_hash_table* ht_open_snapshot(const char* path, const size_t value_size);
+
+// hash function for the keys (also used by the tables built on top of this one)
+uint64_t ht_hash_string(const char* s);
+uint64_t ht_hash_nocase(const char* s);
+uint64_t ht_hash_packed(const ht_packed_key* key);
+
+// fills in stats with the load, probe length and resize statistics of the table
+void ht_get_stats(const ht_hash_table* ht, ht_stats* stats);
+
+// zeroes the search, collision and resize counters
+void ht_reset_stats(ht_hash_table* ht);
+
 // displays the entire hash table on stdout
 void ht_dump(ht_hash_table* ht);
 
+// the key of a slot of an HT_KEY_STRING or HT_KEY_NOCASE table
+static inline const char* ht_item_key(const ht_item* item) {
+  return ((uint8_t)item->key.inl[HT_INLINE_KEY_LEN] == HT_KEY_HEAP) ? item->key.str : item->key.inl;
+}
+
+// hashes and compares packed keys.  They are inline so the type-specialized
+// tables of ht_template.h get them inlined too (ht_hash_packed() is the same hash)
+static inline uint64_t ht_hash_packed_inline(const ht_packed_key* key) {
+  uint64_t words[2];
+  uint64_t hash = HT_HASH_SEED;
+
+  memcpy(words, key, sizeof(words));
+  hash = (hash ^ words[0]) * 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 29;
+  hash = (hash ^ words[1]) * 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 29;
+
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static inline int ht_packed_equal(const ht_packed_key* a, const ht_packed_key* b) {
+  uint64_t x[2], y[2];
+  memcpy(x, a, sizeof(x));
+  memcpy(y, b, sizeof(y));
+  return ((x[0] ^ y[0]) | (x[1] ^ y[1])) == 0;
+}
+
+// the minimal perfect hash of a frozen table, shared with the headers written by
+// ht_write_mph_tables().  A key's bucket comes from the top half of its hash and
+// the bucket's displacement picks the slot, slots are in 0..num_keys-1
+static inline uint32_t ht_mph_bucket(const uint64_t hash, const uint32_t num_buckets) {
+  return (uint32_t)(((hash >> 32) * (uint64_t)num_buckets) >> 32);
+}
+
+static inline uint32_t ht_mph_slot(const uint64_t hash, const uint32_t disp, const uint32_t num_keys) {
+  uint64_t x = (hash ^ ((uint64_t)disp * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 31;
+  return (uint32_t)(((x >> 32) * (uint64_t)num_keys) >> 32);
+}
+
 #endif
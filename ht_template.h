@@ -0,0 +1,296 @@
+/**
+ * ht_template.h - Type-specialized hash tables
+ *
+ * @brief   HT_DEFINE(prefix, KeyT, ValT, hash_fn, eq_fn) generates a hash
+ * table whose keys and values are stored by value in the slot array, so there
+ * is no key copy, no value allocation and no void* to follow.  The functions
+ * are static inline and call hash_fn and eq_fn directly, so the compiler
+ * inlines them into every probe instead of going through strcmp() or a key
+ * mode test.
+ *
+ * The slots are laid out and probed the same way as the ht_* table
+ * (hash_table.c): a parallel array of control bytes searched HT_GROUP_WIDTH
+ * slots at a time, Robin Hood linear probing and backward-shift deletes.  A
+ * resize rehashes the whole table at once.  Values move when the table resizes
+ * or an item is shifted, so a pointer returned by a search is only good until
+ * the next insert or delete.
+ *
+ *   uint64_t hash_fn(const KeyT* key);
+ *   int eq_fn(const KeyT* a, const KeyT* b);      // 1 if the keys are equal
+ *
+ * HT_DEFINE(tt, ht_packed_key, TeamInfo_t, ...) generates the type tt_table
+ * and the functions tt_new(), tt_del_table(), tt_insert(), tt_get_or_insert(),
+ * tt_search(), tt_delete() and tt_next() (see team_table.h).
+*/
+
+#ifndef _HT_TEMPLATE_H_
+#define _HT_TEMPLATE_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hash_table.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// control bytes, the same encoding as hash_table.c
+#define HTT_CTRL_EMPTY      ((uint8_t)0x80)
+#define HTT_CTRL_TAG(hash)  ((uint8_t)((hash) >> 57))   // full slot: top 7 bits of the hash
+#define HTT_CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+
+// bit i is set when control byte i of the group equals tag
+static inline uint32_t htt_group_match(const uint8_t* group, const uint8_t tag) {
+#if defined(__SSE2__)
+  const __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+    mask |= (uint32_t)(group[i] == tag) << i;
+  }
+  return mask;
+#endif
+}
+
+// sets a control byte and its mirror after the end of the array
+static inline void htt_set_ctrl(uint8_t* ctrl, const int size, const int index, const uint8_t c) {
+  ctrl[index] = c;
+  if (index < HT_GROUP_WIDTH - 1) {
+    ctrl[size + index] = c;
+  }
+}
+
+
+#define HT_DEFINE(prefix, KeyT, ValT, hash_fn, eq_fn)                                        \
+                                                                                             \
+/* one slot: the key and value themselves and the full hash of the key */                    \
+typedef struct {                                                                             \
+  KeyT key;                                                                                  \
+  ValT value;                                                                                \
+  uint64_t hash;                                                                             \
+} prefix##_slot;                                                                             \
+                                                                                             \
+typedef struct {                                                                             \
+  int base_size;        /* never shrink below this many slots (a power of two) */            \
+  int size;             /* number of slots */                                                \
+  int count;            /* number of items */                                                \
+  int max_psl;          /* longest probe sequence length */                                  \
+  uint8_t* ctrl;        /* size + HT_GROUP_WIDTH - 1 control bytes */                        \
+  prefix##_slot* slots;                                                                      \
+} prefix##_table;                                                                            \
+                                                                                             \
+/* allocates empty control bytes and slots for size slots, 0 or -1 */                        \
+static inline int prefix##_alloc(const int size, uint8_t** ctrl, prefix##_slot** slots) {   \
+  *ctrl = malloc((size_t)size + HT_GROUP_WIDTH - 1);                                         \
+  *slots = malloc((size_t)size * sizeof(prefix##_slot));                                     \
+  if ((*ctrl == NULL) || (*slots == NULL)) {                                                 \
+    free(*ctrl);                                                                             \
+    free(*slots);                                                                            \
+    return -1;                                                                               \
+  }                                                                                          \
+  memset(*ctrl, HTT_CTRL_EMPTY, (size_t)size + HT_GROUP_WIDTH - 1);                          \
+  return 0;                                                                                  \
+}                                                                                            \
+                                                                                             \
+/* a new table with at least base_size slots, NULL if out of memory */                       \
+static inline prefix##_table* prefix##_new(const int base_size) {                            \
+  prefix##_table* t = malloc(sizeof(prefix##_table));                                        \
+  if (t == NULL) {                                                                           \
+    return NULL;                                                                             \
+  }                                                                                          \
+  t->size = HT_MIN_BASE_SIZE;                                                                \
+  while (t->size < base_size) {                                                              \
+    t->size *= 2;                                                                            \
+  }                                                                                          \
+  t->base_size = t->size;                                                                    \
+  t->count = 0;                                                                              \
+  t->max_psl = 0;                                                                            \
+  if (prefix##_alloc(t->size, &t->ctrl, &t->slots) != 0) {                                   \
+    free(t);                                                                                 \
+    return NULL;                                                                             \
+  }                                                                                          \
+  return t;                                                                                  \
+}                                                                                            \
+                                                                                             \
+/* deletes the table and everything in it */                                                 \
+static inline void prefix##_del_table(prefix##_table* t) {                                   \
+  free(t->ctrl);                                                                             \
+  free(t->slots);                                                                            \
+  free(t);                                                                                   \
+}                                                                                            \
+                                                                                             \
+/* the slot holding key, -1 if it isn't in the table */                                      \
+static inline int prefix##_find(const prefix##_table* t, const KeyT* key, const uint64_t hash) { \
+  const int mask = t->size - 1;                                                              \
+  const uint8_t tag = HTT_CTRL_TAG(hash);                                                    \
+  int pos = (int)(hash & (uint64_t)mask);                                                    \
+                                                                                             \
+  for (int probed = 0; probed <= t->max_psl; probed += HT_GROUP_WIDTH) {                     \
+    const uint8_t* group = t->ctrl + pos;                                                    \
+    uint32_t match = htt_group_match(group, tag);                                            \
+    while (match != 0) {                                                                     \
+      const int index = (pos + __builtin_ctz(match)) & mask;                                 \
+      if ((t->slots[index].hash == hash) && eq_fn(&t->slots[index].key, key)) {              \
+        return index;                                                                        \
+      }                                                                                      \
+      match &= match - 1;                                                                    \
+    }                                                                                        \
+    if (htt_group_match(group, HTT_CTRL_EMPTY) != 0) {                                       \
+      break;                                                                                 \
+    }                                                                                        \
+    pos = (pos + HT_GROUP_WIDTH) & mask;                                                     \
+  }                                                                                          \
+  return -1;                                                                                 \
+}                                                                                            \
+                                                                                             \
+/* stores a slot with Robin Hood probing, returns where it went (-1 if full) */              \
+static inline int prefix##_place(uint8_t* ctrl, prefix##_slot* slots, const int size,       \
+                                 int* max_psl, const prefix##_slot* slot) {                  \
+  const int mask = size - 1;                                                                 \
+  prefix##_slot item = *slot;                                                                \
+  int index = (int)(item.hash & (uint64_t)mask);                                             \
+  int placed = -1;                                                                           \
+  int psl = 0;                                                                               \
+                                                                                             \
+  for (int probed = 0; probed < size; probed++) {                                            \
+    if (!HTT_CTRL_IS_FULL(ctrl[index])) {                                                    \
+      slots[index] = item;                                                                   \
+      htt_set_ctrl(ctrl, size, index, HTT_CTRL_TAG(item.hash));                              \
+      if (psl > *max_psl) {                                                                  \
+        *max_psl = psl;                                                                      \
+      }                                                                                      \
+      return (placed < 0) ? index : placed;                                                  \
+    }                                                                                        \
+    const int resident_psl = (index - (int)(slots[index].hash & (uint64_t)mask)) & mask;     \
+    if (resident_psl < psl) {                                                                \
+      prefix##_slot displaced = slots[index];                                                \
+      slots[index] = item;                                                                   \
+      htt_set_ctrl(ctrl, size, index, HTT_CTRL_TAG(item.hash));                              \
+      if (psl > *max_psl) {                                                                  \
+        *max_psl = psl;                                                                      \
+      }                                                                                      \
+      if (placed < 0) {                                                                      \
+        placed = index;                                                                      \
+      }                                                                                      \
+      item = displaced;                                                                      \
+      psl = resident_psl;                                                                    \
+    }                                                                                        \
+    index = (index + 1) & mask;                                                              \
+    psl++;                                                                                   \
+  }                                                                                          \
+  return -1;                                                                                 \
+}                                                                                            \
+                                                                                             \
+/* rehashes every item into size slots, the table is unchanged on failure */                 \
+static inline int prefix##_resize(prefix##_table* t, const int size) {                       \
+  uint8_t* ctrl;                                                                             \
+  prefix##_slot* slots;                                                                      \
+  int max_psl = 0;                                                                           \
+                                                                                             \
+  if ((size < t->count) || (prefix##_alloc(size, &ctrl, &slots) != 0)) {                     \
+    return -1;                                                                               \
+  }                                                                                          \
+  for (int i = 0; i < t->size; i++) {                                                        \
+    if (HTT_CTRL_IS_FULL(t->ctrl[i])) {                                                      \
+      prefix##_place(ctrl, slots, size, &max_psl, &t->slots[i]);                             \
+    }                                                                                        \
+  }                                                                                          \
+  free(t->ctrl);                                                                             \
+  free(t->slots);                                                                            \
+  t->ctrl = ctrl;                                                                            \
+  t->slots = slots;                                                                          \
+  t->size = size;                                                                            \
+  t->max_psl = max_psl;                                                                      \
+  return 0;                                                                                  \
+}                                                                                            \
+                                                                                             \
+/* the value of key, inserting a zeroed value if it isn't there.  NULL on error */           \
+static inline ValT* prefix##_get_or_insert(prefix##_table* t, const KeyT* key, int* inserted) { \
+  const uint64_t hash = hash_fn(key);                                                        \
+  int index = prefix##_find(t, key, hash);                                                   \
+                                                                                             \
+  if (inserted != NULL) {                                                                    \
+    *inserted = (index < 0);                                                                 \
+  }                                                                                          \
+  if (index >= 0) {                                                                          \
+    return &t->slots[index].value;                                                           \
+  }                                                                                          \
+  if ((long)(t->count + 1) * 100 > (long)t->size * HT_GROW_LOAD) {                          \
+    (void)prefix##_resize(t, t->size * 2);     /* if it fails, place until the table is full */ \
+  }                                                                                          \
+  if (t->count >= t->size) {                                                                 \
+    return NULL;                               /* placing would push a resident out */       \
+  }                                                                                          \
+                                                                                             \
+  prefix##_slot slot;                                                                        \
+  memset(&slot, 0, sizeof(slot));                                                            \
+  slot.key = *key;                                                                           \
+  slot.hash = hash;                                                                          \
+  index = prefix##_place(t->ctrl, t->slots, t->size, &t->max_psl, &slot);                    \
+  if (index < 0) {                                                                           \
+    return NULL;                                                                             \
+  }                                                                                          \
+  t->count++;                                                                                \
+  if ((t->max_psl >= HT_MAX_PSL) && (prefix##_resize(t, t->size * 2) == 0)) {                \
+    index = prefix##_find(t, key, hash);                                                     \
+  }                                                                                          \
+  return &t->slots[index].value;                                                             \
+}                                                                                            \
+                                                                                             \
+/* inserts a copy of value or replaces the key's value, 1 if inserted, 0 if                  \
+   replaced, -1 on error */                                                                  \
+static inline int prefix##_insert(prefix##_table* t, const KeyT* key, const ValT* value) {   \
+  int inserted;                                                                              \
+  ValT* v = prefix##_get_or_insert(t, key, &inserted);                                       \
+  if (v == NULL) {                                                                           \
+    return -1;                                                                               \
+  }                                                                                          \
+  *v = *value;                                                                               \
+  return inserted;                                                                           \
+}                                                                                            \
+                                                                                             \
+/* the value of key in the table, NULL if it isn't there */                                  \
+static inline ValT* prefix##_search(prefix##_table* t, const KeyT* key) {                    \
+  const int index = prefix##_find(t, key, hash_fn(key));                                     \
+  return (index < 0) ? NULL : &t->slots[index].value;                                        \
+}                                                                                            \
+                                                                                             \
+/* deletes key, returns 1 if it was in the table */                                          \
+static inline int prefix##_delete(prefix##_table* t, const KeyT* key) {                      \
+  int index = prefix##_find(t, key, hash_fn(key));                                           \
+  if (index < 0) {                                                                           \
+    return 0;                                                                                \
+  }                                                                                          \
+                                                                                             \
+  const int mask = t->size - 1;                                                              \
+  int next = (index + 1) & mask;                                                             \
+  while (HTT_CTRL_IS_FULL(t->ctrl[next]) &&                                                  \
+         (((next - (int)(t->slots[next].hash & (uint64_t)mask)) & mask) != 0)) {             \
+    t->slots[index] = t->slots[next];                                                        \
+    htt_set_ctrl(t->ctrl, t->size, index, t->ctrl[next]);                                    \
+    index = next;                                                                            \
+    next = (next + 1) & mask;                                                                \
+  }                                                                                          \
+  htt_set_ctrl(t->ctrl, t->size, index, HTT_CTRL_EMPTY);                                     \
+  t->count--;                                                                                \
+                                                                                             \
+  if ((t->size > t->base_size) && ((long)t->count * 100 < (long)t->size * HT_SHRINK_LOAD)) {  \
+    (void)prefix##_resize(t, t->size / 2);                                                   \
+  }                                                                                          \
+  return 1;                                                                                  \
+}                                                                                            \
+                                                                                             \
+/* walks the items: start *index at 0, returns NULL after the last one */                    \
+static inline prefix##_slot* prefix##_next(prefix##_table* t, int* index) {                  \
+  while (*index < t->size) {                                                                 \
+    const int i = (*index)++;                                                                \
+    if (HTT_CTRL_IS_FULL(t->ctrl[i])) {                                                      \
+      return &t->slots[i];                                                                   \
+    }                                                                                        \
+  }                                                                                          \
+  return NULL;                                                                               \
+}
+
+#endif
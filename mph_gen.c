@@ -0,0 +1,108 @@
+/**
+ * mph_gen.c - Generates a perfect hash header for a fixed set of teams
+ *
+ * @brief  This program loads a CSV file of Team Info records (the same format
+ * as soccer2021.csv) into a hash table, freezes it with ht_freeze() and writes
+ * the minimal perfect hash as a C header.  The set of teams is fixed for a
+ * season (NUM_TEAMS of them), so the header can be generated at build time and
+ * a team looked up without building a hash table at all:
+ *
+ *    #include "teams_mph.h"
+ *    int slot = teams_lookup("PORTLANDNWSL");   // -1 if there's no such team
+ *    if (slot >= 0) printTeamInfo((TeamInfoPtr_t)&teams_info[slot]);
+ *
+ * The keys are the ones createKey() makes (the uppercase city followed by the
+ * conference).  The header has the tables written by ht_write_mph_tables() and
+ * teams_info[], the records in slot order.
+ *
+ * usage: mph_gen [file.csv] [header.h]   (default soccer2021.csv teams_mph.h)
+ *
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hash_table.h"
+#include "appHelpers.h"
+
+#define DEFAULT_CSV     "soccer2021.csv"
+#define DEFAULT_HEADER  "teams_mph.h"
+#define MPH_PREFIX      "teams"
+
+/**
+ * writeString() - writes a C string literal
+ *
+ * @param	fp			file to write to
+ * @param	s			string to write
+ */
+static void writeString(FILE* fp, const char* s) {
+	fputc('"', fp);
+	for (; *s != '\0'; s++) {
+		const unsigned char c = (unsigned char)*s;
+		if ((c == '"') || (c == '\\') || (c == '?')) {
+			fprintf(fp, "\\%c", c);
+		}
+		else if ((c < ' ') || (c > '~')) {
+			fprintf(fp, "\\%03o", c);
+		}
+		else {
+			fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+int main(int argc, char* argv[]) {
+	const char* csv = (argc > 1) ? argv[1] : DEFAULT_CSV;
+	const char* header = (argc > 2) ? argv[2] : DEFAULT_HEADER;
+	csvLoadResult_t result;
+
+	ht_hash_table* ht = ht_new();
+	if ((ht == NULL) || (loadTeamInfoCsv(ht, csv, &result) < 0)) {
+		fprintf(stderr, "ERROR: Could not load %s\n", csv);
+		return 1;
+	}
+	if (result.numErrors > 0) {
+		fprintf(stderr, "ERROR: %ld records in %s could not be parsed (the first on line %ld)\n",
+		        result.numErrors, csv, result.errors[0].line);
+		return 1;
+	}
+	if (ht_freeze(ht) != 0) {
+		fprintf(stderr, "ERROR: Could not build the perfect hash\n");
+		return 1;
+	}
+
+	FILE* fp = fopen(header, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "ERROR: Could not create %s\n", header);
+		return 1;
+	}
+	fprintf(fp, "// %s - generated from %s by mph_gen, do not edit\n\n", header, csv);
+	fprintf(fp, "#ifndef _TEAMS_MPH_H\n#define _TEAMS_MPH_H\n\n");
+	fprintf(fp, "#include <stdint.h>\n#include <string.h>\n#include \"hash_table.h\"\n\n");
+	int status = ht_write_mph_tables(ht, fp, MPH_PREFIX);
+
+	fprintf(fp, "\nstatic const TeamInfo_t %s_info[%d] = {", MPH_PREFIX, (ht->count > 0) ? ht->count : 1);
+	for (int i = 0; i < ht->count; i++) {
+		const TeamInfo_t* info = ht->items[i].value;
+		fputs("\n  {", fp);
+		writeString(fp, info->conf);
+		fputs(", ", fp);
+		writeString(fp, info->city);
+		fputs(", ", fp);
+		writeString(fp, info->name);
+		fprintf(fp, ", %d, %d, %d, %d, %d}%s", info->pts, info->win, info->loss, info->tie, info->gd,
+		        (i + 1 < ht->count) ? "," : "\n");
+	}
+	fprintf(fp, "};\n\n#endif\n");
+	if ((fclose(fp) != 0) || (status != 0)) {
+		fprintf(stderr, "ERROR: Could not write %s\n", header);
+		remove(header);
+		return 1;
+	}
+	printf("Wrote %s: %d teams\n", header, ht->count);
+
+	ht_del_hash_table(ht);
+	return 0;
+}
@@ -0,0 +1,390 @@
+/**
+ * prefix_index.c - Prefix index source code file
+ *
+ * @brief   This is the source code file for the prefix index.  The cities and
+ * the names are two sorted arrays of pointers to the Team Info records, in
+ * case-insensitive order, so the records that start with a prefix are next to
+ * each other.  A search is a binary search for the first one and a walk over
+ * the matches, O(log n + m).  The strings aren't copied, the arrays point at
+ * the records in the hash table (values never move).
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include "hash_table.h"
+#include "prefix_index.h"
+
+#define PX_MIN_CAPACITY     16
+
+// the lists are told apart by the offset of their field in TeamInfo_t
+#define PX_FIELD(team, offset)  ((const char*)(team) + (offset))
+#define PX_CITY_OFFSET          offsetof(TeamInfo_t, city)
+#define PX_NAME_OFFSET          offsetof(TeamInfo_t, name)
+
+// Prefix Index ADT
+
+// compares two strings ignoring ASCII case
+static int px_strcmp(const char* a, const char* b);
+
+// checks whether s starts with prefix, ignoring ASCII case
+static int px_starts_with(const char* s, const char* prefix);
+
+// orders two records by the field at offset, then by address
+static int px_compare(const TeamInfo_t* a, const TeamInfo_t* b, const size_t offset);
+
+// first position in a list whose field isn't less than s (and record not before team)
+static int px_lower_bound(const px_list* list, const size_t offset, const char* s,
+                          const TeamInfo_t* team);
+
+// adds or removes a record in one of the lists
+static int px_list_add(px_list* list, const size_t offset, TeamInfoPtr_t team, const int loading);
+static int px_list_remove(px_list* list, const size_t offset, TeamInfoPtr_t team);
+
+// sorts a list that px_attach() appended to
+static void px_list_sort(px_list* list, const size_t offset);
+
+// px_compare() by city and by name for qsort()
+static int px_qsort_city(const void* a, const void* b);
+static int px_qsort_name(const void* a, const void* b);
+
+
+/**
+ * px_new() - initializes a new, empty prefix index
+ *
+ * @return a pointer to the new index or NULL if it could not be allocated
+ */
+px_index* px_new(void) {
+  px_index* px = calloc(1, sizeof(px_index));
+  if (px == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(px_new()): Could not allocate space for the index\n");
+    #endif
+    return NULL;
+  }
+  return px;
+}
+
+
+/**
+ * px_del_index() - deletes a prefix index
+ *
+ * The records belong to the hash table and are not freed.  If the table lives
+ * on, detach the index first with ht_remove_observer(ht, px_observe, px).
+ *
+ * @param px is a pointer to the index
+ */
+void px_del_index(px_index* px) {
+  free(px->cities.teams);
+  free(px->names.teams);
+  free(px);
+}
+
+
+/**
+ * px_attach() - indexes a hash table's Team Info records and follows its changes
+ *
+ * Registers px_observe() as one of the table's observers, which adds the
+ * records that are already in the table (appended, and both lists sorted once
+ * at the end).  From then on every ht_insert() and ht_delete() updates the
+ * index too.
+ *
+ * @param px is a pointer to an empty index
+ * @param ht is a pointer to a hash table of Team Info records (not a snapshot)
+ *
+ * @return 0 if successful, -1 if the table can't be observed or a record
+ * couldn't be indexed
+ */
+int px_attach(px_index* px, ht_hash_table* ht) {
+  const long errors = px->errors;
+  px->loading = 1;
+  const int status = ht_add_observer(ht, px_observe, px);
+  px->loading = 0;
+  px_list_sort(&px->cities, PX_CITY_OFFSET);
+  px_list_sort(&px->names, PX_NAME_OFFSET);
+  if (status != 0) {
+    return -1;
+  }
+  return (px->errors == errors) ? 0 : -1;
+}
+
+
+/**
+ * px_observe() - keeps the index in step with its hash table, see ht_add_observer()
+ *
+ * @param ctx is the index
+ * @param value is the Team Info record that was added or is about to be removed
+ * @param event is HT_VALUE_ADDED, HT_VALUE_REMOVED or HT_VALUE_DELETED
+ */
+void px_observe(void* ctx, void* value, const int event) {
+  px_index* px = ctx;
+  const int status = (event == HT_VALUE_ADDED) ? px_add(px, value) : px_remove(px, value);
+  if (status != 0) {
+    px->errors++;
+  }
+}
+
+
+/**
+ * px_add() - adds a record to the city and name lists
+ *
+ * @param px is a pointer to the index
+ * @param team is the record, its city and name must be filled in
+ *
+ * @return 0 if successful, -1 if out of memory
+ */
+int px_add(px_index* px, TeamInfoPtr_t team) {
+  if (px_list_add(&px->cities, PX_CITY_OFFSET, team, px->loading) != 0) {
+    return -1;
+  }
+  if (px_list_add(&px->names, PX_NAME_OFFSET, team, px->loading) != 0) {
+    px_list_remove(&px->cities, PX_CITY_OFFSET, team);
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+ * px_remove() - removes a record from the city and name lists
+ *
+ * The record is found by its city and name, so it has to be removed before
+ * they change.
+ *
+ * @param px is a pointer to the index
+ * @param team is the record
+ *
+ * @return 0 if successful, -1 if the record isn't in the index
+ */
+int px_remove(px_index* px, TeamInfoPtr_t team) {
+  const int city = px_list_remove(&px->cities, PX_CITY_OFFSET, team);
+  const int name = px_list_remove(&px->names, PX_NAME_OFFSET, team);
+  return ((city == 0) && (name == 0)) ? 0 : -1;
+}
+
+
+/**
+ * px_search() - finds the records whose city or name starts with a prefix
+ *
+ * Case doesn't matter ("new" finds New England and NJ/NY doesn't).  With PX_ANY
+ * the city matches come first, sorted by city, then the records that only
+ * match by name, sorted by name; a record is never listed twice.
+ *
+ * @param px is a pointer to the index
+ * @param prefix is what the user typed so far ("" matches every record)
+ * @param fields is PX_CITY, PX_NAME or PX_ANY
+ * @param out is set to the first max_out matches
+ * @param max_out is the room in out
+ *
+ * @return the number of matches, which can be more than max_out
+ */
+int px_search(const px_index* px, const char* prefix, const int fields,
+              TeamInfoPtr_t* out, const int max_out) {
+  int n = 0;
+
+  if (fields & PX_CITY) {
+    const px_list* list = &px->cities;
+    for (int i = px_lower_bound(list, PX_CITY_OFFSET, prefix, NULL);
+         (i < list->count) && px_starts_with(list->teams[i]->city, prefix); i++, n++) {
+      if (n < max_out) {
+        out[n] = list->teams[i];
+      }
+    }
+  }
+  if (fields & PX_NAME) {
+    const px_list* list = &px->names;
+    for (int i = px_lower_bound(list, PX_NAME_OFFSET, prefix, NULL);
+         (i < list->count) && px_starts_with(list->teams[i]->name, prefix); i++) {
+      if ((fields & PX_CITY) && px_starts_with(list->teams[i]->city, prefix)) {
+        continue;   // already listed by its city
+      }
+      if (n < max_out) {
+        out[n] = list->teams[i];
+      }
+      n++;
+    }
+  }
+  return n;
+}
+
+
+/**
+ * px_list_add() - adds a record to a list
+ *
+ * @param list is the list
+ * @param offset is the offset of the list's field in TeamInfo_t
+ * @param team is the record
+ * @param loading is 1 to append the record (the list is sorted afterwards)
+ *
+ * @return 0 if successful, -1 if out of memory
+ */
+static int px_list_add(px_list* list, const size_t offset, TeamInfoPtr_t team, const int loading) {
+  if (list->count == list->capacity) {
+    const int capacity = (list->capacity == 0) ? PX_MIN_CAPACITY : list->capacity * 2;
+    TeamInfoPtr_t* teams = realloc(list->teams, (size_t)capacity * sizeof(TeamInfoPtr_t));
+    if (teams == NULL) {
+      #if (_DEBUG_ > 0)
+        fprintf(stderr, "ERROR(px_list_add()): Could not grow the index\n");
+      #endif
+      return -1;
+    }
+    list->teams = teams;
+    list->capacity = capacity;
+  }
+
+  const int i = loading ? list->count : px_lower_bound(list, offset, PX_FIELD(team, offset), team);
+  memmove(&list->teams[i + 1], &list->teams[i], (size_t)(list->count - i) * sizeof(TeamInfoPtr_t));
+  list->teams[i] = team;
+  list->count++;
+  return 0;
+}
+
+
+/**
+ * px_list_remove() - removes a record from a list
+ *
+ * @param list is the list
+ * @param offset is the offset of the list's field in TeamInfo_t
+ * @param team is the record
+ *
+ * @return 0 if successful, -1 if the record isn't in the list
+ */
+static int px_list_remove(px_list* list, const size_t offset, TeamInfoPtr_t team) {
+  const int i = px_lower_bound(list, offset, PX_FIELD(team, offset), team);
+  if ((i == list->count) || (list->teams[i] != team)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(px_list_remove()): %s is not in the index\n", PX_FIELD(team, offset));
+    #endif
+    return -1;
+  }
+  memmove(&list->teams[i], &list->teams[i + 1], (size_t)(list->count - i - 1) * sizeof(TeamInfoPtr_t));
+  list->count--;
+  return 0;
+}
+
+
+/**
+ * px_list_sort() - sorts a list by its field, then by address
+ *
+ * @param list is the list
+ * @param offset is the offset of the list's field in TeamInfo_t
+ */
+static void px_list_sort(px_list* list, const size_t offset) {
+  qsort(list->teams, (size_t)list->count, sizeof(TeamInfoPtr_t),
+        (offset == PX_CITY_OFFSET) ? px_qsort_city : px_qsort_name);
+}
+
+
+/**
+ * px_qsort_city() - px_compare() by city for qsort()
+ *
+ * @param a is a pointer to a TeamInfoPtr_t
+ * @param b is a pointer to a TeamInfoPtr_t
+ *
+ * @return see px_compare()
+ */
+static int px_qsort_city(const void* a, const void* b) {
+  return px_compare(*(const TeamInfoPtr_t*)a, *(const TeamInfoPtr_t*)b, PX_CITY_OFFSET);
+}
+
+
+/**
+ * px_qsort_name() - px_compare() by name for qsort()
+ *
+ * @param a is a pointer to a TeamInfoPtr_t
+ * @param b is a pointer to a TeamInfoPtr_t
+ *
+ * @return see px_compare()
+ */
+static int px_qsort_name(const void* a, const void* b) {
+  return px_compare(*(const TeamInfoPtr_t*)a, *(const TeamInfoPtr_t*)b, PX_NAME_OFFSET);
+}
+
+
+/**
+ * px_strcmp() - compares two strings ignoring ASCII case
+ *
+ * @param a is a string
+ * @param b is a string
+ *
+ * @return < 0, 0 or > 0 like strcmp() on the uppercased strings
+ */
+static int px_strcmp(const char* a, const char* b) {
+  for (;; a++, b++) {
+    const int ca = toupper((unsigned char)*a);
+    const int cb = toupper((unsigned char)*b);
+    if ((ca != cb) || (ca == '\0')) {
+      return ca - cb;
+    }
+  }
+}
+
+
+/**
+ * px_starts_with() - checks whether a string starts with a prefix, ignoring ASCII case
+ *
+ * @param s is the string
+ * @param prefix is the prefix
+ *
+ * @return 1 if it does, 0 if it doesn't
+ */
+static int px_starts_with(const char* s, const char* prefix) {
+  for (; *prefix != '\0'; s++, prefix++) {
+    if (toupper((unsigned char)*s) != toupper((unsigned char)*prefix)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/**
+ * px_compare() - orders two records by a field, ignoring case, then by address
+ *
+ * @param a is a record
+ * @param b is a record
+ * @param offset is the offset of the field in TeamInfo_t
+ *
+ * @return < 0 if a comes first, > 0 if b comes first, 0 if they are the same record
+ */
+static int px_compare(const TeamInfo_t* a, const TeamInfo_t* b, const size_t offset) {
+  const int cmp = px_strcmp(PX_FIELD(a, offset), PX_FIELD(b, offset));
+  if (cmp != 0) {
+    return cmp;
+  }
+  return (a < b) ? -1 : (a > b);
+}
+
+
+/**
+ * px_lower_bound() - binary search of a list
+ *
+ * @param list is the list
+ * @param offset is the offset of the list's field in TeamInfo_t
+ * @param s is the string to look for
+ * @param team is the record to look for, NULL for the first record whose field
+ * isn't less than s
+ *
+ * @return the first position whose record doesn't come before (s, team)
+ */
+static int px_lower_bound(const px_list* list, const size_t offset, const char* s,
+                          const TeamInfo_t* team) {
+  int lo = 0, hi = list->count;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    const TeamInfo_t* t = list->teams[mid];
+    int cmp = px_strcmp(PX_FIELD(t, offset), s);
+    if ((cmp == 0) && (team != NULL)) {
+      cmp = (t < team) ? -1 : (t > team);
+    }
+    if (cmp < 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
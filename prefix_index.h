@@ -0,0 +1,63 @@
+/**
+ * prefix_index.h - Prefix index header file
+ *
+ * @brief   This is the header file for an autocomplete index over the city and
+ * team name of the Team Info records in a hash table.  The hash table can only
+ * find a team by its whole key; the index keeps the records sorted by city and
+ * by name (ignoring case) so every record whose city or name starts with what
+ * the user has typed so far ("New", "or") is found with a binary search and a
+ * walk over the matches.
+ *
+ * Like the standings index (standings.h) it follows the hash table through
+ * ht_add_observer(), so it stays in sync with ht_insert() and ht_delete().
+*/
+
+#ifndef _PREFIX_INDEX_H_
+#define _PREFIX_INDEX_H_
+
+#include "hash_table.h"
+
+// fields that px_search() matches
+#define PX_CITY             1
+#define PX_NAME             2
+#define PX_ANY              (PX_CITY | PX_NAME)
+
+// the records sorted by one field
+typedef struct {
+  TeamInfoPtr_t* teams;
+  int count;
+  int capacity;
+} px_list;
+
+// struct containing the prefix index
+typedef struct {
+  px_list cities;
+  px_list names;
+  long errors;        // records the observer couldn't add or find (out of memory)
+  int loading;        // px_attach() is adding the table's records, they are sorted afterwards
+} px_index;
+
+
+// API function prototypes
+
+// creates an empty prefix index
+px_index* px_new(void);
+
+// deletes the index (not the records, they belong to the hash table)
+void px_del_index(px_index* px);
+
+// indexes the records in a hash table and keeps following its changes
+int px_attach(px_index* px, ht_hash_table* ht);
+
+// the ht_observer that px_attach() registers
+void px_observe(void* ctx, void* value, const int event);
+
+// adds a record, or removes it using its current city and name
+int px_add(px_index* px, TeamInfoPtr_t team);
+int px_remove(px_index* px, TeamInfoPtr_t team);
+
+// the records whose city and/or name starts with prefix, ignoring case
+int px_search(const px_index* px, const char* prefix, const int fields,
+              TeamInfoPtr_t* out, const int max_out);
+
+#endif
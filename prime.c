@@ -0,0 +1,55 @@
+/**
+ * prime.c - Prime number helpers for the Hash table ADT
+ *
+ * @brief   This is the source code file for the prime number functions used
+ * to size a double hashing table.  Double hashing only visits every bucket
+ * when the step between attempts is relatively prime to the number of buckets
+ * so the table is sized to a prime.  The Hash table ADT now uses power of two
+ * sizes; these are used for the original double hashing table that
+ * bench_hashtable.c compares against.
+*/
+
+#include "prime.h"
+
+/**
+ * is_prime() - checks whether a number is prime
+ *
+ * Uses trial division by the odd numbers up to the square root of x.  This
+ * is plenty fast for the table sizes we use since it only runs on a resize.
+ *
+ * @param x is the number to check
+ *
+ * @return 1 if x is prime, 0 if it is not and -1 if x < 2 (undefined)
+ */
+int is_prime(const int x) {
+  if (x < 2) {
+    return -1;
+  }
+  if (x < 4) {
+    return 1;
+  }
+  if ((x % 2) == 0) {
+    return 0;
+  }
+  for (int i = 3; i <= x / i; i += 2) {
+    if ((x % i) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/**
+ * next_prime() - finds the next prime number
+ *
+ * @param x is the number to start searching from
+ *
+ * @return the smallest prime that is >= x
+ */
+int next_prime(int x) {
+  while (is_prime(x) != 1) {
+    x++;
+  }
+  return x;
+}
@@ -0,0 +1,17 @@
+/**
+ * prime.h - Prime number helpers for the Hash table ADT
+ *
+ * @brief   This is the header file for the prime number functions used
+ * to size a double hashing table.
+*/
+
+#ifndef _PRIME_H_
+#define _PRIME_H_
+
+// returns 1 if x is prime, 0 if it is not and -1 if x < 2 (undefined)
+int is_prime(const int x);
+
+// returns the next prime that is >= x
+int next_prime(int x);
+
+#endif
@@ -0,0 +1,177 @@
+/**
+ * sharded_table.c - Sharded hash table source code file
+ *
+ * @brief   This is the source code file for the sharded hash table.  It only
+ * routes each key to its shard; the shards do all of the real work.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "hash_table.h"
+#include "sharded_table.h"
+
+// Sharded Hash Table ADT
+
+/**
+ * sht_new() - initializes a new sharded hash table
+ *
+ * @param num_shards is the number of shards, rounded up to a power of two
+ * (at most SHT_MAX_SHARDS)
+ * @param base_size is the total number of slots to start with, split evenly
+ * over the shards
+ *
+ * @return a pointer to the new table or NULL if it could not be allocated
+ */
+sht_table* sht_new(const int num_shards, const int base_size) {
+  sht_table* sht = malloc(sizeof(sht_table));
+  if (sht == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(sht_new()): Could not allocate space for hash table\n");
+    #endif
+    return NULL;
+  }
+
+  sht->shard_bits = 0;
+  while (((1 << sht->shard_bits) < num_shards) && ((1 << sht->shard_bits) < SHT_MAX_SHARDS)) {
+    sht->shard_bits++;
+  }
+  sht->num_shards = 1 << sht->shard_bits;
+  sht->shards = calloc((size_t)sht->num_shards, sizeof(ht_hash_table*));
+  if (sht->shards == NULL) {
+    free(sht);
+    return NULL;
+  }
+  for (int i = 0; i < sht->num_shards; i++) {
+    sht->shards[i] = ht_new_sized(base_size / sht->num_shards);
+    if (sht->shards[i] == NULL) {
+      #if (_DEBUG_ > 0)
+        fprintf(stderr, "ERROR(sht_new()): Could not allocate shard %d\n", i);
+      #endif
+      sht_del_table(sht);
+      return NULL;
+    }
+  }
+  return sht;
+}
+
+
+/**
+ * sht_del_table() - deletes a sharded hash table
+ *
+ * @param sht is a pointer to the table
+ */
+void sht_del_table(sht_table* sht) {
+  for (int i = 0; i < sht->num_shards; i++) {
+    if (sht->shards[i] != NULL) {
+      ht_del_hash_table(sht->shards[i]);
+    }
+  }
+  free(sht->shards);
+  free(sht);
+}
+
+
+/**
+ * sht_use_arenas() - gives every shard its own arena
+ *
+ * Arenas are not thread-safe, so shards that are built by different threads
+ * can't share one.
+ *
+ * @param sht is a pointer to the table, every shard must be empty
+ *
+ * @return 0 if successful, -1 if a shard isn't empty or out of memory
+ */
+int sht_use_arenas(sht_table* sht) {
+  for (int i = 0; i < sht->num_shards; i++) {
+    if (sht->shards[i]->arena != NULL) {
+      continue;
+    }
+    arena_t* arena = arena_new(0);
+    if ((arena == NULL) || (ht_use_arena(sht->shards[i], arena) != 0)) {
+      if (arena != NULL) {
+        arena_del(arena);
+      }
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * sht_shard_of() - picks the shard for a hash
+ *
+ * @param sht is a pointer to the table
+ * @param hash is the hash of the key from ht_hash_string()
+ *
+ * @return the index of the shard
+ */
+int sht_shard_of(const sht_table* sht, const uint64_t hash) {
+  return (int)((hash >> (SHT_SHARD_SHIFT - sht->shard_bits)) & (uint64_t)(sht->num_shards - 1));
+}
+
+
+/**
+ * sht_get_shard() - returns the shard for a key
+ *
+ * @param sht is a pointer to the table
+ * @param key is the key
+ *
+ * @return the shard
+ */
+ht_hash_table* sht_get_shard(sht_table* sht, const char* key) {
+  return sht->shards[sht_shard_of(sht, ht_hash_string(key))];
+}
+
+
+/**
+ * sht_insert() - inserts an element into its shard
+ *
+ * @param sht is a pointer to the table
+ * @param key is the key
+ * @param value is the value, from ht_alloc_value() on the key's shard
+ */
+void sht_insert(sht_table* sht, const char* key, void* value) {
+  const uint64_t hash = ht_hash_string(key);
+  ht_insert_hashed(sht->shards[sht_shard_of(sht, hash)], key, hash, value);
+}
+
+
+/**
+ * sht_search() - searches the key's shard for an element
+ *
+ * @param sht is a pointer to the table
+ * @param key is the key
+ *
+ * @return the value or NULL if the key is not in the table
+ */
+void* sht_search(sht_table* sht, const char* key) {
+  return ht_search(sht_get_shard(sht, key), key);
+}
+
+
+/**
+ * sht_delete() - deletes an element from its shard
+ *
+ * @param sht is a pointer to the table
+ * @param key is the key
+ */
+void sht_delete(sht_table* sht, const char* key) {
+  ht_delete(sht_get_shard(sht, key), key);
+}
+
+
+/**
+ * sht_count() - counts the elements in every shard
+ *
+ * @param sht is a pointer to the table
+ *
+ * @return the number of elements
+ */
+long sht_count(const sht_table* sht) {
+  long count = 0;
+  for (int i = 0; i < sht->num_shards; i++) {
+    count += sht->shards[i]->count;
+  }
+  return count;
+}
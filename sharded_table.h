@@ -0,0 +1,61 @@
+/**
+ * sharded_table.h - Sharded hash table header file
+ *
+ * @brief   This is the header file for a hash table split into a power of two
+ * number of independent shards.  Each shard is an ordinary ht_hash_table with
+ * its own arena; a key always lives in the shard picked by bits of its hash, so
+ * different threads can build different shards at the same time without any
+ * locking (see loadTeamInfoCsvParallel() in appHelpers.c).
+*/
+
+#ifndef _SHARDED_TABLE_H_
+#define _SHARDED_TABLE_H_
+
+#include <stdint.h>
+#include "hash_table.h"
+
+// constants
+#define SHT_MAX_SHARDS      256
+
+// the shard index is taken from the hash bits just below the 7 bits that
+// the shards use for their control bytes, so it doesn't weaken the tags
+#define SHT_SHARD_SHIFT     57
+
+// struct containing the sharded hash table
+typedef struct {
+  int num_shards;             // power of two
+  int shard_bits;             // log2(num_shards)
+  ht_hash_table** shards;
+} sht_table;
+
+
+// API function prototypes
+
+// creates a sharded hash table with room for about base_size slots in total
+sht_table* sht_new(const int num_shards, const int base_size);
+
+// deletes a sharded hash table and all of its shards
+void sht_del_table(sht_table* sht);
+
+// gives every (empty) shard its own arena for keys and values
+int sht_use_arenas(sht_table* sht);
+
+// returns the shard index for a hash from ht_hash_string()
+int sht_shard_of(const sht_table* sht, const uint64_t hash);
+
+// returns the shard that holds (or would hold) key
+ht_hash_table* sht_get_shard(sht_table* sht, const char* key);
+
+// inserts element.  value must come from ht_alloc_value() on sht_get_shard(sht, key)
+void sht_insert(sht_table* sht, const char* key, void* value);
+
+// searches for element in the table
+void* sht_search(sht_table* sht, const char* key);
+
+// deletes an element from the table
+void sht_delete(sht_table* sht, const char* key);
+
+// returns the number of elements in all of the shards
+long sht_count(const sht_table* sht);
+
+#endif
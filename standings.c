@@ -0,0 +1,333 @@
+/**
+ * standings.c - Standings index source code file
+ *
+ * @brief   This is the source code file for the standings index.  Each
+ * conference is a sorted array of pointers to the Team Info records in the hash
+ * table.  Queries are a binary search and a walk over the teams they return,
+ * O(log n + k).  Adding or removing a team is a binary search and a memmove()
+ * of the pointers after it, which is cheap for the tens of teams in a
+ * conference.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "appHelpers.h"
+#include "standings.h"
+
+#define ST_MIN_CAPACITY     16
+
+// Standings Index ADT
+
+// orders two records, best first
+static int st_compare(const TeamInfo_t* a, const TeamInfo_t* b);
+
+// st_compare() for qsort()
+static int st_qsort_compare(const void* a, const void* b);
+
+// first position in a conference that doesn't come before team
+static int st_lower_bound(const st_conference* c, const TeamInfo_t* team);
+
+// the conference list a record belongs in, NULL if its conference isn't valid
+static st_conference* st_conference_of(st_index* st, const TeamInfo_t* team);
+
+
+/**
+ * st_new() - initializes a new, empty standings index
+ *
+ * @return a pointer to the new index or NULL if it could not be allocated
+ */
+st_index* st_new(void) {
+  st_index* st = calloc(1, sizeof(st_index));
+  if (st == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(st_new()): Could not allocate space for the index\n");
+    #endif
+    return NULL;
+  }
+  return st;
+}
+
+
+/**
+ * st_del_index() - deletes a standings index
+ *
+ * The records belong to the hash table and are not freed.  If the table lives
+ * on, detach the index first with ht_remove_observer(ht, st_observe, st).
+ *
+ * @param st is a pointer to the index
+ */
+void st_del_index(st_index* st) {
+  for (int i = 0; i < ST_NUM_CONFS; i++) {
+    free(st->confs[i].teams);
+  }
+  free(st);
+}
+
+
+/**
+ * st_attach() - indexes a hash table's Team Info records and follows its changes
+ *
+ * Registers st_observe() as the table's observer, which adds the records that
+ * are already in the table (appended, and each conference sorted once at the
+ * end instead of inserted one at a time).  From then on the index stays
+ * consistent with the table as long as in-place changes to pts or gd are
+ * bracketed with ht_begin_update() and ht_end_update().
+ *
+ * @param st is a pointer to an empty index
+ * @param ht is a pointer to a hash table of Team Info records (not a snapshot)
+ *
+ * @return 0 if successful, -1 if the table can't be observed or a record
+ * couldn't be indexed
+ */
+int st_attach(st_index* st, ht_hash_table* ht) {
+  const long errors = st->errors;
+  st->loading = 1;
+  const int status = ht_add_observer(ht, st_observe, st);
+  st->loading = 0;
+  for (int i = 0; i < ST_NUM_CONFS; i++) {
+    qsort(st->confs[i].teams, (size_t)st->confs[i].count, sizeof(TeamInfoPtr_t), st_qsort_compare);
+  }
+  if (status != 0) {
+    return -1;
+  }
+  return (st->errors == errors) ? 0 : -1;
+}
+
+
+/**
+ * st_observe() - keeps the index in step with its hash table, see ht_add_observer()
+ *
+ * @param ctx is the index
+ * @param value is the Team Info record that was added or is about to be removed
+ * @param event is HT_VALUE_ADDED, HT_VALUE_REMOVED or HT_VALUE_DELETED
+ */
+void st_observe(void* ctx, void* value, const int event) {
+  st_index* st = ctx;
+  const int status = (event == HT_VALUE_ADDED) ? st_add(st, value) : st_remove(st, value);
+  if (status != 0) {
+    st->errors++;
+  }
+}
+
+
+/**
+ * st_add() - adds a record to its conference's standings
+ *
+ * @param st is a pointer to the index
+ * @param team is the record, its conf, city, pts and gd must be filled in
+ *
+ * @return 0 if successful, -1 if the conference isn't valid or out of memory
+ */
+int st_add(st_index* st, TeamInfoPtr_t team) {
+  st_conference* c = st_conference_of(st, team);
+  if (c == NULL) {
+    return -1;
+  }
+  if (c->count == c->capacity) {
+    const int capacity = (c->capacity == 0) ? ST_MIN_CAPACITY : c->capacity * 2;
+    TeamInfoPtr_t* teams = realloc(c->teams, (size_t)capacity * sizeof(TeamInfoPtr_t));
+    if (teams == NULL) {
+      #if (_DEBUG_ > 0)
+        fprintf(stderr, "ERROR(st_add()): Could not grow the %s standings\n", team->conf);
+      #endif
+      return -1;
+    }
+    c->teams = teams;
+    c->capacity = capacity;
+  }
+
+  const int i = st->loading ? c->count : st_lower_bound(c, team);
+  memmove(&c->teams[i + 1], &c->teams[i], (size_t)(c->count - i) * sizeof(TeamInfoPtr_t));
+  c->teams[i] = team;
+  c->count++;
+  return 0;
+}
+
+
+/**
+ * st_remove() - removes a record from its conference's standings
+ *
+ * The record is found by its fields, so it has to be removed before its conf,
+ * city, pts or gd change (ht_begin_update() does that).
+ *
+ * @param st is a pointer to the index
+ * @param team is the record
+ *
+ * @return 0 if successful, -1 if the record isn't in the index
+ */
+int st_remove(st_index* st, TeamInfoPtr_t team) {
+  st_conference* c = st_conference_of(st, team);
+  if (c == NULL) {
+    return -1;
+  }
+  const int i = st_lower_bound(c, team);
+  if ((i == c->count) || (c->teams[i] != team)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(st_remove()): %s%s is not in the standings\n", team->city, team->conf);
+    #endif
+    return -1;
+  }
+  memmove(&c->teams[i], &c->teams[i + 1], (size_t)(c->count - i - 1) * sizeof(TeamInfoPtr_t));
+  c->count--;
+  return 0;
+}
+
+
+/**
+ * st_count() - returns the number of teams in a conference
+ *
+ * @param st is a pointer to the index
+ * @param conf is the conference
+ *
+ * @return the number of teams
+ */
+int st_count(const st_index* st, const conf_t conf) {
+  return ((int)conf >= 0) && ((int)conf < ST_NUM_CONFS) ? st->confs[conf].count : 0;
+}
+
+
+/**
+ * st_top_k() - lists the first k teams of a conference
+ *
+ * @param st is a pointer to the index
+ * @param conf is the conference
+ * @param k is the number of teams wanted
+ * @param out is set to the teams, best first (room for k)
+ *
+ * @return the number of teams in out, less than k if the conference is smaller
+ */
+int st_top_k(const st_index* st, const conf_t conf, const int k, TeamInfoPtr_t* out) {
+  const int count = st_count(st, conf);
+  const int n = (k < count) ? k : count;
+  if (n <= 0) {
+    return 0;
+  }
+  memcpy(out, st->confs[conf].teams, (size_t)n * sizeof(TeamInfoPtr_t));
+  return n;
+}
+
+
+/**
+ * st_range() - lists the teams of a conference in a range of points
+ *
+ * @param st is a pointer to the index
+ * @param conf is the conference
+ * @param min_pts is the fewest points a team can have
+ * @param max_pts is the most points a team can have
+ * @param out is set to the first max_out teams in the range, best first
+ * @param max_out is the room in out
+ *
+ * @return the number of teams in the range, which can be more than max_out
+ */
+int st_range(const st_index* st, const conf_t conf, const int min_pts, const int max_pts,
+             TeamInfoPtr_t* out, const int max_out) {
+  if ((st_count(st, conf) == 0) || (min_pts > max_pts)) {
+    return 0;
+  }
+  const st_conference* c = &st->confs[conf];
+
+  // the list is sorted by pts descending, find the first team with pts <= max_pts
+  int lo = 0, hi = c->count;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (c->teams[mid]->pts > max_pts) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  int n = 0;
+  for (int i = lo; (i < c->count) && (c->teams[i]->pts >= min_pts); i++, n++) {
+    if (n < max_out) {
+      out[n] = c->teams[i];
+    }
+  }
+  return n;
+}
+
+
+/**
+ * st_compare() - orders two records, best first
+ *
+ * More points first, then the better goal differential.  Ties are broken by
+ * city and then by address so every record has one place in the list and
+ * st_remove() can find it with a binary search.
+ *
+ * @param a is a record
+ * @param b is a record
+ *
+ * @return < 0 if a comes first, > 0 if b comes first, 0 if they are the same record
+ */
+static int st_compare(const TeamInfo_t* a, const TeamInfo_t* b) {
+  if (a->pts != b->pts) {
+    return (a->pts > b->pts) ? -1 : 1;
+  }
+  if (a->gd != b->gd) {
+    return (a->gd > b->gd) ? -1 : 1;
+  }
+  const int cmp = strcmp(a->city, b->city);
+  if (cmp != 0) {
+    return cmp;
+  }
+  return (a < b) ? -1 : (a > b);
+}
+
+
+/**
+ * st_qsort_compare() - st_compare() for two elements of a conference list
+ *
+ * @param a is a pointer to a TeamInfoPtr_t
+ * @param b is a pointer to a TeamInfoPtr_t
+ *
+ * @return see st_compare()
+ */
+static int st_qsort_compare(const void* a, const void* b) {
+  return st_compare(*(const TeamInfoPtr_t*)a, *(const TeamInfoPtr_t*)b);
+}
+
+
+/**
+ * st_lower_bound() - finds where a record is (or would go) in a conference
+ *
+ * @param c is the conference
+ * @param team is the record
+ *
+ * @return the first position whose record doesn't come before team
+ */
+static int st_lower_bound(const st_conference* c, const TeamInfo_t* team) {
+  int lo = 0, hi = c->count;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (st_compare(c->teams[mid], team) < 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+
+/**
+ * st_conference_of() - finds the list a record belongs in
+ *
+ * @param st is a pointer to the index
+ * @param team is the record
+ *
+ * @return the conference or NULL if the record's conf isn't NWSL, EAST or WEST
+ */
+static st_conference* st_conference_of(st_index* st, const TeamInfo_t* team) {
+  conf_t conf;
+  if (parseConf(team->conf, &conf) != 0) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(st_conference_of()): Unknown conference %s\n", team->conf);
+    #endif
+    return NULL;
+  }
+  return &st->confs[conf];
+}
@@ -0,0 +1,67 @@
+/**
+ * standings.h - Standings index header file
+ *
+ * @brief   This is the header file for a secondary index over the Team Info
+ * records in a hash table.  The hash table only finds a team by its key; the
+ * index keeps each conference's teams in standings order (most points first,
+ * then goal differential) so the top of a conference or the teams in a range
+ * of points can be listed without dumping and sorting the whole table.
+ *
+ * The index follows the hash table through ht_add_observer(): inserts, deletes
+ * and replaced values are picked up by the table, and code that changes a
+ * record in place brackets the change with ht_begin_update() and
+ * ht_end_update() (see applyMatchResult() in appHelpers.c).
+*/
+
+#ifndef _STANDINGS_H_
+#define _STANDINGS_H_
+
+#include "hash_table.h"
+
+// constants
+#define ST_NUM_CONFS        3     // one list for each conf_t (NWSL, EAST, WEST)
+
+// one conference's teams, best first
+typedef struct {
+  TeamInfoPtr_t* teams;
+  int count;
+  int capacity;
+} st_conference;
+
+// struct containing the standings index
+typedef struct {
+  st_conference confs[ST_NUM_CONFS];
+  long errors;        // records the observer couldn't add or find (bad conference, out of memory)
+  int loading;        // st_attach() is adding the table's records, they are sorted afterwards
+} st_index;
+
+
+// API function prototypes
+
+// creates an empty standings index
+st_index* st_new(void);
+
+// deletes the index (not the records, they belong to the hash table)
+void st_del_index(st_index* st);
+
+// indexes the records in a hash table and keeps following its changes
+int st_attach(st_index* st, ht_hash_table* ht);
+
+// the ht_observer that st_attach() registers
+void st_observe(void* ctx, void* value, const int event);
+
+// adds a record, or removes it using its current points and goal differential
+int st_add(st_index* st, TeamInfoPtr_t team);
+int st_remove(st_index* st, TeamInfoPtr_t team);
+
+// number of teams in a conference
+int st_count(const st_index* st, const conf_t conf);
+
+// the first k teams of a conference, best first
+int st_top_k(const st_index* st, const conf_t conf, const int k, TeamInfoPtr_t* out);
+
+// the teams of a conference with min_pts <= pts <= max_pts, best first
+int st_range(const st_index* st, const conf_t conf, const int min_pts, const int max_pts,
+             TeamInfoPtr_t* out, const int max_out);
+
+#endif
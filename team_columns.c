@@ -0,0 +1,474 @@
+/**
+ * team_columns.c - Columnar team store source code file
+ *
+ * @brief   This is the source code file for the columnar team store.  The
+ * aggregates and filters walk the columns in blocks of 16 rows: with SSE2 the
+ * 16 conference bytes are compared at once and the resulting mask is widened
+ * to select 4 ints at a time from each column, so the loops are limited by
+ * memory bandwidth rather than by branches.  The sums are widened to 64 bits
+ * as they are added, so they can't overflow.  Without SSE2 the same loops run
+ * one row at a time.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "appHelpers.h"
+#include "team_columns.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define TC_MIN_CAPACITY     64
+
+// Columnar Team Store ADT
+
+// makes room for one more row
+static int tc_grow(tc_store* tc);
+
+// the rows of a conference, row by row (the tail of the SSE2 loops)
+static void tc_totals_rows(const tc_store* tc, const int conf, int row, tc_totals_t* totals);
+static int tc_filter_rows(const tc_store* tc, const int conf, const int column, const int threshold,
+                          int row, uint32_t* rows, int n);
+
+#if defined(__SSE2__)
+// masks that select the rows of a conference out of the next 16 rows
+static inline __m128i tc_conf_mask(const tc_store* tc, const int conf, const int row);
+static inline void tc_widen_mask(const __m128i mask8, __m128i mask32[4]);
+#endif
+
+
+/**
+ * tc_new() - initializes a new, empty columnar store
+ *
+ * The store keeps its row ids in ht: every value in the table is a uint32_t row
+ * id allocated with ht_alloc_value(), so give the table an arena.  The store
+ * registers itself as an observer of the table, so deleting a key from the
+ * table (tc_delete() or ht_delete_packed()) drops its row.
+ *
+ * @param ht is an empty hash table in HT_KEY_PACKED mode
+ *
+ * @return a pointer to the new store or NULL if the table isn't suitable or out
+ * of memory
+ */
+tc_store* tc_new(ht_hash_table* ht) {
+  if ((ht->key_mode != HT_KEY_PACKED) || (ht->count != 0)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(tc_new()): The table must be empty and use packed keys\n");
+    #endif
+    return NULL;
+  }
+  tc_store* tc = calloc(1, sizeof(tc_store));
+  if (tc == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(tc_new()): Could not allocate space for the store\n");
+    #endif
+    return NULL;
+  }
+  tc->ht = ht;
+  if (ht_add_observer(ht, tc_observe, tc) != 0) {
+    free(tc);
+    return NULL;
+  }
+  return tc;
+}
+
+
+/**
+ * tc_del_store() - deletes a columnar store
+ *
+ * The hash table is left alone; its values are only row ids, so delete it too
+ * unless the caller has another use for the keys.
+ *
+ * @param tc is a pointer to the store
+ */
+void tc_del_store(tc_store* tc) {
+  ht_remove_observer(tc->ht, tc_observe, tc);
+  for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+    free(tc->cols[c]);
+  }
+  free(tc->conf);
+  free(tc->city);
+  free(tc->name);
+  free(tc->refs);
+  free(tc);
+}
+
+
+/**
+ * tc_insert() - inserts a team, or replaces the row of a team that's already there
+ *
+ * @param tc is a pointer to the store
+ * @param info is the team, the key is made from its conf and city
+ *
+ * @return the team's row id, -1 if the conference or city isn't valid or out of memory
+ */
+int tc_insert(tc_store* tc, const TeamInfo_t* info) {
+  ht_packed_key key;
+  conf_t conf;
+
+  if ((parseConf(info->conf, &conf) != 0) || (ht_pack_key(&key, conf, info->city) != 0)) {
+    return -1;
+  }
+  int row = tc_find(tc, &key);
+  if (row < 0) {
+    if (tc_grow(tc) != 0) {
+      return -1;
+    }
+    uint32_t* id = ht_alloc_value(tc->ht, sizeof(uint32_t));
+    if (id == NULL) {
+      return -1;
+    }
+    row = tc->count;
+    *id = (uint32_t)row;
+    tc->refs[row] = id;
+    tc->count++;
+
+    const int count = tc->ht->count;
+    ht_insert_packed(tc->ht, &key, id);
+    if (tc->ht->count == count) {   // the table couldn't take the key
+      tc->count--;
+      ht_free_value(tc->ht, id);
+      return -1;
+    }
+  }
+
+  tc->cols[TC_PTS][row] = info->pts;
+  tc->cols[TC_WIN][row] = info->win;
+  tc->cols[TC_LOSS][row] = info->loss;
+  tc->cols[TC_TIE][row] = info->tie;
+  tc->cols[TC_GD][row] = info->gd;
+  tc->conf[row] = (uint8_t)conf;
+  strcpy(tc->city[row], info->city);
+  strcpy(tc->name[row], info->name);
+  return row;
+}
+
+
+/**
+ * tc_find() - finds a team's row
+ *
+ * @param tc is a pointer to the store
+ * @param key is the team's key from ht_pack_key()
+ *
+ * @return the row id, -1 if the team isn't in the store
+ */
+int tc_find(tc_store* tc, const ht_packed_key* key) {
+  const uint32_t* id = ht_search_packed(tc->ht, key);
+  return (id != NULL) ? (int)*id : -1;
+}
+
+
+/**
+ * tc_delete() - deletes a team
+ *
+ * The last row is moved into the team's row (see tc_observe()).
+ *
+ * @param tc is a pointer to the store
+ * @param key is the team's key from ht_pack_key()
+ */
+void tc_delete(tc_store* tc, const ht_packed_key* key) {
+  ht_delete_packed(tc->ht, key);
+}
+
+
+/**
+ * tc_get() - copies a row into a Team Info record
+ *
+ * @param tc is a pointer to the store
+ * @param row is the row id (0 <= row < tc->count)
+ * @param info is filled in with the row
+ */
+void tc_get(const tc_store* tc, const int row, TeamInfo_t* info) {
+  static const char* const confNames[] = {"NWSL", "EAST", "WEST"};
+
+  strcpy(info->conf, confNames[tc->conf[row]]);
+  strcpy(info->city, tc->city[row]);
+  strcpy(info->name, tc->name[row]);
+  info->pts = tc->cols[TC_PTS][row];
+  info->win = tc->cols[TC_WIN][row];
+  info->loss = tc->cols[TC_LOSS][row];
+  info->tie = tc->cols[TC_TIE][row];
+  info->gd = tc->cols[TC_GD][row];
+}
+
+
+/**
+ * tc_observe() - drops the row of a key that is deleted from the table
+ *
+ * The last row is moved into the hole and its id in the table is updated, so
+ * the rows stay dense.  Only HT_VALUE_REMOVED and HT_VALUE_DELETED matter,
+ * tc_insert() adds the rows itself.
+ *
+ * @param ctx is the store
+ * @param value is the row id that is about to be freed by the table
+ * @param event is HT_VALUE_ADDED, HT_VALUE_REMOVED or HT_VALUE_DELETED
+ */
+void tc_observe(void* ctx, void* value, const int event) {
+  tc_store* tc = ctx;
+  uint32_t* id = value;
+
+  if (event == HT_VALUE_ADDED) {
+    return;
+  }
+  const int row = (int)*id;
+  if ((row >= tc->count) || (tc->refs[row] != id)) {
+    tc->errors++;
+    return;
+  }
+  const int last = --tc->count;
+  if (row != last) {
+    for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+      tc->cols[c][row] = tc->cols[c][last];
+    }
+    tc->conf[row] = tc->conf[last];
+    memcpy(tc->city[row], tc->city[last], sizeof(tc->city[0]));
+    memcpy(tc->name[row], tc->name[last], sizeof(tc->name[0]));
+    tc->refs[row] = tc->refs[last];
+    *tc->refs[row] = (uint32_t)row;
+  }
+}
+
+
+/**
+ * tc_totals() - adds up every column over the rows of a conference
+ *
+ * @param tc is a pointer to the store
+ * @param conf is a conf_t, or TC_ALL_CONFS for every row
+ * @param totals is set to the number of rows and the sum of each column
+ *
+ * @return the number of rows
+ */
+long tc_totals(const tc_store* tc, const int conf, tc_totals_t* totals) {
+  int row = 0;
+
+  memset(totals, 0, sizeof(tc_totals_t));
+#if defined(__SSE2__)
+  __m128i sums[TC_NUM_COLUMNS];
+  for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+    sums[c] = _mm_setzero_si128();
+  }
+  for (; row + 16 <= tc->count; row += 16) {
+    const __m128i mask8 = tc_conf_mask(tc, conf, row);
+    __m128i mask32[4];
+    tc_widen_mask(mask8, mask32);
+    totals->count += __builtin_popcount((unsigned)_mm_movemask_epi8(mask8));
+
+    for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+      const int* col = tc->cols[c] + row;
+      for (int q = 0; q < 4; q++) {
+        // the selected ints, sign extended to two pairs of 64-bit lanes
+        const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(col + 4 * q)), mask32[q]);
+        const __m128i sign = _mm_srai_epi32(v, 31);
+        sums[c] = _mm_add_epi64(sums[c], _mm_unpacklo_epi32(v, sign));
+        sums[c] = _mm_add_epi64(sums[c], _mm_unpackhi_epi32(v, sign));
+      }
+    }
+  }
+  for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, sums[c]);
+    totals->sums[c] = (long)(lanes[0] + lanes[1]);
+  }
+#endif
+  tc_totals_rows(tc, conf, row, totals);
+  return totals->count;
+}
+
+
+/**
+ * tc_average() - average of a column over the rows of a conference
+ *
+ * @param tc is a pointer to the store
+ * @param conf is a conf_t, or TC_ALL_CONFS for every row
+ * @param column is TC_PTS, TC_WIN, TC_LOSS, TC_TIE or TC_GD
+ *
+ * @return the average, 0 if there are no rows
+ */
+double tc_average(const tc_store* tc, const int conf, const int column) {
+  tc_totals_t totals;
+  if ((column < 0) || (column >= TC_NUM_COLUMNS) || (tc_totals(tc, conf, &totals) == 0)) {
+    return 0.0;
+  }
+  return (double)totals.sums[column] / (double)totals.count;
+}
+
+
+/**
+ * tc_filter_greater() - finds the rows whose column is greater than a threshold
+ *
+ * ex: tc_filter_greater(tc, TC_ALL_CONFS, TC_GD, 10, rows) for every team with
+ * a goal differential over 10.
+ *
+ * @param tc is a pointer to the store
+ * @param conf is a conf_t, or TC_ALL_CONFS for every row
+ * @param column is TC_PTS, TC_WIN, TC_LOSS, TC_TIE or TC_GD
+ * @param threshold is the value the column has to be greater than
+ * @param rows is set to the row ids in order (room for tc->count), NULL to only
+ * count them
+ *
+ * @return the number of rows
+ */
+int tc_filter_greater(const tc_store* tc, const int conf, const int column, const int threshold,
+                      uint32_t* rows) {
+  int row = 0, n = 0;
+
+  if ((column < 0) || (column >= TC_NUM_COLUMNS)) {
+    return 0;
+  }
+#if defined(__SSE2__)
+  const __m128i limit = _mm_set1_epi32(threshold);
+  const int* col = tc->cols[column];
+  for (; row + 16 <= tc->count; row += 16) {
+    __m128i mask32[4];
+    tc_widen_mask(tc_conf_mask(tc, conf, row), mask32);
+    for (int q = 0; q < 4; q++) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(col + row + 4 * q));
+      unsigned bits = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(
+                        _mm_and_si128(_mm_cmpgt_epi32(v, limit), mask32[q])));
+      if (rows == NULL) {
+        n += __builtin_popcount(bits);
+        continue;
+      }
+      while (bits != 0) {
+        rows[n++] = (uint32_t)(row + 4 * q + __builtin_ctz(bits));
+        bits &= bits - 1;
+      }
+    }
+  }
+#endif
+  return tc_filter_rows(tc, conf, column, threshold, row, rows, n);
+}
+
+
+/**
+ * tc_grow() - makes room for one more row
+ *
+ * @param tc is a pointer to the store
+ *
+ * @return 0 if successful, -1 if out of memory
+ */
+static int tc_grow(tc_store* tc) {
+  if (tc->count < tc->capacity) {
+    return 0;
+  }
+  const int capacity = (tc->capacity == 0) ? TC_MIN_CAPACITY : tc->capacity * 2;
+
+  // each array is grown on its own, a failure leaves the ones before it bigger
+  for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+    int* col = realloc(tc->cols[c], (size_t)capacity * sizeof(int));
+    if (col == NULL) {
+      return -1;
+    }
+    tc->cols[c] = col;
+  }
+  uint8_t* conf = realloc(tc->conf, (size_t)capacity);
+  if (conf == NULL) {
+    return -1;
+  }
+  tc->conf = conf;
+  char (*city)[MAX_CITY_NAME + 1] = realloc(tc->city, (size_t)capacity * sizeof(tc->city[0]));
+  if (city == NULL) {
+    return -1;
+  }
+  tc->city = city;
+  char (*name)[MAX_TEAM_NAME + 1] = realloc(tc->name, (size_t)capacity * sizeof(tc->name[0]));
+  if (name == NULL) {
+    return -1;
+  }
+  tc->name = name;
+  uint32_t** refs = realloc(tc->refs, (size_t)capacity * sizeof(uint32_t*));
+  if (refs == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(tc_grow()): Could not grow the store to %d rows\n", capacity);
+    #endif
+    return -1;
+  }
+  tc->refs = refs;
+  tc->capacity = capacity;
+  return 0;
+}
+
+
+/**
+ * tc_totals_rows() - adds the rows from row on to totals, one at a time
+ *
+ * @param tc is a pointer to the store
+ * @param conf is a conf_t, or TC_ALL_CONFS for every row
+ * @param row is the first row
+ * @param totals is added to
+ */
+static void tc_totals_rows(const tc_store* tc, const int conf, int row, tc_totals_t* totals) {
+  for (; row < tc->count; row++) {
+    if ((conf == TC_ALL_CONFS) || (tc->conf[row] == conf)) {
+      totals->count++;
+      for (int c = 0; c < TC_NUM_COLUMNS; c++) {
+        totals->sums[c] += tc->cols[c][row];
+      }
+    }
+  }
+}
+
+
+/**
+ * tc_filter_rows() - tc_filter_greater() from row on, one row at a time
+ *
+ * @param tc is a pointer to the store
+ * @param conf is a conf_t, or TC_ALL_CONFS for every row
+ * @param column is the column
+ * @param threshold is the value the column has to be greater than
+ * @param row is the first row
+ * @param rows is the row ids found so far, or NULL
+ * @param n is the number of rows found so far
+ *
+ * @return the number of rows found
+ */
+static int tc_filter_rows(const tc_store* tc, const int conf, const int column, const int threshold,
+                          int row, uint32_t* rows, int n) {
+  for (; row < tc->count; row++) {
+    if (((conf == TC_ALL_CONFS) || (tc->conf[row] == conf)) && (tc->cols[column][row] > threshold)) {
+      if (rows != NULL) {
+        rows[n] = (uint32_t)row;
+      }
+      n++;
+    }
+  }
+  return n;
+}
+
+
+#if defined(__SSE2__)
+/**
+ * tc_conf_mask() - selects the rows of a conference out of 16 rows
+ *
+ * @param tc is a pointer to the store
+ * @param conf is a conf_t, or TC_ALL_CONFS for every row
+ * @param row is the first of the 16 rows
+ *
+ * @return 0xff in byte i if row + i is selected, 0 if it isn't
+ */
+static inline __m128i tc_conf_mask(const tc_store* tc, const int conf, const int row) {
+  if (conf == TC_ALL_CONFS) {
+    return _mm_set1_epi8((char)0xff);
+  }
+  return _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(tc->conf + row)), _mm_set1_epi8((char)conf));
+}
+
+
+/**
+ * tc_widen_mask() - widens a mask of 16 bytes to 4 masks of 4 ints
+ *
+ * @param mask8 is the mask from tc_conf_mask()
+ * @param mask32 is set to the masks for rows 0-3, 4-7, 8-11 and 12-15
+ */
+static inline void tc_widen_mask(const __m128i mask8, __m128i mask32[4]) {
+  const __m128i lo = _mm_unpacklo_epi8(mask8, mask8);
+  const __m128i hi = _mm_unpackhi_epi8(mask8, mask8);
+  mask32[0] = _mm_unpacklo_epi16(lo, lo);
+  mask32[1] = _mm_unpackhi_epi16(lo, lo);
+  mask32[2] = _mm_unpacklo_epi16(hi, hi);
+  mask32[3] = _mm_unpackhi_epi16(hi, hi);
+}
+#endif
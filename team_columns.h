@@ -0,0 +1,85 @@
+/**
+ * team_columns.h - Columnar team store header file
+ *
+ * @brief   This is the header file for a struct-of-arrays store of team
+ * records for analytics.  Instead of one TeamInfo_t allocation per team, the
+ * stats live in one contiguous int array per column (pts, win, loss, tie, gd)
+ * and a team is a row id.  The hash table maps a team's packed key to its row
+ * id, so lookups still take one probe, while totals, averages and filters run
+ * down the columns without dereferencing a pointer per team.
+ *
+ * The rows are kept dense: deleting a team moves the last row into its place
+ * and updates that row's id in the hash table, so a scan never skips holes.
+ * Row ids are therefore only stable until the next delete.
+*/
+
+#ifndef _TEAM_COLUMNS_H_
+#define _TEAM_COLUMNS_H_
+
+#include <stdint.h>
+#include "hash_table.h"
+
+// columns of stats
+#define TC_PTS              0
+#define TC_WIN              1
+#define TC_LOSS             2
+#define TC_TIE              3
+#define TC_GD               4
+#define TC_NUM_COLUMNS      5
+
+#define TC_ALL_CONFS        (-1)  // conf argument that selects every row
+
+// struct containing the store
+typedef struct {
+  int count;                  // number of rows
+  int capacity;
+  int* cols[TC_NUM_COLUMNS];  // the stats, cols[TC_PTS][row] is the row's points
+  uint8_t* conf;              // conf_t of each row
+  char (*city)[MAX_CITY_NAME + 1];
+  char (*name)[MAX_TEAM_NAME + 1];
+  uint32_t** refs;            // each row's id in the hash table, updated when the row moves
+  ht_hash_table* ht;          // HT_KEY_PACKED table whose values are the row ids
+  long errors;                // rows the observer couldn't find
+} tc_store;
+
+// what tc_totals() adds up
+typedef struct {
+  long count;                 // rows selected
+  long sums[TC_NUM_COLUMNS];  // sum of each column over those rows
+} tc_totals_t;
+
+
+// API function prototypes
+
+// creates a store whose row ids are kept in an empty HT_KEY_PACKED hash table
+tc_store* tc_new(ht_hash_table* ht);
+
+// deletes the store (the hash table is left to the caller)
+void tc_del_store(tc_store* tc);
+
+// inserts a team or replaces its row, returns the row id
+int tc_insert(tc_store* tc, const TeamInfo_t* info);
+
+// returns the row id of a team, -1 if it isn't in the store
+int tc_find(tc_store* tc, const ht_packed_key* key);
+
+// deletes a team
+void tc_delete(tc_store* tc, const ht_packed_key* key);
+
+// copies a row into a TeamInfo_t
+void tc_get(const tc_store* tc, const int row, TeamInfo_t* info);
+
+// the ht_observer that tc_new() registers, drops the rows deleted from the table
+void tc_observe(void* ctx, void* value, const int event);
+
+// adds up every column over the rows of a conference (or TC_ALL_CONFS)
+long tc_totals(const tc_store* tc, const int conf, tc_totals_t* totals);
+
+// average of a column over the rows of a conference (or TC_ALL_CONFS)
+double tc_average(const tc_store* tc, const int conf, const int column);
+
+// the rows of a conference (or TC_ALL_CONFS) whose column is > threshold
+int tc_filter_greater(const tc_store* tc, const int conf, const int column, const int threshold,
+                      uint32_t* rows);
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * team_record.c - Packed team records source code file
+ *
+ * @brief   This is the source code file for the string pool and for packing
+ * TeamInfo_t records into tr_records and back.  The pool's strings live in
+ * one growing buffer, so a string is named by its offset and the offsets stay
+ * good when the buffer is reallocated.  The index over the strings is linear
+ * probing on ht_hash_string(), kept at most half full.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "appHelpers.h"
+#include "team_record.h"
+
+// conference names for tr_unpack(), indexed by conf_t
+static const char* const tr_conf_names[] = {"NWSL", "EAST", "WEST"};
+
+// Packed Team Record ADT
+
+// doubles the size of the pool's index
+static int tr_grow_index(tr_pool* pool);
+
+// checks that a stat fits in a packed record
+static int tr_stat_fits(const int stat);
+
+
+/**
+ * tr_pool_new() - initializes a new, empty string pool
+ *
+ * @return a pointer to the new pool or NULL if out of memory
+ */
+tr_pool* tr_pool_new(void) {
+  tr_pool* pool = calloc(1, sizeof(tr_pool));
+  if (pool == NULL) {
+    return NULL;
+  }
+  pool->capacity = TR_POOL_MIN_SIZE;
+  pool->index_size = TR_POOL_MIN_SIZE;
+  pool->chars = malloc(pool->capacity);
+  pool->index = calloc((size_t)pool->index_size, sizeof(uint32_t));
+  if ((pool->chars == NULL) || (pool->index == NULL)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(tr_pool_new()): Could not allocate space for the pool\n");
+    #endif
+    tr_pool_del(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+
+/**
+ * tr_pool_del() - deletes a string pool and every string in it
+ *
+ * @param pool is a pointer to the pool
+ */
+void tr_pool_del(tr_pool* pool) {
+  free(pool->chars);
+  free(pool->index);
+  free(pool);
+}
+
+
+/**
+ * tr_intern() - finds a string in the pool, adding it if it isn't there
+ *
+ * @param pool is a pointer to the pool
+ * @param s is the string
+ *
+ * @return the offset of the pool's copy of s (see tr_str()), -1 if out of
+ * memory or the pool is full (offsets are 32 bits)
+ */
+long tr_intern(tr_pool* pool, const char* s) {
+  const size_t len = strlen(s) + 1;
+  if (((pool->count + 1) * 2 > pool->index_size) && (tr_grow_index(pool) != 0)) {
+    return -1;
+  }
+
+  const int mask = pool->index_size - 1;
+  int pos = (int)(ht_hash_string(s) & (uint64_t)mask);
+
+  while (pool->index[pos] != 0) {
+    if (strcmp(pool->chars + pool->index[pos] - 1, s) == 0) {
+      return (long)pool->index[pos] - 1;
+    }
+    pos = (pos + 1) & mask;
+  }
+
+  if (pool->used + len >= UINT32_MAX) {
+    return -1;
+  }
+  if (pool->used + len > pool->capacity) {
+    size_t capacity = pool->capacity * 2;
+    while (capacity < pool->used + len) {
+      capacity *= 2;
+    }
+    char* chars = realloc(pool->chars, capacity);
+    if (chars == NULL) {
+      return -1;
+    }
+    pool->chars = chars;
+    pool->capacity = capacity;
+  }
+
+  const size_t offset = pool->used;
+  memcpy(pool->chars + offset, s, len);
+  pool->used += len;
+  pool->index[pos] = (uint32_t)offset + 1;
+  pool->count++;
+  return (long)offset;
+}
+
+
+/**
+ * tr_pool_bytes() - bytes of memory the pool takes
+ *
+ * @param pool is a pointer to the pool
+ *
+ * @return the size of the pool, its string buffer and its index
+ */
+size_t tr_pool_bytes(const tr_pool* pool) {
+  return sizeof(tr_pool) + pool->capacity + (size_t)pool->index_size * sizeof(uint32_t);
+}
+
+
+/**
+ * tr_pack() - packs a team info record
+ *
+ * @param pool is the pool to intern the city and the team name in
+ * @param info is the record to pack
+ * @param record is filled in with the packed record
+ *
+ * @return 0 on success, -1 if the conference isn't valid, a stat doesn't fit in
+ * 16 bits or the pool is out of memory
+ */
+int tr_pack(tr_pool* pool, const TeamInfo_t* info, tr_record* record) {
+  conf_t conf;
+
+  if ((parseConf(info->conf, &conf) != 0) || !tr_stat_fits(info->pts) || !tr_stat_fits(info->win) ||
+      !tr_stat_fits(info->loss) || !tr_stat_fits(info->tie) || !tr_stat_fits(info->gd)) {
+    return -1;
+  }
+  const long city = tr_intern(pool, info->city);
+  const long name = tr_intern(pool, info->name);
+  if ((city < 0) || (name < 0)) {
+    return -1;
+  }
+
+  memset(record, 0, sizeof(tr_record));
+  record->city = (uint32_t)city;
+  record->name = (uint32_t)name;
+  record->pts = (int16_t)info->pts;
+  record->win = (int16_t)info->win;
+  record->loss = (int16_t)info->loss;
+  record->tie = (int16_t)info->tie;
+  record->gd = (int16_t)info->gd;
+  record->conf = (uint8_t)conf;
+  return 0;
+}
+
+
+/**
+ * tr_unpack() - unpacks a record into a team info record
+ *
+ * @param pool is the pool the record was packed with
+ * @param record is the packed record
+ * @param info is filled in with the team info
+ */
+void tr_unpack(const tr_pool* pool, const tr_record* record, TeamInfo_t* info) {
+  memset(info, 0, sizeof(TeamInfo_t));
+  strcpy(info->conf, tr_conf_names[record->conf]);
+  strncpy(info->city, tr_str(pool, record->city), MAX_CITY_NAME);
+  strncpy(info->name, tr_str(pool, record->name), MAX_TEAM_NAME);
+  info->pts = record->pts;
+  info->win = record->win;
+  info->loss = record->loss;
+  info->tie = record->tie;
+  info->gd = record->gd;
+}
+
+
+/**
+ * tr_grow_index() - doubles the size of the pool's index
+ *
+ * @param pool is a pointer to the pool
+ *
+ * @return 0 on success, -1 if out of memory (the old index is kept)
+ */
+static int tr_grow_index(tr_pool* pool) {
+  const int size = pool->index_size * 2;
+  uint32_t* index = calloc((size_t)size, sizeof(uint32_t));
+  if (index == NULL) {
+    return -1;
+  }
+  for (int i = 0; i < pool->index_size; i++) {
+    if (pool->index[i] != 0) {
+      int pos = (int)(ht_hash_string(pool->chars + pool->index[i] - 1) & (uint64_t)(size - 1));
+      while (index[pos] != 0) {
+        pos = (pos + 1) & (size - 1);
+      }
+      index[pos] = pool->index[i];
+    }
+  }
+  free(pool->index);
+  pool->index = index;
+  pool->index_size = size;
+  return 0;
+}
+
+
+/**
+ * tr_stat_fits() - checks that a stat fits in the 16 bits of a packed record
+ *
+ * @param stat is the stat
+ *
+ * @return 1 if it fits, 0 if it doesn't
+ */
+static int tr_stat_fits(const int stat) {
+  return (stat >= TR_STAT_MIN) && (stat <= TR_STAT_MAX);
+}
@@ -0,0 +1,85 @@
+/**
+ * team_record.h - Packed team records header file
+ *
+ * @brief   This is the header file for tr_record, a 20-byte form of
+ * TeamInfo_t for tables with tens of millions of teams.  The stats are 16-bit
+ * ints, the conference is a byte and the city and team name are offsets into
+ * a string pool that stores each distinct string once, so the cities shared
+ * by several teams are only stored once.  A TeamInfo_t is 72 bytes.
+ *
+ * trt_table is the ht_template.h table of packed records by packed key, so a
+ * team costs one slot (key, record and hash) and its share of the pool:
+ *
+ *   tr_pool* pool = tr_pool_new();
+ *   trt_table* trt = trt_new(2 * num_teams);
+ *   tr_pack(pool, &info, &record);
+ *   trt_insert(trt, &key, &record);
+ *   tr_unpack(pool, trt_search(trt, &key), &info);
+*/
+
+#ifndef _TEAM_RECORD_H_
+#define _TEAM_RECORD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash_table.h"
+#include "ht_template.h"
+
+// constants
+#define TR_STAT_MIN         INT16_MIN     // range of the stats in a packed record
+#define TR_STAT_MAX         INT16_MAX
+#define TR_POOL_MIN_SIZE    1024          // initial bytes (and index slots) of a pool
+
+// a team record with narrow stats and pooled names
+typedef struct {
+  uint32_t  city;       // offset of the city in the string pool
+  uint32_t  name;       // offset of the team name in the string pool
+  int16_t   pts;
+  int16_t   win;
+  int16_t   loss;
+  int16_t   tie;
+  int16_t   gd;
+  uint8_t   conf;       // conf_t
+  uint8_t   unused;
+} tr_record;
+
+// struct containing the string pool.  Each distinct string is stored once,
+// '\0' terminated, and found again through an open addressing index of offsets
+typedef struct {
+  char* chars;
+  size_t used;          // bytes of chars in use
+  size_t capacity;
+  uint32_t* index;      // offset + 1 of a string, 0 for an empty slot
+  int index_size;       // a power of two
+  int count;            // distinct strings
+} tr_pool;
+
+HT_DEFINE(trt, ht_packed_key, tr_record, ht_hash_packed_inline, ht_packed_equal)
+
+
+// API function prototypes
+
+// creates an empty string pool
+tr_pool* tr_pool_new(void);
+
+// deletes the pool and its strings
+void tr_pool_del(tr_pool* pool);
+
+// adds a string to the pool if it isn't there yet, returns its offset
+long tr_intern(tr_pool* pool, const char* s);
+
+// bytes the pool takes (strings and index)
+size_t tr_pool_bytes(const tr_pool* pool);
+
+// packs a TeamInfo_t, interning its city and name
+int tr_pack(tr_pool* pool, const TeamInfo_t* info, tr_record* record);
+
+// unpacks a record into a TeamInfo_t
+void tr_unpack(const tr_pool* pool, const tr_record* record, TeamInfo_t* info);
+
+// the string at an offset returned by tr_intern()
+static inline const char* tr_str(const tr_pool* pool, const uint32_t offset) {
+  return pool->chars + offset;
+}
+
+#endif
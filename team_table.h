@@ -0,0 +1,25 @@
+/**
+ * team_table.h - Hash table of TeamInfo_t records stored by value
+ *
+ * @brief   This is the header file for tt_table, the ht_template.h table
+ * specialized for packed (conference, city) keys and TeamInfo_t values.  Each
+ * slot holds the 16-byte key, the record itself and the hash, so a team costs
+ * one slot and no allocations, and a search is one probe with the packed key
+ * hash and compare inlined.  Use it when the records don't need to be shared
+ * with the observers, snapshots or sharded tables of the ht_* table.
+ *
+ *   tt_table* tt = tt_new(2 * num_teams);
+ *   ht_pack_key(&key, EAST, "Atlanta");
+ *   tt_insert(tt, &key, &info);
+ *   TeamInfo_t* t = tt_search(tt, &key);      // good until the next insert/delete
+*/
+
+#ifndef _TEAM_TABLE_H_
+#define _TEAM_TABLE_H_
+
+#include "hash_table.h"
+#include "ht_template.h"
+
+HT_DEFINE(tt, ht_packed_key, TeamInfo_t, ht_hash_packed_inline, ht_packed_equal)
+
+#endif
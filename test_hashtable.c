@@ -16,6 +16,48 @@
  * appHelpers.c will parse a line from the file and place the fields in a
  * struct that this code will operate on.
  *
+ * If the program is started with the name of a snapshot file
+ * (test_hashtable soccer2021.snap) it opens the snapshot instead of reading the
+ * CSV file.  If the snapshot doesn't exist yet, the CSV file is loaded and saved
+ * as the snapshot for next time.  Delete the snapshot after changing the CSV file.
+ *
+ * test_hashtable -r results.csv applies a file of match results (lines like
+ * PortlandNWSL,SeattleWEST,2-1) to the standings after loading the CSV file and
+ * before the prompts, so the lookups show the updated records.  With -r - the
+ * results are read from stdin as they arrive (ex: from a live feed) and the
+ * program exits at the end of the feed.  A snapshot is read-only, so -r always
+ * loads the CSV file.  A standings index (standings.h) follows the table while
+ * the results are applied, and the top STANDINGS_TOP teams of each conference
+ * are listed at the end.
+ *
+ * test_hashtable -w teams.wal -r results.csv keeps a write-ahead log (wal.h) of
+ * the changes the results make.  The log is replayed on top of the CSV file
+ * when the program starts, so the standings pick up where the last run left
+ * off, even if it crashed.  Like -r, -w always loads the CSV file.
+ *
+ * test_hashtable -b queries.txt [-f csv|json] [-o out] is the non-interactive
+ * batch mode for the nightly jobs: each line of the query file is a
+ * conference and a city (ex: NWSL,Portland, // comments and blank lines are
+ * skipped), the queries are looked up a block at a time with
+ * ht_search_packed_batch() and one result per query is written to out (stdout
+ * by default) as CSV or as a JSON array.  With -b - the queries are read from
+ * stdin.  The messages go to stderr in batch mode, ending with the number of
+ * queries per second.  -r and a snapshot can be used with -b.
+ *
+ * test_hashtable -s soccer2021.csv -s soccer2022.csv ... loads a catalog of
+ * seasons (catalog.h) instead, one season per CSV file (the season is the year
+ * in the file name), reading the files at the same time.  Each lookup at the
+ * prompt then shows the team in every season.
+ *
+ * An unknown option, an option without its value or a second snapshot name
+ * prints the usage and exits with 1, so a typo in a batch job fails instead of
+ * writing a snapshot and waiting at the prompt.
+ *
+ * A city ending in '*' at the prompt (ex: New*) lists the teams of the
+ * conference whose city or name starts with the rest of it, from a prefix
+ * index (prefix_index.h) that follows the table.  Any other conference than
+ * NWSL, EAST or WEST lists the matches of every conference.
+ *
  * @requirements
  * - The program should loop and prompt the user for additional
  * record to look up until the user enters an empty line (Enter key), or 'q'
@@ -27,73 +69,587 @@
  *
 */
 
+#define _POSIX_C_SOURCE 200809L   // for clock_gettime()
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 //#include <stdbool.h>
 
 #include "hash_table.h"
 #include "appHelpers.h"
+#include "standings.h"
+#include "prefix_index.h"
+#include "wal.h"
+#include "catalog.h"
 
-int main(){
-	TeamInfoPtr_t tir;						// pointers to a Team Info records
-  TeamInfoPtr_t tir1;
+#define QUERY_BLOCK   4096        // queries looked up per ht_search_packed_batch()
+#define QUERY_OUTBUF  (1 << 20)   // output buffer for the batch mode results
+#define STANDINGS_TOP 10          // teams per conference listed after -r
+#define MAX_MATCHES   20          // teams listed for a city prefix
 
-	char* key = "";							// key for hash table entry
-//  char key2 = "";
+/**
+ * loadTeams() - creates the hash table and loads soccer2021.csv into it
+ *
+ * @param	snapshot	snapshot file to save the table to, or NULL
+ * @param	msgs		stream for the progress and error messages
+ *
+ * @return	the hash table.  Exits the program if it can't be loaded
+ */
+static ht_hash_table* loadTeams(const char* snapshot, FILE* msgs) {
 	ht_hash_table* teams_ht;				// hash table
 
-  //Introduction
-	printf("\nHash Table ADT test program (by Celina Wong, 21-Nov-2021)\n\n");
-    errno = 0;
-    char *buf = getcwd(NULL, 0);    // allocates a buffer large enough to hold the path
-    if (buf == NULL) {
-        perror("getcwd");
-        printf("Could not display the path\n");
-    }
-    else {
-        printf("Current working directory: %s\n", buf);
-        free(buf);
-    }
-    printf("\n");
-
-	// create a hash table
+	// create a hash table with packed (conference, city) keys, its team info
+	// records come from an arena
 	teams_ht = ht_new();
 	if (teams_ht != NULL) {
-		printf("\nCreating a new hash table...\n");
+		fprintf(msgs, "\nCreating a new hash table...\n");
+		ht_set_key_mode(teams_ht, HT_KEY_PACKED);
+		ht_use_arena(teams_ht, arena_new(0));
 	}
 	else {
-		printf("\nERROR: Could not create a new hash table\n");
+		fprintf(msgs, "\nERROR: Could not create a new hash table\n");
 		exit(1);
 	}
 
   // insert team info records in the hash table
-	printf("\nInserting Team Info records into hash table...\n");
+	fprintf(msgs, "\nInserting Team Info records into hash table...\n");
 
-  char line[200];   //to read each row as a string in .csv file
-  //open .csv file
-  FILE *fp = fopen("soccer2021.csv", "r");
-  if (fp == NULL) { //if error in opening file
-    printf("Cannot open file.\n");
+  //load the .csv file into the hash table
+  csvLoadResult_t result;
+  if (loadTeamInfoCsv(teams_ht, "soccer2021.csv", &result) < 0) { //if error in opening file
+    fprintf(msgs, "Cannot open file.\n");
     exit(1);
   }
+  for (long i = 0; (i < result.numErrors) && (i < CSV_MAX_ERRORS); i++) {
+    fprintf(msgs, "ERROR: Could not parse record on line %ld.", result.errors[i].line);
+    fprintf(msgs, "\tNumber of fields parsed = %d\n", result.errors[i].numFields);
+  }
+
+  // save the table so the next run can open it instead
+  if ((snapshot != NULL) && (ht_save_snapshot(teams_ht, snapshot, sizeof(TeamInfo_t)) == 0)) {
+    fprintf(msgs, "Saved snapshot %s\n", snapshot);
+  }
+  return teams_ht;
+}
 
-  //parse .csv file and put into hash table
-  fgets(line, sizeof(line),fp); //get first line
+/**
+ * printStandings() - lists the top STANDINGS_TOP teams of each conference
+ *
+ * @param	standings	standings index of the hash table
+ * @param	fp			file to write to
+ */
+static void printStandings(const st_index* standings, FILE* fp) {
+	static const char* const confNames[] = {"NWSL", "EAST", "WEST"};
+	TeamInfoPtr_t top[STANDINGS_TOP];
 
-  while ((fgets(line, sizeof(line), fp)) != NULL) {  //loop until end of file
-    key++;    //increment key space
-    tir1 = malloc(sizeof(TeamInfo_t));
-    tir = parseTeamInfo(line);  //parse the line
-    memcpy(tir1, tir, sizeof(TeamInfo_t));
-    key = createKey(tir1);  //create key for each team
-    ht_insert(teams_ht, key, tir1); //insert into hash table
+	for (int conf = 0; conf < ST_NUM_CONFS; conf++) {
+		const int n = st_top_k(standings, (conf_t)conf, STANDINGS_TOP, top);
+		if (n == 0) {
+			continue;
+		}
+		fprintf(fp, "\n%s standings (%d teams)\n", confNames[conf], st_count(standings, (conf_t)conf));
+		fprintf(fp, "   %-15s %-20s %4s %4s %4s %4s %4s\n", "City", "Name", "Pts", "W", "L", "T", "GD");
+		for (int i = 0; i < n; i++) {
+			fprintf(fp, "%2d %-15s %-20s %4d %4d %4d %4d %4d\n", i + 1, top[i]->city, top[i]->name,
+			        top[i]->pts, top[i]->win, top[i]->loss, top[i]->tie, top[i]->gd);
+		}
+	}
+}
+
+/**
+ * printMatches() - lists the teams whose city or name starts with a prefix
+ *
+ * @param	prefixes	prefix index of the hash table, or NULL if there isn't one
+ * @param	conf		conference the user entered (not NWSL, EAST or WEST for all)
+ * @param	prefix		what the user typed before the '*'
+ */
+static void printMatches(const px_index* prefixes, const char* conf, const char* prefix) {
+	TeamInfoPtr_t matches[MAX_MATCHES];
+	conf_t c, want;
+	const bool anyConf = (parseConf(conf, &want) != 0);
+
+	if (prefixes == NULL) {
+		printf("\nPrefix searches need the CSV file, not a snapshot\n");
+		return;
+	}
+	const int n = px_search(prefixes, prefix, PX_ANY, matches, MAX_MATCHES);
+	int shown = 0;
+	printf("\nTeams starting with \"%s\":\n", prefix);
+	for (int i = 0; (i < n) && (i < MAX_MATCHES); i++) {
+		if (anyConf || ((parseConf(matches[i]->conf, &c) == 0) && (c == want))) {
+			printf("  %-4s %-15s %s\n", matches[i]->conf, matches[i]->city, matches[i]->name);
+			shown++;
+		}
+	}
+	if (shown == 0) {
+		printf("  none\n");
+	}
+	if (n > MAX_MATCHES) {
+		printf("  ...%d more\n", n - MAX_MATCHES);
+	}
+}
+
+/**
+ * writeCsvField() - writes a CSV field, quoted if it has a comma or a quote in it
+ *
+ * @param	fp			file to write to
+ * @param	s			the field
+ */
+static void writeCsvField(FILE* fp, const char* s) {
+	if (strpbrk(s, ",\"\r\n") == NULL) {
+		fputs(s, fp);
+		return;
+	}
+	fputc('"', fp);
+	for (; *s != '\0'; s++) {
+		if (*s == '"') {
+			fputc('"', fp);
+		}
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+/**
+ * writeJsonString() - writes a JSON string
+ *
+ * @param	fp			file to write to
+ * @param	s			the string
+ */
+static void writeJsonString(FILE* fp, const char* s) {
+	fputc('"', fp);
+	for (; *s != '\0'; s++) {
+		const unsigned char c = (unsigned char)*s;
+		if ((c == '"') || (c == '\\')) {
+			fputc('\\', fp);
+			fputc(c, fp);
+		}
+		else if (c < ' ') {
+			fprintf(fp, "\\u%04x", c);
+		}
+		else {
+			fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+/**
+ * writeQueryResult() - writes the result of one batch mode query
+ *
+ * @param	fp			file to write to
+ * @param	json		true for a JSON object, false for a CSV line
+ * @param	first		true for the first result (no comma before a JSON object)
+ * @param	conf		the conference that was queried
+ * @param	city		the city that was queried
+ * @param	tir			the team info that was found, or NULL
+ */
+static void writeQueryResult(FILE* fp, bool json, bool first, const char* conf, const char* city,
+                             TeamInfoPtr_t tir) {
+	if (!json) {
+		writeCsvField(fp, conf);
+		fputc(',', fp);
+		writeCsvField(fp, city);
+		if (tir == NULL) {
+			fputs(",0,,,,,,\n", fp);
+			return;
+		}
+		fputs(",1,", fp);
+		writeCsvField(fp, tir->name);
+		fprintf(fp, ",%d,%d,%d,%d,%d\n", tir->pts, tir->win, tir->loss, tir->tie, tir->gd);
+		return;
+	}
+	fputs(first ? "\n  {\"conf\": " : ",\n  {\"conf\": ", fp);
+	writeJsonString(fp, conf);
+	fputs(", \"city\": ", fp);
+	writeJsonString(fp, city);
+	if (tir == NULL) {
+		fputs(", \"found\": false}", fp);
+		return;
+	}
+	fputs(", \"found\": true, \"name\": ", fp);
+	writeJsonString(fp, tir->name);
+	fprintf(fp, ", \"pts\": %d, \"win\": %d, \"loss\": %d, \"tie\": %d, \"gd\": %d}",
+	        tir->pts, tir->win, tir->loss, tir->tie, tir->gd);
+}
+
+/**
+ * trimField() - strips the leading and trailing blanks from a field in place
+ *
+ * @param	s			the field
+ *
+ * @return	a pointer to the first character that isn't blank
+ */
+static char* trimField(char* s) {
+	while ((*s == ' ') || (*s == '\t')) {
+		s++;
+	}
+	char* end = s + strlen(s);
+	while ((end > s) && ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r') || (end[-1] == '\n'))) {
+		*--end = '\0';
+	}
+	return s;
+}
+
+/**
+ * runQueries() - looks up a file of "CONF,CITY" queries and writes the results
+ *
+ * @param	teams_ht	hash table with packed keys
+ * @param	in			the queries, one per line
+ * @param	out			file the results are written to
+ * @param	json		true to write a JSON array, false to write CSV
+ * @param	found		set to the number of queries that found a team
+ * @param	invalid		set to the number of lines that weren't a query
+ *
+ * @return	the number of queries
+ *
+ * @note	The queries are read QUERY_BLOCK lines at a time and the valid ones
+ * are looked up with one ht_search_packed_batch() call, which overlaps the cache
+ * misses of the lookups.  An unknown conference, a city that is too long or a
+ * line without a comma can't be in the table; it is written as not found.
+ */
+static long runQueries(ht_hash_table* teams_ht, FILE* in, FILE* out, bool json,
+                       long* found, long* invalid) {
+	static char lines[QUERY_BLOCK][MATCH_MAX_LINE];
+	static char* confs[QUERY_BLOCK];
+	static char* cities[QUERY_BLOCK];
+	static ht_packed_key keys[QUERY_BLOCK];
+	static void* values[QUERY_BLOCK];
+	static bool valid[QUERY_BLOCK];
+	long numQueries = 0;
+	bool eof = false;
+
+	*found = 0;
+	*invalid = 0;
+	fputs(json ? "[" : "conf,city,found,name,pts,win,loss,tie,gd\n", out);
+	while (!eof) {
+		// read a block of queries and pack the keys of the valid ones
+		int n = 0, numKeys = 0;
+		while (n < QUERY_BLOCK) {
+			char* line = lines[n];
+			if (fgets(line, MATCH_MAX_LINE, in) == NULL) {
+				eof = true;
+				break;
+			}
+			bool tooLong = (strchr(line, '\n') == NULL) && !feof(in);
+			if (tooLong) {   // skip the rest of the line
+				int c;
+				while (((c = fgetc(in)) != EOF) && (c != '\n'))
+					;
+			}
+			char* conf = trimField(line);
+			if ((*conf == '\0') || (strncmp(conf, "//", 2) == 0)) {
+				continue;
+			}
+			char* comma = strchr(conf, ',');
+			char* city = "";
+			if (comma != NULL) {
+				*comma = '\0';
+				conf = trimField(conf);
+				city = trimField(comma + 1);
+			}
+			strUpper(conf);
+			strUpper(city);
+
+			conf_t c;
+			valid[n] = !tooLong && (comma != NULL) && (parseConf(conf, &c) == 0) &&
+			           (ht_pack_key(&keys[numKeys], c, city) == 0);
+			numKeys += valid[n];
+			*invalid += !valid[n];
+			confs[n] = conf;
+			cities[n] = city;
+			n++;
+		}
+
+		// look them up and write the results in the order of the queries
+		*found += ht_search_packed_batch(teams_ht, keys, numKeys, values);
+		for (int i = 0, k = 0; i < n; i++) {
+			TeamInfoPtr_t tir = valid[i] ? (TeamInfoPtr_t)values[k++] : NULL;
+			writeQueryResult(out, json, numQueries + i == 0, confs[i], cities[i], tir);
+		}
+		numQueries += n;
+	}
+	fputs(json ? ((numQueries > 0) ? "\n]\n" : "]\n") : "", out);
+	return numQueries;
+}
+
+/**
+ * runSeasons() - loads a catalog of seasons and looks teams up in all of them
+ *
+ * @param	paths		the CSV files, one per season
+ * @param	numPaths	number of files
+ *
+ * @note	Exits the program when the user is done (or if a file can't be loaded)
+ */
+static void runSeasons(const char* const* paths, int numPaths) {
+	char user_conf[100];	//user input conference
+	char user_city[100];	//user input city
+	ht_packed_key key;
+	conf_t conf;
+
+	cat_catalog* cat = cat_new();
+	if (cat == NULL) {
+		printf("\nERROR: Could not create the catalog\n");
+		exit(1);
+	}
+	for (int i = 0; i < numPaths; i++) {
+		const int season = cat_season_of(paths[i]);
+		if ((season < 0) || (cat_add(cat, season, paths[i]) != 0)) {
+			printf("\nERROR: No season in the file name %s, or the season is there twice\n", paths[i]);
+			exit(1);
+		}
+	}
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	const long loaded = cat_load(cat, (int)sysconf(_SC_NPROCESSORS_ONLN));
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int i = 0; i < cat->num_seasons; i++) {
+		const cat_season* season = &cat->seasons[i];
+		if (season->loaded < 0) {
+			printf("Cannot open file %s.\n", season->path);
+			continue;
+		}
+		printf("Season %d: %ld teams from %s", season->season, season->loaded, season->path);
+		printf((season->result.numErrors > 0) ? " (%ld lines could not be parsed)\n" : "\n",
+		       season->result.numErrors);
+	}
+	if (loaded < 0) {
+		exit(1);
+	}
+	printf("Loaded %d seasons in %.3f ms\n", cat->num_seasons,
+	       ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6);
+
+	vt_reader* reader = cat_register(cat);
+	if (reader == NULL) {
+		printf("\nERROR: Could not register with the catalog\n");
+		exit(1);
+	}
+	for (;;) {
+		printf("\nConference (NWSL, EAST, or WEST): ");
+		fflush(stdout);
+		if (fgets(user_conf, sizeof(user_conf), stdin) == NULL) {
+			break;
+		}
+		user_conf[strcspn(user_conf, "\r\n")] = '\0';
+		if ((user_conf[0] == '\0') || (strcmp(user_conf, "q") == 0)) {
+			break;
+		}
+		printf("City: ");
+		fflush(stdout);
+		if (fgets(user_city, sizeof(user_city), stdin) == NULL) {
+			break;
+		}
+		user_city[strcspn(user_city, "\r\n")] = '\0';
+		strUpper(user_conf);
+		strUpper(user_city);
+
+		// an unknown conference or a long city can't be in any season
+		const bool valid = (parseConf(user_conf, &conf) == 0) && (ht_pack_key(&key, conf, user_city) == 0);
+		for (int i = 0; i < cat->num_seasons; i++) {
+			vt_version* v = vt_acquire(cat->seasons[i].table, reader);
+			printf("\n%d season:", cat->seasons[i].season);
+			printTeamInfo(valid ? (TeamInfoPtr_t)vt_search(v, &key) : NULL);
+			vt_release(reader, v);
+		}
+	}
+	vt_unregister(reader);
+	cat_del(cat);
+	printf("\n\nExiting program.  Celina Wong (wcelina@pdx.edu)\n");
+	exit(0);
+}
+
+int main(int argc, char* argv[]){
+	TeamInfoPtr_t tir;						// pointers to a Team Info records
+
+	ht_packed_key key;						// key for hash table entry
+	conf_t conf;							// conference the user entered
+//  char key2 = "";
+	ht_hash_table* teams_ht;				// hash table
+
+	const char* snapshot = NULL;
+	const char* results = NULL;
+	const char* walPath = NULL;
+	const char* queries = NULL;
+	const char* outPath = NULL;
+	const char* format = "csv";
+	const char* seasons[CAT_MAX_SEASONS];
+	int numSeasons = 0;
+	for (int i = 1; i < argc; i++) {
+		// every option takes a value, the one argument without a '-' is the snapshot
+		const bool hasValue = (i + 1 < argc);
+		if ((strcmp(argv[i], "-s") == 0) && hasValue && (numSeasons < CAT_MAX_SEASONS)) {
+			seasons[numSeasons++] = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-r") == 0) && hasValue) {
+			results = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-w") == 0) && hasValue) {
+			walPath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-b") == 0) && hasValue) {
+			queries = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-f") == 0) && hasValue) {
+			format = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-o") == 0) && hasValue) {
+			outPath = argv[++i];
+		}
+		else if ((argv[i][0] != '-') && (snapshot == NULL)) {
+			snapshot = argv[i];
+		}
+		else {
+			if (argv[i][0] == '-') {
+				fprintf(stderr, "ERROR: Unknown option %s, a missing value or too many seasons\n", argv[i]);
+			}
+			else {
+				fprintf(stderr, "ERROR: More than one snapshot (%s)\n", argv[i]);
+			}
+			fprintf(stderr, "Usage: %s [snapshot] [-r results] [-w wal] [-b queries [-f csv|json] [-o out]] "
+			        "| -s season.csv ...\n", argv[0]);
+			exit(1);
+		}
+	}
+	if ((strcmp(format, "csv") != 0) && (strcmp(format, "json") != 0)) {
+		fprintf(stderr, "ERROR: Unknown format %s (csv or json)\n", format);
+		exit(1);
+	}
+
+	if (numSeasons > 0) {
+		runSeasons(seasons, numSeasons);
+	}
+
+	// the batch mode results may go to stdout, so its messages go to stderr
+	FILE* msgs = (queries != NULL) ? stderr : stdout;
+
+  //Introduction
+	if (queries == NULL) {
+		printf("\nHash Table ADT test program (by Celina Wong, 21-Nov-2021)\n\n");
+	    errno = 0;
+	    char *buf = getcwd(NULL, 0);    // allocates a buffer large enough to hold the path
+	    if (buf == NULL) {
+	        perror("getcwd");
+	        printf("Could not display the path\n");
+	    }
+	    else {
+	        printf("Current working directory: %s\n", buf);
+	        free(buf);
+	    }
+	    printf("\n");
+	}
+
+	// a snapshot opens instantly, there is nothing to parse or insert
+	const bool writable = (results != NULL) || (walPath != NULL);
+	teams_ht = ((snapshot != NULL) && !writable) ? ht_open_snapshot(snapshot, sizeof(TeamInfo_t)) : NULL;
+	if (teams_ht != NULL) {
+		fprintf(msgs, "\nOpened snapshot %s with %d Team Info records\n", snapshot, teams_ht->count);
+	}
+	else {
+		teams_ht = loadTeams(writable ? NULL : snapshot, msgs);
+	}
+
+	// replay the changes made by earlier runs, then log the new ones
+	wal_t* wal = NULL;
+	if (walPath != NULL) {
+		wal = wal_open(walPath, teams_ht, sizeof(TeamInfo_t), teamInfoPackedKey);
+		if (wal == NULL) {
+			fprintf(msgs, "ERROR: Could not open the log %s\n", walPath);
+			exit(1);
+		}
+		fprintf(msgs, "Replayed %ld changes from %s\n", wal->replayed, walPath);
+	}
+
+	// update the standings with the match results
+	if (results != NULL) {
+		const bool fromStdin = (strcmp(results, "-") == 0);
+		FILE* fp = fromStdin ? stdin : fopen(results, "r");
+		if (fp == NULL) {
+			fprintf(msgs, "Cannot open file %s.\n", results);
+			exit(1);
+		}
+		st_index* standings = st_new();
+		if ((standings == NULL) || (st_attach(standings, teams_ht) != 0)) {
+			fprintf(msgs, "ERROR: Could not index the standings\n");
+			exit(1);
+		}
+		matchFeedResult_t feed;
+		applyMatchResults(teams_ht, fp, &feed);
+		if (!fromStdin) {
+			fclose(fp);
+		}
+		for (long i = 0; (i < feed.numErrors) && (i < CSV_MAX_ERRORS); i++) {
+			fprintf(msgs, "ERROR: Could not apply match result on line %ld.", feed.errors[i].line);
+			fprintf(msgs, "\tNumber of fields parsed = %d\n", feed.errors[i].numFields);
+		}
+		fprintf(msgs, "\nApplied %ld match results (%ld new teams, %ld errors)\n",
+		       feed.numResults, feed.numNewTeams, feed.numErrors);
+		printStandings(standings, msgs);
+		ht_remove_observer(teams_ht, st_observe, standings);
+		st_del_index(standings);
+	}
+
+	// nothing changes the table after the results, so the log can be closed
+	if (wal != NULL) {
+		if (wal_close(wal) != 0) {
+			fprintf(msgs, "ERROR: Could not write the log %s\n", walPath);
+			exit(1);
+		}
+		wal = NULL;
+	}
+	if (results != NULL) {
+		const bool fromStdin = (strcmp(results, "-") == 0);
+		if (fromStdin && (queries == NULL)) {
+			exit(0);
+		}
+	}
+
+	// batch mode, look up the queries and exit
+	if (queries != NULL) {
+		const bool fromStdin = (strcmp(queries, "-") == 0);
+		FILE* in = fromStdin ? stdin : fopen(queries, "r");
+		FILE* out = (outPath == NULL) ? stdout : fopen(outPath, "w");
+		if ((in == NULL) || (out == NULL)) {
+			fprintf(stderr, "Cannot open file %s.\n", (in == NULL) ? queries : outPath);
+			exit(1);
+		}
+		setvbuf(out, NULL, _IOFBF, QUERY_OUTBUF);
+
+		struct timespec t0, t1;
+		long found, invalid;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		long numQueries = runQueries(teams_ht, in, out, strcmp(format, "json") == 0, &found, &invalid);
+		int status = (fflush(out) != 0) || ferror(out);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		if (!fromStdin) {
+			fclose(in);
+		}
+		if ((out != stdout) && (fclose(out) != 0)) {
+			status = 1;
+		}
+		if (status != 0) {
+			fprintf(stderr, "ERROR: Could not write the results\n");
+			exit(1);
+		}
+
+		double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+		fprintf(stderr, "\n%ld queries (%ld found, %ld invalid) in %.3f s, %.0f queries/sec\n",
+		        numQueries, found, invalid, secs, (secs > 0) ? numQueries / secs : 0.0);
+		exit(0);
+	}
   //  ht_dump(teams_ht);  //just to see what's happening in here
-  }
 
-  fclose(fp); //after contents are put into hash table, close file
+	// index the cities and names for the '*' prefix searches
+	px_index* prefixes = px_new();
+	if ((prefixes != NULL) && (px_attach(prefixes, teams_ht) != 0)) {
+		ht_remove_observer(teams_ht, px_observe, prefixes);
+		px_del_index(prefixes);
+		prefixes = NULL;
+	}
 
   //prompt and scan user input
   char user_conf[100];   //user input conference
@@ -102,6 +658,7 @@ int main(){
   printf("\nMenu:\n\n");
   printf("Enter '?' to display the keys for all the conference entires.\n");
   printf("Enter 'q' to quit the program at any time.\n");
+  printf("End a city with '*' to list the teams that start with it (ex: New*).\n");
   printf("\nEnter a conference (NWSL, EAST, or WEST): ");
   fflush(stdout);
   fgets(user_conf, 100, stdin);
@@ -123,13 +680,25 @@ int main(){
     user_city[strlen(user_city) - 1]='\0';
 
     for(;;) { //loop prompt for additional records
-      key++;
-      strcat(user_city, user_conf); //create key for user input
-      strcpy(key, user_city);
-      strUpper(key);
-      printf("\nSearching hash table for %s\n", key);
-      tir = (TeamInfoPtr_t) ht_search(teams_ht, key); //search hash table
-      printTeamInfo(tir); //print out selected team info
+      const size_t cityLen = strlen(user_city);
+      if ((cityLen > 0) && (user_city[cityLen - 1] == '*')) {
+        user_city[cityLen - 1] = '\0';
+        strUpper(user_conf);
+        printMatches(prefixes, user_conf, user_city);
+      }
+      else {
+        //create key for user input, an unknown conference or a long city can't be in the table
+        strUpper(user_city);
+        strUpper(user_conf);
+        printf("\nSearching hash table for %s%s\n", user_city, user_conf);
+        if ((parseConf(user_conf, &conf) == 0) && (ht_pack_key(&key, conf, user_city) == 0)) {
+          tir = (TeamInfoPtr_t) ht_search_packed(teams_ht, &key); //search hash table
+        }
+        else {
+          tir = NULL;
+        }
+        printTeamInfo(tir); //print out selected team info
+      }
 
       //repeat prompt
       printf("\nEnter another conference and team nickname.\n");
@@ -147,6 +716,7 @@ int main(){
 
       printf("City: ");
       fflush(stdout);
+      fgets(user_city, 100, stdin);
       user_city[strlen(user_city) - 1]='\0';
 
     }
@@ -0,0 +1,580 @@
+/**
+ * versioned_table.c - Copy-on-write versions of a table of teams
+ *
+ * @brief   This is the source code file for the versioned table.
+ *
+ * Nothing that a reader can reach is ever changed.  The writer's draft starts
+ * out sharing every page of the current version (each page counts the
+ * versions that hold it) and a page is copied the first time the draft
+ * changes it.  Copying a page copies its slots, and every record in it gains a
+ * reference from the copy; a record is only copied when vt_modify() changes a
+ * record that another page still holds.  So a version that changes k teams
+ * costs at most k page copies, and everything else is shared.
+ *
+ * vt_publish() stores the draft in vt->current with a release store, after
+ * every write to it.  A reader loads the pointer with an acquire load and takes
+ * a reference inside an EBR critical section, so the version can't be freed
+ * between the load and the increment.  The last reference dropped retires the
+ * version, which is freed (and releases its pages, and they their records)
+ * once no reader can still be loading it.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "ht_template.h"
+#include "appHelpers.h"
+#include "versioned_table.h"
+
+// a page: packed keys and pointers to the shared records.  The pointer needs
+// a typedef so the template's const ValT* is a pointer to a const pointer
+typedef vt_record* vt_record_ptr;
+HT_DEFINE(vtp, ht_packed_key, vt_record_ptr, ht_hash_packed_inline, ht_packed_equal)
+
+struct _vt_page_s {
+  int refs;                   // versions that hold the page
+  vtp_table* table;
+};
+
+// vt_next() keeps the page in the bits above the slot
+#define VT_SLOT_BITS        24
+
+// prototypes for the Helper functions
+
+// drop a reference, freeing what is no longer referenced
+static void vt_free_version(void* ptr);
+static void vt_page_release(struct _vt_page_s* page);
+static void vt_record_release(vt_record* record);
+
+// the page a hash belongs to
+static inline int vt_page_of(const uint64_t hash);
+
+// the draft's own copy of a page, copied (or created) on the first change
+static struct _vt_page_s* vt_own_page(vt_table* vt, const int p);
+
+// Versioned Table ADT
+
+/**
+ * vt_new() - initializes a new versioned table
+ *
+ * The table starts with an empty version 0.
+ *
+ * @param ebr is the EBR domain to free old versions with, or NULL to create one
+ * for the table.  Tables read by the same threads can share a domain, so a
+ * reader thread needs one vt_reader for all of them (see catalog.h)
+ *
+ * @return a pointer to the new table or NULL if it could not be allocated
+ */
+vt_table* vt_new(ebr_t* ebr) {
+  vt_table* vt = calloc(1, sizeof(vt_table));
+  if (vt == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(vt_new()): Could not allocate space for the table\n");
+    #endif
+    return NULL;
+  }
+  vt->own_ebr = (ebr == NULL);
+  vt->ebr = (ebr != NULL) ? ebr : ebr_new();
+  vt->current = calloc(1, sizeof(vt_version));
+  vt->writer = (vt->ebr != NULL) ? ebr_register(vt->ebr) : NULL;
+  if ((vt->ebr == NULL) || (vt->current == NULL) || (vt->writer == NULL)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(vt_new()): Could not allocate the first version\n");
+    #endif
+    if (vt->writer != NULL) {
+      ebr_unregister(vt->writer);
+    }
+    if (vt->own_ebr && (vt->ebr != NULL)) {
+      ebr_del(vt->ebr);
+    }
+    free(vt->current);
+    free(vt);
+    return NULL;
+  }
+  vt->current->refs = 1;
+  pthread_mutex_init(&vt->write_lock, NULL);
+  return vt;
+}
+
+
+/**
+ * vt_del_table() - deletes a versioned table
+ *
+ * Frees the current version and a draft that wasn't published.  Older versions
+ * are already retired and are freed by their EBR domain (with the table when it
+ * has its own domain).
+ *
+ * @param vt is the table.  No reader may still hold a version
+ */
+void vt_del_table(vt_table* vt) {
+  if (vt->draft != NULL) {
+    vt_free_version(vt->draft);
+  }
+  vt_free_version(vt->current);
+  ebr_unregister(vt->writer);
+  if (vt->own_ebr) {
+    ebr_del(vt->ebr);
+  }
+  pthread_mutex_destroy(&vt->write_lock);
+  free(vt);
+}
+
+
+/**
+ * vt_register() - registers the calling thread as a reader of the table
+ *
+ * @param vt is the table
+ *
+ * @return the reader's handle, passed to vt_acquire() and vt_release(), or
+ * NULL if out of memory
+ */
+vt_reader* vt_register(vt_table* vt) {
+  return ebr_register(vt->ebr);
+}
+
+
+/**
+ * vt_unregister() - unregisters a reader
+ *
+ * @param reader is the handle from vt_register()
+ */
+void vt_unregister(vt_reader* reader) {
+  ebr_unregister(reader);
+}
+
+
+/**
+ * vt_acquire() - takes a reference to the current version
+ *
+ * The version doesn't change while it is held, whatever the writer publishes.
+ * Taking the reference never waits: if the version is replaced between loading
+ * the pointer and counting the reference (its count has dropped to 0), the new
+ * current version is taken instead.
+ *
+ * @param vt is the table
+ * @param reader is the calling thread's handle from vt_register()
+ *
+ * @return the version, release it with vt_release()
+ */
+vt_version* vt_acquire(vt_table* vt, vt_reader* reader) {
+  vt_version* version;
+  int refs = 0;
+
+  ebr_enter(reader);
+  do {
+    version = __atomic_load_n(&vt->current, __ATOMIC_ACQUIRE);
+    refs = __atomic_load_n(&version->refs, __ATOMIC_RELAXED);
+    while ((refs > 0) &&
+           !__atomic_compare_exchange_n(&version->refs, &refs, refs + 1, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+    }
+  } while (refs == 0);
+  ebr_exit(reader);
+  return version;
+}
+
+
+/**
+ * vt_release() - drops a reference taken by vt_acquire()
+ *
+ * @param reader is the calling thread's handle from vt_register()
+ * @param version is the version, it must not be used afterwards
+ */
+void vt_release(vt_reader* reader, vt_version* version) {
+  if (__atomic_sub_fetch(&version->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    ebr_retire(reader, version, vt_free_version);
+  }
+}
+
+
+/**
+ * vt_search() - searches a version for a team
+ *
+ * @param version is a version from vt_acquire()
+ * @param key is the team's key from ht_pack_key()
+ *
+ * @return the team's record or NULL if it isn't in the version.  The record
+ * must not be changed and is good until the version is released
+ */
+const TeamInfo_t* vt_search(const vt_version* version, const ht_packed_key* key) {
+  const uint64_t hash = ht_hash_packed_inline(key);
+  const struct _vt_page_s* page = version->pages[vt_page_of(hash)];
+  if (page == NULL) {
+    return NULL;
+  }
+  const int index = vtp_find(page->table, key, hash);
+  return (index < 0) ? NULL : &page->table->slots[index].value->info;
+}
+
+
+/**
+ * vt_next() - walks the teams of a version
+ *
+ * @param version is a version from vt_acquire()
+ * @param index is where the walk is, set it to 0 before the first call
+ *
+ * @return the next team or NULL after the last one
+ */
+const TeamInfo_t* vt_next(const vt_version* version, int* index) {
+  while ((*index >> VT_SLOT_BITS) < VT_NUM_PAGES) {
+    const int p = *index >> VT_SLOT_BITS;
+    int slot = *index & ((1 << VT_SLOT_BITS) - 1);
+    if (version->pages[p] != NULL) {
+      const vtp_slot* s = vtp_next(version->pages[p]->table, &slot);
+      if (s != NULL) {
+        *index = (p << VT_SLOT_BITS) | slot;
+        return &s->value->info;
+      }
+    }
+    *index = (p + 1) << VT_SLOT_BITS;
+  }
+  return NULL;
+}
+
+
+/**
+ * vt_begin() - starts the next version
+ *
+ * The draft shares every page of the current version until it changes them.
+ * Only one writer at a time has a draft, a second one waits here until the
+ * first publishes or aborts.
+ *
+ * @param vt is the table
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int vt_begin(vt_table* vt) {
+  pthread_mutex_lock(&vt->write_lock);
+  vt_version* draft = malloc(sizeof(vt_version));
+  if (draft == NULL) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(vt_begin()): Could not allocate the next version\n");
+    #endif
+    pthread_mutex_unlock(&vt->write_lock);
+    return -1;
+  }
+
+  // readers are counting their references in current->refs, so copy around it
+  draft->number = vt->current->number + 1;
+  draft->count = vt->current->count;
+  draft->refs = 0;
+  memcpy(draft->pages, vt->current->pages, sizeof(draft->pages));
+  for (int p = 0; p < VT_NUM_PAGES; p++) {
+    if (draft->pages[p] != NULL) {
+      __atomic_add_fetch(&draft->pages[p]->refs, 1, __ATOMIC_RELAXED);
+    }
+  }
+  memset(vt->owned, 0, sizeof(vt->owned));
+  vt->draft = draft;
+  return 0;
+}
+
+
+/**
+ * vt_put() - adds a team to the next version or replaces its record
+ *
+ * @param vt is the table, between vt_begin() and vt_publish()
+ * @param info is the record, copied into the table
+ *
+ * @return 1 if the team was added, 0 if its record was replaced, -1 if there
+ * is no draft, the conference or city isn't valid or out of memory
+ */
+int vt_put(vt_table* vt, const TeamInfo_t* info) {
+  ht_packed_key key;
+  int inserted;
+
+  if ((vt->draft == NULL) || (teamInfoPackedKey(info, &key) < 0)) {
+    return -1;
+  }
+  struct _vt_page_s* page = vt_own_page(vt, vt_page_of(ht_hash_packed_inline(&key)));
+  vt_record* record = malloc(sizeof(vt_record));
+  if ((page == NULL) || (record == NULL)) {
+    free(record);
+    return -1;
+  }
+  record->info = *info;
+  record->refs = 1;
+
+  vt_record** value = vtp_get_or_insert(page->table, &key, &inserted);
+  if (value == NULL) {
+    free(record);
+    return -1;
+  }
+  if (inserted) {
+    vt->draft->count++;
+  }
+  else {
+    vt_record_release(*value);
+  }
+  *value = record;
+  return inserted;
+}
+
+
+/**
+ * vt_modify() - gets a team's record in the next version to change it in place
+ *
+ * The record is copied first if an earlier version still has it, so the
+ * readers of that version don't see the change.  It can be changed until
+ * vt_publish(), except for its conference and city (the key).
+ *
+ * @param vt is the table, between vt_begin() and vt_publish()
+ * @param key is the team's key from ht_pack_key()
+ *
+ * @return the draft's own record or NULL if the team isn't in the table (or
+ * out of memory)
+ */
+TeamInfo_t* vt_modify(vt_table* vt, const ht_packed_key* key) {
+  if (vt->draft == NULL) {
+    return NULL;
+  }
+  const uint64_t hash = ht_hash_packed_inline(key);
+  const int p = vt_page_of(hash);
+  if ((vt->draft->pages[p] == NULL) || (vtp_find(vt->draft->pages[p]->table, key, hash) < 0)) {
+    return NULL;
+  }
+  struct _vt_page_s* page = vt_own_page(vt, p);
+  if (page == NULL) {
+    return NULL;
+  }
+
+  // only this page can add references to a record, so 1 means it's ours
+  vtp_slot* slot = &page->table->slots[vtp_find(page->table, key, hash)];
+  if (__atomic_load_n(&slot->value->refs, __ATOMIC_ACQUIRE) > 1) {
+    vt_record* copy = malloc(sizeof(vt_record));
+    if (copy == NULL) {
+      return NULL;
+    }
+    copy->info = slot->value->info;
+    copy->refs = 1;
+    vt_record_release(slot->value);
+    slot->value = copy;
+    vt->records_copied++;
+  }
+  return &slot->value->info;
+}
+
+
+/**
+ * vt_delete() - deletes a team from the next version
+ *
+ * @param vt is the table, between vt_begin() and vt_publish()
+ * @param key is the team's key from ht_pack_key()
+ *
+ * @return 1 if the team was deleted, 0 if it wasn't in the table, -1 if there
+ * is no draft or out of memory
+ */
+int vt_delete(vt_table* vt, const ht_packed_key* key) {
+  if (vt->draft == NULL) {
+    return -1;
+  }
+  const uint64_t hash = ht_hash_packed_inline(key);
+  const int p = vt_page_of(hash);
+  if ((vt->draft->pages[p] == NULL) || (vtp_find(vt->draft->pages[p]->table, key, hash) < 0)) {
+    return 0;
+  }
+  struct _vt_page_s* page = vt_own_page(vt, p);
+  if (page == NULL) {
+    return -1;
+  }
+  vt_record* record = page->table->slots[vtp_find(page->table, key, hash)].value;
+  vtp_delete(page->table, key);
+  vt_record_release(record);
+  vt->draft->count--;
+  return 1;
+}
+
+
+/**
+ * vt_publish() - makes the next version the current one
+ *
+ * One atomic pointer store: the readers that already hold the old version keep
+ * it, every vt_acquire() from here on gets the new one.  The old version is
+ * freed once its last reader releases it.
+ *
+ * @param vt is the table, after vt_begin()
+ *
+ * @return the number of the version that is now current
+ */
+uint64_t vt_publish(vt_table* vt) {
+  vt_version* draft = vt->draft;
+  vt_version* old = vt->current;
+
+  if (draft == NULL) {
+    return old->number;
+  }
+  draft->refs = 1;
+  __atomic_store_n(&vt->current, draft, __ATOMIC_RELEASE);
+  vt->draft = NULL;
+  if (__atomic_sub_fetch(&old->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    ebr_retire(vt->writer, old, vt_free_version);
+  }
+  pthread_mutex_unlock(&vt->write_lock);
+  return draft->number;
+}
+
+
+/**
+ * vt_abort() - throws the next version away
+ *
+ * @param vt is the table, after vt_begin()
+ */
+void vt_abort(vt_table* vt) {
+  if (vt->draft == NULL) {
+    return;
+  }
+  // no reader has ever seen the draft, so it can go right away
+  vt_free_version(vt->draft);
+  vt->draft = NULL;
+  pthread_mutex_unlock(&vt->write_lock);
+}
+
+
+/**
+ * vt_load_csv() - publishes a version with the teams of a CSV file added
+ *
+ * The file is loaded with loadTeamInfoCsv() into a scratch hash table first,
+ * so a team that appears twice gets the record of its last line.  Teams
+ * already in the table are replaced.
+ *
+ * @param vt is the table, without a draft (the function starts its own)
+ * @param path is the CSV file
+ * @param result is filled in with the line, record, comment and error counts
+ *
+ * @return the number of records loaded, -1 if the file could not be read or
+ * out of memory (nothing is published then)
+ */
+long vt_load_csv(vt_table* vt, const char* path, csvLoadResult_t* result) {
+  ht_hash_table* scratch = ht_new();
+  if ((scratch == NULL) || (ht_set_key_mode(scratch, HT_KEY_PACKED) != 0) ||
+      (ht_use_arena(scratch, arena_new(0)) != 0)) {
+    if (scratch != NULL) {
+      ht_del_hash_table(scratch);
+    }
+    memset(result, 0, sizeof(csvLoadResult_t));
+    return -1;
+  }
+
+  long loaded = loadTeamInfoCsv(scratch, path, result);
+  if ((loaded >= 0) && (vt_begin(vt) == 0)) {
+    ht_item* item;
+    int index = 0;
+    while ((item = ht_next(scratch, &index)) != NULL) {
+      if ((item->value != NULL) && (vt_put(vt, item->value) < 0)) {
+        loaded = -1;
+        break;
+      }
+    }
+    if (loaded >= 0) {
+      vt_publish(vt);
+    }
+    else {
+      vt_abort(vt);
+    }
+  }
+  else {
+    loaded = -1;
+  }
+  ht_del_hash_table(scratch);
+  return loaded;
+}
+
+
+// Helper functions
+
+/**
+ * vt_free_version() - frees a version nobody can reach any more
+ *
+ * @param ptr is the version.  Its pages are released, and freed with their
+ * records if no other version holds them
+ */
+static void vt_free_version(void* ptr) {
+  vt_version* version = ptr;
+  for (int p = 0; p < VT_NUM_PAGES; p++) {
+    if (version->pages[p] != NULL) {
+      vt_page_release(version->pages[p]);
+    }
+  }
+  free(version);
+}
+
+
+static void vt_page_release(struct _vt_page_s* page) {
+  if (__atomic_sub_fetch(&page->refs, 1, __ATOMIC_ACQ_REL) > 0) {
+    return;
+  }
+  vtp_slot* slot;
+  int index = 0;
+  while ((slot = vtp_next(page->table, &index)) != NULL) {
+    vt_record_release(slot->value);
+  }
+  vtp_del_table(page->table);
+  free(page);
+}
+
+
+static void vt_record_release(vt_record* record) {
+  if (__atomic_sub_fetch(&record->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(record);
+  }
+}
+
+
+static inline int vt_page_of(const uint64_t hash) {
+  return (int)((hash >> VT_PAGE_SHIFT) & (VT_NUM_PAGES - 1));
+}
+
+
+/**
+ * vt_own_page() - gets a page of the draft that no other version shares
+ *
+ * The first time the draft changes a page, the page is copied: the copy has
+ * the same slots, and each of its records gains a reference.  A page the
+ * table never had is created.
+ *
+ * @param vt is the table, with a draft
+ * @param p is the page
+ *
+ * @return the draft's page or NULL if out of memory
+ */
+static struct _vt_page_s* vt_own_page(vt_table* vt, const int p) {
+  struct _vt_page_s* shared = vt->draft->pages[p];
+  if (vt->owned[p]) {
+    return shared;
+  }
+
+  struct _vt_page_s* page = malloc(sizeof(struct _vt_page_s));
+  vtp_table* table = vtp_new((shared != NULL) ? shared->table->size : VT_PAGE_SLOTS);
+  if ((page == NULL) || (table == NULL)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(vt_own_page()): Could not copy page %d\n", p);
+    #endif
+    free(page);
+    if (table != NULL) {
+      vtp_del_table(table);
+    }
+    return NULL;
+  }
+  if (shared != NULL) {
+    const vtp_table* from = shared->table;
+    memcpy(table->ctrl, from->ctrl, (size_t)from->size + HT_GROUP_WIDTH - 1);
+    for (int i = 0; i < from->size; i++) {
+      if (HTT_CTRL_IS_FULL(from->ctrl[i])) {
+        table->slots[i] = from->slots[i];
+        __atomic_add_fetch(&from->slots[i].value->refs, 1, __ATOMIC_RELAXED);
+      }
+    }
+    table->count = from->count;
+    table->max_psl = from->max_psl;
+    vt_page_release(shared);
+    vt->pages_copied++;
+  }
+  page->refs = 1;
+  page->table = table;
+  vt->draft->pages[p] = page;
+  vt->owned[p] = 1;
+  return page;
+}
@@ -0,0 +1,121 @@
+/**
+ * versioned_table.h - Copy-on-write versions of a table of teams
+ *
+ * @brief   This is the header file for a table of TeamInfo_t records (keyed by
+ * conference and city, see ht_pack_key()) that readers query one consistent
+ * version at a time while a writer prepares the next one.  A version is
+ * VT_NUM_PAGES pages, each a small ht_template.h table picked by bits of the
+ * key's hash, and the records are shared between the pages that hold them:
+ *
+ *  - vt_begin() starts the next version sharing every page of the current one
+ *  - the first change to a page copies that page (its slots, not its records);
+ *    vt_modify() copies a record the first time it is changed
+ *  - vt_publish() makes the new version current with one atomic pointer store.
+ *    Readers never wait for the writer and the writer never waits for them
+ *
+ * A reader takes a reference to the current version with vt_acquire() and
+ * keeps seeing that version, however many are published meanwhile, until
+ * vt_release().  A version nobody references any more is freed through
+ * epoch-based reclamation (epoch.h), together with the pages and records that
+ * no other version shares.  Each reader thread needs its own vt_reader.
+ *
+ *   vt_reader* reader = vt_register(vt);
+ *   vt_version* v = vt_acquire(vt, reader);
+ *   const TeamInfo_t* team = vt_search(v, &key);   // good until vt_release()
+ *   vt_release(reader, v);
+*/
+
+#ifndef _VERSIONED_TABLE_H_
+#define _VERSIONED_TABLE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "hash_table.h"
+#include "appHelpers.h"
+#include "epoch.h"
+
+// constants
+#define VT_PAGE_BITS        6
+#define VT_NUM_PAGES        (1 << VT_PAGE_BITS)
+#define VT_PAGE_SLOTS       16    // slots of a new page
+
+// the page is picked by the hash bits just below the 7 bits of the control
+// byte tags, so it doesn't weaken the tags inside the page
+#define VT_PAGE_SHIFT       (57 - VT_PAGE_BITS)
+
+// a record shared by the pages of one or more versions.  info comes first so
+// a pointer to the record is a pointer to its TeamInfo_t
+typedef struct _vt_record_s {
+  TeamInfo_t info;
+  int refs;                   // pages that hold it
+} vt_record;
+
+struct _vt_page_s;
+
+// one version of the table.  It never changes once it is published
+typedef struct {
+  uint64_t number;            // 0 for the empty table, one more for each vt_publish()
+  long count;                 // teams in the version
+  int refs;                   // vt_acquire() references, plus one while it is current
+  struct _vt_page_s* pages[VT_NUM_PAGES];   // NULL for a page that never had a team
+} vt_version;
+
+// struct containing the versioned table
+typedef struct {
+  vt_version* current;        // the published version, swapped atomically
+  ebr_t* ebr;                 // frees the versions nobody can reach any more
+  int own_ebr;                // 1 if ebr was created by vt_new()
+
+  // the writer, one at a time between vt_begin() and vt_publish()/vt_abort()
+  pthread_mutex_t write_lock;
+  vt_version* draft;
+  uint8_t owned[VT_NUM_PAGES];  // pages of the draft that no other version shares
+  ebr_thread_t* writer;       // EBR state the writer retires versions with
+
+  long pages_copied;          // pages copied by writers since vt_new()
+  long records_copied;        // records copied by vt_modify() since vt_new()
+} vt_table;
+
+// per-thread handle of a reader
+typedef ebr_thread_t vt_reader;
+
+
+// API function prototypes
+
+// creates an empty table.  Tables that are read by the same threads can share
+// an EBR domain (ebr), NULL gives the table its own
+vt_table* vt_new(ebr_t* ebr);
+
+// deletes the table and every version.  No reader may still hold a version
+void vt_del_table(vt_table* vt);
+
+// registers and unregisters the calling thread as a reader
+vt_reader* vt_register(vt_table* vt);
+void vt_unregister(vt_reader* reader);
+
+// takes and drops a reference to the current version
+vt_version* vt_acquire(vt_table* vt, vt_reader* reader);
+void vt_release(vt_reader* reader, vt_version* version);
+
+// searches a version, the record is good until the version is released
+const TeamInfo_t* vt_search(const vt_version* version, const ht_packed_key* key);
+
+// walks the teams of a version, start with *index = 0
+const TeamInfo_t* vt_next(const vt_version* version, int* index);
+
+// starts the next version, waits for another writer to publish first
+int vt_begin(vt_table* vt);
+
+// changes the next version (only between vt_begin() and vt_publish())
+int vt_put(vt_table* vt, const TeamInfo_t* info);
+TeamInfo_t* vt_modify(vt_table* vt, const ht_packed_key* key);
+int vt_delete(vt_table* vt, const ht_packed_key* key);
+
+// makes the next version current, or throws it away
+uint64_t vt_publish(vt_table* vt);
+void vt_abort(vt_table* vt);
+
+// publishes a version with the records of a CSV file added
+long vt_load_csv(vt_table* vt, const char* path, csvLoadResult_t* result);
+
+#endif
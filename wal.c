@@ -0,0 +1,791 @@
+/**
+ * wal.c - Write-ahead log source code file
+ *
+ * @brief   This is the source code file for the write-ahead log of a hash
+ * table.  The log file is a header followed by records:
+ *
+ *   header | record | record | ...
+ *   record = size (4) | checksum (4) | op (1) | key length (1) | value length (2) |
+ *            key | value
+ *
+ * The size counts the whole record and the checksum covers everything after
+ * it, so replay stops at the first record that was only partly written.  A
+ * put with a value length of 0 puts a NULL value.  A compacted log starts
+ * with a clear record, so replaying it on top of a table loaded from the CSV
+ * file also drops the teams that were deleted since.
+ *
+ * The writer appends records to a buffer under `lock`.  A commit swaps the
+ * buffers under `lock` and writes and syncs the full one under `io_lock`, so
+ * the writer keeps going while the disk catches up.
+*/
+
+#define _POSIX_C_SOURCE 200809L     // for fdatasync() and friends with -std=c99
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "hash_table.h"
+#include "wal.h"
+
+#if defined(__APPLE__)
+#define wal_datasync(fd) fsync(fd)
+#else
+#define wal_datasync(fd) fdatasync(fd)
+#endif
+
+// constants, typedefs and global variables
+#define WAL_MAGIC           "HTWAL\r\n"
+#define WAL_BYTE_ORDER      0x01020304u
+
+#define WAL_OP_PUT          1
+#define WAL_OP_DEL          2
+#define WAL_OP_CLEAR        3
+
+typedef struct {
+  char magic[8];
+  uint32_t version;         // WAL_VERSION
+  uint32_t byte_order;      // WAL_BYTE_ORDER as written by the logging machine
+  uint32_t key_mode;        // of the table
+  uint32_t value_size;
+} wal_file_header;
+
+typedef struct {
+  uint32_t size;            // bytes in the record, this header included
+  uint32_t checksum;        // of the bytes after this field
+  uint8_t op;
+  uint8_t key_len;
+  uint16_t value_len;       // value_size, or 0 for a delete or a NULL value
+} wal_record;
+
+// Write-ahead Log ADT
+
+// appends a record to the buffer, committing first if it is full
+static int wal_append(wal_t* wal, const int op, const void* key, const int key_len, const void* value);
+
+// writes a record into memory, returns its size
+static size_t wal_encode(char* p, const int op, const void* key, const int key_len,
+                         const void* value, const size_t value_size);
+
+// checksum of the bytes of a record after its checksum field
+static uint32_t wal_checksum(const char* p, size_t len);
+
+// replays the records of an open log, returns the end of the last good record
+static uint64_t wal_replay(wal_t* wal, const char* data, const uint64_t size);
+
+// applies one record to the table
+static int wal_apply(wal_t* wal, const wal_record* rec, const char* key, const char* value);
+
+// writes all of len bytes
+static int wal_write_all(const int fd, const char* p, size_t len);
+
+// syncs the directory holding path, so a new or renamed file survives a crash
+static int wal_sync_dir(const char* path);
+
+// creates or opens the log file, returns its size or -1
+static long wal_open_file(wal_t* wal, char** data);
+
+// the flusher thread
+static void* wal_flusher(void* arg);
+
+// reads the monotonic clock in nanoseconds
+static double wal_now_ns(void);
+
+
+/**
+ * wal_open() - opens the write-ahead log of a hash table
+ *
+ * Creates the log if it doesn't exist.  Otherwise its records are replayed
+ * into the table, which normally holds what was loaded from the CSV file (or
+ * nothing).  Then the log registers itself as an observer of the table and
+ * starts its flusher thread, so every change from now on is logged.
+ *
+ * @param path is the log file
+ * @param ht is the table, not a snapshot or a frozen table
+ * @param value_size is the size of every value in the table
+ * @param key_fn gets the key of a value (ex: teamInfoPackedKey())
+ *
+ * @return a pointer to the log, or NULL if the log doesn't belong to a table
+ * like this one, can't be read or written or we're out of memory
+ */
+wal_t* wal_open(const char* path, ht_hash_table* ht, const size_t value_size, wal_key_fn key_fn) {
+  if ((ht->snapshot != NULL) || (ht->frozen_disp != NULL) || (value_size == 0) ||
+      (value_size > UINT16_MAX)) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(wal_open()): The table must be writable and its values small\n");
+    #endif
+    return NULL;
+  }
+  wal_t* wal = calloc(1, sizeof(wal_t));
+  if (wal == NULL) {
+    return NULL;
+  }
+  wal->ht = ht;
+  wal->key_fn = key_fn;
+  wal->value_size = value_size;
+  wal->path = malloc(strlen(path) + 1);
+  wal->buf = malloc(WAL_BUFFER_SIZE);
+  wal->spare = malloc(WAL_BUFFER_SIZE);
+  wal->fd = -1;
+  char* data = NULL;
+  long size = -1;
+  if ((wal->path != NULL) && (wal->buf != NULL) && (wal->spare != NULL)) {
+    strcpy(wal->path, path);
+    size = wal_open_file(wal, &data);
+  }
+  if (size < 0) {
+    #if (_DEBUG_ > 0)
+      fprintf(stderr, "ERROR(wal_open()): Could not open the log %s\n", path);
+    #endif
+    if (wal->fd >= 0) {
+      close(wal->fd);
+    }
+    free(wal->path);
+    free(wal->buf);
+    free(wal->spare);
+    free(wal);
+    return NULL;
+  }
+
+  // drop a torn record at the end so new records follow the last good one
+  wal->file_bytes = (data != NULL) ? wal_replay(wal, data, (uint64_t)size) : (uint64_t)size;
+  free(data);
+  if ((wal->file_bytes < (uint64_t)size) &&
+      ((ftruncate(wal->fd, (off_t)wal->file_bytes) != 0) || (wal_datasync(wal->fd) != 0))) {
+    wal->error = 1;
+  }
+
+  pthread_mutex_init(&wal->lock, NULL);
+  pthread_mutex_init(&wal->io_lock, NULL);
+  pthread_cond_init(&wal->wake, NULL);
+  if (pthread_create(&wal->flusher, NULL, wal_flusher, wal) != 0) {
+    wal->stop = -1;     // no flusher, wal_commit() has to be called
+  }
+  // the values already in the table are in the CSV file or the log
+  if (ht_add_observer(ht, wal_observe, wal) != 0) {
+    wal->error = 1;
+  }
+  wal->attached = 1;
+  return wal;
+}
+
+
+/**
+ * wal_close() - commits the records that are left and closes the log
+ *
+ * The table keeps going without a log.
+ *
+ * @param wal is a pointer to the log
+ *
+ * @return 0 if every record reached the disk, -1 if something couldn't be written
+ */
+int wal_close(wal_t* wal) {
+  ht_remove_observer(wal->ht, wal_observe, wal);
+  if (wal->stop == 0) {
+    pthread_mutex_lock(&wal->lock);
+    wal->stop = 1;
+    pthread_cond_signal(&wal->wake);
+    pthread_mutex_unlock(&wal->lock);
+    pthread_join(wal->flusher, NULL);
+  }
+  int status = wal_commit(wal);
+  if ((close(wal->fd) != 0) || wal->error) {
+    status = -1;
+  }
+  pthread_cond_destroy(&wal->wake);
+  pthread_mutex_destroy(&wal->lock);
+  pthread_mutex_destroy(&wal->io_lock);
+  free(wal->path);
+  free(wal->buf);
+  free(wal->spare);
+  free(wal);
+  return status;
+}
+
+
+/**
+ * wal_commit() - writes the buffered records and waits for them to reach the disk
+ *
+ * All of the buffered records go out in one write() and one fdatasync() (the
+ * group commit).  Can be called from any thread; the flusher thread calls it
+ * when a group is full or the window has passed.
+ *
+ * @param wal is a pointer to the log
+ *
+ * @return 0 on success, -1 if the records couldn't be written (the log is no
+ * longer durable after that)
+ */
+int wal_commit(wal_t* wal) {
+  pthread_mutex_lock(&wal->io_lock);
+  pthread_mutex_lock(&wal->lock);
+  char* buf = wal->buf;
+  const size_t used = wal->used;
+  const int pending = wal->pending;
+  wal->buf = wal->spare;
+  wal->spare = buf;
+  wal->used = 0;
+  wal->pending = 0;
+  pthread_mutex_unlock(&wal->lock);
+
+  int status = 0;
+  if (used > 0) {
+    status = ((wal_write_all(wal->fd, buf, used) == 0) && (wal_datasync(wal->fd) == 0)) ? 0 : -1;
+    pthread_mutex_lock(&wal->lock);
+    if (status == 0) {
+      wal->file_bytes += used;
+      wal->records += pending;
+      wal->commits++;
+    }
+    else {
+      wal->error = 1;
+    }
+    pthread_mutex_unlock(&wal->lock);
+  }
+  pthread_mutex_unlock(&wal->io_lock);
+  return (status == 0) && !wal->error ? 0 : -1;
+}
+
+
+/**
+ * wal_compact() - rewrites the log as the current contents of the table
+ *
+ * Writes a clear record and a put for every item of the table to a new file,
+ * syncs it and renames it over the log, so the old log is replaced in one
+ * step.  A crash before the rename leaves the old log.  The buffered records
+ * are dropped because the table already has their changes.  Call it from the
+ * thread that changes the table (wal_observe() does) since it walks the table.
+ *
+ * @param wal is a pointer to the log
+ *
+ * @return 0 on success, -1 if the new log couldn't be written (the old one is kept)
+ */
+int wal_compact(wal_t* wal) {
+  char key[WAL_MAX_KEY + 1];
+  char tmp_path[FILENAME_MAX];
+  wal_file_header header;
+  int status = -1;
+
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", wal->path) >= (int)sizeof(tmp_path)) {
+    return -1;
+  }
+  pthread_mutex_lock(&wal->io_lock);
+  const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    pthread_mutex_unlock(&wal->io_lock);
+    return -1;
+  }
+
+  // the records go out through the spare buffer, a buffer at a time
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+  header.version = WAL_VERSION;
+  header.byte_order = WAL_BYTE_ORDER;
+  header.key_mode = (uint32_t)wal->ht->key_mode;
+  header.value_size = (uint32_t)wal->value_size;
+  memcpy(wal->spare, &header, sizeof(header));
+  size_t used = sizeof(header);
+  uint64_t file_bytes = 0;
+  int ok = 1;
+  used += wal_encode(wal->spare + used, WAL_OP_CLEAR, NULL, 0, NULL, 0);
+
+  int index = 0;
+  for (ht_item* item = ht_next(wal->ht, &index); ok && (item != NULL); item = ht_next(wal->ht, &index)) {
+    int key_len;
+    if (wal->ht->key_mode == HT_KEY_PACKED) {
+      key_len = sizeof(ht_packed_key);
+      memcpy(key, &item->key.packed, sizeof(ht_packed_key));
+    }
+    else {
+      key_len = (int)strlen(ht_item_key(item));
+      if (key_len > WAL_MAX_KEY) {
+        ok = 0;
+        break;
+      }
+      memcpy(key, ht_item_key(item), (size_t)key_len);
+    }
+    if (used + sizeof(wal_record) + WAL_MAX_KEY + wal->value_size > WAL_BUFFER_SIZE) {
+      ok = (wal_write_all(fd, wal->spare, used) == 0);
+      file_bytes += used;
+      used = 0;
+    }
+    used += wal_encode(wal->spare + used, WAL_OP_PUT, key, key_len, item->value, wal->value_size);
+  }
+  ok = ok && (wal_write_all(fd, wal->spare, used) == 0) && (wal_datasync(fd) == 0);
+  file_bytes += used;
+  ok = (close(fd) == 0) && ok;
+
+  // swap the new log in
+  if (ok && (rename(tmp_path, wal->path) == 0)) {
+    const int new_fd = open(wal->path, O_WRONLY | O_APPEND);
+    if (new_fd >= 0) {
+      wal_sync_dir(wal->path);
+      close(wal->fd);
+      wal->fd = new_fd;
+      pthread_mutex_lock(&wal->lock);
+      wal->used = 0;
+      wal->pending = 0;
+      wal->file_bytes = file_bytes;
+      wal->compactions++;
+      pthread_mutex_unlock(&wal->lock);
+      status = 0;
+    }
+    else {
+      wal->error = 1;
+    }
+  }
+  else {
+    remove(tmp_path);
+  }
+  pthread_mutex_unlock(&wal->io_lock);
+  return status;
+}
+
+
+/**
+ * wal_observe() - records a change to the table
+ *
+ * An added or changed value is recorded as a put and a deleted key as a
+ * delete.  HT_VALUE_REMOVED is the first half of an update or a replacement,
+ * so nothing is recorded until the HT_VALUE_ADDED that follows.  If the log has
+ * grown too big it is compacted first.
+ *
+ * @param ctx is the log
+ * @param value is the value
+ * @param event is HT_VALUE_ADDED, HT_VALUE_REMOVED or HT_VALUE_DELETED
+ */
+void wal_observe(void* ctx, void* value, const int event) {
+  wal_t* wal = ctx;
+  char key[WAL_MAX_KEY + 1];
+
+  if ((event == HT_VALUE_REMOVED) || !wal->attached) {
+    return;
+  }
+  const int key_len = wal->key_fn(value, key);
+  if ((key_len <= 0) || (key_len > WAL_MAX_KEY)) {
+    wal->error = 1;
+    return;
+  }
+
+  if (wal_append(wal, (event == HT_VALUE_ADDED) ? WAL_OP_PUT : WAL_OP_DEL, key, key_len,
+                 (event == HT_VALUE_ADDED) ? value : NULL) != 0) {
+    wal->error = 1;
+  }
+}
+
+
+/**
+ * wal_append() - appends a record to the buffer
+ *
+ * Wakes the flusher once a group is full.  If the buffer has no room left (the
+ * disk is behind) the writer commits it itself.  If the log has grown to
+ * WAL_COMPACT_RATIO times the table it is compacted before the record is
+ * appended, so a deleted key is still in the table, goes into the new log and
+ * is deleted by the record.  A failed compaction sets wal->error and isn't
+ * tried again until the log has grown by another WAL_COMPACT_MIN_BYTES.
+ *
+ * @param wal is a pointer to the log
+ * @param op is WAL_OP_PUT or WAL_OP_DEL
+ * @param key is the key
+ * @param key_len is the length of key
+ * @param value is the value for a put (NULL for a delete)
+ *
+ * @return 0 on success, -1 if the buffer couldn't be committed
+ */
+static int wal_append(wal_t* wal, const int op, const void* key, const int key_len, const void* value) {
+  const size_t size = sizeof(wal_record) + (size_t)key_len + wal->value_size;
+  const uint64_t live_bytes = (uint64_t)wal->ht->count * size;
+
+  pthread_mutex_lock(&wal->lock);
+  if ((wal->file_bytes > WAL_COMPACT_MIN_BYTES) && (wal->file_bytes > WAL_COMPACT_RATIO * live_bytes) &&
+      (wal->file_bytes > wal->compact_after)) {
+    pthread_mutex_unlock(&wal->lock);
+    const int compacted = wal_compact(wal);
+    pthread_mutex_lock(&wal->lock);
+    if (compacted != 0) {
+      // the old log is kept; back off instead of walking the table on every append
+      wal->error = 1;
+      wal->compact_after = wal->file_bytes + WAL_COMPACT_MIN_BYTES;
+      #if (_DEBUG_ > 0)
+        fprintf(stderr, "ERROR(wal_append()): Could not compact %s\n", wal->path);
+      #endif
+    }
+  }
+  while (wal->used + size > WAL_BUFFER_SIZE) {
+    pthread_mutex_unlock(&wal->lock);
+    if (wal_commit(wal) != 0) {
+      return -1;
+    }
+    pthread_mutex_lock(&wal->lock);
+  }
+  if (wal->pending == 0) {
+    wal->oldest_ns = wal_now_ns();
+  }
+  wal->used += wal_encode(wal->buf + wal->used, op, key, key_len, value, wal->value_size);
+  // once per group, the flusher may not get to run before the next record
+  if (++wal->pending == WAL_GROUP_RECORDS) {
+    pthread_cond_signal(&wal->wake);
+  }
+  pthread_mutex_unlock(&wal->lock);
+  return 0;
+}
+
+
+/**
+ * wal_encode() - writes a record into memory
+ *
+ * @param p is where the record goes
+ * @param op is WAL_OP_PUT, WAL_OP_DEL or WAL_OP_CLEAR
+ * @param key is the key (key_len bytes, no '\0')
+ * @param key_len is the length of key
+ * @param value is the value of a put, or NULL
+ * @param value_size is the size of a value
+ *
+ * @return the size of the record
+ */
+static size_t wal_encode(char* p, const int op, const void* key, const int key_len,
+                         const void* value, const size_t value_size) {
+  wal_record rec;
+
+  rec.op = (uint8_t)op;
+  rec.key_len = (uint8_t)key_len;
+  rec.value_len = (uint16_t)((value != NULL) ? value_size : 0);
+  rec.size = (uint32_t)(sizeof(rec) + (size_t)key_len + rec.value_len);
+  if (key_len > 0) {
+    memcpy(p + sizeof(rec), key, (size_t)key_len);
+  }
+  if (value != NULL) {
+    memcpy(p + sizeof(rec) + key_len, value, value_size);
+  }
+  rec.checksum = 0;
+  memcpy(p, &rec, sizeof(rec));
+  rec.checksum = wal_checksum(p + 2 * sizeof(uint32_t), rec.size - 2 * sizeof(uint32_t));
+  memcpy(p, &rec, sizeof(rec));
+  return rec.size;
+}
+
+
+/**
+ * wal_checksum() - checksum of the bytes of a record
+ *
+ * A Fletcher sum of 64-bit words (a running sum and a sum of the running sums,
+ * so the order of the words counts), mixed and folded to 32 bits at the end.
+ * It is there to catch a record that was only partly written, and its adds
+ * don't wait on each other the way the multiplies of a hash would.
+ *
+ * @param p is the first byte after the checksum field
+ * @param len is the number of bytes
+ *
+ * @return the checksum
+ */
+static uint32_t wal_checksum(const char* p, size_t len) {
+  uint64_t sum = HT_HASH_SEED ^ (uint64_t)len;
+  uint64_t sum2 = 0;
+  uint64_t word;
+
+  while (len >= sizeof(word)) {
+    memcpy(&word, p, sizeof(word));
+    sum += word;
+    sum2 += sum;
+    p += sizeof(word);
+    len -= sizeof(word);
+  }
+  if (len > 0) {
+    word = 0;
+    memcpy(&word, p, len);
+    sum += word;
+    sum2 += sum;
+  }
+  uint64_t hash = sum ^ (sum2 * 0x9E3779B97F4A7C15ULL);
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+
+/**
+ * wal_replay() - replays the records of a log into the table
+ *
+ * @param wal is a pointer to the log
+ * @param data is the whole log file
+ * @param size is the size of the file
+ *
+ * @return the end of the last good record, where the next record goes
+ */
+static uint64_t wal_replay(wal_t* wal, const char* data, const uint64_t size) {
+  uint64_t pos = sizeof(wal_file_header);
+  wal_record rec;
+
+  while (pos + sizeof(rec) <= size) {
+    memcpy(&rec, data + pos, sizeof(rec));
+    if ((rec.size < sizeof(rec)) || (rec.size > size - pos) ||
+        (rec.size != sizeof(rec) + rec.key_len + rec.value_len) ||
+        ((rec.value_len != 0) && (rec.value_len != wal->value_size)) ||
+        (rec.checksum != wal_checksum(data + pos + 2 * sizeof(uint32_t), rec.size - 2 * sizeof(uint32_t)))) {
+      break;
+    }
+    const char* key = data + pos + sizeof(rec);
+    if (wal_apply(wal, &rec, key, (rec.value_len != 0) ? key + rec.key_len : NULL) != 0) {
+      break;
+    }
+    wal->replayed++;
+    pos += rec.size;
+  }
+  return pos;
+}
+
+
+/**
+ * wal_apply() - applies a replayed record to the table
+ *
+ * A put changes the value in place if the key is already in the table (so the
+ * table's other observers see an update), otherwise it inserts a copy.
+ *
+ * @param wal is a pointer to the log
+ * @param rec is the record
+ * @param key is the key (rec->key_len bytes)
+ * @param value is the value of a put, or NULL
+ *
+ * @return 0 on success, -1 if the record doesn't fit this table or out of memory
+ */
+static int wal_apply(wal_t* wal, const wal_record* rec, const char* key, const char* value) {
+  ht_hash_table* ht = wal->ht;
+  const int packed = (ht->key_mode == HT_KEY_PACKED);
+  char str[WAL_MAX_KEY + 1];
+  ht_packed_key pk;
+
+  if (rec->op == WAL_OP_CLEAR) {
+    // collect the keys first, deleting moves the items the walk is on
+    const int count = ht->count;
+    int n = 0;
+    int index = 0;
+    char (*keys)[WAL_MAX_KEY + 1] = malloc((size_t)(count + 1) * sizeof(*keys));
+    if (keys == NULL) {
+      return -1;
+    }
+    for (ht_item* item = ht_next(ht, &index); (item != NULL) && (n < count); item = ht_next(ht, &index)) {
+      if (packed) {
+        memcpy(keys[n++], &item->key.packed, sizeof(ht_packed_key));
+      }
+      else if (strlen(ht_item_key(item)) <= WAL_MAX_KEY) {
+        strcpy(keys[n++], ht_item_key(item));
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      if (packed) {
+        memcpy(&pk, keys[i], sizeof(pk));
+        ht_delete_packed(ht, &pk);
+      }
+      else {
+        ht_delete(ht, keys[i]);
+      }
+    }
+    free(keys);
+    return 0;
+  }
+
+  if ((packed && (rec->key_len != sizeof(ht_packed_key))) || (rec->key_len > WAL_MAX_KEY)) {
+    return -1;
+  }
+  memcpy(packed ? (void*)&pk : (void*)str, key, rec->key_len);
+  str[rec->key_len] = '\0';
+  if (rec->op == WAL_OP_DEL) {
+    if (packed) {
+      ht_delete_packed(ht, &pk);
+    }
+    else {
+      ht_delete(ht, str);
+    }
+    return 0;
+  }
+  if (rec->op != WAL_OP_PUT) {
+    return -1;
+  }
+
+  void* found = packed ? ht_search_packed(ht, &pk) : ht_search(ht, str);
+  if ((found != NULL) && (value != NULL)) {
+    ht_begin_update(ht, found);
+    memcpy(found, value, wal->value_size);
+    ht_end_update(ht, found);
+    return 0;
+  }
+  void* copy = NULL;
+  if (value != NULL) {
+    if ((copy = ht_alloc_value(ht, wal->value_size)) == NULL) {
+      return -1;
+    }
+    memcpy(copy, value, wal->value_size);
+  }
+  if (packed) {
+    ht_insert_packed(ht, &pk, copy);
+  }
+  else if (ht_upsert(ht, str, copy) < 0) {
+    ht_free_value(ht, copy);
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+ * wal_write_all() - writes all of a buffer, retrying short writes
+ *
+ * @return 0 on success, -1 on error
+ */
+static int wal_write_all(const int fd, const char* p, size_t len) {
+  while (len > 0) {
+    const ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+
+/**
+ * wal_sync_dir() - syncs the directory that holds a file
+ *
+ * @param path is the file
+ *
+ * @return 0 on success, -1 on error
+ */
+static int wal_sync_dir(const char* path) {
+  char dir[FILENAME_MAX];
+  const char* slash = strrchr(path, '/');
+  if (slash == NULL) {
+    strcpy(dir, ".");
+  }
+  else if ((size_t)(slash - path) < sizeof(dir)) {
+    memcpy(dir, path, (size_t)(slash - path));
+    dir[(slash == path) ? 1 : slash - path] = '\0';
+  }
+  else {
+    return -1;
+  }
+  const int fd = open(dir, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  const int status = fsync(fd);
+  close(fd);
+  return status;
+}
+
+
+/**
+ * wal_open_file() - creates the log file or opens and reads an existing one
+ *
+ * @param wal is a pointer to the log, wal->fd is set to the open file
+ * @param data is set to the contents of an existing log (free it), or NULL
+ *
+ * @return the size of the file, -1 if it isn't a log of this table or can't be
+ * read or written
+ */
+static long wal_open_file(wal_t* wal, char** data) {
+  wal_file_header header;
+  struct stat st;
+
+  *data = NULL;
+  wal->fd = open(wal->path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if ((wal->fd < 0) || (fstat(wal->fd, &st) != 0)) {
+    return -1;
+  }
+
+  // a new log (or one that crashed before its header was written)
+  if ((size_t)st.st_size < sizeof(header)) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+    header.version = WAL_VERSION;
+    header.byte_order = WAL_BYTE_ORDER;
+    header.key_mode = (uint32_t)wal->ht->key_mode;
+    header.value_size = (uint32_t)wal->value_size;
+    if ((ftruncate(wal->fd, 0) != 0) || (wal_write_all(wal->fd, (const char*)&header, sizeof(header)) != 0) ||
+        (wal_datasync(wal->fd) != 0)) {
+      return -1;
+    }
+    wal_sync_dir(wal->path);
+    return (long)sizeof(header);
+  }
+
+  char* p = malloc((size_t)st.st_size);
+  if (p == NULL) {
+    return -1;
+  }
+  size_t got = 0;
+  while (got < (size_t)st.st_size) {
+    const ssize_t n = pread(wal->fd, p + got, (size_t)st.st_size - got, (off_t)got);
+    if (n <= 0) {
+      if ((n < 0) && (errno == EINTR)) {
+        continue;
+      }
+      free(p);
+      return -1;
+    }
+    got += (size_t)n;
+  }
+  memcpy(&header, p, sizeof(header));
+  if ((memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0) || (header.version != WAL_VERSION) ||
+      (header.byte_order != WAL_BYTE_ORDER) || (header.key_mode != (uint32_t)wal->ht->key_mode) ||
+      (header.value_size != (uint32_t)wal->value_size)) {
+    free(p);
+    return -1;
+  }
+  *data = p;
+  return (long)st.st_size;
+}
+
+
+/**
+ * wal_flusher() - the flusher thread
+ *
+ * Commits when the writer says a group is full, or when the oldest buffered
+ * record has waited WAL_GROUP_WINDOW_MS.
+ *
+ * @param arg is the log
+ */
+static void* wal_flusher(void* arg) {
+  wal_t* wal = arg;
+  const double window_ns = WAL_GROUP_WINDOW_MS * 1e6;
+
+  pthread_mutex_lock(&wal->lock);
+  while (!wal->stop) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += WAL_GROUP_WINDOW_MS * 1000000L / 2;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&wal->wake, &wal->lock, &deadline);
+    if ((wal->pending >= WAL_GROUP_RECORDS) ||
+        ((wal->pending > 0) && (wal_now_ns() - wal->oldest_ns >= window_ns))) {
+      pthread_mutex_unlock(&wal->lock);
+      wal_commit(wal);
+      pthread_mutex_lock(&wal->lock);
+    }
+  }
+  pthread_mutex_unlock(&wal->lock);
+  return NULL;
+}
+
+
+/**
+ * wal_now_ns() - reads the monotonic clock
+ *
+ * @return the current time in nanoseconds
+ */
+static double wal_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
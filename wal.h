@@ -0,0 +1,101 @@
+/**
+ * wal.h - Write-ahead log header file
+ *
+ * @brief   This is the header file for an append-only log that makes the
+ * changes to a hash table durable.  The log registers itself as an observer
+ * of the table, so every ht_insert(), ht_delete() and in-place update
+ * (ht_begin_update()/ht_end_update()) is recorded without changing the code
+ * that makes it.  A value that is added or changed is recorded as a put of the
+ * key and a copy of the value, a deleted key as a delete.  Replaying a put or a
+ * delete twice gives the same table, so a record can safely be replayed on
+ * top of a newer state.
+ *
+ * Records are buffered and written by group commit: a flusher thread does one
+ * write() and one fdatasync() for every WAL_GROUP_RECORDS records, or once the
+ * oldest record has waited WAL_GROUP_WINDOW_MS, so the thread changing the
+ * table never waits for the disk.  A change is durable once wal_commit() has
+ * returned or the window has passed, so a crash loses at most the last window
+ * of changes.
+ *
+ * wal_open() replays the log into the table.  A torn record at the end (from a
+ * crash in the middle of a write) is dropped.  When the log grows to
+ * WAL_COMPACT_RATIO times the size of the table it is compacted: the whole
+ * table is written to a new log (a snapshot of the table in the log's own
+ * format, which can be replayed into a writable table) that atomically
+ * replaces the old one.
+*/
+
+#ifndef _WAL_H_
+#define _WAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "hash_table.h"
+
+// constants
+#define WAL_VERSION             1
+#define WAL_MAX_KEY             64      // longest key in bytes
+#define WAL_GROUP_RECORDS       1024    // commit after this many records
+#define WAL_GROUP_WINDOW_MS     5       // or once the oldest record has waited this long
+#define WAL_BUFFER_SIZE         (1024 * 1024)          // per buffer, room for a group while the last one syncs
+#define WAL_COMPACT_MIN_BYTES   (4L * 1024 * 1024)   // never compact a smaller log
+#define WAL_COMPACT_RATIO       4       // compact when the log is this many times the table
+
+// gets the key of a value in the table: a '\0' terminated string for a string
+// key table (returns its length) or an ht_packed_key (returns its size).
+// key has room for WAL_MAX_KEY bytes.  Returns -1 if the value has no key
+typedef int (*wal_key_fn)(const void* value, void* key);
+
+// struct containing the log
+typedef struct {
+  ht_hash_table* ht;
+  wal_key_fn key_fn;
+  size_t value_size;
+  char* path;
+  int fd;
+  int attached;               // 0 while ht_add_observer() reports the table's values
+
+  // records waiting for the next commit.  The writer appends to buf while the
+  // committer writes the other buffer, io_lock keeps the commits in order
+  pthread_mutex_t lock;
+  pthread_mutex_t io_lock;
+  char* buf;
+  char* spare;
+  size_t used;
+  int pending;                // records in buf
+  double oldest_ns;           // when the oldest record in buf was added
+  int error;                  // a write failed, the log is no longer durable
+
+  // flusher thread, woken when a group is full
+  pthread_t flusher;
+  pthread_cond_t wake;
+  int stop;
+
+  uint64_t file_bytes;        // size of the log file, counting what is committed
+  uint64_t compact_after;     // after a failed compaction, don't retry until the log is past this
+  long records;               // records written since wal_open()
+  long commits;
+  long compactions;
+  long replayed;              // records replayed by wal_open()
+} wal_t;
+
+
+// API function prototypes
+
+// opens (or creates) the log of a hash table and replays it into the table
+wal_t* wal_open(const char* path, ht_hash_table* ht, const size_t value_size, wal_key_fn key_fn);
+
+// commits what is left and closes the log
+int wal_close(wal_t* wal);
+
+// writes the buffered records and waits for them to reach the disk
+int wal_commit(wal_t* wal);
+
+// rewrites the log as the current contents of the table
+int wal_compact(wal_t* wal);
+
+// the ht_observer that wal_open() registers, records a change to the table
+void wal_observe(void* ctx, void* value, const int event);
+
+#endif